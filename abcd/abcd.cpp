@@ -99,6 +99,7 @@ void print_usage(const std::string &name = std::string("abcd")) {
     std::cout << defaults_abcd_events_buffer_max_size << std::endl;
     std::cout << "\t-p <publish_timeout>: Defines the maximum time in seconds between subsequent publications, default: ";
     std::cout << defaults_abcd_publish_timeout << std::endl;
+    std::cout << "\t-R <file_name>: Save the raw readout buffers to a capture file, to be replayed with abcd_decoder" << std::endl;
     std::cout << "\t-v: Set verbose execution" << std::endl;
 
     return;
@@ -131,9 +132,10 @@ int main(int argc, char *argv[])
     unsigned int CONET_node = defaults_abcd_CONET_node;
     unsigned int VME_address = defaults_abcd_VME_address;
     unsigned int events_buffer_max_size = defaults_abcd_events_buffer_max_size;
+    std::string capture_file_name;
 
     int c = 0;
-    while ((c = getopt(argc, argv, "hS:D:C:f:T:c:l:n:V:B:p:v")) != -1) {
+    while ((c = getopt(argc, argv, "hS:D:C:f:T:c:l:n:V:B:p:R:v")) != -1) {
         switch (c) {
             case 'h':
                 print_usage(argv[0]);
@@ -179,6 +181,9 @@ int main(int argc, char *argv[])
             case 'p':
                 publish_timeout = std::stof(optarg);
                 break;
+            case 'R':
+                capture_file_name = optarg;
+                break;
             default:
                 std::cout << "Unknown command: " << c << std::endl;
                 break;
@@ -194,6 +199,7 @@ int main(int argc, char *argv[])
     global_status.VME_address = VME_address;
     global_status.events_buffer_max_size = events_buffer_max_size;
     global_status.config_file = config_file;
+    global_status.capture_file_name = capture_file_name;
     global_status.status_address = status_address;
     global_status.data_address = data_address;
     global_status.commands_address = commands_address;
@@ -0,0 +1,268 @@
+/*
+ * (C) Copyright 2026 European Union, Cristiano Lino Fontana
+ *
+ * This file is part of ABCD.
+ *
+ * ABCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ABCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <string>
+
+#include <cstdint>
+
+// For getopt()
+#include <unistd.h>
+
+#include "events.hpp"
+#include "waveforms_buffer.hpp"
+#include "caen_decoder.hpp"
+
+void print_usage(const char *name);
+
+int main(int argc, char *argv[])
+{
+    unsigned int verbosity = 0;
+    unsigned int iterations = 1;
+    std::string events_file_name;
+    std::string waveforms_file_name;
+
+    int c = 0;
+    while ((c = getopt(argc, argv, "hvi:e:w:")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 'i':
+            iterations = std::stoul(optarg);
+            break;
+        case 'e':
+            events_file_name = optarg;
+            break;
+        case 'w':
+            waveforms_file_name = optarg;
+            break;
+        case 'v':
+            verbosity += 1;
+            break;
+        default:
+            std::cout << "Unknown command: " << c << std::endl;
+            break;
+        }
+    }
+
+    if (argc <= optind)
+    {
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    const std::string input_file_name(argv[optind]);
+
+    std::ifstream input_file(input_file_name, std::ios::binary);
+
+    if (!input_file)
+    {
+        std::cerr << "ERROR: Unable to open input file" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    caen_decoder::settings settings;
+
+    if (!caen_decoder::read_capture_header(input_file, settings))
+    {
+        std::cerr << "ERROR: Input file is not a valid capture file" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    if (verbosity > 0)
+    {
+        std::cout << "Input file name: " << input_file_name << std::endl;
+        std::cout << "Model: " << settings.model << std::endl;
+        std::cout << "DPP firmware version: " << settings.dpp_version << std::endl;
+        std::cout << "Number of channels: " << settings.channels_number << std::endl;
+        std::cout << "Flag extended timestamp: " << settings.flag_tt64 << std::endl;
+        std::cout << "Scope enable: " << settings.enabled_waveforms << std::endl;
+        std::cout << "Show gates: " << settings.show_gates << std::endl;
+        std::cout << "Offset step: " << settings.offset_step << std::endl;
+    }
+
+    if (settings.dpp_version != 0 && settings.dpp_version != 3)
+    {
+        std::cerr << "ERROR: Unsupported firmware (DPP version: " << settings.dpp_version << ")" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    // All the readout buffers are loaded in memory beforehand, so that the
+    // benchmark measures only the decoding
+    std::vector<std::vector<char>> readout_buffers;
+    size_t total_bytes = 0;
+
+    std::vector<char> readout_buffer;
+
+    while (caen_decoder::read_readout_buffer(input_file, readout_buffer))
+    {
+        total_bytes += readout_buffer.size();
+        readout_buffers.push_back(readout_buffer);
+    }
+
+    input_file.close();
+
+    if (verbosity > 0)
+    {
+        std::cout << "Readout buffers: " << readout_buffers.size() << "; ";
+        std::cout << "Total size: " << total_bytes << " B" << std::endl;
+    }
+
+    std::ofstream events_file;
+    std::ofstream waveforms_file;
+
+    if (events_file_name.length() > 0)
+    {
+        events_file.open(events_file_name, std::ios::binary);
+    }
+    if (waveforms_file_name.length() > 0)
+    {
+        waveforms_file.open(waveforms_file_name, std::ios::binary);
+    }
+
+    caen_decoder::timestamps timestamps;
+    caen_decoder::counters counters;
+
+    std::vector<std::vector<struct caen_decoder::PSD_event>> PSD_events;
+    std::vector<struct event_PSD> events_buffer;
+    std::vector<uint8_t> waveforms_buffer;
+
+    size_t total_events = 0;
+    size_t total_waveforms = 0;
+    size_t errors = 0;
+
+    std::chrono::duration<double> decoding_time(0);
+
+    for (unsigned int iteration = 0; iteration < iterations; iteration++)
+    {
+        // Every iteration replays the acquisition from its start
+        timestamps.reset(settings.channels_number);
+        counters.reset(settings.channels_number);
+
+        for (const auto &buffer: readout_buffers)
+        {
+            events_buffer.clear();
+            waveforms_buffer.clear();
+
+            waveforms_buffer::writer waveforms(waveforms_buffer);
+
+            const auto decoding_start = std::chrono::high_resolution_clock::now();
+
+            int64_t events_number = 0;
+
+            if (settings.dpp_version == 0)
+            {
+                events_number = caen_decoder::decode_STD(buffer.data(), buffer.size(),
+                                                         settings, timestamps, counters,
+                                                         waveforms);
+            }
+            else
+            {
+                events_number = caen_decoder::decode_PSD(buffer.data(), buffer.size(),
+                                                         settings, timestamps, counters,
+                                                         PSD_events, events_buffer,
+                                                         waveforms);
+            }
+
+            const auto decoding_end = std::chrono::high_resolution_clock::now();
+            decoding_time += decoding_end - decoding_start;
+
+            if (events_number < 0)
+            {
+                errors += 1;
+
+                if (verbosity > 0)
+                {
+                    std::cout << "Malformed readout buffer of size: " << buffer.size() << " B" << std::endl;
+                }
+            }
+            else
+            {
+                total_events += events_number;
+            }
+
+            total_waveforms += waveforms.get_records_number();
+
+            // The decoded data is saved only once
+            if (iteration == 0)
+            {
+                if (events_file.is_open())
+                {
+                    events_file.write(reinterpret_cast<const char *>(events_buffer.data()),
+                                      events_buffer.size() * sizeof(struct event_PSD));
+                }
+                if (waveforms_file.is_open())
+                {
+                    waveforms_file.write(reinterpret_cast<const char *>(waveforms_buffer.data()),
+                                         waveforms_buffer.size());
+                }
+            }
+        }
+    }
+
+    const double seconds = decoding_time.count();
+
+    std::cout << "Iterations: " << iterations << std::endl;
+    std::cout << "Decoded events: " << total_events << std::endl;
+    std::cout << "Decoded waveforms: " << total_waveforms << std::endl;
+    std::cout << "Malformed buffers: " << errors << std::endl;
+    std::cout << "Decoding time: " << seconds << " s" << std::endl;
+
+    if (seconds > 0)
+    {
+        std::cout << "Throughput: " << (total_bytes * iterations) / seconds / 1e6 << " MB/s; ";
+        std::cout << total_events / seconds / 1e6 << " Mevents/s" << std::endl;
+    }
+
+    for (unsigned int ch = 0; ch < counters.counts.size(); ch++)
+    {
+        std::cout << "Channel: " << ch << "; ";
+        std::cout << "counts: " << counters.counts[ch] << "; ";
+        std::cout << "ICR counts: " << counters.ICR_counts[ch] << std::endl;
+    }
+
+    return errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void print_usage(const char *name)
+{
+    std::cout << "Usage: " << name << " [options] <file_name>" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Replays the CAEN readout buffers captured by abcd (with its -R option)," << std::endl;
+    std::cout << "decoding them without the CAEN libraries and measuring the decoding throughput." << std::endl;
+    std::cout << "The counts in the output refer to the last iteration." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Optional arguments:" << std::endl;
+    std::cout << "\t-h: Display this message" << std::endl;
+    std::cout << "\t-i <iterations>: Number of times that the file is decoded, default: 1" << std::endl;
+    std::cout << "\t-e <file_name>: Save the decoded events to an ABCD events file (ade)" << std::endl;
+    std::cout << "\t-w <file_name>: Save the decoded waveforms to an ABCD waveforms file (adw)" << std::endl;
+    std::cout << "\t-v: Set verbose execution, using it multiple times increases the verbosity" << std::endl;
+
+    return;
+}
@@ -0,0 +1,410 @@
+/*
+ * (C) Copyright 2026 European Union, Cristiano Lino Fontana
+ *
+ * This file is part of ABCD.
+ *
+ * ABCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ABCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CAEN_DECODER_HPP__
+#define __CAEN_DECODER_HPP__ 1
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "events.hpp"
+#include "waveforms_buffer.hpp"
+
+// Decoding of the readout buffers of CAEN digitizers, without the CAEN
+// libraries. It is used to replay offline the readout buffers captured by
+// abcd, in order to test and optimize the decoding.
+// The conversion of the CAEN events to the ABCD events and waveforms is
+// shared with abcd: the live path calls the same templates on the structures
+// returned by the CAEN libraries, while the offline path calls them on the
+// structures decoded here, that have the same members.
+
+// Maximum number of channels of the STD events, as in the CAEN libraries
+#define CAEN_DECODER_MAX_CHANNELS 64
+
+namespace caen_decoder
+{
+    // Parameters of the acquisition that are needed to decode the buffers
+    struct settings
+    {
+        uint16_t dpp_version = 0;
+        uint32_t model = 0;
+        uint32_t channels_number = 0;
+        bool flag_tt64 = false;
+        bool enabled_waveforms = false;
+        bool show_gates = false;
+        uint64_t offset_step = 0x40000000;
+    };
+
+    // Status of the 64-bit timestamps reconstruction of each channel
+    struct timestamps
+    {
+        std::vector<uint64_t> previous_timestamp;
+        std::vector<uint64_t> time_offset;
+
+        inline void reset(unsigned int channels_number)
+        {
+            previous_timestamp.assign(channels_number, 0);
+            time_offset.assign(channels_number, 0);
+        }
+    };
+
+    // Counters updated by the decoding, with the same names of the ones in
+    // the status of abcd
+    struct counters
+    {
+        std::vector<unsigned long> counts;
+        std::vector<unsigned long> partial_counts;
+        std::vector<unsigned long> ICR_counts;
+
+        inline void reset(unsigned int channels_number)
+        {
+            counts.assign(channels_number, 0);
+            partial_counts.assign(channels_number, 0);
+            ICR_counts.assign(channels_number, 0);
+        }
+    };
+
+    // A STD event as decoded from the readout buffer.
+    // The members have the same names of the CAEN_DGTZ_UINT16_EVENT_t.
+    struct STD_event
+    {
+        uint32_t ChSize[CAEN_DECODER_MAX_CHANNELS];
+        uint16_t *DataChannel[CAEN_DECODER_MAX_CHANNELS];
+
+        // Storage of the samples of all the channels
+        std::vector<uint16_t> samples;
+    };
+
+    // A DPP-PSD event as decoded from the readout buffer.
+    // The members have the same names of the CAEN_DGTZ_DPP_PSD_Event_t.
+    struct PSD_event
+    {
+        uint32_t Format;
+        uint32_t TimeTag;
+        int16_t ChargeShort;
+        int16_t ChargeLong;
+        int16_t Baseline;
+        int16_t Pur;
+        const uint32_t *Waveforms;
+        uint32_t Extras;
+    };
+
+    // The waveforms of a DPP-PSD event.
+    // The members have the same names of the CAEN_DGTZ_DPP_PSD_Waveforms_t,
+    // the traces point to the storage vectors.
+    struct PSD_waveforms
+    {
+        uint32_t Ns = 0;
+        uint8_t dualTrace = 0;
+        uint16_t *Trace1 = nullptr;
+        uint16_t *Trace2 = nullptr;
+        uint8_t *DTrace1 = nullptr;
+        uint8_t *DTrace2 = nullptr;
+        uint8_t *DTrace3 = nullptr;
+        uint8_t *DTrace4 = nullptr;
+
+        std::vector<uint16_t> analog_traces;
+        std::vector<uint8_t> digital_traces;
+
+        PSD_waveforms() = default;
+        PSD_waveforms(const PSD_waveforms &) = delete;
+        PSD_waveforms &operator=(const PSD_waveforms &) = delete;
+
+        inline void resize(uint32_t samples_number)
+        {
+            Ns = samples_number;
+
+            analog_traces.resize(2 * samples_number);
+            digital_traces.resize(4 * samples_number);
+
+            Trace1 = analog_traces.data();
+            Trace2 = analog_traces.data() + samples_number;
+            DTrace1 = digital_traces.data();
+            DTrace2 = digital_traces.data() + samples_number;
+            DTrace3 = digital_traces.data() + 2 * samples_number;
+            DTrace4 = digital_traces.data() + 3 * samples_number;
+        }
+    };
+
+    //! Reconstruction of the 64-bit timestamp for the STD firmware
+    inline uint64_t STD_timestamp(uint32_t TriggerTimeTag,
+                                  unsigned int ch,
+                                  uint64_t *previous_timestamp,
+                                  uint64_t *time_offset,
+                                  uint64_t offset_step)
+    {
+        const uint64_t trigger_time_tag = TriggerTimeTag & 0x3FFFFFFF;
+
+        if (trigger_time_tag < previous_timestamp[ch])
+        {
+            time_offset[ch] += offset_step;
+        }
+        previous_timestamp[ch] = trigger_time_tag;
+
+        return trigger_time_tag + time_offset[ch];
+    }
+
+    //! Reading the ICR flag from Extra word in the DPP firmware
+    //! When the flag is seen the digitizer's input counter saw 1024 events
+    template <typename event_t>
+    inline bool PSD_ICR_flag(const event_t &event)
+    {
+        return (((uint64_t)event.Extras) >> 13) & 1;
+    }
+
+    //! Reconstruction of the 64-bit timestamp for the DPP-PSD firmware.
+    //! The returned timestamp is shifted by 10 bits to fit the fine time tag.
+    template <typename event_t>
+    inline uint64_t PSD_timestamp(const event_t *events,
+                                  uint32_t i,
+                                  uint32_t events_number,
+                                  unsigned int ch,
+                                  bool flag_tt64,
+                                  uint64_t *previous_timestamp,
+                                  uint64_t *time_offset)
+    {
+        // 64-bit timestamp management
+        uint64_t timestamp64bit;
+        uint64_t fine_timestamp = 0;
+
+        if (flag_tt64)
+        {
+            timestamp64bit = (events[i].TimeTag & 0x7FFFFFFF) |
+                             ((((uint64_t)events[i].Extras) & 0xFFFF0000) << 15);
+
+            fine_timestamp = events[i].Extras & 0x3FF;
+
+            // corrections for isolated 4 s jumps in future
+            // LSB of Extras (bit 31 of 64 bit timestamp) flips to 1 (shark peak)
+            if ((previous_timestamp[ch] + ((uint64_t)(1 << 30)) < timestamp64bit) &&
+                (i + 1 < events_number))
+            {
+                // jump greater than 4 seconds && we have following event to check
+                uint64_t nexttag64bit = (events[i + 1].TimeTag & 0x7FFFFFFF) |
+                                        ((((uint64_t)events[i + 1].Extras) & 0xFFFF0000) << 15);
+                if (nexttag64bit + ((uint64_t)1 << 30) < timestamp64bit)
+                {
+                    timestamp64bit -= ((uint64_t)1 << 31);
+                }
+            }
+
+            // This is to check if there is a jump of more than 4.3 s to the past
+            if (timestamp64bit + ((uint64_t)1 << 31) < previous_timestamp[ch])
+            {
+                time_offset[ch] += ((uint64_t)1 << 47);
+            }
+        }
+        else
+        {
+            // x720
+            timestamp64bit = (events[i].TimeTag & 0x3FFFFFFF);
+
+            if (timestamp64bit < previous_timestamp[ch])
+            {
+                time_offset[ch] += 0x40000000;
+            }
+        } // end if for 64-bit timestamp
+
+        previous_timestamp[ch] = timestamp64bit;
+        // end 64-bit timestamp management
+
+        const uint64_t temporary_timestamp = (previous_timestamp[ch] + time_offset[ch]);
+
+        // The timestamp is shifted by 10 bits to fit the fine time tag that
+        // we get from the DCFD of the v1730s
+        return (temporary_timestamp << 10) + fine_timestamp;
+    }
+
+    //! Stores the waveforms of the channels of a STD event.
+    //! The event can be a CAEN_DGTZ_UINT16_EVENT_t or a STD_event.
+    template <typename event_t, typename counters_t>
+    inline void STD_store_event(const event_t &event,
+                                uint32_t TriggerTimeTag,
+                                unsigned int channels_number,
+                                uint64_t *previous_timestamp,
+                                uint64_t *time_offset,
+                                uint64_t offset_step,
+                                counters_t &the_counters,
+                                waveforms_buffer::writer &waveforms)
+    {
+        // loop on channels
+        for (unsigned int ch = 0; ch < channels_number; ch++)
+        {
+            const uint32_t samples_number = event.ChSize[ch];
+
+            if (samples_number > 0)
+            {
+                const uint64_t timestamp = STD_timestamp(TriggerTimeTag, ch,
+                                                         previous_timestamp, time_offset,
+                                                         offset_step);
+                const uint8_t channel = ch;
+
+                the_counters.counts[channel] += 1;
+                the_counters.partial_counts[channel] += 1;
+
+                uint16_t *const samples = waveforms.append(timestamp, channel, samples_number);
+
+                memcpy(samples,
+                       event.DataChannel[ch],
+                       samples_number * sizeof(uint16_t));
+            }
+        }
+    }
+
+    //! Stores the i-th DPP-PSD event of a channel in the events buffer and
+    //! returns its timestamp.
+    //! The events can be CAEN_DGTZ_DPP_PSD_Event_t or PSD_event.
+    template <typename event_t, typename counters_t>
+    inline uint64_t PSD_store_event(const event_t *events,
+                                    uint32_t i,
+                                    uint32_t events_number,
+                                    unsigned int ch,
+                                    bool flag_tt64,
+                                    uint64_t *previous_timestamp,
+                                    uint64_t *time_offset,
+                                    counters_t &the_counters,
+                                    std::vector<struct event_PSD> &events_buffer)
+    {
+        if (PSD_ICR_flag(events[i]))
+        {
+            the_counters.ICR_counts[ch] += 1024;
+        }
+
+        const uint64_t timestamp = PSD_timestamp(events, i, events_number, ch,
+                                                 flag_tt64,
+                                                 previous_timestamp, time_offset);
+
+        const uint16_t qshort = 0 + events[i].ChargeShort;
+        const uint16_t qlong = 0 + events[i].ChargeLong;
+        const uint16_t baseline = events[i].Baseline;
+        const uint8_t channel = ch;
+        const uint8_t group_counter = events[i].Pur;
+
+        events_buffer.emplace_back(timestamp, qshort, qlong, baseline, channel, group_counter);
+
+        the_counters.counts[channel] += 1;
+        the_counters.partial_counts[channel] += 1;
+
+        return timestamp;
+    }
+
+    //! Stores the waveforms of a DPP-PSD event, only the first analog trace
+    //! is stored and the digital traces are stored as the gates.
+    //! The waveforms can be CAEN_DGTZ_DPP_PSD_Waveforms_t or PSD_waveforms.
+    template <typename waveforms_t>
+    inline void PSD_store_waveforms(const waveforms_t &event_waveforms,
+                                    uint64_t timestamp,
+                                    uint8_t channel,
+                                    bool show_gates,
+                                    waveforms_buffer::writer &waveforms)
+    {
+        const uint32_t samples_number = event_waveforms.Ns;
+
+        // Without samples the traces might be null pointers, only the
+        // header of the record is written
+        if (show_gates)
+        {
+            uint16_t *const samples = waveforms.append(timestamp, channel, samples_number, 4);
+
+            if (samples_number > 0)
+            {
+                memcpy(samples,
+                       event_waveforms.Trace1,
+                       samples_number * sizeof(uint16_t));
+
+                // Reading the gates waveforms
+                memcpy(waveforms.additional(0),
+                       event_waveforms.DTrace1,
+                       samples_number * sizeof(uint8_t));
+                memcpy(waveforms.additional(1),
+                       event_waveforms.DTrace2,
+                       samples_number * sizeof(uint8_t));
+                memcpy(waveforms.additional(2),
+                       event_waveforms.DTrace3,
+                       samples_number * sizeof(uint8_t));
+                memcpy(waveforms.additional(3),
+                       event_waveforms.DTrace4,
+                       samples_number * sizeof(uint8_t));
+            }
+        }
+        else
+        {
+            uint16_t *const samples = waveforms.append(timestamp, channel, samples_number);
+
+            if (samples_number > 0)
+            {
+                memcpy(samples,
+                       event_waveforms.Trace1,
+                       samples_number * sizeof(uint16_t));
+            }
+        }
+    }
+
+    //! Decodes a readout buffer of the STD firmware, as
+    //! CAEN_DGTZ_GetEventInfo() and CAEN_DGTZ_DecodeEvent() do.
+    //! Only the digitizers that pack two samples per 32-bit word are
+    //! supported (e.g. x720, x724, x725, x730), without zero suppression.
+    //! Returns the number of decoded events or -1 if the buffer is malformed.
+    int64_t decode_STD(const char *buffer, uint32_t size,
+                       const settings &the_settings,
+                       timestamps &the_timestamps,
+                       counters &the_counters,
+                       waveforms_buffer::writer &waveforms);
+
+    //! Splits a readout buffer of the DPP-PSD firmware in the events of
+    //! each channel, as CAEN_DGTZ_GetDPPEvents() does.
+    //! The format is the one of the x725 and x730 families, with the time
+    //! tag and the charge always enabled. The samples and the extras words
+    //! are present according to the ES and EE flags of the format word.
+    //! Returns the number of decoded events or -1 if the buffer is malformed.
+    int64_t get_PSD_events(const char *buffer, uint32_t size,
+                           const settings &the_settings,
+                           std::vector<std::vector<struct PSD_event>> &events);
+
+    //! Decodes the waveforms of a DPP-PSD event, as
+    //! CAEN_DGTZ_DecodeDPPWaveforms() does.
+    //! In dual trace mode the samples alternate between the two analog
+    //! probes, each sample is then repeated twice in its trace.
+    void decode_PSD_waveforms(const struct PSD_event &event,
+                              struct PSD_waveforms &event_waveforms);
+
+    //! Decodes a readout buffer of the DPP-PSD firmware, storing the events
+    //! and the waveforms as abcd does.
+    //! Returns the number of decoded events or -1 if the buffer is malformed.
+    int64_t decode_PSD(const char *buffer, uint32_t size,
+                       const settings &the_settings,
+                       timestamps &the_timestamps,
+                       counters &the_counters,
+                       std::vector<std::vector<struct PSD_event>> &events,
+                       std::vector<struct event_PSD> &events_buffer,
+                       waveforms_buffer::writer &waveforms);
+
+    // Capture files start with a header containing the decoding settings,
+    // followed by the readout buffers each one preceded by its size in bytes
+    // as a uint32_t.
+    bool write_capture_header(std::ofstream &file, const settings &the_settings);
+    bool read_capture_header(std::ifstream &file, settings &the_settings);
+    bool write_readout_buffer(std::ofstream &file, const char *buffer, uint32_t size);
+    bool read_readout_buffer(std::ifstream &file, std::vector<char> &buffer);
+}
+
+#endif
@@ -0,0 +1,418 @@
+/*
+ * (C) Copyright 2026 European Union, Cristiano Lino Fontana
+ *
+ * This file is part of ABCD.
+ *
+ * ABCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ABCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+
+#include "events.hpp"
+#include "waveforms_buffer.hpp"
+#include "caen_decoder.hpp"
+
+#define CAPTURE_MAGIC "ABCDCAEN"
+#define CAPTURE_MAGIC_SIZE 8
+#define CAPTURE_VERSION 0
+
+#define CAPTURE_FLAG_TT64 0x1
+#define CAPTURE_FLAG_WAVEFORMS 0x2
+#define CAPTURE_FLAG_GATES 0x4
+
+// Every event or aggregate starts with a header word with this tag
+#define HEADER_TAG 0xA
+#define HEADER_WORDS 4
+// The channels mask of the standard firmware has at most 16 bits
+#define MASK_CHANNELS 16
+
+int64_t caen_decoder::decode_STD(const char *buffer, uint32_t size,
+                                 const settings &the_settings,
+                                 timestamps &the_timestamps,
+                                 counters &the_counters,
+                                 waveforms_buffer::writer &waveforms)
+{
+    const uint32_t words_number = size / sizeof(uint32_t);
+
+    // The x720 has 12 bit samples, the other models 14 bit samples
+    const uint32_t sample_mask = (the_settings.model == 720) ? 0x0FFF : 0x3FFF;
+    // Only the x725 and x730 have 16 channels, that need a second byte in
+    // the channels mask
+    const bool extended_mask = (the_settings.model == 725 || the_settings.model == 730);
+
+    const unsigned int channels_number = std::min<unsigned int>(the_settings.channels_number, CAEN_DECODER_MAX_CHANNELS);
+
+    struct STD_event event;
+
+    int64_t events_number = 0;
+    uint32_t offset = 0;
+
+    while (offset + HEADER_WORDS <= words_number)
+    {
+        uint32_t header[HEADER_WORDS];
+        memcpy(header, buffer + offset * sizeof(uint32_t), sizeof(header));
+
+        const uint32_t event_size = header[0] & 0x0FFFFFFF;
+
+        if ((header[0] >> 28) != HEADER_TAG || event_size < HEADER_WORDS || offset + event_size > words_number)
+        {
+            return -1;
+        }
+
+        uint32_t channels_mask = header[1] & 0xFF;
+
+        if (extended_mask)
+        {
+            channels_mask |= ((header[2] >> 24) & 0xFF) << 8;
+        }
+
+        const uint32_t enabled_channels = __builtin_popcount(channels_mask);
+        const uint32_t words_per_channel = (enabled_channels > 0) ? (event_size - HEADER_WORDS) / enabled_channels : 0;
+        const uint32_t samples_number = words_per_channel * 2;
+
+        event.samples.resize(enabled_channels * samples_number);
+
+        const char *data = buffer + (offset + HEADER_WORDS) * sizeof(uint32_t);
+        uint16_t *samples = event.samples.data();
+
+        for (unsigned int ch = 0; ch < CAEN_DECODER_MAX_CHANNELS; ch++)
+        {
+            if (ch >= MASK_CHANNELS || !((channels_mask >> ch) & 1))
+            {
+                event.ChSize[ch] = 0;
+                event.DataChannel[ch] = nullptr;
+
+                continue;
+            }
+
+            // The record of a channel beyond the configured ones is skipped,
+            // but it is still in the data
+            if (ch >= channels_number)
+            {
+                event.ChSize[ch] = 0;
+                event.DataChannel[ch] = nullptr;
+
+                data += words_per_channel * sizeof(uint32_t);
+                samples += samples_number;
+
+                continue;
+            }
+
+            event.ChSize[ch] = samples_number;
+            event.DataChannel[ch] = samples;
+
+            for (uint32_t word_index = 0; word_index < words_per_channel; word_index++)
+            {
+                uint32_t word;
+                memcpy(&word, data + word_index * sizeof(uint32_t), sizeof(word));
+
+                samples[word_index * 2] = word & sample_mask;
+                samples[word_index * 2 + 1] = (word >> 16) & sample_mask;
+            }
+
+            data += words_per_channel * sizeof(uint32_t);
+            samples += samples_number;
+        }
+
+        STD_store_event(event, header[3], channels_number,
+                        the_timestamps.previous_timestamp.data(),
+                        the_timestamps.time_offset.data(),
+                        the_settings.offset_step,
+                        the_counters,
+                        waveforms);
+
+        events_number += 1;
+        offset += event_size;
+    }
+
+    return events_number;
+}
+
+int64_t caen_decoder::get_PSD_events(const char *buffer, uint32_t size,
+                                     const settings &the_settings,
+                                     std::vector<std::vector<struct PSD_event>> &events)
+{
+    // The events point directly to the words of the buffer, as the
+    // waveforms are decoded afterwards.
+    const uint32_t *words = reinterpret_cast<const uint32_t *>(buffer);
+    const uint32_t words_number = size / sizeof(uint32_t);
+
+    events.resize(the_settings.channels_number);
+
+    for (auto &channel_events: events)
+    {
+        channel_events.clear();
+    }
+
+    int64_t events_number = 0;
+    uint32_t offset = 0;
+
+    while (offset + HEADER_WORDS <= words_number)
+    {
+        const uint32_t aggregate_size = words[offset] & 0x0FFFFFFF;
+
+        if ((words[offset] >> 28) != HEADER_TAG || aggregate_size < HEADER_WORDS || offset + aggregate_size > words_number)
+        {
+            return -1;
+        }
+
+        const uint32_t couples_mask = words[offset + 1] & 0xFF;
+        const uint32_t aggregate_end = offset + aggregate_size;
+
+        uint32_t position = offset + HEADER_WORDS;
+
+        for (unsigned int couple = 0; couple < 8; couple++)
+        {
+            if (!((couples_mask >> couple) & 1))
+            {
+                continue;
+            }
+
+            if (position + 2 > aggregate_end)
+            {
+                return -1;
+            }
+
+            const uint32_t channel_aggregate_size = words[position] & 0x3FFFFF;
+            const uint32_t format = words[position + 1];
+
+            if (channel_aggregate_size < 2 || position + channel_aggregate_size > aggregate_end)
+            {
+                return -1;
+            }
+
+            // The samples words are present only if the ES flag is set,
+            // regardless of the number of samples in the format
+            const uint32_t samples_enabled = (format >> 27) & 1;
+            const uint32_t extras_enabled = (format >> 28) & 1;
+            const uint32_t samples_number = samples_enabled ? (format & 0xFFFF) * 8 : 0;
+            const uint32_t event_words = 1 + samples_number / 2 + extras_enabled + 1;
+
+            const uint32_t channel_aggregate_end = position + channel_aggregate_size;
+
+            for (uint32_t p = position + 2; p + event_words <= channel_aggregate_end; p += event_words)
+            {
+                const uint32_t time_tag_word = words[p];
+                const unsigned int ch = couple * 2 + (time_tag_word >> 31);
+
+                const uint32_t extras = extras_enabled ? words[p + 1 + samples_number / 2] : 0;
+                const uint32_t charges = words[p + 1 + samples_number / 2 + extras_enabled];
+
+                struct PSD_event event;
+
+                // Without the samples the format reports no samples, so that
+                // the waveforms are decoded empty
+                event.Format = samples_enabled ? format : (format & 0xFFFF0000);
+                event.TimeTag = time_tag_word & 0x7FFFFFFF;
+                event.ChargeShort = charges & 0x7FFF;
+                event.ChargeLong = (charges >> 16) & 0xFFFF;
+                // The baseline is available only with the extras option 0b000
+                event.Baseline = (((format >> 24) & 0x7) == 0) ? ((extras & 0xFFFF) / 4) : 0;
+                event.Pur = (charges >> 15) & 1;
+                event.Waveforms = words + p + 1;
+                event.Extras = extras;
+
+                if (ch < events.size())
+                {
+                    events[ch].push_back(event);
+                    events_number += 1;
+                }
+            }
+
+            position = channel_aggregate_end;
+        }
+
+        offset = aggregate_end;
+    }
+
+    return events_number;
+}
+
+void caen_decoder::decode_PSD_waveforms(const struct PSD_event &event,
+                                        struct PSD_waveforms &event_waveforms)
+{
+    const uint32_t samples_number = (event.Format & 0xFFFF) * 8;
+    const bool dual_trace = (event.Format >> 31) & 1;
+
+    event_waveforms.resize(samples_number);
+    event_waveforms.dualTrace = dual_trace;
+
+    // The waveform words contain two samples each, every sample has 14 bits
+    // of the analog probe and the two digital probes in the most
+    // significant bits.
+    for (uint32_t sample_index = 0; sample_index < samples_number; sample_index += 2)
+    {
+        const uint32_t word = event.Waveforms[sample_index / 2];
+        const uint16_t even = word & 0x3FFF;
+        const uint16_t odd = (word >> 16) & 0x3FFF;
+
+        if (dual_trace)
+        {
+            event_waveforms.Trace1[sample_index] = even;
+            event_waveforms.Trace1[sample_index + 1] = even;
+            event_waveforms.Trace2[sample_index] = odd;
+            event_waveforms.Trace2[sample_index + 1] = odd;
+        }
+        else
+        {
+            event_waveforms.Trace1[sample_index] = even;
+            event_waveforms.Trace1[sample_index + 1] = odd;
+            event_waveforms.Trace2[sample_index] = 0;
+            event_waveforms.Trace2[sample_index + 1] = 0;
+        }
+
+        event_waveforms.DTrace1[sample_index] = (word >> 14) & 1;
+        event_waveforms.DTrace2[sample_index] = (word >> 15) & 1;
+        event_waveforms.DTrace1[sample_index + 1] = (word >> 30) & 1;
+        event_waveforms.DTrace2[sample_index + 1] = (word >> 31) & 1;
+    }
+
+    // The x725 and x730 have only two digital probes
+    if (samples_number > 0)
+    {
+        memset(event_waveforms.DTrace3, 0, samples_number * sizeof(uint8_t));
+        memset(event_waveforms.DTrace4, 0, samples_number * sizeof(uint8_t));
+    }
+}
+
+int64_t caen_decoder::decode_PSD(const char *buffer, uint32_t size,
+                                 const settings &the_settings,
+                                 timestamps &the_timestamps,
+                                 counters &the_counters,
+                                 std::vector<std::vector<struct PSD_event>> &events,
+                                 std::vector<struct event_PSD> &events_buffer,
+                                 waveforms_buffer::writer &waveforms)
+{
+    const int64_t events_number = get_PSD_events(buffer, size, the_settings, events);
+
+    if (events_number < 0)
+    {
+        return events_number;
+    }
+
+    uint64_t *const previous_timestamp = the_timestamps.previous_timestamp.data();
+    uint64_t *const time_offset = the_timestamps.time_offset.data();
+
+    struct PSD_waveforms event_waveforms;
+
+    // loop on channels
+    for (unsigned int ch = 0; ch < events.size(); ch++)
+    {
+        const std::vector<struct PSD_event> &channel_events = events[ch];
+        const uint32_t channel_events_number = channel_events.size();
+
+        // loop on events
+        for (uint32_t i = 0; i < channel_events_number; i++)
+        {
+            const uint64_t timestamp = PSD_store_event(channel_events.data(), i,
+                                                       channel_events_number, ch,
+                                                       the_settings.flag_tt64,
+                                                       previous_timestamp,
+                                                       time_offset,
+                                                       the_counters,
+                                                       events_buffer);
+
+            if (the_settings.enabled_waveforms)
+            {
+                decode_PSD_waveforms(channel_events[i], event_waveforms);
+
+                PSD_store_waveforms(event_waveforms, timestamp, ch, the_settings.show_gates, waveforms);
+            }
+        } // end loop on events
+    } // end loop on channels
+
+    return events_number;
+}
+
+bool caen_decoder::write_capture_header(std::ofstream &file, const settings &the_settings)
+{
+    const uint32_t version = CAPTURE_VERSION;
+    const uint16_t flags = (the_settings.flag_tt64 ? CAPTURE_FLAG_TT64 : 0)
+                         | (the_settings.enabled_waveforms ? CAPTURE_FLAG_WAVEFORMS : 0)
+                         | (the_settings.show_gates ? CAPTURE_FLAG_GATES : 0);
+
+    file.write(CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+    file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char *>(&the_settings.dpp_version), sizeof(the_settings.dpp_version));
+    file.write(reinterpret_cast<const char *>(&flags), sizeof(flags));
+    file.write(reinterpret_cast<const char *>(&the_settings.model), sizeof(the_settings.model));
+    file.write(reinterpret_cast<const char *>(&the_settings.channels_number), sizeof(the_settings.channels_number));
+    file.write(reinterpret_cast<const char *>(&the_settings.offset_step), sizeof(the_settings.offset_step));
+
+    return file.good();
+}
+
+bool caen_decoder::read_capture_header(std::ifstream &file, settings &the_settings)
+{
+    char magic[CAPTURE_MAGIC_SIZE];
+    uint32_t version = 0;
+    uint16_t flags = 0;
+
+    file.read(magic, CAPTURE_MAGIC_SIZE);
+
+    if (!file.good() || memcmp(magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0)
+    {
+        return false;
+    }
+
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+    if (version != CAPTURE_VERSION)
+    {
+        return false;
+    }
+
+    file.read(reinterpret_cast<char *>(&the_settings.dpp_version), sizeof(the_settings.dpp_version));
+    file.read(reinterpret_cast<char *>(&flags), sizeof(flags));
+    file.read(reinterpret_cast<char *>(&the_settings.model), sizeof(the_settings.model));
+    file.read(reinterpret_cast<char *>(&the_settings.channels_number), sizeof(the_settings.channels_number));
+    file.read(reinterpret_cast<char *>(&the_settings.offset_step), sizeof(the_settings.offset_step));
+
+    the_settings.flag_tt64 = flags & CAPTURE_FLAG_TT64;
+    the_settings.enabled_waveforms = flags & CAPTURE_FLAG_WAVEFORMS;
+    the_settings.show_gates = flags & CAPTURE_FLAG_GATES;
+
+    return file.good();
+}
+
+bool caen_decoder::write_readout_buffer(std::ofstream &file, const char *buffer, uint32_t size)
+{
+    file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    file.write(buffer, size);
+
+    return file.good();
+}
+
+bool caen_decoder::read_readout_buffer(std::ifstream &file, std::vector<char> &buffer)
+{
+    uint32_t size = 0;
+
+    file.read(reinterpret_cast<char *>(&size), sizeof(size));
+
+    if (!file.good())
+    {
+        return false;
+    }
+
+    // The vector storage is allocated with new, thus it is aligned well
+    // enough to be read as 32-bit words by the decoders.
+    buffer.resize(size);
+    file.read(buffer.data(), size);
+
+    return file.good();
+}
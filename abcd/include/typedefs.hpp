@@ -24,6 +24,7 @@
 #include <string>
 #include <chrono>
 #include <queue>
+#include <fstream>
 
 #include <json/json.h>
 #include <zmq.h>
@@ -80,6 +81,10 @@ struct status
     bool enabled_waveforms = false;
     bool show_gates = false;
 
+    // Raw readout buffers capture, for the offline replay with abcd_decoder
+    std::string capture_file_name;
+    std::ofstream capture_file;
+
     std::vector<unsigned long> counts;
     std::vector<unsigned long> partial_counts;
     // Incoming Counting Rate (ICR) counts from board firmware
@@ -87,7 +92,10 @@ struct status
 
     // We are using a vector because it guarantees that the buffer is contiguous.
     std::vector<struct event_PSD> events_buffer;
-    std::vector<struct event_waveform> waveforms_buffer;
+    // The waveforms are stored directly in their binary format, ready to be
+    // published, thus the number of waveforms is kept separately.
+    std::vector<uint8_t> waveforms_buffer;
+    size_t waveforms_buffer_size_Number = 0;
 };
 
 struct state
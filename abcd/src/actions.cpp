@@ -33,6 +33,8 @@
 #include "socket_functions.hpp"
 #include "typedefs.hpp"
 #include "events.hpp"
+#include "waveforms_buffer.hpp"
+#include "caen_decoder.hpp"
 #include "states.hpp"
 #include "actions.hpp"
 
@@ -87,32 +89,13 @@ void actions::generic::publish_events(status &global_status)
                                             global_status.events_buffer_max_size / 10);
     }
 
-    const size_t waveforms_buffer_size = global_status.waveforms_buffer.size();
+    const size_t waveforms_buffer_size = global_status.waveforms_buffer_size_Number;
 
     if (waveforms_buffer_size > 0)
     {
-        size_t total_size = 0;
-
-        for (auto event : global_status.waveforms_buffer)
-        {
-            total_size += event.size();
-        }
-
-        std::vector<uint8_t> output_buffer(total_size);
-
-        size_t portion = 0;
-
-        for (auto event : global_status.waveforms_buffer)
-        {
-            const size_t event_size = event.size();
-            const std::vector<uint8_t> event_buffer = event.serialize();
-
-            memcpy(output_buffer.data() + portion,
-                   reinterpret_cast<const void *>(event_buffer.data()),
-                   event_size);
-
-            portion += event_size;
-        }
+        // The waveforms are already serialized in the buffer, so it can be
+        // sent as it is.
+        const size_t total_size = global_status.waveforms_buffer.size();
 
         std::string topic = defaults_abcd_data_waveforms_topic;
         topic += "_v0";
@@ -133,7 +116,7 @@ void actions::generic::publish_events(status &global_status)
 
         const bool result = socket_functions::send_byte_message(global_status.data_socket,
                                                                 topic,
-                                                                output_buffer.data(),
+                                                                global_status.waveforms_buffer.data(),
                                                                 total_size);
         global_status.waveforms_msg_ID += 1;
 
@@ -144,11 +127,9 @@ void actions::generic::publish_events(status &global_status)
             std::cout << std::endl;
         }
 
-        // Cleanup vector
+        // Cleanup vector, its capacity is kept for the next readouts
         global_status.waveforms_buffer.clear();
-        // Initialize vector size to its max size plus a 10%
-        global_status.waveforms_buffer.reserve(global_status.events_buffer_max_size +
-                                               global_status.events_buffer_max_size / 10);
+        global_status.waveforms_buffer_size_Number = 0;
     }
 }
 
@@ -206,6 +187,11 @@ void actions::generic::stop_acquisition(status &global_status)
 
     global_status.stop_time = stop_time;
 
+    if (global_status.capture_file.is_open())
+    {
+        global_status.capture_file.close();
+    }
+
     if (verbosity > 0)
     {
         std::cout << '[' << utilities_functions::time_string() << "] ";
@@ -224,6 +210,8 @@ void actions::generic::clear_memory(status &global_status)
     global_status.partial_counts.clear();
     global_status.ICR_counts.clear();
     global_status.events_buffer.clear();
+    global_status.waveforms_buffer.clear();
+    global_status.waveforms_buffer_size_Number = 0;
 
     if (global_status.verbosity > 0)
     {
@@ -1172,6 +1160,39 @@ state actions::start_acquisition(status &global_status)
         std::cout << std::endl;
     }
 
+    if (global_status.capture_file_name.length() > 0)
+    {
+        caen_decoder::settings capture_settings;
+
+        capture_settings.dpp_version = global_status.dpp_version;
+        capture_settings.model = digitizer->GetModel();
+        capture_settings.channels_number = channels_number;
+        capture_settings.flag_tt64 = global_status.flag_tt64;
+        capture_settings.enabled_waveforms = global_status.enabled_waveforms;
+        capture_settings.show_gates = global_status.show_gates;
+        capture_settings.offset_step = global_status.offset_step;
+
+        // The capture file is overwritten at each start, as the timestamps
+        // reconstruction restarts from zero
+        global_status.capture_file.open(global_status.capture_file_name, std::ios::binary | std::ios::trunc);
+
+        if (!global_status.capture_file.is_open() ||
+            !caen_decoder::write_capture_header(global_status.capture_file, capture_settings))
+        {
+            std::cout << '[' << utilities_functions::time_string() << "] ";
+            std::cout << "WARNING: Unable to write the capture file: " << global_status.capture_file_name;
+            std::cout << std::endl;
+
+            global_status.capture_file.close();
+        }
+        else if (global_status.verbosity > 0)
+        {
+            std::cout << '[' << utilities_functions::time_string() << "] ";
+            std::cout << "Capturing the readout buffers to: " << global_status.capture_file_name;
+            std::cout << std::endl;
+        }
+    }
+
     digitizer->SWStartAcquisition();
 
     global_status.start_time = start_time;
@@ -1289,6 +1310,10 @@ state actions::add_to_buffer(status &global_status)
 
     uint32_t bsize = 0;
 
+    // The waveforms are decoded directly in the binary buffer that is
+    // published
+    waveforms_buffer::writer waveforms(global_status.waveforms_buffer);
+
     do
     {
         if (verbosity > 0)
@@ -1332,6 +1357,11 @@ state actions::add_to_buffer(status &global_status)
         uint64_t *const previous_timestamp = global_status.previous_timestamp;
         uint64_t *const time_offset = global_status.time_offset;
 
+        if (bsize > 0 && global_status.capture_file.is_open())
+        {
+            caen_decoder::write_readout_buffer(global_status.capture_file, global_status.readout_buffer, bsize);
+        }
+
         if (bsize > 0)
         {
             // We have events...
@@ -1373,42 +1403,12 @@ state actions::add_to_buffer(status &global_status)
 
                     digitizer->DecodeEvent(event_pointer, (void **)(&global_status.Evt_STD));
 
-                    // loop on channels
-                    for (unsigned int ch = 0; ch < channels_number; ch++)
-                    {
-                        const uint32_t samples_number = global_status.Evt_STD->ChSize[ch];
-
-                        if (verbosity > 1)
-                        {
-                            std::cout << '[' << utilities_functions::time_string() << "] ";
-                            std::cout << "ChSize[" << ch << "]: " << samples_number << "; ";
-                            std::cout << std::endl;
-                        }
-
-                        if (samples_number > 0)
-                        {
-                            // 64-bit timestamp management
-                            const uint64_t trigger_time_tag = event_info.TriggerTimeTag & 0x3FFFFFFF;
-
-                            if (trigger_time_tag < previous_timestamp[ch])
-                            {
-                                time_offset[ch] += global_status.offset_step;
-                            }
-                            previous_timestamp[ch] = trigger_time_tag;
-
-                            const uint64_t timestamp = trigger_time_tag + time_offset[ch];
-                            const uint8_t channel = ch;
-
-                            global_status.counts[channel] += 1;
-                            global_status.partial_counts[channel] += 1;
-
-                            global_status.waveforms_buffer.emplace_back(timestamp, channel, samples_number);
-
-                            memcpy(global_status.waveforms_buffer.back().samples.data(),
-                                   global_status.Evt_STD->DataChannel[ch],
-                                   samples_number * sizeof(uint16_t));
-                        }
-                    }
+                    caen_decoder::STD_store_event(*global_status.Evt_STD, event_info.TriggerTimeTag,
+                                                  channels_number,
+                                                  previous_timestamp, time_offset,
+                                                  global_status.offset_step,
+                                                  global_status,
+                                                  waveforms);
                 }
             } // end of STD firmware
             else if (global_status.dpp_version == 3)
@@ -1449,90 +1449,19 @@ state actions::add_to_buffer(status &global_status)
                         //    continue;
                         //}
 
-                        // Reading the ICR flag from Extra word in the DPP firmware
-                        // When the flag is seen the digitizer's input counter saw 1024 events
-                        if ((((uint64_t)global_status.Evt_PSD[ch][i].Extras) >> 13) & 1)
-                        {
-                            global_status.ICR_counts[ch] += 1024;
-                        }
-
-                        // 64-bit timestamp management
-                        uint64_t timestamp64bit;
-                        uint64_t fine_timestamp = 0;
-
-                        if (global_status.flag_tt64)
-                        {
-                            timestamp64bit = (global_status.Evt_PSD[ch][i].TimeTag & 0x7FFFFFFF) |
-                                             ((((uint64_t)global_status.Evt_PSD[ch][i].Extras) & 0xFFFF0000) << 15);
-
-                            fine_timestamp = global_status.Evt_PSD[ch][i].Extras & 0x3FF;
-
-                            // corrections for isolated 4 s jumps in future
-                            // LSB of Extras (bit 31 of 64 bit timestamp) flips to 1 (shark peak)
-                            if ((previous_timestamp[ch] + ((uint64_t)(1 << 30)) < timestamp64bit) &&
-                                (i + 1 < numEvents[ch]))
-                            {
-                                // jump greater than 4 seconds && we have following event to check
-                                uint64_t nexttag64bit = (global_status.Evt_PSD[ch][i + 1].TimeTag & 0x7FFFFFFF) |
-                                                        ((((uint64_t)global_status.Evt_PSD[ch][i + 1].Extras) & 0xFFFF0000) << 15);
-                                if (nexttag64bit + ((uint64_t)1 << 30) < timestamp64bit)
-                                {
-                                    timestamp64bit -= ((uint64_t)1 << 31);
-                                }
-                            }
-
-                            // This is to check if there is a jump of more than 4.3 s to the past
-                            if (timestamp64bit + ((uint64_t)1 << 31) < previous_timestamp[ch])
-                            {
-                                time_offset[ch] += ((uint64_t)1 << 47);
-                            }
-                        }
-                        else
-                        {
-                            // x720
-                            timestamp64bit = (global_status.Evt_PSD[ch][i].TimeTag & 0x3FFFFFFF);
-
-                            if (timestamp64bit < previous_timestamp[ch])
-                            {
-                                time_offset[ch] += 0x40000000;
-                            }
-                        } // end if for 64-bit timestamp
-
-                        previous_timestamp[ch] = timestamp64bit;
-                        // end 64-bit timestamp management
-
-                        const uint64_t temporary_timestamp = (previous_timestamp[ch] + time_offset[ch]);
-
-                        // FIXME: Testing the fine time tag from the V1730 DCFD
-                        // If we shift the timestamp by 10 bits we should be able to fit the fine time tag
-                        // that we get from the DCFD of the v1730s
-                        const uint64_t timestamp = (temporary_timestamp << 10) + fine_timestamp;
-
-                        const uint16_t qshort = 0 + global_status.Evt_PSD[ch][i].ChargeShort;
-                        const uint16_t qlong = 0 + global_status.Evt_PSD[ch][i].ChargeLong;
-                        // const uint16_t baseline = 0 + (global_status.Evt_PSD[ch][i].Extras & 0x0000FFFF);
-                        const uint16_t baseline = global_status.Evt_PSD[ch][i].Baseline;
-                        const uint8_t channel = ch;
-                        const uint8_t group_counter = global_status.Evt_PSD[ch][i].Pur;
-
-                        // std::cerr << "MAIN: Event: timestamp: " << timestamp << std::endl;
-                        // std::cerr << "MAIN: Event: baseline: " << baseline << std::endl;
-                        // std::cerr << "MAIN: Event: qshort: " << qshort << std::endl;
-                        // std::cerr << "MAIN: Event: qlong: " << qlong << std::endl;
-                        // std::cerr << "MAIN: Event: extras: " << global_status.Evt_PSD[ch][i].Extras << std::endl;
-
-                        global_status.events_buffer.emplace_back(timestamp, qshort, qlong, baseline, channel, group_counter);
-
-                        global_status.counts[channel] += 1;
-                        global_status.partial_counts[channel] += 1;
+                        const uint64_t timestamp = caen_decoder::PSD_store_event(global_status.Evt_PSD[ch], i, numEvents[ch], ch,
+                                                                                 global_status.flag_tt64,
+                                                                                 previous_timestamp, time_offset,
+                                                                                 global_status,
+                                                                                 global_status.events_buffer);
 
                         if (verbosity > 1 && (i % 1000 == 0))
                         {
                             std::cout << '[' << utilities_functions::time_string() << "] ";
                             std::cout << "Event[" << i << "]: ";
                             std::cout << "timestamp: " << timestamp << "; ";
-                            std::cout << "qshort: " << qshort << "; ";
-                            std::cout << "qlong: " << qlong << "; ";
+                            std::cout << "qshort: " << global_status.events_buffer.back().qshort << "; ";
+                            std::cout << "qlong: " << global_status.events_buffer.back().qlong << "; ";
                             std::cout << std::endl;
                         }
 
@@ -1540,40 +1469,9 @@ state actions::add_to_buffer(status &global_status)
                         {
                             digitizer->DecodeDPPWaveforms(&global_status.Evt_PSD[ch][i], global_status.Waveforms_PSD);
 
-                            const uint32_t samples_number = global_status.Waveforms_PSD->Ns;
-
-                            // std::cerr << "MAIN: Event: Number of samples: " << global_status.Waveforms_PSD->Ns << std::endl;
-
-                            if (global_status.show_gates)
-                            {
-                                global_status.waveforms_buffer.emplace_back(timestamp, channel, samples_number, 4);
-
-                                memcpy(global_status.waveforms_buffer.back().samples.data(),
-                                       global_status.Waveforms_PSD->Trace1,
-                                       samples_number * sizeof(uint16_t));
-
-                                // Reading the gates waveforms
-                                memcpy(global_status.waveforms_buffer.back().additional_samples[0].data(),
-                                       global_status.Waveforms_PSD->DTrace1,
-                                       samples_number * sizeof(uint8_t));
-                                memcpy(global_status.waveforms_buffer.back().additional_samples[1].data(),
-                                       global_status.Waveforms_PSD->DTrace2,
-                                       samples_number * sizeof(uint8_t));
-                                memcpy(global_status.waveforms_buffer.back().additional_samples[2].data(),
-                                       global_status.Waveforms_PSD->DTrace3,
-                                       samples_number * sizeof(uint8_t));
-                                memcpy(global_status.waveforms_buffer.back().additional_samples[3].data(),
-                                       global_status.Waveforms_PSD->DTrace4,
-                                       samples_number * sizeof(uint8_t));
-                            }
-                            else
-                            {
-                                global_status.waveforms_buffer.emplace_back(timestamp, channel, samples_number);
-
-                                memcpy(global_status.waveforms_buffer.back().samples.data(),
-                                       global_status.Waveforms_PSD->Trace1,
-                                       samples_number * sizeof(uint16_t));
-                            }
+                            caen_decoder::PSD_store_waveforms(*global_status.Waveforms_PSD, timestamp, ch,
+                                                              global_status.show_gates,
+                                                              waveforms);
                         }
                     } // end loop on events
                 } // end loop on channels
@@ -1585,16 +1483,18 @@ state actions::add_to_buffer(status &global_status)
 
     } while ((bsize >= 0) && (delta_time < std::chrono::milliseconds(global_status.data_reading_timeout)));
 
+    global_status.waveforms_buffer_size_Number += waveforms.get_records_number();
+
     if (verbosity > 0)
     {
         std::cout << '[' << utilities_functions::time_string() << "] ";
         std::cout << "Events buffer size: " << global_status.events_buffer.size() << "; ";
-        std::cout << "Waveforms buffer size: " << global_status.waveforms_buffer.size() << "; ";
+        std::cout << "Waveforms buffer size: " << global_status.waveforms_buffer_size_Number << " (" << global_status.waveforms_buffer.size() << " B); ";
         std::cout << std::endl;
     }
 
     if (global_status.events_buffer.size() >= global_status.events_buffer_max_size ||
-        global_status.waveforms_buffer.size() >= global_status.events_buffer_max_size)
+        global_status.waveforms_buffer_size_Number >= global_status.events_buffer_max_size)
     {
         return states::PUBLISH_EVENTS;
     }
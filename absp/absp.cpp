@@ -85,6 +85,7 @@ void print_usage(const std::string &name = std::string("absp"))
     std::cout << defaults_abcd_config_filename << std::endl;
     std::cout << "\t-T <period>: Set base period in milliseconds, default: ";
     std::cout << defaults_abcd_base_period << std::endl;
+    std::cout << "\t-s <number>: Number of simulated digitizers to create, default: 0" << std::endl;
     std::cout << "\t-v: Set verbose execution, repeating the option increases the verbosity level" << std::endl;
     std::cout << "\t-l <log_filename>: Log to file instead of to the console" << std::endl;
 
@@ -107,9 +108,10 @@ int main(int argc, char *argv[])
     unsigned int verbosity = 0;
 
     bool identification_only = false;
+    unsigned int simulated_digitizers_number = 0;
 
     int c = 0;
-    while ((c = getopt(argc, argv, "hIS:D:C:f:T:vl:")) != -1)
+    while ((c = getopt(argc, argv, "hIS:D:C:f:T:s:vl:")) != -1)
     {
         switch (c)
         {
@@ -140,6 +142,15 @@ int main(int argc, char *argv[])
             {
             }
             break;
+        case 's':
+            try
+            {
+                simulated_digitizers_number = std::stoul(optarg);
+            }
+            catch (std::logic_error &e)
+            {
+            }
+            break;
         case 'v':
             verbosity += 1;
             break;
@@ -162,6 +173,8 @@ int main(int argc, char *argv[])
     global_status.commands_address = commands_address;
     global_status.identification_only = identification_only;
     global_status.adq_cu_ptr = NULL;
+    global_status.simulated_digitizers_number = simulated_digitizers_number;
+    global_status.parallel_readout = defaults_absp_parallel_readout;
 
     try
     {
@@ -213,6 +226,7 @@ int main(int argc, char *argv[])
     absp_logger_console->info("Verbosity: {}", verbosity);
     absp_logger_console->info("Log file: {}", log_filename);
     absp_logger_console->info("Base period: {}", base_period);
+    absp_logger_console->info("Simulated digitizers: {}", simulated_digitizers_number);
 
     if (identification_only)
     {
@@ -146,7 +146,7 @@ public:
     bool AcquisitionReady();
     bool DataOverflow();
 
-    int GetWaveformsFromCard(std::vector<struct event_waveform> &waveforms);
+    int GetWaveformsFromCard(waveforms_buffer::writer &waveforms);
 
     void SetDBSInstancesNumber(unsigned int n) { DBS_instances_number = n; }
     unsigned int GetDBSInstancesNumber() const { return DBS_instances_number; }
@@ -168,7 +168,7 @@ public:
     bool AcquisitionReady();
     bool DataOverflow();
 
-    int GetWaveformsFromCard(std::vector<struct event_waveform> &waveforms);
+    int GetWaveformsFromCard(waveforms_buffer::writer &waveforms);
 
     uint32_t event_counters_base_address;
 
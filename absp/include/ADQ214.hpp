@@ -140,7 +140,7 @@ public:
     bool AcquisitionReady();
     bool DataOverflow();
 
-    int GetWaveformsFromCard(std::vector<struct event_waveform> &waveforms);
+    int GetWaveformsFromCard(waveforms_buffer::writer &waveforms);
 
     //--------------------------------------------------------------------------
 
@@ -86,7 +86,7 @@ public:
 
     bool AcquisitionReady();
 
-    int GetWaveformsFromCard(std::vector<struct event_waveform> &waveforms);
+    int GetWaveformsFromCard(waveforms_buffer::writer &waveforms);
 
     //--------------------------------------------------------------------------
 
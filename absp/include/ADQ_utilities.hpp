@@ -2,7 +2,10 @@
 #define __ADQ_UTILITIES_HPP__
 
 #include <vector>
+#include <map>
+#include <utility>
 #include <memory>
+#include <mutex>
 #include <spdlog/spdlog.h>
 
 #define LINUX
@@ -11,12 +14,44 @@
 extern std::shared_ptr<spdlog::logger> absp_logger_console;
 extern std::shared_ptr<spdlog::logger> absp_logger_error;
 
+// The ADQ SDK does not state that its functions can be called concurrently
+// on the same board, while the readouts of the digitizers run in parallel.
+// The control and status calls of a board are thus serialized with a mutex
+// of that board, and the calls on the whole control unit with a mutex of the
+// control unit. The data transfers (e.g. GetDataWHTS, GetDataStreaming and
+// WaitForRecordBuffer) only touch the DMA buffers of their board and they are
+// called without any lock, so that the boards are read out concurrently.
+// The boards are numbered from 1, the number 0 selects the control unit.
+inline std::mutex &ADQ_mutex(const void *adq_cu_ptr, int adq_num)
+{
+    static std::mutex registry_mutex;
+    // The nodes of a map are never moved, thus the mutexes stay valid
+    static std::map<std::pair<const void*, int>, std::mutex> mutexes;
+
+    std::lock_guard<std::mutex> registry_lock(registry_mutex);
+
+    return mutexes[std::make_pair(adq_cu_ptr, adq_num)];
+}
+
+// It uses the adq_cu_ptr and adq_num of the calling scope
+#define ADQ_LOCKED(f) \
+    ([&]() { \
+        std::lock_guard<std::mutex> ADQ_lock(ADQ_mutex(adq_cu_ptr, adq_num)); \
+        return (f); \
+    }())
+
+#define ADQ_CU_LOCKED(f) \
+    ([&]() { \
+        std::lock_guard<std::mutex> ADQ_lock(ADQ_mutex(adq_cu_ptr, 0)); \
+        return (f); \
+    }())
+
 #define CHECKZERO(f) \
 { \
     const auto retval = (f); \
     if (!(retval)) { \
         char error_string[512]; \
-        ADQControlUnit_GetLastFailedDeviceErrorWithText(adq_cu_ptr, error_string); \
+        ADQ_CU_LOCKED(ADQControlUnit_GetLastFailedDeviceErrorWithText(adq_cu_ptr, error_string)); \
         absp_logger_error->error("ADQSDK ERROR in: {} (code: {}); text: {}", (#f), retval, error_string); \
     } \
 }
@@ -14,6 +14,8 @@ extern "C"
 #include <string>
 #include <vector>
 
+#include "waveforms_buffer.hpp"
+
 #define DIGITIZER_SUCCESS 1
 #define DIGITIZER_FAILURE 0
 
@@ -114,7 +116,7 @@ namespace ABCD
         virtual bool AcquisitionReady() { return false; }
         virtual bool DataOverflow() { return false; }
 
-        virtual int GetWaveformsFromCard(std::vector<struct event_waveform> & /*waveforms*/)
+        virtual int GetWaveformsFromCard(waveforms_buffer::writer & /*waveforms*/)
         {
             return DIGITIZER_FAILURE;
         }
@@ -0,0 +1,77 @@
+#ifndef __SIMULATED_HPP__
+#define __SIMULATED_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <chrono>
+
+extern "C" {
+#include <jansson.h>
+}
+
+#include "Digitizer.hpp"
+
+namespace ABCD {
+
+// Digitizer that generates exponential pulses on the enabled channels,
+// without any hardware. It is used to test the readout without the boards.
+class Simulated : public ABCD::Digitizer {
+public:
+    // -------------------------------------------------------------------------
+    //  Digitizer configuration
+    // -------------------------------------------------------------------------
+    static const unsigned int default_channels_number;
+    static const unsigned int default_samples_number;
+    static const unsigned int default_waveforms_per_readout;
+
+    unsigned int samples_number;
+    unsigned int pretrigger;
+    // Waveforms generated by each enabled channel at each readout
+    unsigned int waveforms_per_readout;
+    // Time in clock steps between two pulses on the same channel
+    uint64_t pulses_period;
+    // Emulates the time spent in the DMA transfer of a real board
+    unsigned int readout_time;
+
+    uint16_t baseline;
+    uint16_t pulse_height;
+    double decay_time;
+
+    bool acquisition_running;
+
+    uint64_t timestamp_last;
+    // Linear congruential generator state, used for the noise
+    uint32_t random_state;
+
+    std::vector<size_t> event_counters;
+
+    // All the simulated boards share a dummy control unit, and they take the
+    // same locks of the ADQ boards on it
+    void* adq_cu_ptr;
+    int adq_num;
+
+    Simulated(unsigned int simulated_index);
+    ~Simulated();
+
+    int Initialize();
+    int ReadConfig(json_t* config);
+    int Configure();
+
+    int StartAcquisition();
+    int RearmTrigger();
+    int StopAcquisition();
+    int ForceSoftwareTrigger();
+    int ResetOverflow();
+
+    bool AcquisitionReady();
+    bool DataOverflow();
+
+    int GetWaveformsFromCard(waveforms_buffer::writer &waveforms);
+
+    std::vector<size_t> GetEventCounters();
+
+    int SpecificCommand(json_t* json_command);
+};
+}
+
+#endif
@@ -44,6 +44,7 @@ namespace actions
 
         int start_acquisition(status&, unsigned int);
         void rearm_trigger(status&, unsigned int);
+        struct readout_result read_digitizer(status&, unsigned int, waveforms_buffer::writer&);
         void stop_acquisition(status&);
     }
 
@@ -48,6 +48,34 @@ extern "C" {
 extern std::shared_ptr<spdlog::logger> logger_console;
 extern std::shared_ptr<spdlog::logger> logger_error;
 
+// Statistics of the readouts of a single digitizer
+struct readout_statistics
+{
+    unsigned long readouts = 0;
+    unsigned long fetch_failures = 0;
+    unsigned long overflows = 0;
+
+    // Durations of the readouts in ms
+    long int last_time = 0;
+    long int max_time = 0;
+    long int total_time = 0;
+};
+
+// Result of the readout of a single digitizer, that might be run in a
+// separate thread
+struct readout_result
+{
+    bool is_ready = false;
+    bool is_overflow = false;
+    int retval = DIGITIZER_SUCCESS;
+
+    std::vector<size_t> event_counters;
+
+    size_t waveforms_number = 0;
+
+    long int time = 0;
+};
+
 struct status
 {
     std::string status_address;
@@ -77,8 +105,16 @@ struct status
     void *adq_cu_ptr;
     std::vector<ABCD::Digitizer*> digitizers;
 
+    // Number of simulated digitizers created besides the real ones
+    unsigned int simulated_digitizers_number;
+
     std::map<unsigned int, unsigned int> digitizers_user_ids;
 
+    // If true the digitizers are read concurrently, all of them writing
+    // directly in the waveforms_buffer
+    bool parallel_readout;
+    std::map<unsigned int, struct readout_statistics> readouts_statistics;
+
     unsigned int channels_number;
 
     // -------------------------------------------------------------------------
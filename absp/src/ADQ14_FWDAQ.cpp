@@ -383,8 +383,8 @@ int ABCD::ADQ14_FWDAQ::RearmTrigger()
     const std::string log_name = GetName() + " " + GetModel() + "::RearmTrigger()";
     absp_logger_console->trace("{} Rearming trigger; Trigger mode: {} (index: {});", log_name, ADQ_descriptions::trigger_mode.at(trigger_mode), trigger_mode);
 
-    CHECKZERO(ADQ_DisarmTrigger(adq_cu_ptr, adq_num));
-    CHECKZERO(ADQ_ArmTrigger(adq_cu_ptr, adq_num));
+    CHECKZERO(ADQ_LOCKED(ADQ_DisarmTrigger(adq_cu_ptr, adq_num)));
+    CHECKZERO(ADQ_LOCKED(ADQ_ArmTrigger(adq_cu_ptr, adq_num)));
 
     if (trigger_mode == ADQ_SW_TRIGGER_MODE)
     {
@@ -402,7 +402,7 @@ bool ABCD::ADQ14_FWDAQ::AcquisitionReady()
 {
     const std::string log_name = GetName() + " " + GetModel() + "::AcquisitionReady()";
 
-    const unsigned int retval = ADQ_GetAcquiredAll(adq_cu_ptr, adq_num);
+    const unsigned int retval = ADQ_LOCKED(ADQ_GetAcquiredAll(adq_cu_ptr, adq_num));
 
     absp_logger_console->trace("{} Acquisition ready: {};", log_name, retval);
 
@@ -415,7 +415,7 @@ bool ABCD::ADQ14_FWDAQ::DataOverflow()
 {
     const std::string log_name = GetName() + " " + GetModel() + "::DataOverflow()";
 
-    const unsigned int retval = ADQ_GetStreamOverflow(adq_cu_ptr, adq_num);
+    const unsigned int retval = ADQ_LOCKED(ADQ_GetStreamOverflow(adq_cu_ptr, adq_num));
 
     absp_logger_console->debug("{} Overflow: {};", log_name, retval);
 
@@ -424,7 +424,7 @@ bool ABCD::ADQ14_FWDAQ::DataOverflow()
 
 //==============================================================================
 
-int ABCD::ADQ14_FWDAQ::GetWaveformsFromCard(std::vector<struct event_waveform> &waveforms)
+int ABCD::ADQ14_FWDAQ::GetWaveformsFromCard(waveforms_buffer::writer &waveforms)
 {
     const std::string log_name = GetName() + " " + GetModel() + "::GetWaveformsFromCard()";
 
@@ -489,12 +489,9 @@ int ABCD::ADQ14_FWDAQ::GetWaveformsFromCard(std::vector<struct event_waveform> &
                 absp_logger_console->trace("{} Channel: {} as read from ADQ: {};", log_name, channel, (unsigned int)ADQ_channel);
                 if (IsChannelEnabled(channel))
                 {
-                    struct event_waveform this_waveform = waveform_create(timestamp_waveform,
-                                                                          channel,
-                                                                          samples_per_record,
-                                                                          0);
-
-                    uint16_t *const samples = waveform_samples_get(&this_waveform);
+                    uint16_t *const samples = waveforms.append(timestamp_waveform,
+                                                               channel,
+                                                               samples_per_record);
 
                     for (unsigned int sample_index = 0; sample_index < samples_per_record; sample_index++)
                     {
@@ -504,8 +501,6 @@ int ABCD::ADQ14_FWDAQ::GetWaveformsFromCard(std::vector<struct event_waveform> &
                         // offset, for compatibility with the rest of ABCD
                         samples[sample_index] = (value + (1 << 15));
                     }
-
-                    waveforms.push_back(this_waveform);
                 }
             }
         }
@@ -538,9 +533,9 @@ int ABCD::ADQ14_FWDAQ::ForceSoftwareTrigger()
 
     absp_logger_console->debug("{} Forcing a software trigger;", log_name);
 
-    CHECKZERO(ADQ_DisarmTrigger(adq_cu_ptr, adq_num));
-    CHECKZERO(ADQ_ArmTrigger(adq_cu_ptr, adq_num));
-    CHECKZERO(ADQ_SWTrig(adq_cu_ptr, adq_num));
+    CHECKZERO(ADQ_LOCKED(ADQ_DisarmTrigger(adq_cu_ptr, adq_num)));
+    CHECKZERO(ADQ_LOCKED(ADQ_ArmTrigger(adq_cu_ptr, adq_num)));
+    CHECKZERO(ADQ_LOCKED(ADQ_SWTrig(adq_cu_ptr, adq_num)));
 
     return DIGITIZER_SUCCESS;
 }
@@ -553,7 +548,7 @@ int ABCD::ADQ14_FWDAQ::ResetOverflow()
 
     absp_logger_console->info("{} Resetting a data overflow;", log_name);
 
-    CHECKZERO(ADQ_ResetDevice(adq_cu_ptr, adq_num, RESET_OVERFLOW));
+    CHECKZERO(ADQ_LOCKED(ADQ_ResetDevice(adq_cu_ptr, adq_num, RESET_OVERFLOW)));
 
     return DIGITIZER_SUCCESS;
 }
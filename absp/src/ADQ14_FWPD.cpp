@@ -673,7 +673,7 @@ bool ABCD::ADQ14_FWPD::AcquisitionReady()
     {
         unsigned int filled_buffers = 0;
 
-        CHECKZERO(ADQ_GetTransferBufferStatus(adq_cu_ptr, adq_num, &filled_buffers));
+        CHECKZERO(ADQ_LOCKED(ADQ_GetTransferBufferStatus(adq_cu_ptr, adq_num, &filled_buffers)));
 
         const std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
         const auto delta_time = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_buffer_ready);
@@ -722,7 +722,7 @@ bool ABCD::ADQ14_FWPD::DataOverflow()
 {
     const std::string log_name = GetName() + " " + GetModel() + "::DataOverflow()";
 
-    const unsigned int retval = ADQ_GetStreamOverflow(adq_cu_ptr, adq_num);
+    const unsigned int retval = ADQ_LOCKED(ADQ_GetStreamOverflow(adq_cu_ptr, adq_num));
 
     absp_logger_console->debug("{} Overflow: {};", log_name, retval);
 
@@ -731,7 +731,7 @@ bool ABCD::ADQ14_FWPD::DataOverflow()
 
 //==============================================================================
 
-int ABCD::ADQ14_FWPD::GetWaveformsFromCard(std::vector<struct event_waveform> &waveforms)
+int ABCD::ADQ14_FWPD::GetWaveformsFromCard(waveforms_buffer::writer &waveforms)
 {
     const std::string log_name = GetName() + " " + GetModel() + "::GetWaveformsFromCard()";
 
@@ -827,12 +827,9 @@ int ABCD::ADQ14_FWPD::GetWaveformsFromCard(std::vector<struct event_waveform> &w
 
                         const uint64_t timestamp_waveform = (timestamp + timestamp_offset) << timestamp_bit_shift;
 
-                        struct event_waveform this_waveform = waveform_create(timestamp_waveform,
-                                                                              channel,
-                                                                              samples_per_record,
-                                                                              0);
-
-                        uint16_t *const samples = waveform_samples_get(&this_waveform);
+                        uint16_t *const samples = waveforms.append(timestamp_waveform,
+                                                                   channel,
+                                                                   samples_per_record);
 
                         // There is the possibility that there is an incomplete
                         // buffer left from the previous call of GetDataStreaming()
@@ -879,8 +876,6 @@ int ABCD::ADQ14_FWPD::GetWaveformsFromCard(std::vector<struct event_waveform> &w
 
                             samples_offset += samples_per_record;
                         }
-
-                        waveforms.push_back(this_waveform);
                     }
 
                     // The last record is incomplete and we should store it for
@@ -920,7 +915,7 @@ int ABCD::ADQ14_FWPD::GetWaveformsFromCard(std::vector<struct event_waveform> &w
         if (absp_logger_console->should_log(spdlog::level::debug))
         {
             struct ADQDramStatus DRAM_status;
-            ADQ_GetStatus(adq_cu_ptr, adq_num, ADQ_STATUS_ID_DRAM, &DRAM_status);
+            ADQ_LOCKED(ADQ_GetStatus(adq_cu_ptr, adq_num, ADQ_STATUS_ID_DRAM, &DRAM_status));
 
             absp_logger_console->debug("{} DRAM fill: {} kB; DRAM max fill: {} kB;", log_name, ((double)DRAM_status.fill / 1024.0), ((double)DRAM_status.fill_max / 1024.0));
         }
@@ -1055,12 +1050,9 @@ int ABCD::ADQ14_FWPD::GetWaveformsFromCard(std::vector<struct event_waveform> &w
 
                 const uint64_t timestamp_waveform = (timestamp + timestamp_offset) << timestamp_bit_shift;
 
-                struct event_waveform this_waveform = waveform_create(timestamp_waveform,
-                                                                      channel,
-                                                                      samples_per_record,
-                                                                      0);
-
-                uint16_t *const samples = waveform_samples_get(&this_waveform);
+                uint16_t *const samples = waveforms.append(timestamp_waveform,
+                                                           channel,
+                                                           samples_per_record);
 
                 for (unsigned int sample_index = 0; sample_index < samples_per_record; sample_index++)
                 {
@@ -1071,8 +1063,6 @@ int ABCD::ADQ14_FWPD::GetWaveformsFromCard(std::vector<struct event_waveform> &w
                     samples[sample_index] = ((value >> 2) + (1 << 15));
                 }
 
-                waveforms.push_back(this_waveform);
-
                 CHECKNEGATIVE(ADQ_ReturnRecordBuffer(adq_cu_ptr, adq_num,
                                                      available_channel,
                                                      ADQ_record));
@@ -1095,7 +1085,7 @@ std::vector<size_t> ABCD::ADQ14_FWPD::GetEventCounters()
     {
         const uint32_t address = event_counters_base_address + 0x2C + channel * 4;
 
-        event_counters[channel] = ADQ_ReadRegister(adq_cu_ptr, adq_num, address) & 0xFFFFu;
+        event_counters[channel] = ADQ_LOCKED(ADQ_ReadRegister(adq_cu_ptr, adq_num, address)) & 0xFFFFu;
     }
 
     return event_counters;
@@ -1136,7 +1126,7 @@ int ABCD::ADQ14_FWPD::ForceSoftwareTrigger()
 
     absp_logger_console->debug("{} Forcing a software trigger;", log_name);
 
-    CHECKZERO(ADQ_SWTrig(adq_cu_ptr, adq_num));
+    CHECKZERO(ADQ_LOCKED(ADQ_SWTrig(adq_cu_ptr, adq_num)));
 
     return DIGITIZER_SUCCESS;
 }
@@ -303,7 +303,7 @@ bool ABCD::ADQ36_FWDAQ::AcquisitionReady()
 
 //==============================================================================
 
-int ABCD::ADQ36_FWDAQ::GetWaveformsFromCard(std::vector<struct event_waveform> &waveforms)
+int ABCD::ADQ36_FWDAQ::GetWaveformsFromCard(waveforms_buffer::writer &waveforms)
 {
     const std::string log_name = GetName() + " " + GetModel() + "::DataOverflow()";
 
@@ -407,12 +407,9 @@ int ABCD::ADQ36_FWDAQ::GetWaveformsFromCard(std::vector<struct event_waveform> &
 
                 const uint64_t timestamp_waveform = (timestamp + timestamp_offset) << timestamp_bit_shift;
 
-                struct event_waveform this_waveform = waveform_create(timestamp_waveform,
-                                                                      channel,
-                                                                      samples_per_record,
-                                                                      0);
-
-                uint16_t *const samples = waveform_samples_get(&this_waveform);
+                uint16_t *const samples = waveforms.append(timestamp_waveform,
+                                                           channel,
+                                                           samples_per_record);
 
                 if (ADQ_records_array->record[record_index]->header->data_format == ADQ_DATA_FORMAT_INT16)
                 {
@@ -449,8 +446,6 @@ int ABCD::ADQ36_FWDAQ::GetWaveformsFromCard(std::vector<struct event_waveform> &
                 {
                     absp_logger_error->error("{} Unexpected data format (got: {});", log_name, ADQ_records_array->record[record_index]->header->data_format);
                 }
-
-                waveforms.push_back(this_waveform);
             }
 
             // ReturnRecordBuffer() signals to the API that we are done with the
@@ -501,7 +496,7 @@ int ABCD::ADQ36_FWDAQ::ForceSoftwareTrigger()
 
     absp_logger_console->debug("{} Forcing a software trigger;", log_name);
 
-    CHECKNEGATIVE(ADQ_SWTrig(adq_cu_ptr, adq_num));
+    CHECKNEGATIVE(ADQ_LOCKED(ADQ_SWTrig(adq_cu_ptr, adq_num)));
 
     return DIGITIZER_SUCCESS;
 }
@@ -14,6 +14,7 @@
 #include "ADQ14_FWDAQ.hpp"
 #include "ADQ14_FWPD.hpp"
 #include "ADQ36_FWDAQ.hpp"
+#include "Simulated.hpp"
 %}
 
 %include <std_string.i>
@@ -34,6 +35,9 @@
 %ignore ABCD::ADQ36_FWDAQ::ADQ36_FWDAQ;
 %ignore ABCD::ADQ36_FWDAQ::~ADQ36_FWDAQ;
 
+%ignore ABCD::Simulated::Simulated;
+%ignore ABCD::Simulated::~Simulated;
+
 // Include the header files for the SWIG parser
 
 %include "events.h"
@@ -44,3 +48,4 @@
 %include "ADQ14_FWDAQ.hpp"
 %include "ADQ14_FWPD.hpp"
 %include "ADQ36_FWDAQ.hpp"
+%include "Simulated.hpp"
@@ -0,0 +1,320 @@
+#include <cmath>
+#include <cstdint>
+
+#include <chrono>
+#include <thread>
+#include <string>
+
+extern "C"
+{
+#include <jansson.h>
+}
+
+#include "ADQ_utilities.hpp"
+#include "Simulated.hpp"
+
+const unsigned int ABCD::Simulated::default_channels_number = 4;
+const unsigned int ABCD::Simulated::default_samples_number = 256;
+const unsigned int ABCD::Simulated::default_waveforms_per_readout = 100;
+
+// Dummy control unit of the simulated boards
+static int simulated_control_unit;
+
+ABCD::Simulated::Simulated(unsigned int simulated_index) : ABCD::Digitizer()
+{
+    SetModel("Simulated");
+    SetName("SIM" + std::to_string(simulated_index));
+
+    const std::string log_name = GetName() + " " + GetModel() + "::Simulated()";
+    absp_logger_console->info("{}", log_name);
+
+    SetEnabled(false);
+
+    samples_number = default_samples_number;
+    pretrigger = default_samples_number / 8;
+    waveforms_per_readout = default_waveforms_per_readout;
+    pulses_period = 10000;
+    readout_time = 0;
+
+    baseline = 8192;
+    pulse_height = 4000;
+    decay_time = 40;
+
+    acquisition_running = false;
+
+    timestamp_last = 0;
+    random_state = 1 + simulated_index;
+
+    adq_cu_ptr = &simulated_control_unit;
+    // The ADQ boards are numbered from 1
+    adq_num = simulated_index + 1;
+}
+
+//==============================================================================
+
+ABCD::Simulated::~Simulated()
+{
+    const std::string log_name = GetName() + " " + GetModel() + "::~Simulated()";
+    absp_logger_console->info("{}", log_name);
+}
+
+//==============================================================================
+
+int ABCD::Simulated::Initialize()
+{
+    const std::string log_name = GetName() + " " + GetModel() + "::Initialize()";
+    absp_logger_console->info("{}", log_name);
+
+    SetChannelsNumber(default_channels_number);
+
+    event_counters.clear();
+    event_counters.resize(GetChannelsNumber(), 0);
+
+    absp_logger_console->info("{} Channels number: {};", log_name, GetChannelsNumber());
+
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+int ABCD::Simulated::ReadConfig(json_t *config)
+{
+    const std::string log_name = GetName() + " " + GetModel() + "::ReadConfig()";
+
+    const bool enable = json_is_true(json_object_get(config, "enable"));
+
+    absp_logger_console->info("{} Card is {}", log_name, enable ? "enabled" : "disabled");
+
+    SetEnabled(enable);
+    json_object_set_nocheck(config, "enable", json_boolean(enable));
+
+    json_t *json_samples_number = json_object_get(config, "samples_number");
+
+    if (json_is_integer(json_samples_number) && json_integer_value(json_samples_number) > 0)
+    {
+        samples_number = json_integer_value(json_samples_number);
+    }
+
+    json_t *json_pretrigger = json_object_get(config, "pretrigger");
+
+    if (json_is_integer(json_pretrigger) && json_integer_value(json_pretrigger) >= 0)
+    {
+        pretrigger = json_integer_value(json_pretrigger);
+    }
+
+    if (pretrigger >= samples_number)
+    {
+        pretrigger = samples_number / 8;
+    }
+
+    json_t *json_waveforms_per_readout = json_object_get(config, "waveforms_per_readout");
+
+    if (json_is_integer(json_waveforms_per_readout) && json_integer_value(json_waveforms_per_readout) >= 0)
+    {
+        waveforms_per_readout = json_integer_value(json_waveforms_per_readout);
+    }
+
+    json_t *json_pulses_period = json_object_get(config, "pulses_period");
+
+    if (json_is_integer(json_pulses_period) && json_integer_value(json_pulses_period) > 0)
+    {
+        pulses_period = json_integer_value(json_pulses_period);
+    }
+
+    json_t *json_readout_time = json_object_get(config, "readout_time");
+
+    if (json_is_integer(json_readout_time) && json_integer_value(json_readout_time) >= 0)
+    {
+        readout_time = json_integer_value(json_readout_time);
+    }
+
+    json_t *json_decay_time = json_object_get(config, "decay_time");
+
+    if (json_is_number(json_decay_time) && json_number_value(json_decay_time) > 0)
+    {
+        decay_time = json_number_value(json_decay_time);
+    }
+
+    absp_logger_console->info("{} Samples number: {}; Pretrigger: {}; Waveforms per readout: {}; Pulses period: {}; Readout time: {} ms; Decay time: {};", log_name, samples_number, pretrigger, waveforms_per_readout, pulses_period, readout_time, decay_time);
+
+    json_object_set_new_nocheck(config, "samples_number", json_integer(samples_number));
+    json_object_set_new_nocheck(config, "pretrigger", json_integer(pretrigger));
+    json_object_set_new_nocheck(config, "waveforms_per_readout", json_integer(waveforms_per_readout));
+    json_object_set_new_nocheck(config, "pulses_period", json_integer(pulses_period));
+    json_object_set_new_nocheck(config, "readout_time", json_integer(readout_time));
+    json_object_set_new_nocheck(config, "decay_time", json_real(decay_time));
+
+    for (unsigned int channel = 0; channel < GetChannelsNumber(); channel++)
+    {
+        SetChannelEnabled(channel, false);
+    }
+
+    json_t *json_channels = json_object_get(config, "channels");
+
+    if (json_channels != NULL && json_is_array(json_channels))
+    {
+        size_t index;
+        json_t *value;
+
+        json_array_foreach(json_channels, index, value)
+        {
+            json_t *json_id = json_object_get(value, "id");
+
+            if (json_id != NULL && json_is_integer(json_id))
+            {
+                const int id = json_integer_value(json_id);
+
+                absp_logger_console->info("{} Found channel: {};", log_name, id);
+
+                const bool enabled = json_is_true(json_object_get(value, "enable"));
+
+                absp_logger_console->info("{} Channel is {};", log_name, (enabled ? "enabled" : "disabled"));
+
+                json_object_set_new_nocheck(value, "enable", json_boolean(enabled));
+
+                if (0 <= id && id < static_cast<int>(GetChannelsNumber()))
+                {
+                    SetChannelEnabled(id, enabled);
+                }
+            }
+        }
+    }
+
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+int ABCD::Simulated::Configure()
+{
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+int ABCD::Simulated::StartAcquisition()
+{
+    acquisition_running = true;
+
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+int ABCD::Simulated::RearmTrigger()
+{
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+int ABCD::Simulated::StopAcquisition()
+{
+    acquisition_running = false;
+
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+int ABCD::Simulated::ForceSoftwareTrigger()
+{
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+int ABCD::Simulated::ResetOverflow()
+{
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+bool ABCD::Simulated::AcquisitionReady()
+{
+    // As ADQ_GetAcquiredAll() of the ADQ boards
+    return ADQ_LOCKED(acquisition_running && IsEnabled());
+}
+
+//==============================================================================
+
+bool ABCD::Simulated::DataOverflow()
+{
+    // As ADQ_GetStreamOverflow() of the ADQ boards
+    return ADQ_LOCKED(false);
+}
+
+//==============================================================================
+
+int ABCD::Simulated::GetWaveformsFromCard(waveforms_buffer::writer &waveforms)
+{
+    const std::string log_name = GetName() + " " + GetModel() + "::GetWaveformsFromCard()";
+
+    // The data transfer is not locked, as ADQ_GetDataWHTS() of the ADQ boards
+    if (readout_time > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(readout_time));
+    }
+
+    for (unsigned int waveform_index = 0; waveform_index < waveforms_per_readout; waveform_index++)
+    {
+        timestamp_last += pulses_period;
+
+        for (unsigned int channel = 0; channel < GetChannelsNumber(); channel++)
+        {
+            if (!IsChannelEnabled(channel))
+            {
+                continue;
+            }
+
+            uint16_t *const samples = waveforms.append(timestamp_last,
+                                                       channel,
+                                                       samples_number);
+
+            for (unsigned int sample_index = 0; sample_index < samples_number; sample_index++)
+            {
+                random_state = random_state * 1664525u + 1013904223u;
+
+                // Noise of a few channels, from the high bits of the generator
+                const int noise = static_cast<int>(random_state >> 29) - 4;
+
+                double pulse = 0;
+
+                if (sample_index >= pretrigger)
+                {
+                    pulse = pulse_height * std::exp(-(sample_index - pretrigger) / decay_time);
+                }
+
+                samples[sample_index] = baseline - static_cast<uint16_t>(pulse) + noise;
+            }
+
+            event_counters[channel] += 1;
+        }
+    }
+
+    absp_logger_console->debug("{} Generated waveforms: {};", log_name, waveforms.get_records_number());
+
+    return DIGITIZER_SUCCESS;
+}
+
+//==============================================================================
+
+std::vector<size_t> ABCD::Simulated::GetEventCounters()
+{
+    return event_counters;
+}
+
+//==============================================================================
+
+int ABCD::Simulated::SpecificCommand(json_t *json_command)
+{
+    const std::string log_name = GetName() + " " + GetModel() + "::SpecificCommand()";
+
+    const char *cstr_command = json_string_value(json_object_get(json_command, "command"));
+    const std::string command = (cstr_command) ? std::string(cstr_command) : std::string();
+
+    absp_logger_console->info("{} Specific command: {};", log_name, command);
+
+    return DIGITIZER_SUCCESS;
+}
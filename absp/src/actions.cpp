@@ -20,6 +20,7 @@
 #include <chrono>
 #include <vector>
 #include <map>
+#include <memory>
 // For std::pair
 #include <utility>
 #include <cmath>
@@ -28,6 +29,11 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <future>
+// For std::ref
+#include <functional>
+// For std::max
+#include <algorithm>
 #include <unistd.h>
 #include <zmq.h>
 
@@ -66,6 +72,7 @@ extern "C"
 #include "ADQ14_FWDAQ.hpp"
 #include "ADQ14_FWPD.hpp"
 #include "ADQ36_FWDAQ.hpp"
+#include "Simulated.hpp"
 
 // The global channel number of each card is calculated with the formula:
 // global_channel_number = board_channel_number + board_user_id * GetChannelsNumber()
@@ -248,6 +255,67 @@ void actions::generic::rearm_trigger(status &global_status, unsigned int digitiz
     digitizer->RearmTrigger();
 }
 
+struct readout_result actions::generic::read_digitizer(status &global_status, unsigned int digitizer_index, waveforms_buffer::writer &waveforms)
+{
+    // WARNING: This function might run in a separate thread for each
+    // digitizer, thus it should not modify global_status and it should not
+    // use the sockets.
+    struct readout_result result;
+
+    const unsigned int user_id = global_status.digitizers_user_ids.at(digitizer_index);
+    auto digitizer = global_status.digitizers[digitizer_index];
+
+    result.is_ready = digitizer->AcquisitionReady();
+    result.is_overflow = digitizer->DataOverflow();
+
+    absp_logger_console->info("Polling board: {} (user_id: {}, digitizer_index: {}); Acquisition ready: {}; Overflow: {};", digitizer->GetName(), user_id, digitizer_index, (result.is_ready ? "yes" : "no"), (result.is_overflow ? "yes" : "no"));
+
+    if (result.is_overflow)
+    {
+        // The DRAM is full and data was probably lost and corrupted, so we
+        // signal this as an error. A flush of the DMA would provide
+        // corrupted data.
+        digitizer->ResetOverflow();
+    }
+
+    if (result.is_ready)
+    {
+        absp_logger_console->info("Getting waveforms from card: {};", digitizer->GetName());
+
+        const auto get_data_start = std::chrono::high_resolution_clock::now();
+
+        result.event_counters = digitizer->GetEventCounters();
+
+        // The digitizer writes the waveforms directly in the final buffer,
+        // without intermediate copies.
+        result.retval = digitizer->GetWaveformsFromCard(waveforms);
+
+        // Releasing the buffer, so that it can be grown by the other readouts
+        waveforms.close();
+
+        const auto get_data_end = std::chrono::high_resolution_clock::now();
+        auto delta_time = std::chrono::duration_cast<std::chrono::milliseconds>(get_data_end - get_data_start);
+
+        result.time = delta_time.count();
+        result.waveforms_number = waveforms.get_records_number();
+
+        absp_logger_console->info("Waveforms download from card: {}: {}; waveforms number: {}; Time required: {} ms;", digitizer->GetName(), (result.retval == DIGITIZER_SUCCESS ? "success" : "failure"), result.waveforms_number, result.time);
+
+        if (result.retval == DIGITIZER_FAILURE)
+        {
+            // A failed readout is discarded as a whole
+            waveforms.discard();
+            result.waveforms_number = 0;
+        }
+        else
+        {
+            actions::generic::rearm_trigger(global_status, digitizer_index);
+        }
+    }
+
+    return result;
+}
+
 void actions::generic::stop_acquisition(status &global_status)
 {
     absp_logger_console->info("#### Stopping acquisition!!! ");
@@ -524,6 +592,15 @@ bool actions::generic::create_digitizer(status &global_status)
         }
     }
 
+    for (unsigned int simulated_index = 0; simulated_index < global_status.simulated_digitizers_number; simulated_index++)
+    {
+        ABCD::Simulated *simulated_ptr = new ABCD::Simulated(simulated_index);
+
+        simulated_ptr->Initialize();
+
+        global_status.digitizers.push_back(simulated_ptr);
+    }
+
     const int number_of_failed_devices = ADQControlUnit_GetFailedDeviceCount(global_status.adq_cu_ptr);
 
     if (number_of_failed_devices > 0)
@@ -608,6 +685,21 @@ bool actions::generic::configure_digitizer(status &global_status)
         global_status.waveforms_buffer_size_max_Number = waveforms_buffer_size_max_Number;
 
         json_object_set_new_nocheck(json_global, "waveforms_buffer_max_size", json_integer(waveforms_buffer_size_max_Number));
+
+        json_t *json_parallel_readout = json_object_get(json_global, "parallel_readout");
+
+        if (json_is_boolean(json_parallel_readout))
+        {
+            global_status.parallel_readout = json_is_true(json_parallel_readout);
+        }
+        else
+        {
+            global_status.parallel_readout = defaults_absp_parallel_readout;
+        }
+
+        absp_logger_console->info("Parallel readout: {};", (global_status.parallel_readout ? "true" : "false"));
+
+        json_object_set_new_nocheck(json_global, "parallel_readout", json_boolean(global_status.parallel_readout));
     }
 
     unsigned int max_channel_number = 0;
@@ -859,6 +951,17 @@ bool actions::generic::allocate_memory(status &global_status)
     // Reserve the waveforms_buffer in order to have a good starting size of its buffer
     global_status.waveforms_buffer.reserve(global_status.waveforms_buffer_size_max_Number * (waveform_header_size() + sizeof(uint16_t) * defaults_absp_waveforms_expected_number_of_samples));
 
+    global_status.readouts_statistics.clear();
+
+    // The statistics are created here, so that the readout threads never
+    // modify the map
+    for (auto value = global_status.digitizers_user_ids.begin(); value != global_status.digitizers_user_ids.end(); ++value)
+    {
+        const unsigned int digitizer_index = value->first;
+
+        global_status.readouts_statistics[digitizer_index] = readout_statistics();
+    }
+
     return true;
 }
 
@@ -1304,6 +1407,11 @@ state actions::start_acquisition(status &global_status)
     global_status.ICR_curr_counts.clear();
     global_status.ICR_curr_counts.resize(global_status.channels_number, 0);
 
+    for (auto &statistics: global_status.readouts_statistics)
+    {
+        statistics.second = readout_statistics();
+    }
+
     // Start acquisition
     absp_logger_console->info("Starting acquisition;");
 
@@ -1419,24 +1527,72 @@ state actions::read_data(status &global_status)
 {
     bool is_error = false;
 
-    // Gather data from the available digitizers
+    std::map<unsigned int, struct readout_result> results;
+
+    // All the digitizers write their waveforms directly in the
+    // waveforms_buffer, each one with its own writer that converts the
+    // channels to the global numbering.
+    waveforms_buffer::concurrent_buffer shared_buffer(global_status.waveforms_buffer);
+
+    std::map<unsigned int, std::unique_ptr<waveforms_buffer::writer>> writers;
+
     for (auto value = global_status.digitizers_user_ids.begin(); value != global_status.digitizers_user_ids.end(); ++value)
     {
         const unsigned int digitizer_index = value->first;
         const unsigned int user_id = value->second;
         auto digitizer = global_status.digitizers[digitizer_index];
 
-        const bool is_ready = digitizer->AcquisitionReady();
-        const bool is_overflow = digitizer->DataOverflow();
+        const uint8_t first_channel = user_id * digitizer->GetChannelsNumber();
+
+        writers[digitizer_index] = std::make_unique<waveforms_buffer::writer>(shared_buffer, first_channel);
+    }
+
+    if (global_status.parallel_readout && global_status.digitizers_user_ids.size() > 1)
+    {
+        // Each digitizer is read in its own thread, so that a slow DMA
+        // transfer of a board does not delay the others. The calls to the
+        // ADQ API are serialized by the drivers.
+        std::map<unsigned int, std::future<struct readout_result>> readouts;
+
+        for (auto &entry: writers)
+        {
+            const unsigned int digitizer_index = entry.first;
+
+            readouts[digitizer_index] = std::async(std::launch::async,
+                                                   actions::generic::read_digitizer,
+                                                   std::ref(global_status),
+                                                   digitizer_index,
+                                                   std::ref(*entry.second));
+        }
+
+        for (auto &readout: readouts)
+        {
+            results[readout.first] = readout.second.get();
+        }
+    }
+    else
+    {
+        for (auto &entry: writers)
+        {
+            const unsigned int digitizer_index = entry.first;
+
+            results[digitizer_index] = actions::generic::read_digitizer(global_status, digitizer_index, *entry.second);
+        }
+    }
 
-        absp_logger_console->info("Polling board: {} (user_id: {}, digitizer_index: {}); Acquisition ready: {}; Overflow: {};", digitizer->GetName(), user_id, digitizer_index, (is_ready ? "yes" : "no"), (is_overflow ? "yes" : "no"));
+    // Merging the results of the readouts, in the order of the digitizers
+    for (auto &entry: results)
+    {
+        const unsigned int digitizer_index = entry.first;
+        const struct readout_result &result = entry.second;
+        const unsigned int user_id = global_status.digitizers_user_ids.at(digitizer_index);
+        auto digitizer = global_status.digitizers[digitizer_index];
+
+        struct readout_statistics &statistics = global_status.readouts_statistics[digitizer_index];
 
-        if (is_overflow)
+        if (result.is_overflow)
         {
-            // The DRAM is full and data was probably lost and corrupted, so we
-            // signal this as an error. A flush of the DMA would provide
-            // corrupted data.
-            digitizer->ResetOverflow();
+            statistics.overflows += 1;
 
             std::string error_string = "Data overflow in digitizer: ";
             error_string += digitizer->GetName();
@@ -1454,33 +1610,23 @@ state actions::read_data(status &global_status)
             is_error = true;
         }
 
-        if (is_ready)
+        if (result.is_ready)
         {
-            absp_logger_console->info("Getting waveforms from card;");
+            statistics.readouts += 1;
+            statistics.last_time = result.time;
+            statistics.total_time += result.time;
+            statistics.max_time = std::max(statistics.max_time, result.time);
 
-            const auto get_data_start = std::chrono::high_resolution_clock::now();
-
-            const std::vector<size_t> event_counters = digitizer->GetEventCounters();
-
-            for (uint8_t channel = 0; channel < (digitizer)->GetChannelsNumber(); channel += 1)
+            for (uint8_t channel = 0; channel < (digitizer)->GetChannelsNumber() && channel < result.event_counters.size(); channel += 1)
             {
                 const uint8_t global_channel = channel + user_id * (digitizer)->GetChannelsNumber();
-                global_status.ICR_curr_counts[global_channel] = event_counters[channel];
+                global_status.ICR_curr_counts[global_channel] = result.event_counters[channel];
             }
 
-            std::vector<struct event_waveform> waveforms;
-
-            const int retval = digitizer->GetWaveformsFromCard(waveforms);
-
-            const auto get_data_end = std::chrono::high_resolution_clock::now();
-            auto delta_time = std::chrono::duration_cast<std::chrono::milliseconds>(get_data_end - get_data_start);
-
-            unsigned int waveforms_size = waveforms.size();
-
-            absp_logger_console->info("Waveforms download: {}; waveforms number: {}; Time required: {} ms;", (retval == DIGITIZER_SUCCESS ? "success" : "failure"), waveforms_size, delta_time.count());
-
-            if (retval == DIGITIZER_FAILURE)
+            if (result.retval == DIGITIZER_FAILURE)
             {
+                statistics.fetch_failures += 1;
+
                 std::string error_string = "Data fetch failure in digitizer: ";
                 error_string += digitizer->GetName();
 
@@ -1498,36 +1644,30 @@ state actions::read_data(status &global_status)
             }
             else
             {
-                for (unsigned int waveform_index = 0; waveform_index < waveforms_size; waveform_index++)
+                // The channels were already converted to the global numbering
+                // by the writer, only the headers are read here
+                const waveforms_buffer::writer &waveforms = *writers.at(digitizer_index);
+
+                for (size_t waveform_index = 0; waveform_index < waveforms.records.size(); waveform_index++)
                 {
-                    struct event_waveform this_waveform = waveforms[waveform_index];
+                    const size_t offset = waveforms.records[waveform_index].first;
+                    const size_t this_waveform_size = waveforms.records[waveform_index].second;
 
-                    const uint8_t global_channel = this_waveform.channel + user_id * (digitizer)->GetChannelsNumber();
+                    const uint8_t global_channel = waveforms_buffer::get_channel(global_status.waveforms_buffer.data() + offset);
 
-                    this_waveform.channel = global_channel;
                     global_status.counts[global_channel] += 1;
                     global_status.partial_counts[global_channel] += 1;
                     global_status.waveforms_buffer_size_Number += 1;
 
-                    const size_t current_waveform_buffer_size = global_status.waveforms_buffer.size();
-                    const size_t this_waveform_size = waveform_size(&this_waveform);
-
-                    absp_logger_console->trace("Storing waveform in buffer; Waveform index: {}; channel: {}; samples: {}; buffer pointer: {}; Waveforms buffer size: {}; Waveform size: {};", waveform_index, (unsigned int)this_waveform.channel, (unsigned int)this_waveform.samples_number, static_cast<void *>(this_waveform.buffer), current_waveform_buffer_size, this_waveform_size);
-
-                    global_status.waveforms_buffer.resize(current_waveform_buffer_size + this_waveform_size);
-
-                    memcpy(global_status.waveforms_buffer.data() + current_waveform_buffer_size,
-                           reinterpret_cast<void *>(waveform_serialize(&this_waveform)),
-                           this_waveform_size);
-
-                    waveform_destroy_samples(&this_waveform);
+                    absp_logger_console->trace("Stored waveform in buffer; Waveform index: {}; channel: {}; buffer offset: {}; Waveform size: {};", waveform_index, (unsigned int)global_channel, offset, this_waveform_size);
                 }
-
-                actions::generic::rearm_trigger(global_status, digitizer_index);
             }
         }
     }
 
+    // Removing the records of the failed readouts and the unused space
+    shared_buffer.finish();
+
     const size_t waveforms_buffer_size_Bytes = global_status.waveforms_buffer.size();
 
     absp_logger_console->info("Waveforms buffer size: {} ({} B);", global_status.waveforms_buffer_size_Number, waveforms_buffer_size_Bytes);
@@ -1631,6 +1771,38 @@ state actions::acquisition_publish_status(status &global_status)
 
         json_object_set_new_nocheck(acquisition, "counts", counts);
         json_object_set_new_nocheck(acquisition, "ICR_counts", ICR_counts);
+
+        json_t *readouts = json_array();
+
+        for (auto value = global_status.digitizers_user_ids.begin(); value != global_status.digitizers_user_ids.end(); ++value)
+        {
+            const unsigned int digitizer_index = value->first;
+            const unsigned int user_id = value->second;
+            const struct readout_statistics &statistics = global_status.readouts_statistics[digitizer_index];
+
+            json_t *readout = json_object();
+
+            json_object_set_new_nocheck(readout, "id", json_integer(user_id));
+            json_object_set_new_nocheck(readout, "name", json_string(global_status.digitizers[digitizer_index]->GetName().c_str()));
+            json_object_set_new_nocheck(readout, "readouts", json_integer(statistics.readouts));
+            json_object_set_new_nocheck(readout, "fetch_failures", json_integer(statistics.fetch_failures));
+            json_object_set_new_nocheck(readout, "overflows", json_integer(statistics.overflows));
+            json_object_set_new_nocheck(readout, "last_time", json_integer(statistics.last_time));
+            json_object_set_new_nocheck(readout, "max_time", json_integer(statistics.max_time));
+
+            if (statistics.readouts > 0)
+            {
+                json_object_set_new_nocheck(readout, "mean_time", json_real(static_cast<double>(statistics.total_time) / statistics.readouts));
+            }
+            else
+            {
+                json_object_set_new_nocheck(readout, "mean_time", json_real(0));
+            }
+
+            json_array_append_new(readouts, readout);
+        }
+
+        json_object_set_new_nocheck(acquisition, "readouts", readouts);
     }
 
     json_object_set_new_nocheck(status_message, "acquisition", acquisition);
@@ -28,6 +28,9 @@
 
 #include "events.h"
 
+#define RADIX_SORT_PARALLEL
+#include "radix_sort.h"
+
 #define BUFFER_SIZE_UNIT 1000000
 #define GiB (1024.0 * 1024.0 * 1024.0)
 
@@ -135,9 +138,10 @@ int main(int argc, char *argv[])
     unsigned int verbosity = 0;
     uintmax_t buffer_size = BUFFER_SIZE_UNIT;
     bool disable_sort_on_disk = false;
+    unsigned int threads_number = 1;
 
     int c = 0;
-    while ((c = getopt(argc, argv, "hvb:d")) != -1) {
+    while ((c = getopt(argc, argv, "hvb:dt:")) != -1) {
         switch (c) {
             case 'h':
                 print_usage(argv[0]);
@@ -151,6 +155,12 @@ int main(int argc, char *argv[])
             case 'd':
                 disable_sort_on_disk = true;
                 break;
+            case 't':
+                threads_number = strtoul(optarg, NULL, 0);
+                if (threads_number < 1) {
+                    threads_number = 1;
+                }
+                break;
             default:
                 printf("Unknown command: %c", c);
                 break;
@@ -173,6 +183,7 @@ int main(int argc, char *argv[])
             printf("\t%s\n", argv[i + optind]);
         }
         printf("Buffer size: %" PRIuMAX " M event (%.3f GiB)\n", buffer_size / BUFFER_SIZE_UNIT, buffer_size * sizeof(struct event_PSD) / GiB);
+        printf("Threads number: %u\n", threads_number);
         printf("Verbosity: %u\n", verbosity);
         if (disable_sort_on_disk) {
             printf("Sort on disk is disabled!\n");
@@ -188,6 +199,14 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    // Scratch buffer for the radix sort, if it cannot be allocated the
+    // buffers are sorted with the insertion sort
+    struct event_PSD *sorting_buffer = malloc(buffer_size * sizeof(struct event_PSD));
+    if (!sorting_buffer && verbosity > 0)
+    {
+        printf("WARNING: could not allocate memory for the sorting buffer, using the insertion sort\n");
+    }
+
     for (int index_files = optind; index_files < argc; index_files += 1)
     {
         uintmax_t number_of_events = 0;
@@ -235,7 +254,28 @@ int main(int argc, char *argv[])
                     printf("Sorting buffer number: %" PRIuMAX "; size: %" PRIuMAX " events\n", counter_buffers, counter_events);
                 }
 
-                insertion_sort(buffer, buffer, counter_events, verbosity);
+                enum radix_sort_error_t sorting_result = RADIX_SORT_ERROR_ALLOCATION;
+
+                if (sorting_buffer) {
+                    struct timespec sorting_start;
+                    struct timespec sorting_end;
+                    clock_gettime(CLOCK_REALTIME, &sorting_start);
+
+                    sorting_result = radix_sort_timestamps_parallel(buffer, counter_events,
+                                                                    sizeof(struct event_PSD),
+                                                                    offsetof(struct event_PSD, timestamp),
+                                                                    sorting_buffer, threads_number);
+
+                    clock_gettime(CLOCK_REALTIME, &sorting_end);
+
+                    if (verbosity > 0) {
+                        printf("Radix sorting time: %f s\n", time_difference(sorting_end, sorting_start));
+                    }
+                }
+
+                if (sorting_result != RADIX_SORT_OK) {
+                    insertion_sort(buffer, buffer, counter_events, verbosity);
+                }
 
                 // Move the file pointer back to the start of the buffer
                 fseek(file, -counter_events * sizeof(struct event_PSD), SEEK_CUR);
@@ -271,6 +311,9 @@ int main(int argc, char *argv[])
     if (buffer) {
         free(buffer);
     }
+    if (sorting_buffer) {
+        free(sorting_buffer);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -279,8 +322,8 @@ void print_usage(const char *name) {
     printf("Usage: %s [options] <file_name> [<file_name> ...]\n", name);
     printf("\n");
     printf("Sorts ade files based on the events' timestamps.\n");
-    printf("The sorting happens, in a single thread, in two stages:\n");
-    printf("1. The file is read in buffers that are sorted in memory then written back to the file.\n");
+    printf("The sorting happens in two stages:\n");
+    printf("1. The file is read in buffers that are radix sorted in memory then written back to the file.\n");
     printf("2. If enabled, the file is sorted in-place on the whole file itself on the disk drive.\n");
     printf("\n");
     printf("WARNING: If the sorting on the file is not enabled then the sorting is only partial!\n");
@@ -294,6 +337,7 @@ void print_usage(const char *name) {
     printf("\t-d: Disables the sorting in-place on the file\n");
     printf("\t-b <buffer_size>: Buffer size for the pre-sorting, in multiples of 1 million events, default: 1\n");
     printf("\t                  The size of one PSD event is %u B so 1 million events = %u MiB.\n", (unsigned int)sizeof(struct event_PSD), (unsigned int)sizeof(struct event_PSD) * BUFFER_SIZE_UNIT / 1024);
+    printf("\t-t <threads>: Number of threads used for the sorting of the buffers, default: 1\n");
     printf("\t-v: Set verbose execution, using it multiple times increases the verbosity level.\n");
     printf("\t    With a verbosity of 2 it prints the progress of the sorting.\n");
 
@@ -321,7 +321,7 @@ bool actions::generic::read_socket(status &global_status)
         
                     memcpy(new_data.data(), histo_E->histo, histo_size * sizeof(uint8_t));
         
-                    global_status.fifoes[channel].push(new_data);
+                    global_status.fifoes[channel].push(std::move(new_data));
                 }
             }
 
@@ -925,7 +925,7 @@ state actions::normal_fit_peak(status &global_status)
             const binary_fifo::time_point to_time = std::chrono::system_clock::now();
             const binary_fifo::time_point from_time = std::chrono::system_clock::now() - std::chrono::seconds(global_status.accumulation_time);
  
-            std::vector<binary_fifo::binary_data> data =
+            std::vector<binary_fifo::binary_view> data =
                 global_status.fifoes[channel].get_data(from_time, to_time);
 
             // Creating an empty istogram as a temporary hook for the histogram_add_to() function
@@ -934,11 +934,15 @@ state actions::normal_fit_peak(status &global_status)
                                       histo_E->min,
                                       histo_E->max,
                                       histo_E->bin_width,
+                                      histo_E->inverse_bin_width,
+                                      1,
+                                      1,
                                       nullptr};
  
             for (auto &this_data: data)
             {
-                temp_histo.histo = reinterpret_cast<counter_type*>(this_data.data());
+                // The temporary histogram is only read by histogram_add_to()
+                temp_histo.histo = const_cast<counter_type*>(reinterpret_cast<const counter_type*>(this_data.data()));
                 
                 histogram_add_to(histo_E, &temp_histo);
             }
@@ -43,12 +43,14 @@
 #include <time.h>
 
 #include <zmq.h>
-#include <zlib.h>
-#include <bzlib.h>
 
 #include "defaults.h"
 #include "socket_functions.h"
 #include "utilities_functions.h"
+#include "codecs.h"
+#include "prefilters.h"
+#include "compressed_topics.h"
+#include "ordered_pool.h"
 
 unsigned int terminate_flag = 0;
 
@@ -59,11 +61,24 @@ unsigned int terminate_flag = 0;
 
 void signal_handler(int signum);
 
+struct gzad_worker
+{
+    struct codec_compressor compressor;
+    unsigned int prefilters;
+
+    // Buffer for the pre-filters that do not work in place
+    uint8_t *scratch_buffer;
+    size_t scratch_capacity;
+
+    unsigned int verbosity;
+};
+
 void print_usage(const char *name)
 {
     printf("Usage: %s [options]\n", name);
     printf("\n");
-    printf("Datastream filter that compressed packets with the zlib or with bz2.\n");
+    printf("Datastream filter that compresses packets with the zlib, bz2, lz4 or zstd codecs.\n");
+    printf("The packets are compressed in parallel by a pool of worker threads, preserving their order.\n");
     printf("\n");
     printf("Optional arguments:\n");
     printf("\t-h: Display this message\n");
@@ -72,11 +87,128 @@ void print_usage(const char *name)
     printf("\t-A <address>: Input socket address, default: %s\n", defaults_abcd_data_address_sub);
     printf("\t-D <address>: Output socket address, default: %s\n", defaults_gzad_data_address);
     printf("\t-T <period>: Set base period in milliseconds, default: %d\n", defaults_gzad_base_period);
-    printf("\t-b: Enable usage of bz2\n");
+    printf("\t-c <codec>: Compression codec, default: %s, available:", defaults_gzad_codec);
+    for (int type = 0; type < CODECS_NUMBER; type++)
+    {
+        if (codec_available(type))
+        {
+            printf(" %s", codec_name(type));
+        }
+    }
+    printf("\n");
+    printf("\t-b: Enable usage of bz2, same as: -c bz2\n");
+    printf("\t-l <level>: Compression level, default: depends on the codec\n");
+    printf("\t-j <threads>: Number of compression threads, default: %d\n", defaults_gzad_threads);
+    printf("\t-p <pre-filter>: Enable a pre-filter, repeating the option enables more pre-filters, available:\n");
+    printf("\t                 delta: delta encoding of the events timestamps and of the waveforms samples\n");
+    printf("\t                 shuffle: byte-shuffle of the events records\n");
 
     return;
 }
 
+bool gzad_compress(struct pool_job *job, void *worker_context)
+{
+    struct gzad_worker *worker = worker_context;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // The output buffer is sized for incompressible data
+    const size_t bound = codec_compress_bound(&worker->compressor, job->input_size);
+
+    if (job->output_capacity < bound)
+    {
+        uint8_t *new_output = realloc(job->output, bound * sizeof(uint8_t));
+
+        if (!new_output)
+        {
+            printf("ERROR: Unable to allocate output buffer\n");
+
+            return false;
+        }
+
+        job->output = new_output;
+        job->output_capacity = bound;
+    }
+
+    const unsigned int prefilters = prefilter_applicable(worker->prefilters, prefilter_data_type(job->topic), job->input_size);
+
+    if (prefilters != PREFILTER_NONE && worker->scratch_capacity < job->input_size)
+    {
+        uint8_t *new_scratch = realloc(worker->scratch_buffer, job->input_size * sizeof(uint8_t));
+
+        if (!new_scratch)
+        {
+            printf("ERROR: Unable to allocate the pre-filters buffer\n");
+
+            return false;
+        }
+
+        worker->scratch_buffer = new_scratch;
+        worker->scratch_capacity = job->input_size;
+    }
+
+    const uint8_t *input = prefilter_apply(prefilters, prefilter_data_type(job->topic),
+                                           job->input, job->input_size, worker->scratch_buffer);
+
+    job->output_size = codec_compress(&worker->compressor, input, job->input_size, job->output, job->output_capacity);
+
+    if (job->output_size == 0)
+    {
+        printf("ERROR: Unable to compress the message with topic: %s\n", job->topic);
+
+        return false;
+    }
+
+    if (worker->verbosity > 0)
+    {
+        struct timespec stop;
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+
+        const float elaboration_time = (stop.tv_sec - start.tv_sec) * 1000.0 + (stop.tv_nsec - start.tv_nsec) / 1000000.0;
+        const float elaboration_speed = job->input_size / elaboration_time * 1000.0 / 1024.0 / 1024.0;
+
+        printf("size: %zu; output_size: %zu; ratio: %.1f%%; elaboration_time: %f ms; elaboration_speed: %f MBi/s\n", job->input_size, job->output_size, ((float)job->output_size) / job->input_size * 100, elaboration_time, elaboration_speed);
+    }
+
+    return true;
+}
+
+//! Sends the oldest compressed message, if it is ready or if waiting for it.
+//! Returns true if a message was collected.
+bool send_oldest(struct ordered_pool *pool, void *output_socket, enum codec_types codec, unsigned int prefilters, bool wait, unsigned int verbosity)
+{
+    struct pool_job *job = ordered_pool_collect(pool, wait);
+
+    if (!job)
+    {
+        return false;
+    }
+
+    if (job->success)
+    {
+        // The workers applied only the pre-filters suitable for the data
+        const unsigned int applied_prefilters = prefilter_applicable(prefilters, prefilter_data_type(job->topic), job->input_size);
+
+        // Compute the new topic, with the uncompressed size for the receiver
+        char new_topic[defaults_all_topic_buffer_size];
+
+        compressed_topic_format(new_topic, defaults_all_topic_buffer_size, job->topic,
+                                codec, applied_prefilters, job->input_size, job->output_size);
+
+        send_byte_message(output_socket, new_topic, (void *)job->output, job->output_size, verbosity);
+
+        if (verbosity > 0)
+        {
+            printf("Sending message with topic: %s\n", new_topic);
+        }
+    }
+
+    ordered_pool_release(pool);
+
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     // Register the handler for SIGTERM (from kill), SIGINT (from ctrl-c)
@@ -89,16 +221,37 @@ int main(int argc, char *argv[])
     char *input_address = defaults_abcd_data_address_sub;
     char *output_address = defaults_gzad_data_address;
     char *subscription_topic = defaults_gzad_topic_subscribe;
-    bool use_bz2 = false;
+    int codec = codec_from_name(defaults_gzad_codec);
+    int level = -1;
+    int threads_number = defaults_gzad_threads;
+    unsigned int prefilters = PREFILTER_NONE;
 
     int c = 0;
-    while ((c = getopt(argc, argv, "hbt:A:D:T:v")) != -1) {
+    while ((c = getopt(argc, argv, "hbc:l:j:p:t:A:D:T:v")) != -1) {
         switch (c) {
             case 'h':
                 print_usage(argv[0]);
                 return EXIT_SUCCESS;
             case 'b':
-                use_bz2 = true;
+                codec = CODEC_BZ2;
+                break;
+            case 'c':
+                codec = codec_from_name(optarg);
+                break;
+            case 'l':
+                level = atoi(optarg);
+                break;
+            case 'j':
+                threads_number = atoi(optarg);
+                break;
+            case 'p':
+                if (prefilter_from_name(optarg, strlen(optarg)) == PREFILTER_NONE)
+                {
+                    printf("ERROR: Unknown pre-filter: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                prefilters |= prefilter_from_name(optarg, strlen(optarg));
                 break;
             case 't':
                 subscription_topic = optarg;
@@ -121,11 +274,68 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (codec < 0 || !codec_available(codec))
+    {
+        printf("ERROR: Unknown or unavailable codec\n");
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (level < 0)
+    {
+        level = codec_default_level(codec);
+    }
+
+    if (threads_number < 1)
+    {
+        threads_number = 1;
+    }
+
     if (verbosity > 0) {
         printf("Input socket address: %s\n", input_address);
         printf("Output socket address: %s\n", output_address);
         printf("Verbosity: %u\n", verbosity);
         printf("Base period: %u\n", base_period);
+        printf("Codec: %s\n", codec_name(codec));
+        printf("Level: %d\n", level);
+        printf("Threads: %d\n", threads_number);
+        for (unsigned int i = 0; i < PREFILTERS_NUMBER; i++)
+        {
+            if (prefilters & (1 << i))
+            {
+                printf("Pre-filter: %s\n", prefilter_name(1 << i));
+            }
+        }
+    }
+
+    // Each worker keeps its own compressor, that is reused for all the messages
+    struct gzad_worker workers[threads_number];
+    void *worker_contexts[threads_number];
+
+    for (int i = 0; i < threads_number; i++)
+    {
+        if (!codec_compressor_init(&workers[i].compressor, codec, level))
+        {
+            for (int j = 0; j <= i; j++)
+            {
+                codec_compressor_free(&workers[j].compressor);
+            }
+
+            return EXIT_FAILURE;
+        }
+
+        workers[i].prefilters = prefilters;
+        workers[i].scratch_buffer = NULL;
+        workers[i].scratch_capacity = 0;
+        workers[i].verbosity = verbosity;
+        worker_contexts[i] = &workers[i];
+    }
+
+    struct ordered_pool pool;
+
+    if (!ordered_pool_init(&pool, threads_number * defaults_gzad_jobs_per_thread, gzad_compress, worker_contexts, threads_number))
+    {
+        return EXIT_FAILURE;
     }
 
     // Creates a ZeroMQ context
@@ -188,159 +398,113 @@ int main(int argc, char *argv[])
 
     while (terminate_flag == 0)
     {
-        char *topic;
-        char *input_buffer;
-        size_t size;
-
-        const int result = receive_byte_message(input_socket, &topic, (void **)(&input_buffer), &size, true, verbosity);
-
-        if (result == EXIT_FAILURE)
+        // Sending the messages that were compressed in the meantime, in the
+        // same order they were received
+        while (send_oldest(&pool, output_socket, codec, prefilters, false, verbosity))
         {
-            printf("[%zu] ERROR: Some error occurred!!!\n", counter);
-        }
-        else if (size == 0 && result == EXIT_SUCCESS)
-        {
-            if (verbosity > 2)
-            {
-                printf("[%zu] No message available\n", counter);
-            }
+            msg_ID += 1;
         }
-        else if (size > 0 && result == EXIT_SUCCESS)
+
+        // The input is drained without waiting, so that the workers are fed
+        // as long as messages are available
+        bool input_available = true;
+        bool received_any = false;
+
+        while (input_available && terminate_flag == 0)
         {
-            if (verbosity > 0)
+            // If all the workers are busy the oldest message is waited for
+            if (ordered_pool_full(&pool) && send_oldest(&pool, output_socket, codec, prefilters, true, verbosity))
             {
-                printf("[%zu] Message received!!! (topic: %s)\n", counter, topic);
+                msg_ID += 1;
             }
 
-            const clock_t event_start = clock();
-
-            uint64_t output_size = 0;
+            char *topic;
+            char *input_buffer;
+            size_t size;
 
-            uint8_t *output_buffer = malloc(size * sizeof(uint8_t));
+            const int result = receive_byte_message(input_socket, &topic, (void **)(&input_buffer), &size, true, verbosity);
 
-            if (output_buffer == NULL)
+            if (result == EXIT_FAILURE)
             {
-                printf("[%zu] ERROR: Unable to allocate output buffer\n", counter);
+                printf("[%zu] ERROR: Some error occurred!!!\n", counter);
+
+                input_available = false;
             }
-            else
+            else if (size == 0 && result == EXIT_SUCCESS)
             {
-                if (use_bz2 == false)
-                {
-                    // Preparing the struct that the library uses as input
-                    z_stream zipped_stream;
-
-                    zipped_stream.zalloc = Z_NULL;
-                    zipped_stream.zfree = Z_NULL;
-                    zipped_stream.opaque = Z_NULL;
-                    zipped_stream.data_type = Z_BINARY;
-
-                    zipped_stream.avail_in = (uInt)size;
-                    zipped_stream.next_in = (Bytef *)input_buffer;
-                    zipped_stream.avail_out = (uInt)size;
-                    zipped_stream.next_out = (Bytef *)output_buffer;
-
-                    deflateInit(&zipped_stream, Z_BEST_SPEED);
-                    deflate(&zipped_stream, Z_FINISH);
-
-                    output_size = zipped_stream.total_out;
-
-                    deflateEnd(&zipped_stream);
-                }
-                else
+                if (verbosity > 2)
                 {
-                    // Preparing the struct that the library uses as input
-                    bz_stream zipped_stream;
-
-                    zipped_stream.bzalloc = NULL;
-                    zipped_stream.bzfree = NULL;
-                    zipped_stream.opaque = NULL;
-
-                    zipped_stream.avail_in = size;
-                    zipped_stream.next_in = input_buffer;
-                    zipped_stream.avail_out = size;
-                    zipped_stream.next_out = (char*)output_buffer;
-
-                    BZ2_bzCompressInit(&zipped_stream, 9, verbosity, 0);
-                    BZ2_bzCompress(&zipped_stream, BZ_FINISH);
-
-                    // Apparently these two are both valid
-                    //output_size = size - zipped_stream.avail_out;
-                    output_size = (((size_t)zipped_stream.total_out_hi32) << 32) | zipped_stream.total_out_lo32;
-
-                    BZ2_bzCompressEnd(&zipped_stream);
+                    printf("[%zu] No message available\n", counter);
                 }
 
-                char topic_no_size[defaults_all_topic_buffer_size];
-
-                // Find the size portion of the topic
-                char *size_position = rstrstr(topic, "_s");
-                size_t size_index = size_position - topic;
-
-                if (!size_position)
+                input_available = false;
+            }
+            else if (size > 0 && result == EXIT_SUCCESS)
+            {
+                if (verbosity > 0)
                 {
-                    printf("[%zu] WARNING: Unable to find size in topic\n", counter);
-                    size_index = strlen(topic);
+                    printf("[%zu] Message received!!! (topic: %s)\n", counter, topic);
                 }
 
-                strncpy(topic_no_size, topic, size_index);
-                topic_no_size[size_index] = '\0';
+                // The pool takes care of freeing the buffers
+                ordered_pool_submit(&pool, topic, (uint8_t *)input_buffer, size);
 
-                // Compute the new topic
-                char new_topic[defaults_all_topic_buffer_size];
+                msg_counter += 1;
+                received_any = true;
+            }
+            else
+            {
+                printf("[%zu] ERROR: What?!?!?!\n", counter);
 
-                const char *compression = use_bz2 ? "bz2_" : "zlib_"; 
+                input_available = false;
+            }
 
-                // I am not sure if snprintf is standard or not, apprently it is in the C99 standard
-                snprintf(new_topic,
-                         defaults_all_topic_buffer_size,
-                         "compressed_%s%s_s%" PRIu64,
-                         compression, topic_no_size, output_size);
+            counter += 1;
 
-                send_byte_message(output_socket, new_topic, (void *)output_buffer, output_size, verbosity);
+            while (send_oldest(&pool, output_socket, codec, prefilters, false, verbosity))
+            {
                 msg_ID += 1;
+            }
+        }
 
-                if (verbosity > 0)
+        // Waiting only if there was nothing to do: for the oldest message if
+        // the workers are busy, otherwise for the base period
+        if (!received_any)
+        {
+            if (!ordered_pool_empty(&pool))
+            {
+                if (send_oldest(&pool, output_socket, codec, prefilters, true, verbosity))
                 {
-                    printf("Sending message with topic: %s\n", new_topic);
+                    msg_ID += 1;
                 }
-
-                free(output_buffer);
             }
-
-            const clock_t event_stop = clock();
-
-            if (verbosity > 0)
+            else
             {
-                const float elaboration_time = (float)(event_stop - event_start) / CLOCKS_PER_SEC * 1000;
-                const float elaboration_speed = size / elaboration_time * 1000.0 / 1024.0 / 1024.0;
-
-                printf("size: %zu; output_size: %" PRIu64 "; ratio: %.1f%%; elaboration_time: %f ms; elaboration_speed: %f MBi/s\n", size, output_size, ((float)output_size) / size * 100, elaboration_time, elaboration_speed);
-                //printf("Elaboration time: %f ms\n", (float)(event_stop - event_start) / CLOCKS_PER_SEC * 1000);
+                nanosleep(&wait, NULL);
+                //usleep(base_period * 1000);
             }
-
-            msg_counter += 1;
-
-            // Remember to free buffers
-            free(topic);
-            free(input_buffer);
-        }
-        else
-        {
-            printf("[%zu] ERROR: What?!?!?!\n", counter);
         }
 
-        counter += 1;
-
-        // Putting a delay in order not to fill-up the queues
-        nanosleep(&wait, NULL);
-        //usleep(base_period * 1000);
-
         if (verbosity > 2)
         {
             printf("counter: %zu; msg_counter: %zu, msg_ID: %zu\n", counter, msg_counter, msg_ID);
         }
     }
 
+    // Sending the messages that are still being compressed
+    while (send_oldest(&pool, output_socket, codec, prefilters, true, verbosity))
+    {
+        msg_ID += 1;
+    }
+
+    ordered_pool_destroy(&pool);
+
+    for (int i = 0; i < threads_number; i++)
+    {
+        codec_compressor_free(&workers[i].compressor);
+        free(workers[i].scratch_buffer);
+    }
+
     // Wait a bit to allow the sockets to deliver
     nanosleep(&slow_joiner_wait, NULL);
     //usleep(defaults_all_slow_joiner_wait * 1000);
@@ -0,0 +1,518 @@
+#ifndef __CODECS_H__
+#define __CODECS_H__ 1
+
+// Compression codecs used by gzad and unzad.
+//
+// The compressor and decompressor structures keep the contexts of the
+// libraries, so that they are reused between messages instead of being
+// created from scratch every time. A context must not be used by more than
+// one thread at a time, thus each worker thread owns its own.
+//
+// The codec is signalled in the topic of the compressed messages as:
+//
+//   compressed_<codec>[+<pre-filter>]_<original topic without size>_u<uncompressed size>_s<compressed size>
+//
+// where the pre-filters are described in prefilters.h and the topics are
+// written and parsed in compressed_topics.h.
+//
+// The lz4 and zstd codecs are available only if the libraries were found at
+// configure time, that defines ABCD_HAVE_LZ4 and ABCD_HAVE_ZSTD.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <zlib.h>
+#include <bzlib.h>
+
+#ifdef ABCD_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef ABCD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define CODECS_TOPIC_PREFIX "compressed_"
+
+enum codec_types
+{
+    CODEC_ZLIB = 0,
+    CODEC_BZ2 = 1,
+    CODEC_LZ4 = 2,
+    CODEC_ZSTD = 3,
+    CODECS_NUMBER = 4
+};
+
+struct codec_compressor
+{
+    enum codec_types type;
+    int level;
+
+    z_stream zlib_stream;
+    bool zlib_initialized;
+
+#ifdef ABCD_HAVE_LZ4
+    void *lz4_state;
+#endif
+
+#ifdef ABCD_HAVE_ZSTD
+    ZSTD_CCtx *zstd_context;
+#endif
+};
+
+struct codec_decompressor
+{
+    z_stream zlib_stream;
+    bool zlib_initialized;
+
+#ifdef ABCD_HAVE_ZSTD
+    ZSTD_DCtx *zstd_context;
+#endif
+};
+
+extern inline
+const char *codec_name(enum codec_types type)
+{
+    switch (type)
+    {
+        case CODEC_ZLIB:
+            return "zlib";
+        case CODEC_BZ2:
+            return "bz2";
+        case CODEC_LZ4:
+            return "lz4";
+        case CODEC_ZSTD:
+            return "zstd";
+        default:
+            return "unknown";
+    }
+}
+
+extern inline
+bool codec_available(enum codec_types type)
+{
+    switch (type)
+    {
+        case CODEC_ZLIB:
+        case CODEC_BZ2:
+            return true;
+#ifdef ABCD_HAVE_LZ4
+        case CODEC_LZ4:
+            return true;
+#endif
+#ifdef ABCD_HAVE_ZSTD
+        case CODEC_ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+//! Returns the codec with the given name, or -1 if it is unknown
+extern inline
+int codec_from_name(const char *name)
+{
+    for (int type = 0; type < CODECS_NUMBER; type++)
+    {
+        if (strcmp(name, codec_name(type)) == 0)
+        {
+            return type;
+        }
+    }
+
+    return -1;
+}
+
+//! Determines the codec from the topic of a compressed message, the position
+//! after the codec name is stored in topic_rest, it points either to the
+//! pre-filters or to the underscore before the original topic.
+//! Returns the codec or -1 if it is unknown
+extern inline
+int codec_from_topic(const char *topic, const char **topic_rest)
+{
+    const size_t prefix_length = strlen(CODECS_TOPIC_PREFIX);
+
+    const char *position = topic;
+
+    if (strncmp(topic, CODECS_TOPIC_PREFIX, prefix_length) == 0)
+    {
+        position += prefix_length;
+    }
+
+    for (int type = 0; type < CODECS_NUMBER; type++)
+    {
+        const char *name = codec_name(type);
+        const size_t name_length = strlen(name);
+
+        if (strncmp(position, name, name_length) == 0 && (position[name_length] == '_' || position[name_length] == '+'))
+        {
+            (*topic_rest) = position + name_length;
+
+            return type;
+        }
+    }
+
+    return -1;
+}
+
+extern inline
+int codec_default_level(enum codec_types type)
+{
+    switch (type)
+    {
+        case CODEC_ZLIB:
+            return Z_BEST_SPEED;
+        case CODEC_BZ2:
+            return 9;
+        default:
+            return 1;
+    }
+}
+
+extern inline
+void codec_compressor_free(struct codec_compressor *compressor)
+{
+    if (compressor->zlib_initialized)
+    {
+        deflateEnd(&compressor->zlib_stream);
+        compressor->zlib_initialized = false;
+    }
+
+#ifdef ABCD_HAVE_LZ4
+    free(compressor->lz4_state);
+    compressor->lz4_state = NULL;
+#endif
+
+#ifdef ABCD_HAVE_ZSTD
+    ZSTD_freeCCtx(compressor->zstd_context);
+    compressor->zstd_context = NULL;
+#endif
+}
+
+extern inline
+bool codec_compressor_init(struct codec_compressor *compressor, enum codec_types type, int level)
+{
+    memset(compressor, 0, sizeof(struct codec_compressor));
+
+    compressor->type = type;
+    compressor->level = level;
+
+    if (!codec_available(type))
+    {
+        printf("ERROR: The %s codec is not available\n", codec_name(type));
+
+        return false;
+    }
+
+    if (type == CODEC_ZLIB)
+    {
+        compressor->zlib_stream.zalloc = Z_NULL;
+        compressor->zlib_stream.zfree = Z_NULL;
+        compressor->zlib_stream.opaque = Z_NULL;
+        compressor->zlib_stream.data_type = Z_BINARY;
+
+        if (deflateInit(&compressor->zlib_stream, level) != Z_OK)
+        {
+            printf("ERROR: Unable to initialize the zlib compressor\n");
+
+            return false;
+        }
+
+        compressor->zlib_initialized = true;
+    }
+#ifdef ABCD_HAVE_LZ4
+    else if (type == CODEC_LZ4)
+    {
+        compressor->lz4_state = malloc(LZ4_sizeofState());
+
+        if (!compressor->lz4_state)
+        {
+            printf("ERROR: Unable to allocate the lz4 state\n");
+
+            return false;
+        }
+    }
+#endif
+#ifdef ABCD_HAVE_ZSTD
+    else if (type == CODEC_ZSTD)
+    {
+        compressor->zstd_context = ZSTD_createCCtx();
+
+        if (!compressor->zstd_context)
+        {
+            printf("ERROR: Unable to create the zstd context\n");
+
+            return false;
+        }
+
+        ZSTD_CCtx_setParameter(compressor->zstd_context, ZSTD_c_compressionLevel, level);
+    }
+#endif
+
+    return true;
+}
+
+//! Maximum size of the compressed data, also for incompressible data
+extern inline
+size_t codec_compress_bound(const struct codec_compressor *compressor, size_t size)
+{
+    switch (compressor->type)
+    {
+        case CODEC_ZLIB:
+            return deflateBound((z_streamp)&compressor->zlib_stream, size);
+        case CODEC_BZ2:
+            // From the bzip2 manual: 1% larger than the input plus 600 bytes
+            return size + size / 100 + 600;
+#ifdef ABCD_HAVE_LZ4
+        case CODEC_LZ4:
+            return LZ4_compressBound(size);
+#endif
+#ifdef ABCD_HAVE_ZSTD
+        case CODEC_ZSTD:
+            return ZSTD_compressBound(size);
+#endif
+        default:
+            return size;
+    }
+}
+
+//! Compresses the input, the output buffer should be as big as the bound.
+//! Returns the size of the compressed data, or 0 on errors
+extern inline
+size_t codec_compress(struct codec_compressor *compressor,
+                      const uint8_t *input, size_t size,
+                      uint8_t *output, size_t output_capacity)
+{
+    if (compressor->type == CODEC_ZLIB)
+    {
+        z_stream *zipped_stream = &compressor->zlib_stream;
+
+        deflateReset(zipped_stream);
+
+        zipped_stream->avail_in = (uInt)size;
+        zipped_stream->next_in = (Bytef *)input;
+        zipped_stream->avail_out = (uInt)output_capacity;
+        zipped_stream->next_out = (Bytef *)output;
+
+        if (deflate(zipped_stream, Z_FINISH) != Z_STREAM_END)
+        {
+            return 0;
+        }
+
+        return zipped_stream->total_out;
+    }
+    else if (compressor->type == CODEC_BZ2)
+    {
+        // The bz2 library has no way to reset a stream, so it is recreated
+        bz_stream zipped_stream;
+
+        zipped_stream.bzalloc = NULL;
+        zipped_stream.bzfree = NULL;
+        zipped_stream.opaque = NULL;
+
+        if (BZ2_bzCompressInit(&zipped_stream, compressor->level, 0, 0) != BZ_OK)
+        {
+            return 0;
+        }
+
+        zipped_stream.avail_in = size;
+        zipped_stream.next_in = (char *)input;
+        zipped_stream.avail_out = output_capacity;
+        zipped_stream.next_out = (char *)output;
+
+        int result = BZ_FINISH_OK;
+
+        while (result == BZ_FINISH_OK)
+        {
+            result = BZ2_bzCompress(&zipped_stream, BZ_FINISH);
+        }
+
+        const size_t output_size = (((size_t)zipped_stream.total_out_hi32) << 32) | zipped_stream.total_out_lo32;
+
+        BZ2_bzCompressEnd(&zipped_stream);
+
+        return (result == BZ_STREAM_END) ? output_size : 0;
+    }
+#ifdef ABCD_HAVE_LZ4
+    else if (compressor->type == CODEC_LZ4)
+    {
+        const int output_size = LZ4_compress_fast_extState(compressor->lz4_state,
+                                                           (const char *)input,
+                                                           (char *)output,
+                                                           (int)size,
+                                                           (int)output_capacity,
+                                                           compressor->level);
+
+        return (output_size > 0) ? (size_t)output_size : 0;
+    }
+#endif
+#ifdef ABCD_HAVE_ZSTD
+    else if (compressor->type == CODEC_ZSTD)
+    {
+        const size_t output_size = ZSTD_compress2(compressor->zstd_context,
+                                                  output, output_capacity,
+                                                  input, size);
+
+        return ZSTD_isError(output_size) ? 0 : output_size;
+    }
+#endif
+
+    return 0;
+}
+
+extern inline
+void codec_decompressor_free(struct codec_decompressor *decompressor)
+{
+    if (decompressor->zlib_initialized)
+    {
+        inflateEnd(&decompressor->zlib_stream);
+        decompressor->zlib_initialized = false;
+    }
+
+#ifdef ABCD_HAVE_ZSTD
+    ZSTD_freeDCtx(decompressor->zstd_context);
+    decompressor->zstd_context = NULL;
+#endif
+}
+
+extern inline
+bool codec_decompressor_init(struct codec_decompressor *decompressor)
+{
+    memset(decompressor, 0, sizeof(struct codec_decompressor));
+
+    decompressor->zlib_stream.zalloc = Z_NULL;
+    decompressor->zlib_stream.zfree = Z_NULL;
+    decompressor->zlib_stream.opaque = Z_NULL;
+    decompressor->zlib_stream.data_type = Z_BINARY;
+    decompressor->zlib_stream.avail_in = 0;
+    decompressor->zlib_stream.next_in = Z_NULL;
+
+    if (inflateInit(&decompressor->zlib_stream) != Z_OK)
+    {
+        printf("ERROR: Unable to initialize the zlib decompressor\n");
+
+        return false;
+    }
+
+    decompressor->zlib_initialized = true;
+
+#ifdef ABCD_HAVE_ZSTD
+    decompressor->zstd_context = ZSTD_createDCtx();
+
+    if (!decompressor->zstd_context)
+    {
+        printf("ERROR: Unable to create the zstd context\n");
+
+        codec_decompressor_free(decompressor);
+
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+//! Decompresses the input into the output buffer.
+//! Returns false if the data is corrupted or if it does not fit the output.
+extern inline
+bool codec_decompress(struct codec_decompressor *decompressor, enum codec_types type,
+                      const uint8_t *input, size_t size,
+                      uint8_t *output, size_t output_capacity, size_t *output_size)
+{
+    (*output_size) = 0;
+
+    if (type == CODEC_ZLIB)
+    {
+        z_stream *zipped_stream = &decompressor->zlib_stream;
+
+        inflateReset(zipped_stream);
+
+        zipped_stream->avail_in = (uInt)size;
+        zipped_stream->next_in = (Bytef *)input;
+        zipped_stream->avail_out = (uInt)output_capacity;
+        zipped_stream->next_out = (Bytef *)output;
+
+        const int result = inflate(zipped_stream, Z_FINISH);
+
+        (*output_size) = zipped_stream->total_out;
+
+        return (result == Z_STREAM_END);
+    }
+    else if (type == CODEC_BZ2)
+    {
+        bz_stream zipped_stream;
+
+        zipped_stream.bzalloc = NULL;
+        zipped_stream.bzfree = NULL;
+        zipped_stream.opaque = NULL;
+
+        if (BZ2_bzDecompressInit(&zipped_stream, 0, 0) != BZ_OK)
+        {
+            return false;
+        }
+
+        zipped_stream.avail_in = size;
+        zipped_stream.next_in = (char *)input;
+        zipped_stream.avail_out = output_capacity;
+        zipped_stream.next_out = (char *)output;
+
+        int result = BZ_OK;
+        bool progress = true;
+
+        // The library stops with BZ_OK when the output buffer is full or
+        // when the input is truncated, in both cases it stops progressing
+        while (result == BZ_OK && progress)
+        {
+            const unsigned int previous_avail_in = zipped_stream.avail_in;
+            const unsigned int previous_avail_out = zipped_stream.avail_out;
+
+            result = BZ2_bzDecompress(&zipped_stream);
+
+            progress = (zipped_stream.avail_in != previous_avail_in || zipped_stream.avail_out != previous_avail_out);
+        }
+
+        (*output_size) = (((size_t)zipped_stream.total_out_hi32) << 32) | zipped_stream.total_out_lo32;
+
+        BZ2_bzDecompressEnd(&zipped_stream);
+
+        return (result == BZ_STREAM_END);
+    }
+#ifdef ABCD_HAVE_LZ4
+    else if (type == CODEC_LZ4)
+    {
+        const int result = LZ4_decompress_safe((const char *)input, (char *)output, (int)size, (int)output_capacity);
+
+        if (result < 0)
+        {
+            return false;
+        }
+
+        (*output_size) = result;
+
+        return true;
+    }
+#endif
+#ifdef ABCD_HAVE_ZSTD
+    else if (type == CODEC_ZSTD)
+    {
+        const size_t result = ZSTD_decompressDCtx(decompressor->zstd_context, output, output_capacity, input, size);
+
+        if (ZSTD_isError(result))
+        {
+            return false;
+        }
+
+        (*output_size) = result;
+
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+#endif
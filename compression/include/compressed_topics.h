@@ -0,0 +1,113 @@
+#ifndef __COMPRESSED_TOPICS_H__
+#define __COMPRESSED_TOPICS_H__ 1
+
+// Topics of the compressed messages, they carry the codec, the pre-filters
+// and the sizes of the uncompressed and compressed data:
+//
+//   compressed_<codec>[+<pre-filter>]_<original topic without size>_u<uncompressed size>_s<compressed size>
+//
+// so that the receiver can allocate exactly the memory for the uncompressed
+// data. The uncompressed size is optional, to read the topics produced by
+// older versions of gzad.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "defaults.h"
+#include "utilities_functions.h"
+#include "codecs.h"
+#include "prefilters.h"
+
+struct compressed_topic
+{
+    int codec;
+    unsigned int prefilters;
+
+    // Original topic, without the sizes
+    char original_topic[defaults_all_topic_buffer_size];
+
+    bool has_uncompressed_size;
+    size_t uncompressed_size;
+};
+
+//! Copies the topic removing the "_s<size>" suffix
+extern inline
+void compressed_topic_strip_size(const char *topic, char *output, size_t output_size)
+{
+    const char *size_position = rstrstr(topic, "_s");
+
+    size_t size_index = size_position ? (size_t)(size_position - topic) : strlen(topic);
+
+    if (size_index >= output_size)
+    {
+        size_index = output_size - 1;
+    }
+
+    memcpy(output, topic, size_index);
+    output[size_index] = '\0';
+}
+
+//! Writes the topic of a compressed message
+extern inline
+void compressed_topic_format(char *output, size_t output_size, const char *topic,
+                             enum codec_types codec, unsigned int prefilters,
+                             size_t uncompressed_size, size_t compressed_size)
+{
+    char topic_no_size[defaults_all_topic_buffer_size];
+    char prefilters_string[defaults_all_topic_buffer_size];
+
+    compressed_topic_strip_size(topic, topic_no_size, defaults_all_topic_buffer_size);
+    prefilter_to_topic(prefilters, prefilters_string, defaults_all_topic_buffer_size);
+
+    snprintf(output, output_size,
+             CODECS_TOPIC_PREFIX "%s%s_%s_u%zu_s%zu",
+             codec_name(codec), prefilters_string, topic_no_size,
+             uncompressed_size, compressed_size);
+}
+
+//! Parses the topic of a compressed message, returns false if the codec or
+//! a pre-filter are unknown
+extern inline
+bool compressed_topic_parse(const char *topic, struct compressed_topic *result)
+{
+    const char *topic_rest = NULL;
+    const char *original_topic = topic;
+
+    result->codec = codec_from_topic(topic, &topic_rest);
+    result->prefilters = PREFILTER_NONE;
+    result->has_uncompressed_size = false;
+    result->uncompressed_size = 0;
+
+    const bool known = (result->codec >= 0) &&
+                       prefilter_from_topic(topic_rest, &result->prefilters, &original_topic);
+
+    compressed_topic_strip_size(known ? original_topic : topic,
+                                result->original_topic,
+                                defaults_all_topic_buffer_size);
+
+    // After removing the compressed size, the uncompressed size is the last
+    // part of the topic
+    char *uncompressed_position = rstrstr(result->original_topic, "_u");
+
+    if (uncompressed_position)
+    {
+        char *end = NULL;
+
+        const unsigned long long uncompressed_size = strtoull(uncompressed_position + 2, &end, 10);
+
+        if (end != uncompressed_position + 2 && *end == '\0')
+        {
+            result->has_uncompressed_size = true;
+            result->uncompressed_size = uncompressed_size;
+
+            *uncompressed_position = '\0';
+        }
+    }
+
+    return known;
+}
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef __ORDERED_POOL_H__
+#define __ORDERED_POOL_H__ 1
+
+// Pool of worker threads that process the messages in parallel, while the
+// results are collected in the same order of the submissions.
+//
+// The jobs are stored in a ring of slots: the main thread submits the jobs
+// at the tail, the workers take them in order and the main thread collects
+// them from the head, waiting for the oldest one to be done. The slots keep
+// their output buffers, that are reused and grown by the work function, so
+// that in the steady state there are no allocations for the outputs.
+//
+// Typical usage from the main thread:
+//
+//   if (ordered_pool_full(&pool)) {
+//       struct pool_job *job = ordered_pool_collect(&pool, true);
+//       send(job->output, job->output_size);
+//       ordered_pool_release(&pool);
+//   }
+//   ordered_pool_submit(&pool, topic, buffer, size);
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+enum pool_job_states
+{
+    POOL_JOB_FREE = 0,
+    POOL_JOB_QUEUED = 1,
+    POOL_JOB_DONE = 2
+};
+
+struct pool_job
+{
+    enum pool_job_states state;
+
+    // The submitted message, owned by the pool
+    char *topic;
+    uint8_t *input;
+    size_t input_size;
+
+    // The output buffer is kept between the jobs of the same slot
+    uint8_t *output;
+    size_t output_size;
+    size_t output_capacity;
+
+    bool success;
+};
+
+struct ordered_pool;
+
+typedef bool (*pool_work_fn)(struct pool_job *job, void *worker_context);
+
+struct pool_worker
+{
+    struct ordered_pool *pool;
+    void *context;
+    pthread_t thread;
+};
+
+struct ordered_pool
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t job_queued;
+    pthread_cond_t job_done;
+
+    struct pool_job *jobs;
+    size_t capacity;
+
+    // Monotonic counters of the jobs, the slot is the counter modulo the
+    // capacity: head is the next job to collect, next the next job to process
+    // and tail the next job to submit.
+    size_t head;
+    size_t next;
+    size_t tail;
+
+    bool stop;
+
+    pool_work_fn work;
+
+    struct pool_worker *workers;
+    size_t workers_number;
+};
+
+extern inline
+void *ordered_pool_worker(void *arg)
+{
+    struct pool_worker *worker = arg;
+    struct ordered_pool *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    while (true)
+    {
+        while (!pool->stop && pool->next == pool->tail)
+        {
+            pthread_cond_wait(&pool->job_queued, &pool->mutex);
+        }
+
+        if (pool->next == pool->tail)
+        {
+            break;
+        }
+
+        struct pool_job *job = &pool->jobs[pool->next % pool->capacity];
+        pool->next += 1;
+
+        pthread_mutex_unlock(&pool->mutex);
+
+        job->success = pool->work(job, worker->context);
+
+        pthread_mutex_lock(&pool->mutex);
+
+        job->state = POOL_JOB_DONE;
+
+        pthread_cond_broadcast(&pool->job_done);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+extern inline
+bool ordered_pool_full(struct ordered_pool *pool)
+{
+    return (pool->tail - pool->head) >= pool->capacity;
+}
+
+extern inline
+bool ordered_pool_empty(struct ordered_pool *pool)
+{
+    return (pool->tail == pool->head);
+}
+
+//! Queues a message, the pool takes the ownership of the topic and of the
+//! input buffer. The pool must not be full.
+extern inline
+void ordered_pool_submit(struct ordered_pool *pool, char *topic, uint8_t *input, size_t input_size)
+{
+    pthread_mutex_lock(&pool->mutex);
+
+    struct pool_job *job = &pool->jobs[pool->tail % pool->capacity];
+
+    job->state = POOL_JOB_QUEUED;
+    job->topic = topic;
+    job->input = input;
+    job->input_size = input_size;
+    job->output_size = 0;
+    job->success = false;
+
+    pool->tail += 1;
+
+    pthread_cond_signal(&pool->job_queued);
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+//! Returns the oldest job if it is done, waiting for it if requested.
+//! Returns NULL if there are no jobs or if it is not done yet.
+//! The job must be released with ordered_pool_release() after its use.
+extern inline
+struct pool_job *ordered_pool_collect(struct ordered_pool *pool, bool wait)
+{
+    if (ordered_pool_empty(pool))
+    {
+        return NULL;
+    }
+
+    struct pool_job *job = &pool->jobs[pool->head % pool->capacity];
+
+    pthread_mutex_lock(&pool->mutex);
+
+    while (wait && job->state != POOL_JOB_DONE)
+    {
+        pthread_cond_wait(&pool->job_done, &pool->mutex);
+    }
+
+    const bool done = (job->state == POOL_JOB_DONE);
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    return done ? job : NULL;
+}
+
+//! Frees the input of the oldest job and makes its slot available
+extern inline
+void ordered_pool_release(struct ordered_pool *pool)
+{
+    struct pool_job *job = &pool->jobs[pool->head % pool->capacity];
+
+    free(job->topic);
+    free(job->input);
+
+    job->topic = NULL;
+    job->input = NULL;
+    job->input_size = 0;
+    job->state = POOL_JOB_FREE;
+
+    pool->head += 1;
+}
+
+//! Stops the workers after they processed the queued jobs, the jobs that
+//! were not collected are discarded
+extern inline
+void ordered_pool_destroy(struct ordered_pool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->stop = true;
+
+    pthread_cond_broadcast(&pool->job_queued);
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 0; i < pool->workers_number; i++)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    while (!ordered_pool_empty(pool))
+    {
+        ordered_pool_release(pool);
+    }
+
+    for (size_t i = 0; i < pool->capacity; i++)
+    {
+        free(pool->jobs[i].output);
+    }
+
+    pthread_cond_destroy(&pool->job_done);
+    pthread_cond_destroy(&pool->job_queued);
+    pthread_mutex_destroy(&pool->mutex);
+
+    free(pool->jobs);
+    free(pool->workers);
+}
+
+//! Starts the workers, each one with its own context from worker_contexts
+extern inline
+bool ordered_pool_init(struct ordered_pool *pool, size_t capacity, pool_work_fn work,
+                       void **worker_contexts, size_t workers_number)
+{
+    memset(pool, 0, sizeof(struct ordered_pool));
+
+    pool->capacity = (capacity > 0) ? capacity : 1;
+    pool->work = work;
+
+    pool->jobs = calloc(pool->capacity, sizeof(struct pool_job));
+    pool->workers = calloc(workers_number, sizeof(struct pool_worker));
+
+    if (!pool->jobs || !pool->workers)
+    {
+        printf("ERROR: Unable to allocate the workers pool\n");
+
+        free(pool->jobs);
+        free(pool->workers);
+
+        return false;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->job_queued, NULL);
+    pthread_cond_init(&pool->job_done, NULL);
+
+    for (size_t i = 0; i < workers_number; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].context = worker_contexts[i];
+
+        if (pthread_create(&pool->workers[i].thread, NULL, ordered_pool_worker, &pool->workers[i]) != 0)
+        {
+            printf("ERROR: Unable to start the worker thread %zu\n", i);
+
+            ordered_pool_destroy(pool);
+
+            return false;
+        }
+
+        pool->workers_number += 1;
+    }
+
+    return true;
+}
+
+#endif
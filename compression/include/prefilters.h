@@ -0,0 +1,332 @@
+#ifndef __PREFILTERS_H__
+#define __PREFILTERS_H__ 1
+
+// Pre-filters that rearrange the data before the compression, so that the
+// codecs find more redundancy in it. They depend on the type of the data,
+// that is determined from the topic:
+//
+//   delta: for the events, the timestamps are replaced by the difference with
+//          the previous timestamp; for the waveforms, the samples of each
+//          waveform are replaced by the difference with the previous sample.
+//   shuffle: for the events, the bytes of the 16-byte records are transposed
+//            so that the bytes of the same field are contiguous.
+//
+// The pre-filters are applied in the order delta then shuffle, and reverted
+// in the opposite order. They are signalled in the topic after the codec:
+//
+//   compressed_<codec>+<pre-filter>+<pre-filter>_<original topic>_u<size>_s<size>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "events.h"
+
+enum prefilter_flags
+{
+    PREFILTER_NONE = 0,
+    PREFILTER_DELTA = 1 << 0,
+    PREFILTER_SHUFFLE = 1 << 1
+};
+
+#define PREFILTERS_NUMBER 2
+
+enum prefilter_data_types
+{
+    PREFILTER_OPAQUE = 0,
+    PREFILTER_EVENTS = 1,
+    PREFILTER_WAVEFORMS = 2
+};
+
+extern inline
+const char *prefilter_name(unsigned int flag)
+{
+    switch (flag)
+    {
+        case PREFILTER_DELTA:
+            return "delta";
+        case PREFILTER_SHUFFLE:
+            return "shuffle";
+        default:
+            return "unknown";
+    }
+}
+
+//! Returns the flag of the pre-filter with the given name, or PREFILTER_NONE
+extern inline
+unsigned int prefilter_from_name(const char *name, size_t name_length)
+{
+    for (unsigned int i = 0; i < PREFILTERS_NUMBER; i++)
+    {
+        const unsigned int flag = 1 << i;
+        const char *this_name = prefilter_name(flag);
+
+        if (strlen(this_name) == name_length && strncmp(name, this_name, name_length) == 0)
+        {
+            return flag;
+        }
+    }
+
+    return PREFILTER_NONE;
+}
+
+extern inline
+enum prefilter_data_types prefilter_data_type(const char *topic)
+{
+    if (strstr(topic, "events"))
+    {
+        return PREFILTER_EVENTS;
+    }
+    else if (strstr(topic, "waveforms"))
+    {
+        return PREFILTER_WAVEFORMS;
+    }
+    else
+    {
+        return PREFILTER_OPAQUE;
+    }
+}
+
+//! Selects the pre-filters that can be applied to the data
+extern inline
+unsigned int prefilter_applicable(unsigned int flags, enum prefilter_data_types type, size_t size)
+{
+    if (type == PREFILTER_EVENTS && (size % sizeof(struct event_PSD)) == 0)
+    {
+        return flags & (PREFILTER_DELTA | PREFILTER_SHUFFLE);
+    }
+    else if (type == PREFILTER_WAVEFORMS)
+    {
+        return flags & PREFILTER_DELTA;
+    }
+    else
+    {
+        return PREFILTER_NONE;
+    }
+}
+
+//! Writes the pre-filters in the topic format, e.g. "+delta+shuffle"
+extern inline
+void prefilter_to_topic(unsigned int flags, char *string, size_t string_size)
+{
+    size_t offset = 0;
+
+    string[0] = '\0';
+
+    for (unsigned int i = 0; i < PREFILTERS_NUMBER; i++)
+    {
+        const unsigned int flag = 1 << i;
+
+        if ((flags & flag) && offset < string_size)
+        {
+            const int written = snprintf(string + offset, string_size - offset, "+%s", prefilter_name(flag));
+
+            offset += (written > 0) ? written : 0;
+        }
+    }
+}
+
+//! Reads the pre-filters from the topic, starting after the codec name.
+//! The position of the original topic is stored in original_topic.
+//! Returns false if an unknown pre-filter is found.
+extern inline
+bool prefilter_from_topic(const char *position, unsigned int *flags, const char **original_topic)
+{
+    (*flags) = PREFILTER_NONE;
+
+    while (*position == '+')
+    {
+        position += 1;
+
+        const size_t name_length = strcspn(position, "+_");
+        const unsigned int flag = prefilter_from_name(position, name_length);
+
+        if (flag == PREFILTER_NONE)
+        {
+            return false;
+        }
+
+        (*flags) |= flag;
+        position += name_length;
+    }
+
+    if (*position == '_')
+    {
+        position += 1;
+    }
+
+    (*original_topic) = position;
+
+    return true;
+}
+
+extern inline
+void prefilter_events_delta(uint8_t *buffer, size_t events_number)
+{
+    uint64_t previous = 0;
+
+    for (size_t i = 0; i < events_number; i++)
+    {
+        uint64_t timestamp;
+
+        memcpy(&timestamp, buffer + i * sizeof(struct event_PSD), sizeof(timestamp));
+
+        const uint64_t delta = timestamp - previous;
+        previous = timestamp;
+
+        memcpy(buffer + i * sizeof(struct event_PSD), &delta, sizeof(delta));
+    }
+}
+
+extern inline
+void prefilter_events_undelta(uint8_t *buffer, size_t events_number)
+{
+    uint64_t previous = 0;
+
+    for (size_t i = 0; i < events_number; i++)
+    {
+        uint64_t delta;
+
+        memcpy(&delta, buffer + i * sizeof(struct event_PSD), sizeof(delta));
+
+        const uint64_t timestamp = previous + delta;
+        previous = timestamp;
+
+        memcpy(buffer + i * sizeof(struct event_PSD), &timestamp, sizeof(timestamp));
+    }
+}
+
+extern inline
+void prefilter_events_shuffle(const uint8_t *input, size_t events_number, uint8_t *output)
+{
+    for (size_t i = 0; i < events_number; i++)
+    {
+        for (size_t b = 0; b < sizeof(struct event_PSD); b++)
+        {
+            output[b * events_number + i] = input[i * sizeof(struct event_PSD) + b];
+        }
+    }
+}
+
+extern inline
+void prefilter_events_unshuffle(const uint8_t *input, size_t events_number, uint8_t *output)
+{
+    for (size_t i = 0; i < events_number; i++)
+    {
+        for (size_t b = 0; b < sizeof(struct event_PSD); b++)
+        {
+            output[i * sizeof(struct event_PSD) + b] = input[b * events_number + i];
+        }
+    }
+}
+
+//! Applies or reverts the delta of the samples of each waveform, the headers
+//! are not modified so they are parsed in the same way in both directions
+extern inline
+void prefilter_waveforms_delta(uint8_t *buffer, size_t size, bool revert)
+{
+    size_t offset = 0;
+
+    while (offset + waveform_header_size() <= size)
+    {
+        uint32_t samples_number;
+        uint8_t additional_waveforms;
+
+        memcpy(&samples_number, buffer + offset + 9, sizeof(samples_number));
+        memcpy(&additional_waveforms, buffer + offset + 13, sizeof(additional_waveforms));
+
+        const size_t this_size = waveform_header_size()
+                                 + sizeof(uint16_t) * samples_number
+                                 + sizeof(uint8_t) * samples_number * additional_waveforms;
+
+        if (offset + this_size > size)
+        {
+            break;
+        }
+
+        uint8_t *samples = buffer + offset + waveform_header_size();
+        uint16_t previous = 0;
+
+        for (size_t i = 0; i < samples_number; i++)
+        {
+            uint16_t sample;
+
+            memcpy(&sample, samples + i * sizeof(uint16_t), sizeof(sample));
+
+            const uint16_t value = revert ? (uint16_t)(previous + sample) : (uint16_t)(sample - previous);
+            previous = revert ? value : sample;
+
+            memcpy(samples + i * sizeof(uint16_t), &value, sizeof(value));
+        }
+
+        offset += this_size;
+    }
+}
+
+//! Applies the pre-filters, the buffer may be modified and the scratch
+//! buffer must be as big as the data.
+//! Returns the pointer to the filtered data, that is either of the two.
+extern inline
+uint8_t *prefilter_apply(unsigned int flags, enum prefilter_data_types type,
+                         uint8_t *buffer, size_t size, uint8_t *scratch)
+{
+    if (type == PREFILTER_EVENTS)
+    {
+        const size_t events_number = size / sizeof(struct event_PSD);
+
+        if (flags & PREFILTER_DELTA)
+        {
+            prefilter_events_delta(buffer, events_number);
+        }
+        if (flags & PREFILTER_SHUFFLE)
+        {
+            prefilter_events_shuffle(buffer, events_number, scratch);
+
+            return scratch;
+        }
+    }
+    else if (type == PREFILTER_WAVEFORMS && (flags & PREFILTER_DELTA))
+    {
+        prefilter_waveforms_delta(buffer, size, false);
+    }
+
+    return buffer;
+}
+
+//! Reverts the pre-filters, the buffer may be modified and the scratch
+//! buffer must be as big as the data.
+//! Returns the pointer to the original data, that is either of the two.
+extern inline
+uint8_t *prefilter_revert(unsigned int flags, enum prefilter_data_types type,
+                          uint8_t *buffer, size_t size, uint8_t *scratch)
+{
+    if (type == PREFILTER_EVENTS)
+    {
+        const size_t events_number = size / sizeof(struct event_PSD);
+
+        uint8_t *output = buffer;
+
+        if (flags & PREFILTER_SHUFFLE)
+        {
+            prefilter_events_unshuffle(buffer, events_number, scratch);
+
+            output = scratch;
+        }
+        if (flags & PREFILTER_DELTA)
+        {
+            prefilter_events_undelta(output, events_number);
+        }
+
+        return output;
+    }
+    else if (type == PREFILTER_WAVEFORMS && (flags & PREFILTER_DELTA))
+    {
+        prefilter_waveforms_delta(buffer, size, true);
+    }
+
+    return buffer;
+}
+
+#endif
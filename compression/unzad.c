@@ -43,12 +43,14 @@
 #include <time.h>
 
 #include <zmq.h>
-#include <zlib.h>
-#include <bzlib.h>
 
 #include "defaults.h"
 #include "socket_functions.h"
 #include "utilities_functions.h"
+#include "codecs.h"
+#include "prefilters.h"
+#include "compressed_topics.h"
+#include "ordered_pool.h"
 
 unsigned int terminate_flag = 0;
 
@@ -59,11 +61,24 @@ unsigned int terminate_flag = 0;
 
 void signal_handler(int signum);
 
+struct unzad_worker
+{
+    struct codec_decompressor decompressor;
+
+    // Buffer used to revert the pre-filters, it is swapped with the output
+    // buffers of the jobs
+    uint8_t *scratch_buffer;
+    size_t scratch_capacity;
+
+    unsigned int verbosity;
+};
+
 void print_usage(const char *name)
 {
     printf("Usage: %s [options]\n", name);
     printf("\n");
     printf("Datastream filter that decompressed packets that were compressed by gzad.\n");
+    printf("The packets are decompressed in parallel by a pool of worker threads, preserving their order.\n");
     printf("\n");
     printf("Optional arguments:\n");
     printf("\t-h: Display this message\n");
@@ -72,10 +87,170 @@ void print_usage(const char *name)
     printf("\t-A <address>: Input socket address, default: %s\n", defaults_gzad_data_address_sub);
     printf("\t-D <address>: Output socket address, default: %s\n", defaults_unzad_data_address);
     printf("\t-T <period>: Set base period in milliseconds, default: %d\n", defaults_unzad_base_period);
+    printf("\t-j <threads>: Number of decompression threads, default: %d\n", defaults_unzad_threads);
 
     return;
 }
 
+//! Makes sure that the buffer can hold the size, keeping its content
+bool reserve_buffer(uint8_t **buffer, size_t *capacity, size_t size)
+{
+    if (*capacity < size)
+    {
+        uint8_t *new_buffer = realloc(*buffer, size * sizeof(uint8_t));
+
+        if (!new_buffer)
+        {
+            return false;
+        }
+
+        (*buffer) = new_buffer;
+        (*capacity) = size;
+    }
+
+    return true;
+}
+
+bool unzad_decompress(struct pool_job *job, void *worker_context)
+{
+    struct unzad_worker *worker = worker_context;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct compressed_topic topic_info;
+
+    if (!compressed_topic_parse(job->topic, &topic_info))
+    {
+        printf("ERROR: Unable to determine compression from topic: %s\n", job->topic);
+
+        return false;
+    }
+
+    if (worker->verbosity > 1)
+    {
+        printf("We found a %s compressed packet\n", codec_name(topic_info.codec));
+    }
+
+    // The size is known from the topic, otherwise it is guessed and the
+    // buffer is enlarged until the data fits
+    size_t output_size = 0;
+    size_t expected_size = topic_info.has_uncompressed_size
+                           ? topic_info.uncompressed_size
+                           : job->input_size * defaults_unzad_output_buffer_multiplier;
+
+    bool decompressed = false;
+
+    while (!decompressed)
+    {
+        // The buffer of the slot is reused if it is big enough
+        if (!reserve_buffer(&job->output, &job->output_capacity, expected_size))
+        {
+            printf("ERROR: Unable to allocate output buffer\n");
+
+            return false;
+        }
+
+        decompressed = codec_decompress(&worker->decompressor, topic_info.codec,
+                                        job->input, job->input_size,
+                                        job->output, expected_size, &output_size);
+
+        if (!decompressed && (topic_info.has_uncompressed_size || output_size < expected_size))
+        {
+            printf("ERROR: Unable to decompress the packet with topic: %s\n", job->topic);
+
+            return false;
+        }
+
+        expected_size *= 2;
+    }
+
+    if (topic_info.has_uncompressed_size && output_size != topic_info.uncompressed_size)
+    {
+        printf("WARNING: Uncompressed size mismatch, expected: %zu; found: %zu\n", topic_info.uncompressed_size, output_size);
+    }
+
+    if (topic_info.prefilters != PREFILTER_NONE)
+    {
+        if (!reserve_buffer(&worker->scratch_buffer, &worker->scratch_capacity, output_size))
+        {
+            printf("ERROR: Unable to allocate the pre-filters buffer\n");
+
+            return false;
+        }
+
+        uint8_t *restored = prefilter_revert(topic_info.prefilters,
+                                             prefilter_data_type(topic_info.original_topic),
+                                             job->output, output_size, worker->scratch_buffer);
+
+        // Swapping the buffers, so that the job has the restored data
+        if (restored == worker->scratch_buffer)
+        {
+            const size_t restored_capacity = worker->scratch_capacity;
+
+            worker->scratch_buffer = job->output;
+            worker->scratch_capacity = job->output_capacity;
+
+            job->output = restored;
+            job->output_capacity = restored_capacity;
+        }
+    }
+
+    job->output_size = output_size;
+
+    if (worker->verbosity > 0)
+    {
+        struct timespec stop;
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+
+        const float elaboration_time = (stop.tv_sec - start.tv_sec) * 1000.0 + (stop.tv_nsec - start.tv_nsec) / 1000000.0;
+        const float elaboration_speed = job->input_size / elaboration_time * 1000.0 / 1024.0 / 1024.0;
+
+        printf("size: %zu; output_size: %zu; ratio: %.1f%%; elaboration_time: %f ms; elaboration_speed: %f MBi/s\n", job->input_size, job->output_size, ((float)job->output_size) / job->input_size * 100, elaboration_time, elaboration_speed);
+    }
+
+    return true;
+}
+
+//! Sends the oldest decompressed message, if it is ready or if waiting for it.
+//! Returns true if a message was collected.
+bool send_oldest(struct ordered_pool *pool, void *output_socket, bool wait, unsigned int verbosity)
+{
+    struct pool_job *job = ordered_pool_collect(pool, wait);
+
+    if (!job)
+    {
+        return false;
+    }
+
+    if (job->success)
+    {
+        struct compressed_topic topic_info;
+
+        compressed_topic_parse(job->topic, &topic_info);
+
+        // Compute the new topic
+        char new_topic[defaults_all_topic_buffer_size];
+
+        // I am not sure if snprintf is standard or not, apprently it is in the C99 standard
+        snprintf(new_topic,
+                 defaults_all_topic_buffer_size,
+                 "%s_s%zu",
+                 topic_info.original_topic, job->output_size);
+
+        send_byte_message(output_socket, new_topic, (void *)job->output, job->output_size, verbosity);
+
+        if (verbosity > 0)
+        {
+            printf("Sending message with topic: %s\n", new_topic);
+        }
+    }
+
+    ordered_pool_release(pool);
+
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     // Register the handler for SIGTERM (from kill), SIGINT (from ctrl-c)
@@ -88,13 +263,17 @@ int main(int argc, char *argv[])
     char *input_address = defaults_gzad_data_address_sub;
     char *output_address = defaults_unzad_data_address;
     char *subscription_topic = defaults_unzad_topic_subscribe;
+    int threads_number = defaults_unzad_threads;
 
     int c = 0;
-    while ((c = getopt(argc, argv, "ht:A:D:T:v")) != -1) {
+    while ((c = getopt(argc, argv, "hj:t:A:D:T:v")) != -1) {
         switch (c) {
             case 'h':
                 print_usage(argv[0]);
                 return EXIT_SUCCESS;
+            case 'j':
+                threads_number = atoi(optarg);
+                break;
             case 't':
                 subscription_topic = optarg;
                 break;
@@ -116,14 +295,49 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (threads_number < 1)
+    {
+        threads_number = 1;
+    }
+
     if (verbosity > 0) {
         printf("Input socket address: %s\n", input_address);
         printf("Output socket address: %s\n", output_address);
         printf("Verbosity: %u\n", verbosity);
         printf("Base period: %u\n", base_period);
+        printf("Threads: %d\n", threads_number);
+    }
+
+    // Each worker keeps its own decompressor, that is reused for all the messages
+    struct unzad_worker workers[threads_number];
+    void *worker_contexts[threads_number];
+
+    for (int i = 0; i < threads_number; i++)
+    {
+        if (!codec_decompressor_init(&workers[i].decompressor))
+        {
+            for (int j = 0; j < i; j++)
+            {
+                codec_decompressor_free(&workers[j].decompressor);
+            }
+
+            return EXIT_FAILURE;
+        }
+
+        workers[i].scratch_buffer = NULL;
+        workers[i].scratch_capacity = 0;
+        workers[i].verbosity = verbosity;
+        worker_contexts[i] = &workers[i];
+    }
+
+    struct ordered_pool pool;
+
+    if (!ordered_pool_init(&pool, threads_number * defaults_unzad_jobs_per_thread, unzad_decompress, worker_contexts, threads_number))
+    {
+        return EXIT_FAILURE;
     }
 
-    // Creates a �MQ context
+    // Creates a ZeroMQ context
     void *context = zmq_ctx_new();
     if (!context)
     {
@@ -183,194 +397,92 @@ int main(int argc, char *argv[])
 
     while (terminate_flag == 0)
     {
-        char *topic;
-        char *input_buffer;
-        size_t size;
-
-        const int result = receive_byte_message(input_socket, &topic, (void **)(&input_buffer), &size, true, verbosity);
-
-        if (result == EXIT_FAILURE)
+        // Sending the messages that were decompressed in the meantime, in the
+        // same order they were received
+        while (send_oldest(&pool, output_socket, false, verbosity))
         {
-            printf("[%zu] ERROR: Some error occurred!!!\n", counter);
+            msg_ID += 1;
         }
-        else if (size == 0 && result == EXIT_SUCCESS)
-        {
-            if (verbosity > 2)
-            {
-                printf("[%zu] No message available\n", counter);
-            }
-        }
-        else if (size > 0 && result == EXIT_SUCCESS)
+
+        // The input is drained without waiting, so that the workers are fed
+        // as long as messages are available
+        bool input_available = true;
+        bool received_any = false;
+
+        while (input_available && terminate_flag == 0)
         {
-            if (verbosity > 0)
+            // If all the workers are busy the oldest message is waited for
+            if (ordered_pool_full(&pool) && send_oldest(&pool, output_socket, true, verbosity))
             {
-                printf("[%zu] Message received!!! (topic: %s)\n", counter, topic);
+                msg_ID += 1;
             }
 
-            const clock_t event_start = clock();
-
-            uint64_t output_size = 0;
+            char *topic;
+            char *input_buffer;
+            size_t size;
 
-            const size_t output_buffer_size = size * defaults_unzad_output_buffer_multiplier;
-            uint8_t *output_buffer = malloc(output_buffer_size * sizeof(uint8_t));
+            const int result = receive_byte_message(input_socket, &topic, (void **)(&input_buffer), &size, true, verbosity);
 
-            if (output_buffer == NULL)
+            if (result == EXIT_FAILURE)
             {
-                printf("[%zu] ERROR: Unable to allocate output buffer\n", counter);
+                printf("[%zu] ERROR: Some error occurred!!!\n", counter);
+
+                input_available = false;
             }
-            else
+            else if (size == 0 && result == EXIT_SUCCESS)
             {
-                // Determine the compression from the topic
-                char *zlib_compressed = strstr(topic, "zlib_");
-                char *bz2_compressed = strstr(topic, "bz2_");
-
-                if (!zlib_compressed && !bz2_compressed)
+                if (verbosity > 2)
                 {
-                    printf("[%zu] ERROR: Unable to determine compression from topic\n", counter);
+                    printf("[%zu] No message available\n", counter);
                 }
-                else if (zlib_compressed && bz2_compressed)
-                {
-                    printf("[%zu] ERROR: Found both compressions\n", counter);
-                }
-                else if (zlib_compressed && !bz2_compressed)
-                {
-                    if (verbosity > 0)
-                    {
-                        printf("[%zu] We found a zlib compressed packet\n", counter);
-                    }
-
-                    //FIXME
-                    // Preparing the struct that the library uses as input
-                    z_stream zipped_stream;
-
-                    zipped_stream.zalloc = Z_NULL;
-                    zipped_stream.zfree = Z_NULL;
-                    zipped_stream.opaque = Z_NULL;
-                    zipped_stream.data_type = Z_BINARY;
-
-                    zipped_stream.avail_in = (uInt)size;
-                    zipped_stream.next_in = (Bytef *)input_buffer;
-                    zipped_stream.avail_out = (uInt)output_buffer_size;
-                    zipped_stream.next_out = (Bytef *)output_buffer;
-
-                    inflateInit(&zipped_stream);
-                    inflate(&zipped_stream, Z_FINISH);
-
-                    output_size = zipped_stream.total_out;
-
-                    inflateEnd(&zipped_stream);
-                }
-                else if (!zlib_compressed && bz2_compressed)
-                {
-                    if (verbosity > 0)
-                    {
-                        printf("[%zu] We found a bz2 compressed packet\n", counter);
-                    }
-
-                    // Preparing the struct that the library uses as input
-                    bz_stream zipped_stream;
-
-                    zipped_stream.bzalloc = NULL;
-                    zipped_stream.bzfree = NULL;
-                    zipped_stream.opaque = NULL;
-
-                    zipped_stream.avail_in = size;
-                    zipped_stream.next_in = input_buffer;
-                    zipped_stream.avail_out = output_buffer_size;
-                    zipped_stream.next_out = (char*)output_buffer;
-
-                    size_t decompress_counter = 0;
-
-                    BZ2_bzDecompressInit(&zipped_stream, verbosity, 0);
-                    for (size_t j = 0; BZ_STREAM_END != BZ2_bzDecompress(&zipped_stream); j++)
-                    {
-                        if (verbosity > 0)
-                        {
-                            printf("[%zu] Iteration: %zu\n", counter, decompress_counter);
-                        }
-                    }
 
-                    output_size = (((size_t)zipped_stream.total_out_hi32) << 32) | zipped_stream.total_out_lo32;
-
-                    BZ2_bzDecompressEnd(&zipped_stream);
-                }
-                else
+                input_available = false;
+            }
+            else if (size > 0 && result == EXIT_SUCCESS)
+            {
+                if (verbosity > 0)
                 {
-                    printf("[%zu] ERROR: What?!?!?! Another combination?\n", counter);
+                    printf("[%zu] Message received!!! (topic: %s)\n", counter, topic);
                 }
 
-                char topic_no_size[defaults_all_topic_buffer_size];
-
-                // Find the size portion of the topic
-                char *size_position = rstrstr(topic, "_s");
-                size_t size_index = size_position - topic;
+                // The pool takes care of freeing the buffers
+                ordered_pool_submit(&pool, topic, (uint8_t *)input_buffer, size);
 
-                if (!size_position)
-                {
-                    printf("[%zu] WARNING: Unable to find size in topic\n", counter);
-                    size_index = strlen(topic);
-                }
-
-                size_t starting_index = 0;
-                if (zlib_compressed && !bz2_compressed)
-                {
-                    starting_index = (zlib_compressed - topic) + strlen("zlib_");
-                }
-                else if (!zlib_compressed && bz2_compressed)
-                {
-                    starting_index = (bz2_compressed - topic) + strlen("bz2_");
-                }
-
-                strncpy(topic_no_size, topic + starting_index, size_index - starting_index);
-                topic_no_size[size_index] = '\0';
+                msg_counter += 1;
+                received_any = true;
+            }
+            else
+            {
+                printf("[%zu] ERROR: What?!?!?!\n", counter);
 
-                // Compute the new topic
-                char new_topic[defaults_all_topic_buffer_size];
+                input_available = false;
+            }
 
-                // I am not sure if snprintf is standard or not, apprently it is in the C99 standard
-                snprintf(new_topic,
-                         defaults_all_topic_buffer_size,
-                         "%s_s%" PRIu64,
-                         topic_no_size, output_size);
+            counter += 1;
 
-                send_byte_message(output_socket, new_topic, (void *)output_buffer, output_size, verbosity);
+            while (send_oldest(&pool, output_socket, false, verbosity))
+            {
                 msg_ID += 1;
+            }
+        }
 
-                if (verbosity > 0)
+        // Waiting only if there was nothing to do: for the oldest message if
+        // the workers are busy, otherwise for the base period
+        if (!received_any)
+        {
+            if (!ordered_pool_empty(&pool))
+            {
+                if (send_oldest(&pool, output_socket, true, verbosity))
                 {
-                    printf("Sending message with topic: %s\n", new_topic);
+                    msg_ID += 1;
                 }
-
-                free(output_buffer);
             }
-
-            const clock_t event_stop = clock();
-
-            if (verbosity > 0)
+            else
             {
-                const float elaboration_time = (float)(event_stop - event_start) / CLOCKS_PER_SEC * 1000;
-                const float elaboration_speed = size / elaboration_time * 1000.0 / 1024.0 / 1024.0;
-
-                printf("size: %zu; output_size: %" PRIu64 "; ratio: %.1f%%; elaboration_time: %f ms; elaboration_speed: %f MBi/s\n", size, output_size, ((float)output_size) / size * 100, elaboration_time, elaboration_speed);
-                //printf("Elaboration time: %f ms\n", (float)(event_stop - event_start) / CLOCKS_PER_SEC * 1000);
+                nanosleep(&wait, NULL);
+                //usleep(base_period * 1000);
             }
-
-            msg_counter += 1;
-
-            // Remember to free buffers
-            free(topic);
-            free(input_buffer);
         }
-        else
-        {
-            printf("[%zu] ERROR: What?!?!?!\n", counter);
-        }
-
-        counter += 1;
-
-        // Putting a delay in order not to fill-up the queues
-        nanosleep(&wait, NULL);
-        //usleep(base_period * 1000);
 
         if (verbosity > 2)
         {
@@ -378,6 +490,20 @@ int main(int argc, char *argv[])
         }
     }
 
+    // Sending the messages that are still being decompressed
+    while (send_oldest(&pool, output_socket, true, verbosity))
+    {
+        msg_ID += 1;
+    }
+
+    ordered_pool_destroy(&pool);
+
+    for (int i = 0; i < threads_number; i++)
+    {
+        codec_decompressor_free(&workers[i].decompressor);
+        free(workers[i].scratch_buffer);
+    }
+
     // Wait a bit to allow the sockets to deliver
     nanosleep(&slow_joiner_wait, NULL);
     //usleep(defaults_all_slow_joiner_wait * 1000);
@@ -0,0 +1,139 @@
+#! /usr/bin/env python3
+
+#  (C) Copyright 2026 European Union, Cristiano Lino Fontana
+#
+#  This file is part of ABCD.
+#
+#  ABCD is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  ABCD is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
+
+# Reads the binary deltas of the histograms published by spec (or tofcalc),
+# when their "publication_format" is set to "binary" or "both".
+# The message format is described in include/histograms_deltas.hpp
+
+import argparse
+import struct
+import json
+import zlib
+
+import zmq
+import numpy as np
+
+parser = argparse.ArgumentParser(description='Read the histograms deltas from the data socket of spec')
+parser.add_argument('-S',
+                    '--socket',
+                    type = str,
+                    help = 'Socket address',
+                    default = "tcp://127.0.0.1:16188")
+parser.add_argument('-t',
+                    '--topic',
+                    type = str,
+                    help = 'Topic to subscribe to, use data_tofcalc_deltas for tofcalc',
+                    default = "data_spec_deltas")
+
+args = parser.parse_args()
+
+topic = args.topic.encode('ascii')
+
+print("Connecting to: {}".format(args.socket))
+print("Subscribing to topic: '{}'".format(args.topic))
+
+def decode_message(message):
+    topic, data = message.split(b' ', 1)
+
+    header_size, = struct.unpack('<I', data[:4])
+    header = json.loads(data[4:4 + header_size].decode('utf-8'))
+    payload = data[4 + header_size:]
+
+    if header["compression"] == "zlib":
+        payload = zlib.decompress(payload)
+
+    return header, payload
+
+# The histograms store the counters, the values of the bins are the counters
+# multiplied by the "scale" of the last descriptor
+def apply_entries(histogram, descriptor, payload):
+    entries = descriptor["entries"]
+    offset = descriptor["offset"]
+
+    values = np.frombuffer(payload, dtype = np.float64, count = entries, offset = offset)
+    indexes = np.frombuffer(payload, dtype = np.uint32, count = entries, offset = offset + 8 * entries)
+
+    if descriptor["full"]:
+        histogram[:] = 0
+
+    histogram[indexes] = values
+
+# The histograms reconstructed from the deltas, the keys are (channel, name)
+histograms = dict()
+scales = dict()
+
+with zmq.Context() as context:
+    socket = context.socket(zmq.SUB)
+
+    socket.connect(args.socket)
+    socket.setsockopt(zmq.SUBSCRIBE, topic)
+
+    last_msg_ID = None
+    waiting_keyframe = True
+
+    try:
+        while True:
+            header, payload = decode_message(socket.recv())
+
+            msg_ID = header["msg_ID"]
+
+            # After a lost message the histograms are valid only from the
+            # next keyframe
+            if last_msg_ID is not None and msg_ID != last_msg_ID + 1:
+                waiting_keyframe = True
+
+            last_msg_ID = msg_ID
+
+            if waiting_keyframe and not header["keyframe"]:
+                print("Message [{:d}]: waiting for a keyframe".format(msg_ID))
+                continue
+
+            waiting_keyframe = False
+
+            for channel_data in header["data"]:
+                channel = channel_data["id"]
+
+                for name, descriptor in channel_data.items():
+                    if not isinstance(descriptor, dict) or not "entries" in descriptor:
+                        continue
+
+                    config = descriptor["config"]
+
+                    if "bins" in config:
+                        size = config["bins"]
+                    else:
+                        size = config["bins_x"] * config["bins_y"]
+
+                    key = (channel, name)
+
+                    if key not in histograms or len(histograms[key]) != size:
+                        histograms[key] = np.zeros(size)
+
+                    apply_entries(histograms[key], descriptor, payload)
+                    scales[key] = descriptor.get("scale", 1)
+
+            print("Message [{:d}]: keyframe: {}, payload size: {:d}".format(msg_ID, header["keyframe"], header["payload_size"]))
+
+            for (channel, name), histogram in sorted(histograms.items()):
+                integral = histogram.sum() * scales[(channel, name)]
+
+                print("\tChannel: {:d}, histogram: {}, integral: {:f}".format(channel, name, integral))
+
+    except KeyboardInterrupt:
+        socket.close()
@@ -89,6 +89,14 @@ void print_usage(const std::string &name = std::string("fifo")) {
     std::cout << "\t-V: Set more verbose execution" << std::endl;
     std::cout << "\t-E <expiration_time>: Set base expiration time in seconds, default: ";
     std::cout << defaults_fifo_expiration_time / 1000000000ULL << std::endl;
+    std::cout << "\t-M <memory_budget>: Store the data in a ring of the given size in MiB, ";
+    std::cout << "the oldest data is dropped when it is full, 0 disables it, default: ";
+    std::cout << defaults_fifo_memory_budget << std::endl;
+    std::cout << "\t-F <directory>: Directory of the segment files of the disk tier, default: ";
+    std::cout << defaults_fifo_disk_directory << std::endl;
+    std::cout << "\t-B <disk_budget>: Move the expired data to the disk tier, up to the given size in MiB, ";
+    std::cout << "0 disables it, default: ";
+    std::cout << defaults_fifo_disk_budget << std::endl;
 
     return;
 }
@@ -117,9 +125,12 @@ int main(int argc, char *argv[])
     std::string subscription_topic = defaults_abcd_data_events_topic;
     unsigned int base_period = defaults_fifo_base_period;
     binary_fifo::long_int expiration_time = defaults_fifo_expiration_time;
+    size_t memory_budget = defaults_fifo_memory_budget;
+    std::string disk_directory = defaults_fifo_disk_directory;
+    size_t disk_budget = defaults_fifo_disk_budget;
 
     int c = 0;
-    while ((c = getopt(argc, argv, "hA:S:R:t:T:vVE:")) != -1) {
+    while ((c = getopt(argc, argv, "hA:S:R:t:T:vVE:M:F:B:")) != -1) {
         switch (c) {
             case 'h':
                 print_usage(std::string(argv[0]));
@@ -158,6 +169,25 @@ int main(int argc, char *argv[])
                 catch (std::logic_error &e)
                 { }
                 break;
+            case 'M':
+                try
+                {
+                    memory_budget = std::stoul(optarg);
+                }
+                catch (std::logic_error &e)
+                { }
+                break;
+            case 'F':
+                disk_directory = optarg;
+                break;
+            case 'B':
+                try
+                {
+                    disk_budget = std::stoul(optarg);
+                }
+                catch (std::logic_error &e)
+                { }
+                break;
             default:
                 std::cout << "Unknown command: " << c << std::endl;
                 break;
@@ -172,7 +202,14 @@ int main(int argc, char *argv[])
     global_status.reply_address = reply_address;
     global_status.subscription_topic = subscription_topic;
     global_status.expiration_time = expiration_time;
+    global_status.memory_budget = memory_budget;
     global_status.fifo.set_expiration_time(global_status.expiration_time);
+    global_status.fifo.set_memory_budget(global_status.memory_budget * 1024 * 1024);
+    global_status.disk_directory = disk_directory;
+    global_status.disk_budget = disk_budget;
+    global_status.fifo.set_disk_tier(global_status.disk_directory,
+                                     global_status.disk_budget * 1024 * 1024,
+                                     defaults_fifo_disk_segment_size);
 
     if (global_status.verbosity > 0) {
         std::cout << "ABCD data socket address: " << abcd_data_address << std::endl;
@@ -182,6 +219,9 @@ int main(int argc, char *argv[])
         std::cout << "Verbosity: " << verbosity << std::endl;
         std::cout << "Base period: " << base_period << std::endl;
         std::cout << "Expiration time: " << expiration_time / 1000000000ULL << " s" << std::endl;
+        std::cout << "Memory budget: " << memory_budget << " MiB" << std::endl;
+        std::cout << "Disk directory: " << disk_directory << std::endl;
+        std::cout << "Disk budget: " << disk_budget << " MiB" << std::endl;
     }
 
     state current_state = states::START;
@@ -0,0 +1,99 @@
+#  (C) Copyright 2016 Cristiano Lino Fontana
+#
+#  This file is part of ABCD.
+#
+#  ABCD is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  ABCD is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
+
+# Helper functions to request the data from fifo with the binary replies.
+#
+# A binary reply is a multipart message with the frames:
+#   1. the JSON reply, with the same fields of the JSON replies but the data;
+#   2. the index, with a pair of little-endian 64 bit integers for each
+#      packet: the timestamp in nanoseconds from the UNIX epoch and the size
+#      in bytes of the packet;
+#   3. the packets split in frames of at most "chunk_size" bytes, a frame
+#      never spans two packets and there are "chunks" frames;
+#   4. a final frame, that is empty if the transfer succeeded or that holds a
+#      JSON error message if it failed midway.
+# If there is an error before the transfer, only the first frame is sent.
+
+import datetime
+import json
+import struct
+
+import zmq
+
+INDEX_FORMAT = "<qQ"
+
+def request_data(socket, from_date, to_date, msg_ID = 1, chunk_size = None):
+    """Requests the data between the two dates to fifo, the socket must be
+    a connected zmq.REQ socket.
+    Returns the JSON reply, the list of the timestamps in nanoseconds from
+    the UNIX epoch and the list of the packets as memoryviews.
+    """
+    request_message = dict()
+    request_message["msg_ID"] = msg_ID
+    request_message["timestamp"] = datetime.datetime.now().isoformat()
+    request_message["command"] = "get_data"
+    request_message["arguments"] = dict()
+    request_message["arguments"]["from"] = from_date
+    request_message["arguments"]["to"] = to_date
+    request_message["arguments"]["format"] = "binary"
+
+    if chunk_size is not None:
+        request_message["arguments"]["chunk_size"] = int(chunk_size)
+
+    socket.send(json.dumps(request_message).encode('ascii'))
+
+    # The frames are not copied, the data is read directly from the buffers
+    # of the messages
+    frames = socket.recv_multipart(copy = False)
+
+    reply_message = json.loads(frames[0].bytes.decode('ascii'))
+
+    if reply_message.get("type") != "data" or len(frames) < 3:
+        return reply_message, list(), list()
+
+    if len(frames[-1].bytes) > 0:
+        return json.loads(frames[-1].bytes.decode('ascii')), list(), list()
+
+    index = list(struct.iter_unpack(INDEX_FORMAT, frames[1].buffer))
+
+    chunks = frames[2:-1]
+    chunk_size = reply_message["chunk_size"]
+
+    timestamps = list()
+    packets = list()
+    chunk_index = 0
+
+    # The packets in a single frame are not copied
+    for timestamp, size in index:
+        chunks_number = (size + chunk_size - 1) // chunk_size
+
+        if chunks_number == 0:
+            packet = memoryview(b'')
+        elif chunks_number == 1:
+            packet = chunks[chunk_index].buffer
+        else:
+            packet = memoryview(b''.join(chunk.buffer for chunk in chunks[chunk_index:chunk_index + chunks_number]))
+
+        timestamps.append(timestamp)
+        packets.append(packet)
+        chunk_index += chunks_number
+
+    return reply_message, timestamps, packets
+
+def timestamps_to_datetimes(timestamps):
+    """Converts the timestamps of the index in datetime objects"""
+    return [datetime.datetime.fromtimestamp(t / 1e9) for t in timestamps]
@@ -24,6 +24,8 @@ import json
 import time
 import base64
 
+import fifo_client
+
 parser = argparse.ArgumentParser(description='Send a request to fifo and reads the reply')
 parser.add_argument('-R',
                     '--request_socket',
@@ -40,6 +42,10 @@ parser.add_argument('-t',
                     type = str,
                     default = None,
                     help = 'To date and time, default: now')
+parser.add_argument('-j',
+                    '--json',
+                    action = 'store_true',
+                    help = 'Request the data encoded in base64 in the JSON reply, instead of the binary reply')
 
 args = parser.parse_args()
 
@@ -50,40 +56,58 @@ with zmq.Context() as context:
 
     socket.connect(args.request_socket)
 
-    request_message = dict()
-    request_message["msg_ID"] = 1
-    request_message["timestamp"] = datetime.datetime.now().isoformat()
-    request_message["command"] = "get_data"
-    request_message["arguments"] = dict()
-
     if args.from_date is not None:
-        request_message["arguments"]["from"] = args.from_date
+        from_date = args.from_date
     else:
-        request_message["arguments"]["from"] = (datetime.datetime.now() - datetime.timedelta(seconds = -60)).isoformat()
+        from_date = (datetime.datetime.now() - datetime.timedelta(seconds = -60)).isoformat()
 
     if args.to_date is not None:
-        request_message["arguments"]["to"] = args.to_date
+        to_date = args.to_date
+    else:
+        to_date = datetime.datetime.now().isoformat()
+
+    if not args.json:
+        reply_message, timestamps, packets = fifo_client.request_data(socket, from_date, to_date)
+
+        print("Received reply type: {}".format(reply_message["type"]))
+        print("               id: {:d}".format(int(reply_message["msg_ID"])))
+        print("               timestamp: {}".format(reply_message["timestamp"]))
+
+        if reply_message["type"] == "data":
+            print("               size: {:d}".format(int(reply_message["size"])))
+            print("               data_packets: {:d}".format(len(packets)))
+
+        for timestamp, data in zip(timestamps, packets):
+            # Do something with the data packet...
+            continue
     else:
-        request_message["arguments"]["to"] = datetime.datetime.now().isoformat()
+        request_message = dict()
+        request_message["msg_ID"] = 1
+        request_message["timestamp"] = datetime.datetime.now().isoformat()
+        request_message["command"] = "get_data"
+        request_message["arguments"] = dict()
+
+        request_message["arguments"]["from"] = from_date
+        request_message["arguments"]["to"] = to_date
 
-    json_request_message = json.dumps(request_message)
-    print("Sending message: {}".format(json_request_message))
+        json_request_message = json.dumps(request_message)
+        print("Sending message: {}".format(json_request_message))
 
-    socket.send(json_request_message.encode('ascii'))
+        socket.send(json_request_message.encode('ascii'))
 
-    json_reply_message = socket.recv().decode('ascii')
+        json_reply_message = socket.recv().decode('ascii')
 
-    reply_message = json.loads(json_reply_message)
+        reply_message = json.loads(json_reply_message)
 
-    print("Received reply type: {}".format(reply_message["type"]))
-    print("               id: {:d}".format(int(reply_message["msg_ID"])))
-    print("               timestamp: {}".format(reply_message["timestamp"]))
-    print("               size: {:d}".format(int(reply_message["size"])))
-    print("               data_packets: {:d}".format(len(reply_message["data"])))
+        print("Received reply type: {}".format(reply_message["type"]))
+        print("               id: {:d}".format(int(reply_message["msg_ID"])))
+        print("               timestamp: {}".format(reply_message["timestamp"]))
+        print("               size: {:d}".format(int(reply_message["size"])))
+        print("               data_packets: {:d}".format(len(reply_message["data"])))
 
-    for data_packet in reply_message["data"]:
-        data = base64.b64decode(data_packet.encode('ascii'), validate = False)
+        for data_packet in reply_message["data"]:
+            data = base64.b64decode(data_packet.encode('ascii'), validate = False)
 
-        # Do something with the data packet...
+            # Do something with the data packet...
 
     socket.close()
@@ -1,9 +1,12 @@
 #ifndef __ACTIONS_HPP__
 #define __ACTIONS_HPP__ 1
 
+#include <vector>
+
 #include <jansson.h>
 
 #include "states.hpp"
+#include "binary_fifo.hpp"
 
 namespace actions
 {
@@ -11,6 +14,34 @@ namespace actions
     {
         // This function is used in the publish_status actions
         void publish_message(status&, std::string, json_t*);
+
+        // Sends a frame of a multipart reply
+        bool send_frame(void*, const void*, size_t, bool);
+
+        // Number of the data frames of a binary reply
+        size_t count_data_frames(const std::vector<binary_fifo::binary_view>&, size_t);
+
+        // Sends the JSON reply followed by the index of the data, by the data
+        // split in frames and by a final frame, that holds the error if the
+        // transfer failed. It returns without waiting for the transfer, the
+        // FIFO is held until ZeroMQ releases the data frames.
+        bool send_binary_reply(status&,
+                               const char*,
+                               size_t,
+                               const std::vector<binary_fifo::binary_view>&,
+                               const std::vector<binary_fifo::long_int>&,
+                               size_t);
+
+        // The FIFO is held while the data frames of a reply are pending
+        bool fifo_held(status&);
+
+        // Copies the received data in the FIFO, or defers it while the FIFO
+        // is held
+        void store_data(status&, const uint8_t*, size_t);
+
+        // Moves the deferred data in the FIFO and drops the expired data,
+        // unless the FIFO is held
+        void update_fifo(status&);
     }
 
     state start(status&);
@@ -7,6 +7,9 @@
 #include <map>
 #include <cstdint>
 #include <set>
+#include <deque>
+#include <utility>
+#include <atomic>
 
 #include <zmq.h>
 
@@ -36,7 +39,18 @@ struct status
 
     binary_fifo::binary_fifo fifo;
 
+    // Data frames of the binary replies not yet released by ZeroMQ. They
+    // point to the FIFO storage, that is not modified until they are all
+    // released. The data received meanwhile is deferred.
+    std::atomic<size_t> pending_frames{0};
+    std::deque<std::pair<binary_fifo::binary_data, binary_fifo::time_point>> deferred_data;
+    size_t deferred_bytes = 0;
+    size_t deferred_dropped = 0;
+
     binary_fifo::long_int expiration_time = defaults_fifo_expiration_time;
+    size_t memory_budget = defaults_fifo_memory_budget;
+    std::string disk_directory = defaults_fifo_disk_directory;
+    size_t disk_budget = defaults_fifo_disk_budget;
 };
 
 struct state
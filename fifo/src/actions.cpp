@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <ctime>
+#include <atomic>
 
 extern "C" {
 #include <zmq.h>
@@ -54,6 +55,227 @@ void actions::generic::publish_message(status &global_status,
     global_status.status_msg_ID += 1;
 }
 
+bool actions::generic::send_frame(void *socket, const void *buffer, size_t size, bool more)
+{
+    const int result = zmq_send(socket, buffer, size, more ? ZMQ_SNDMORE : 0);
+
+    if (result < 0)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "ERROR: ZeroMQ Error on reply frame send: ";
+        std::cout << zmq_strerror(errno);
+        std::cout << std::endl;
+
+        return false;
+    }
+
+    return true;
+}
+
+size_t actions::generic::count_data_frames(const std::vector<binary_fifo::binary_view> &data,
+                                           size_t chunk_size)
+{
+    size_t frames = 0;
+
+    for (const auto &this_data: data)
+    {
+        frames += (this_data.size() + chunk_size - 1) / chunk_size;
+    }
+
+    return frames;
+}
+
+// Called by ZeroMQ, possibly from its I/O thread, once a data frame was sent
+// or dropped
+static void release_data_frame(void *, void *hint)
+{
+    std::atomic<size_t> *pending_frames = reinterpret_cast<std::atomic<size_t> *>(hint);
+
+    pending_frames->fetch_sub(1);
+}
+
+// Closes the multipart reply with the final frame, that is empty if the
+// transfer succeeded or that holds a JSON error message
+static void send_final_frame(void *reply_socket, const std::string &error_string)
+{
+    if (error_string.empty())
+    {
+        actions::generic::send_frame(reply_socket, nullptr, 0, false);
+    }
+    else
+    {
+        const std::string message = "{\"type\": \"error\", \"error\": \"" + error_string + "\"}";
+
+        actions::generic::send_frame(reply_socket, message.c_str(), message.size(), false);
+    }
+}
+
+bool actions::generic::send_binary_reply(status &global_status,
+                                         const char *reply_buffer,
+                                         size_t reply_size,
+                                         const std::vector<binary_fifo::binary_view> &data,
+                                         const std::vector<binary_fifo::long_int> &timestamps,
+                                         size_t chunk_size)
+{
+    void *reply_socket = global_status.reply_socket;
+
+    if (!send_frame(reply_socket, reply_buffer, reply_size, true))
+    {
+        // Nothing was sent, the REP socket still expects a reply
+        const std::string message = "{\"type\": \"error\", \"error\": \"ERROR: Unable to send the reply\"}";
+
+        send_frame(reply_socket, message.c_str(), message.size(), false);
+
+        return false;
+    }
+
+    // The index frame has a pair of 64 bit numbers for each packet: the
+    // timestamp in nanoseconds from the UNIX epoch and the size in bytes
+    std::vector<int64_t> index(2 * data.size());
+
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        index[2 * i] = timestamps[i];
+        index[2 * i + 1] = data[i].size();
+    }
+
+    if (!send_frame(reply_socket, index.data(), index.size() * sizeof(int64_t), true))
+    {
+        send_final_frame(reply_socket, "ERROR: Unable to send the index");
+
+        return false;
+    }
+
+    // The data frames point directly to the FIFO storage, in pieces of at
+    // most chunk_size bytes, so the data is neither copied nor held twice in
+    // memory. ZeroMQ releases each frame once it is sent, and the FIFO shall
+    // not be modified until all the frames are released.
+    std::atomic<size_t> &pending_frames = global_status.pending_frames;
+    std::string error_string;
+
+    for (size_t i = 0; i < data.size() && error_string.empty(); i++)
+    {
+        const binary_fifo::binary_view &this_data = data[i];
+
+        for (size_t offset = 0; offset < this_data.size(); offset += chunk_size)
+        {
+            const size_t this_size = std::min(chunk_size, this_data.size() - offset);
+
+            zmq_msg_t frame;
+
+            pending_frames.fetch_add(1);
+
+            if (zmq_msg_init_data(&frame,
+                                  const_cast<uint8_t *>(this_data.data() + offset),
+                                  this_size,
+                                  release_data_frame,
+                                  &pending_frames) != 0)
+            {
+                pending_frames.fetch_sub(1);
+
+                error_string = "ERROR: Unable to create a data frame";
+            }
+            else if (zmq_msg_send(&frame, reply_socket, ZMQ_SNDMORE) < 0)
+            {
+                // The frame is released by closing it
+                zmq_msg_close(&frame);
+
+                error_string = "ERROR: Unable to send a data frame";
+            }
+
+            if (!error_string.empty())
+            {
+                char time_buffer[BUFFER_SIZE];
+                time_string(time_buffer, BUFFER_SIZE, NULL);
+                std::cout << '[' << time_buffer << "] ";
+                std::cout << error_string << ": ";
+                std::cout << zmq_strerror(errno);
+                std::cout << std::endl;
+
+                break;
+            }
+        }
+    }
+
+    // The frames are released when they are written to the connection, or
+    // when the connection is closed, e.g. by the heartbeats timeout. The
+    // main loop does not wait for them, the FIFO is held meanwhile.
+    send_final_frame(reply_socket, error_string);
+
+    return error_string.empty();
+}
+
+bool actions::generic::fifo_held(status &global_status)
+{
+    return global_status.pending_frames.load() > 0;
+}
+
+void actions::generic::store_data(status &global_status, const uint8_t *data, size_t size)
+{
+    const binary_fifo::time_point now = binary_fifo::clock::now();
+
+    if (!fifo_held(global_status))
+    {
+        // The data deferred during a reply comes first
+        if (!global_status.deferred_data.empty())
+        {
+            update_fifo(global_status);
+        }
+
+        if (global_status.fifo.uses_arena())
+        {
+            // The data is copied only once, directly in the arena
+            uint8_t *destination = global_status.fifo.arena_push(size, now);
+
+            if (destination)
+            {
+                memcpy(destination, data, size);
+            }
+        }
+        else
+        {
+            global_status.fifo.push(binary_fifo::binary_data(data, data + size), now);
+        }
+
+        return;
+    }
+
+    // The deferred data is limited to the memory budget, if it is set,
+    // dropping the oldest data
+    const size_t budget = global_status.fifo.get_memory_budget();
+
+    global_status.deferred_bytes += size;
+    global_status.deferred_data.emplace_back(binary_fifo::binary_data(data, data + size), now);
+
+    while (budget > 0 && global_status.deferred_bytes > budget && !global_status.deferred_data.empty())
+    {
+        global_status.deferred_bytes -= global_status.deferred_data.front().first.size();
+        global_status.deferred_dropped += 1;
+
+        global_status.deferred_data.pop_front();
+    }
+}
+
+void actions::generic::update_fifo(status &global_status)
+{
+    if (fifo_held(global_status))
+    {
+        return;
+    }
+
+    for (auto &this_data: global_status.deferred_data)
+    {
+        global_status.fifo.push(std::move(this_data.first), this_data.second);
+    }
+
+    global_status.deferred_data.clear();
+    global_status.deferred_bytes = 0;
+
+    global_status.fifo.update();
+}
+
 /******************************************************************************/
 /* Specific actions                                                           */
 /******************************************************************************/
@@ -116,6 +338,14 @@ state actions::create_sockets(status &global_status)
         return states::COMMUNICATION_ERROR;
     }
 
+    // The frames of a reply are released only when they are sent or when the
+    // connection is closed, so the peers that vanished are disconnected
+    const int heartbeat_interval = defaults_fifo_reply_heartbeat_interval;
+    const int heartbeat_timeout = defaults_fifo_reply_heartbeat_timeout;
+
+    zmq_setsockopt(reply_socket, ZMQ_HEARTBEAT_IVL, &heartbeat_interval, sizeof(heartbeat_interval));
+    zmq_setsockopt(reply_socket, ZMQ_HEARTBEAT_TIMEOUT, &heartbeat_timeout, sizeof(heartbeat_timeout));
+
     // Creates the abcd data socket
     void *abcd_data_socket = zmq_socket(context, ZMQ_SUB);
     if (!abcd_data_socket)
@@ -226,13 +456,57 @@ state actions::publish_status(status &global_status)
     json_object_set_new_nocheck(status_message,
                                 "expiration_time",
                                 json_integer(global_status.fifo.get_expiration_time() / 1000000000l));
+    json_object_set_new_nocheck(status_message,
+                                "memory_budget",
+                                json_integer(global_status.fifo.get_memory_budget()));
+    json_object_set_new_nocheck(status_message,
+                                "evictions",
+                                json_integer(global_status.fifo.get_evicted_count()));
+    json_object_set_new_nocheck(status_message,
+                                "evicted_size",
+                                json_integer(global_status.fifo.get_evicted_bytes()));
+    json_object_set_new_nocheck(status_message,
+                                "rejections",
+                                json_integer(global_status.fifo.get_rejected_count()));
+    json_object_set_new_nocheck(status_message,
+                                "deferred_counts",
+                                json_integer(global_status.deferred_data.size()));
+    json_object_set_new_nocheck(status_message,
+                                "deferred_drops",
+                                json_integer(global_status.deferred_dropped));
+    json_object_set_new_nocheck(status_message,
+                                "disk_budget",
+                                json_integer(global_status.fifo.get_disk_budget()));
+    json_object_set_new_nocheck(status_message,
+                                "disk_counts",
+                                json_integer(global_status.fifo.disk_count()));
+    json_object_set_new_nocheck(status_message,
+                                "disk_size",
+                                json_integer(global_status.fifo.disk_size()));
+    json_object_set_new_nocheck(status_message,
+                                "disk_evicted_segments",
+                                json_integer(global_status.fifo.get_disk_evicted_segments()));
+    json_object_set_new_nocheck(status_message,
+                                "disk_rejections",
+                                json_integer(global_status.fifo.get_disk_rejected_count()));
+
+    if (global_status.fifo.count() > 0 || global_status.fifo.disk_count() > 0)
+    {
+        // Age of the oldest retained data in seconds
+        const std::chrono::duration<double> oldest_age = std::chrono::system_clock::now()
+                                                         - global_status.fifo.get_oldest_timestamp();
+
+        json_object_set_new_nocheck(status_message,
+                                    "oldest_age",
+                                    json_real(oldest_age.count()));
+    }
 
     actions::generic::publish_message(global_status, defaults_fifo_status_topic, status_message);
 
     json_decref(status_message);
 
     // Cleaning up the FIFO periodically
-    global_status.fifo.update();
+    actions::generic::update_fifo(global_status);
 
     return states::RECEIVE_COMMANDS;
 }
@@ -288,6 +562,13 @@ state actions::receive_commands(status &global_status)
         //std::cout << "request_ID\tjson_result: " << json_result << "; " << std::endl;
         auto json_result = json_object_set_new_nocheck(reply_message, "request_ID", json_integer(request_ID));
 
+        // With the binary format, the data is sent in the frames following
+        // the JSON reply, instead of being encoded in it
+        bool binary_reply = false;
+        size_t chunk_size = defaults_fifo_reply_chunk_size;
+        std::vector<binary_fifo::binary_view> data;
+        std::vector<binary_fifo::long_int> timestamps;
+
         if (json_command != NULL && json_is_string(json_command))
         {
             const std::string command = json_string_value(json_command);
@@ -309,6 +590,19 @@ state actions::receive_commands(status &global_status)
                 const std::string from_string = json_string_value(json_from);
                 const std::string to_string = json_string_value(json_to);
 
+                json_t *json_format = json_object_get(json_arguments, "format");
+                json_t *json_chunk_size = json_object_get(json_arguments, "chunk_size");
+
+                if (json_format != NULL && json_is_string(json_format))
+                {
+                    binary_reply = (std::string(json_string_value(json_format)) == std::string("binary"));
+                }
+
+                if (json_chunk_size != NULL && json_is_integer(json_chunk_size) && json_integer_value(json_chunk_size) > 0)
+                {
+                    chunk_size = json_integer_value(json_chunk_size);
+                }
+
                 if (global_status.verbosity > 0)
                 {
                     char time_buffer[BUFFER_SIZE];
@@ -455,7 +749,7 @@ state actions::receive_commands(status &global_status)
                     std::cout << std::endl;
                 }
 
-                global_status.fifo.update();
+                actions::generic::update_fifo(global_status);
 
                 if (global_status.verbosity > 0)
                 {
@@ -466,39 +760,63 @@ state actions::receive_commands(status &global_status)
                     std::cout << std::endl;
                 }
 
-                std::vector<binary_fifo::binary_data> data = global_status.fifo.get_data(from_time, to_time);
-
-                if (global_status.verbosity > 0)
-                {
-                    char time_buffer[BUFFER_SIZE];
-                    time_string(time_buffer, BUFFER_SIZE, NULL);
-                    std::cout << '[' << time_buffer << "] ";
-                    std::cout << "Encoding base64 data; ";
-                    std::cout << std::endl;
-                }
-
-                json_t *json_data = json_array();
+                data = global_status.fifo.get_data(from_time, to_time);
 
                 size_t total_size = 0;
 
                 for (auto &this_data: data)
                 {
                     total_size += this_data.size();
+                }
 
-                    size_t output_size = 0;
-                    unsigned char *base64_data = base64_encode(this_data.data(), this_data.size(), &output_size);
+                if (binary_reply)
+                {
+                    // Timestamps from the UNIX epoch
+                    timestamps = global_status.fifo.get_timestamps_from_epoch(binary_fifo::time_point(),
+                                                                              from_time, to_time);
+
+                    const size_t chunks = actions::generic::count_data_frames(data, chunk_size);
 
-                    if (!base64_data)
+                    json_object_set_new_nocheck(reply_message, "format", json_string("binary"));
+                    json_object_set_new_nocheck(reply_message, "packets", json_integer(data.size()));
+                    json_object_set_new_nocheck(reply_message, "chunk_size", json_integer(chunk_size));
+                    json_object_set_new_nocheck(reply_message, "chunks", json_integer(chunks));
+                }
+                else
+                {
+                    if (global_status.verbosity > 0)
                     {
-                        error_flag = true;
-                        error_string += "ERROR: Unable to encode binary data;";
+                        char time_buffer[BUFFER_SIZE];
+                        time_string(time_buffer, BUFFER_SIZE, NULL);
+                        std::cout << '[' << time_buffer << "] ";
+                        std::cout << "Encoding base64 data; ";
+                        std::cout << std::endl;
                     }
-                    else
-                    {
-                        json_array_append_new(json_data, json_string(reinterpret_cast<char *>(base64_data)));
 
-                        free(base64_data);
+                    json_t *json_data = json_array();
+
+                    for (auto &this_data: data)
+                    {
+                        size_t output_size = 0;
+                        unsigned char *base64_data = base64_encode(this_data.data(), this_data.size(), &output_size);
+
+                        if (!base64_data)
+                        {
+                            error_flag = true;
+                            error_string += "ERROR: Unable to encode binary data;";
+                        }
+                        else
+                        {
+                            json_array_append_new(json_data, json_string(reinterpret_cast<char *>(base64_data)));
+
+                            free(base64_data);
+                        }
                     }
+
+                    json_result = json_object_set_new_nocheck(reply_message,
+                                                              "data",
+                                                              json_data);
+                    std::cout << "data\tjson_result: " << json_result << "; " << std::endl;
                 }
 
                 if (global_status.verbosity > 0)
@@ -511,11 +829,6 @@ state actions::receive_commands(status &global_status)
                     std::cout << std::endl;
                 }
 
-                json_result = json_object_set_new_nocheck(reply_message,
-                                                          "data",
-                                                          json_data);
-                std::cout << "data\tjson_result: " << json_result << "; " << std::endl;
-
                 json_result = json_object_set_new_nocheck(reply_message,
                                                           "size",
                                                           json_integer(total_size));
@@ -579,7 +892,19 @@ state actions::receive_commands(status &global_status)
                 std::cout << std::endl;
             }
 
-            send_byte_message(reply_socket, nullptr, output_buffer, strlen(output_buffer), 1);
+            if (binary_reply && !error_flag)
+            {
+                actions::generic::send_binary_reply(global_status,
+                                                    output_buffer,
+                                                    strlen(output_buffer),
+                                                    data,
+                                                    timestamps,
+                                                    chunk_size);
+            }
+            else
+            {
+                send_byte_message(reply_socket, nullptr, output_buffer, strlen(output_buffer), 1);
+            }
 
             free(output_buffer);
         }
@@ -613,14 +938,16 @@ state actions::read_socket(status &global_status)
 {
     void *abcd_data_socket = global_status.abcd_data_socket;
 
-    char *topic;
-    uint8_t *input_buffer;
-    size_t size;
-
-    int result = receive_byte_message(abcd_data_socket, &topic, (void **)(&input_buffer), &size, true, global_status.verbosity);
+    // The messages are received in a ZeroMQ message, instead of a copy of
+    // it, so the data is copied only once in the FIFO
+    zmq_msg_t message;
+    zmq_msg_init(&message);
 
-    while (size > 0 && result == EXIT_SUCCESS)
+    while (zmq_msg_recv(&message, abcd_data_socket, ZMQ_DONTWAIT) >= 0)
     {
+        const size_t size = zmq_msg_size(&message);
+        const char *begin = reinterpret_cast<const char *>(zmq_msg_data(&message));
+
         if (global_status.verbosity > 0)
         {
             char time_buffer[BUFFER_SIZE];
@@ -630,22 +957,37 @@ state actions::read_socket(status &global_status)
             std::cout << std::endl;
         }
 
-        if (global_status.verbosity > 0)
+        // The topic is separated from the data by a space
+        const char *separator = reinterpret_cast<const char *>(memchr(begin, ' ', size));
+
+        if (separator == NULL)
         {
             char time_buffer[BUFFER_SIZE];
             time_string(time_buffer, BUFFER_SIZE, NULL);
             std::cout << '[' << time_buffer << "] ";
-            std::cout << "Topic: " << topic << "; ";
+            std::cout << "ERROR: Unable to find topic separator";
             std::cout << std::endl;
+
+            continue;
         }
 
-        const std::string topic_string(topic);
+        const std::string topic_string(begin, separator);
+
+        if (global_status.verbosity > 0)
+        {
+            char time_buffer[BUFFER_SIZE];
+            time_string(time_buffer, BUFFER_SIZE, NULL);
+            std::cout << '[' << time_buffer << "] ";
+            std::cout << "Topic: " << topic_string << "; ";
+            std::cout << std::endl;
+        }
 
         if (topic_string.find(global_status.subscription_topic) == 0)
         {
             const clock_t event_start = clock();
 
-            const size_t data_size = size;
+            const uint8_t *data = reinterpret_cast<const uint8_t *>(separator + 1);
+            const size_t data_size = size - (separator + 1 - begin);
 
             if (global_status.verbosity > 0)
             {
@@ -656,12 +998,7 @@ state actions::read_socket(status &global_status)
                 std::cout << std::endl;
             }
 
-            binary_fifo::binary_data new_data;
-            new_data.resize(data_size);
-
-            memcpy(new_data.data(), input_buffer, data_size * sizeof(uint8_t));
-
-            global_status.fifo.push(new_data);
+            actions::generic::store_data(global_status, data, data_size);
 
             const clock_t event_stop = clock();
 
@@ -675,14 +1012,23 @@ state actions::read_socket(status &global_status)
             }
 
         }
+    }
 
-        // Remember to free buffers
-        free(topic);
-        free(input_buffer);
+    // Without messages the receive fails with EAGAIN
+    const int error_number = errno;
 
-        result = receive_byte_message(abcd_data_socket, &topic, (void **)(&input_buffer), &size, true, global_status.verbosity);
+    if (error_number != EAGAIN)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "ERROR: ZeroMQ Error on receive: ";
+        std::cout << zmq_strerror(error_number);
+        std::cout << std::endl;
     }
 
+    zmq_msg_close(&message);
+
     const std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
     if (now - global_status.last_publication > std::chrono::seconds(defaults_fifo_publish_timeout))
     {
@@ -17,36 +17,28 @@
  * along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+
 // This macro is to use nanosleep even with compilation flag: -std=c99
 #define _POSIX_C_SOURCE 199309L
 // This macro is to enable snprintf() in macOS
 #define _C99_SOURCE
 
-// For nanosleep()
-#include <time.h>
 // Fot getopt
 #include <getopt.h>
 // For malloc
 #include <stdlib.h>
-// For memcpy
-#include <string.h>
-// For ints with fixed size
-#include <stdint.h>
-#include <inttypes.h>
 // For kernel signals management
 #include <signal.h>
 // For snprintf()
 #include <stdio.h>
 // For boolean datatype
 #include <stdbool.h>
-// For the time functions for ISO time
-#include <time.h>
 
-#include <zmq.h>
+#include <jansson.h>
 
 #include "defaults.h"
-#include "events.h"
-#include "socket_functions.h"
+#include "filter_chain.h"
+#include "enfi_plugin.h"
 
 unsigned int terminate_flag = 0;
 
@@ -87,10 +79,17 @@ int main(int argc, char *argv[])
     signal(SIGINT, signal_handler);
     signal(SIGHUP, signal_handler);
 
-    unsigned int verbosity = 0;
-    unsigned int base_period = defaults_enfi_base_period;
-    char *input_address = defaults_abcd_data_address_sub;
-    char *output_address = defaults_enfi_data_address;
+    struct filter_chain_settings settings;
+    settings.input_address = defaults_abcd_data_address_sub;
+    settings.output_address = defaults_enfi_data_address;
+    settings.subscribe_topic = defaults_abcd_data_events_topic;
+    settings.base_period = defaults_enfi_base_period;
+    settings.ade_buffer_size = defaults_cofi_ade_buffer_size;
+    settings.forward_unknown = false;
+    settings.numbered_topics = false;
+    settings.verbosity = 0;
+    settings.terminate_flag = &terminate_flag;
+
     float min_energy = defaults_enfi_min_energy;
     float max_energy = defaults_enfi_max_energy;
 
@@ -101,13 +100,13 @@ int main(int argc, char *argv[])
                 print_usage(argv[0]);
                 return EXIT_SUCCESS;
             case 'S':
-                input_address = optarg;
+                settings.input_address = optarg;
                 break;
             case 'P':
-                output_address = optarg;
+                settings.output_address = optarg;
                 break;
             case 'T':
-                base_period = atoi(optarg);
+                settings.base_period = atoi(optarg);
                 break;
             case 'e':
                 min_energy = atof(optarg);
@@ -116,7 +115,7 @@ int main(int argc, char *argv[])
                 max_energy = atof(optarg);
                 break;
             case 'v':
-                verbosity = 1;
+                settings.verbosity = 1;
                 break;
             default:
                 printf("Unknown command: %c", c);
@@ -124,216 +123,20 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (verbosity > 0) {
-        printf("Input socket address: %s\n", input_address);
-        printf("Output socket address: %s\n", output_address);
-        printf("Verbosity: %u\n", verbosity);
-        printf("Base period: %u\n", base_period);
-        printf("Minimum energy: %f\n", min_energy);
-        printf("Maximum energy: %f\n", max_energy);
-    }
-
-    // Creates a �MQ context
-    void *context = zmq_ctx_new();
-    if (!context)
-    {
-        printf("ERROR: ZeroMQ Error on context creation");
-        return EXIT_FAILURE;
-    }
-
-    void *input_socket = zmq_socket(context, ZMQ_SUB);
-    if (!input_socket)
-    {
-        printf("ERROR: ZeroMQ Error on input socket creation\n");
-        return EXIT_FAILURE;
-    }
-
-    void *output_socket = zmq_socket(context, ZMQ_PUB);
-    if (!output_socket)
-    {
-        printf("ERROR: ZeroMQ Error on output socket creation\n");
-        return EXIT_FAILURE;
-    }
-
-    const int is = zmq_connect(input_socket, input_address);
-    if (is != 0)
-    {
-        printf("ERROR: ZeroMQ Error on input socket binding: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-
-    const int os = zmq_bind(output_socket, output_address);
-    if (os != 0)
-    {
-        printf("ERROR: ZeroMQ Error on output socket connection: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-
-    // Subscribe to data topic
-    zmq_setsockopt(input_socket, ZMQ_SUBSCRIBE, defaults_abcd_data_events_topic, strlen(defaults_abcd_data_events_topic));
-
-    // Wait a bit to prevent the slow-joiner syndrome
-    struct timespec slow_joiner_wait;
-    slow_joiner_wait.tv_sec = defaults_all_slow_joiner_wait / 1000;
-    slow_joiner_wait.tv_nsec = (defaults_all_slow_joiner_wait % 1000) * 1000000L;
-    nanosleep(&slow_joiner_wait, NULL);
-    //usleep(defaults_all_slow_joiner_wait * 1000);
-
-    // Setting up the wait for the main loop
-    // If you're asking why, on earth, are we using something so complicated,
-    // on the man page of usleep it is said:
-    // 4.3BSD, POSIX.1-2001.  POSIX.1-2001  declares  this  function  obsolete;  use  nanosleep(2)
-    struct timespec wait;
-    wait.tv_sec = base_period / 1000;
-    wait.tv_nsec = (base_period % 1000) * 1000000L;
-
-    size_t counter = 0;
-    size_t msg_counter = 0;
-    size_t msg_ID = 0;
-
-    while (terminate_flag == 0)
-    {
-        char *topic;
-        uint8_t *input_buffer;
-        size_t size;
-
-        const int result = receive_byte_message(input_socket, &topic, (void **)(&input_buffer), &size, true, verbosity);
-
-        if (result == EXIT_FAILURE)
-        {
-            printf("[%zu] ERROR: Some error occurred!!!\n", counter);
-        }
-        else if (size == 0 && result == EXIT_SUCCESS)
-        {
-            if (verbosity > 1)
-            {
-                printf("[%zu] No message available\n", counter);
-            }
-        }
-        else if (size > 0 && result == EXIT_SUCCESS)
-        {
-            if (verbosity > 0)
-            {
-                printf("[%zu] Message received!!! (topic: %s)\n", counter, topic);
-            }
-
-            // Check if the topic is the right one
-            if (strstr(topic, "data_abcd_events_v0") == topic)
-            {
-                const clock_t event_start = clock();
-
-                const size_t events_number = size / sizeof(struct event_PSD);
-
-                uintmax_t selected_number = 0;
-
-                struct event_PSD *events = (void *)input_buffer;
-
-                if ((size % sizeof(struct event_PSD)) != 0)
-                {
-                    printf("[%zu] ERROR: The buffer size is not a multiple of %zu\n", counter, sizeof(struct event_PSD));
-                }
-                else
-                {
-                    struct event_PSD *selected_events = malloc(sizeof(struct event_PSD) * events_number);
-
-                    if (selected_events == NULL)
-                    {
-                        printf("[%zu] ERROR: Unable to allocate output buffer\n", counter);
-                    }
-                    else
-                    {
-                        for (size_t i = 0; i < events_number; i++)
-                        {
-                            const struct event_PSD this_event = events[i];
-
-                            /******************************************************/
-                            /* HERE BE THE FILTER!!!                              */
-                            /******************************************************/
-                            if (min_energy <= this_event.qlong && this_event.qlong < max_energy)
-                            {
-                                selected_events[selected_number] = this_event;
-                                selected_number += 1;
-                            }
-                        }
-
-                        const size_t output_size = selected_number * sizeof(struct event_PSD);
-
-                        // Compute the new topic
-                        char new_topic[defaults_all_topic_buffer_size];
-                        // I am not sure if snprintf is standard or not, apprently it is in the C99 standard
-                        snprintf(new_topic, defaults_all_topic_buffer_size, "data_abcd_events_v0_s%zu", output_size);
-
-                        send_byte_message(output_socket, new_topic, (void *)selected_events, output_size, verbosity);
-                        msg_ID += 1;
-
-                        if (verbosity > 0)
-                        {
-                            printf("Sending message with topic: %s\n", new_topic);
-                        }
-
-                        free(selected_events);
-                    }
-                }
-
-                const clock_t event_stop = clock();
-
-                if (verbosity > 0)
-                {
-                    const float elaboration_time = (float)(event_stop - event_start) / CLOCKS_PER_SEC * 1000;
-                    const float elaboration_speed = size / elaboration_time * 1000.0 / 1024.0 / 1024.0;
+    // The filter is a chain with a single stage
+    json_t *json_stage = json_object();
+    json_object_set_new(json_stage, "filter", json_string(enfi_plugin.name));
+    json_object_set_new(json_stage, "min_energy", json_real(min_energy));
+    json_object_set_new(json_stage, "max_energy", json_real(max_energy));
 
-                    printf("size: %zu; events_number: %zu; selected_number: %" PRIuMAX "; ratio: %.2f%%; elaboration_time: %f ms; elaboration_speed: %f MBi/s\n", size, events_number, selected_number, selected_number / (float)events_number * 100, elaboration_time, elaboration_speed);
-                }
-            }
+    json_t *json_chain = json_array();
+    json_array_append_new(json_chain, json_stage);
 
-            msg_counter += 1;
+    const struct filter_plugin *plugins[] = {&enfi_plugin};
 
-            // Remember to free buffers
-            free(topic);
-            free(input_buffer);
-        }
-        else
-        {
-            printf("[%zu] ERROR: What?!?!?!\n", counter);
-        }
-
-        counter += 1;
-
-        // Putting a delay in order not to fill-up the queues
-        nanosleep(&wait, NULL);
-        //usleep(base_period * 1000);
-
-        if (verbosity > 1)
-        {
-            printf("counter: %zu; msg_counter: %zu, msg_ID: %zu\n", counter, msg_counter, msg_ID);
-        }
-    }
+    const int result = filter_chain_run(&settings, json_chain, plugins, 1);
 
+    json_decref(json_chain);
 
-    // Wait a bit to allow the sockets to deliver
-    nanosleep(&slow_joiner_wait, NULL);
-    //usleep(defaults_all_slow_joiner_wait * 1000);
-
-    const int ic = zmq_close(input_socket);
-    if (ic != 0)
-    {
-        printf("ERROR: ZeroMQ Error on input socket close: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-    
-    const int oc = zmq_close(output_socket);
-    if (oc != 0)
-    {
-        printf("ERROR: ZeroMQ Error on output socket close: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-    
-    const int cc = zmq_ctx_destroy(context);
-    if (cc != 0)
-    {
-        printf("ERROR: ZeroMQ Error on context destroy: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-    
-    return EXIT_SUCCESS;
+    return result;
 }
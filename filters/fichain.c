@@ -0,0 +1,198 @@
+/*
+ * (C) Copyright 2026 Cristiano Lino Fontana
+ *
+ * This file is part of ABCD.
+ *
+ * ABCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ABCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This macro is to use nanosleep even with compilation flag: -std=c99
+#define _POSIX_C_SOURCE 199309L
+// This macro is to enable snprintf() in macOS
+#define _C99_SOURCE
+
+// Fot getopt
+#include <getopt.h>
+// For malloc
+#include <stdlib.h>
+// For kernel signals management
+#include <signal.h>
+// For snprintf()
+#include <stdio.h>
+// For boolean datatype
+#include <stdbool.h>
+
+#include <jansson.h>
+
+#include "defaults.h"
+#include "filter_chain.h"
+#include "chafi_plugin.h"
+#include "enfi_plugin.h"
+#include "pufi_plugin.h"
+#include "cofi_plugin.h"
+#include "sofi_plugin.h"
+
+unsigned int terminate_flag = 0;
+
+// Handle standard signals
+// SIGTERM (from kill): terminates kindly forcing the status to the closing branch of the state machine.
+// SIGINT (from ctrl-c): same behaviour as SIGTERM
+// SIGHUP (from shell processes): same behaviour as SIGTERM
+
+void signal_handler(int signum);
+
+void print_usage(const char *name)
+{
+    printf("Usage: %s [options] <chain_config_file_name>\n", name);
+    printf("\n");
+    printf("Datastream filter that runs a chain of filters in the same process.\n");
+    printf("The filters are applied back to back on the same data, without sending it between processes.\n");
+    printf("The chain is defined in a JSON file containing an object with the list of the filters,\n");
+    printf("each filter has the same parameters of the standalone version.\n");
+    printf("Example:\n");
+    printf("  {\n");
+    printf("    \"input\": \"%s\",\n", defaults_abcd_data_address_sub);
+    printf("    \"output\": \"%s\",\n", defaults_fichain_data_address);
+    printf("    \"filters\": [\n");
+    printf("      { \"filter\": \"chafi\", \"channels\": [0, 1, 2] },\n");
+    printf("      { \"filter\": \"enfi\", \"min_energy\": 400, \"max_energy\": 60000 },\n");
+    printf("      { \"filter\": \"pufi\", \"polygons_file\": \"polygons.json\", \"lut_size\": 256 },\n");
+    printf("      { \"filter\": \"sofi\", \"horizon_time\": 1000000 },\n");
+    printf("      { \"filter\": \"cofi\", \"references\": [0], \"left_window\": 200, \"right_window\": 200,\n");
+    printf("        \"multiplicity\": 1, \"keep_reference\": false, \"anticoincidences_address\": \"%s\" }\n", defaults_cofi_anticoincidence_data_address);
+    printf("    ]\n");
+    printf("  }\n");
+    printf("The pufi polygons may also be given directly with the \"polygons\" array.\n");
+    printf("\n");
+    printf("Optional arguments:\n");
+    printf("\t-h: Display this message\n");
+    printf("\t-v: Set verbose execution, repeating the option increases the verbosity level\n");
+    printf("\n");
+    printf("\t-A <address>: Input socket address, it overrides the configuration, default: %s\n", defaults_abcd_data_address_sub);
+    printf("\t              If it has the form 'file://<path_to_file>' then data will be read from an ade or adr file.\n");
+    printf("\t              For ade files the address may have the form 'file://<path_to_file>[:<buffer_size>]', default: %d.\n", defaults_fichain_ade_buffer_size);
+    printf("\t              When the file is finished, fichain will quit.\n");
+    printf("\t-D <address>: Output socket address, it overrides the configuration, default: %s\n", defaults_fichain_data_address);
+    printf("\t-T <period>: Set base period in milliseconds, default: %d\n", defaults_fichain_base_period);
+
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    // Register the handler for SIGTERM (from kill), SIGINT (from ctrl-c)
+    signal(SIGTERM, signal_handler);
+    signal(SIGINT, signal_handler);
+    signal(SIGHUP, signal_handler);
+
+    struct filter_chain_settings settings;
+    settings.input_address = NULL;
+    settings.output_address = NULL;
+    settings.subscribe_topic = defaults_fichain_topic_subscribe;
+    settings.base_period = defaults_fichain_base_period;
+    settings.ade_buffer_size = defaults_fichain_ade_buffer_size;
+    settings.forward_unknown = true;
+    settings.numbered_topics = false;
+    settings.verbosity = 0;
+    settings.terminate_flag = &terminate_flag;
+
+    int c = 0;
+    while ((c = getopt(argc, argv, "hA:D:T:v")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 'A':
+            settings.input_address = optarg;
+            break;
+        case 'D':
+            settings.output_address = optarg;
+            break;
+        case 'T':
+            settings.base_period = atoi(optarg);
+            break;
+        case 'v':
+            settings.verbosity += 1;
+            break;
+        default:
+            printf("Unknown command: %c", c);
+            break;
+        }
+    }
+
+    const int number_of_arguments = argc - optind;
+
+    if (number_of_arguments < 1)
+    {
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    const char *config_file_name = argv[optind];
+
+    json_error_t error;
+    json_t *json_config = json_load_file(config_file_name, 0, &error);
+
+    if (!json_config)
+    {
+        printf("ERROR: Parse error while reading config file: %s (source: %s, line: %d, column: %d, position: %d)\n", error.text, error.source, error.line, error.column, error.position);
+
+        return EXIT_FAILURE;
+    }
+
+    if (!json_is_object(json_config))
+    {
+        printf("ERROR: The config file does not contain an object\n");
+
+        json_decref(json_config);
+
+        return EXIT_FAILURE;
+    }
+
+    // The command line addresses override the ones of the configuration
+    if (!settings.input_address)
+    {
+        const char *input_address = json_string_value(json_object_get(json_config, "input"));
+
+        settings.input_address = (input_address) ? input_address : defaults_abcd_data_address_sub;
+    }
+
+    if (!settings.output_address)
+    {
+        const char *output_address = json_string_value(json_object_get(json_config, "output"));
+
+        settings.output_address = (output_address) ? output_address : defaults_fichain_data_address;
+    }
+
+    const struct filter_plugin *plugins[] = {&chafi_plugin, &enfi_plugin, &pufi_plugin, &cofi_plugin, &sofi_plugin};
+
+    const int result = filter_chain_run(&settings,
+                                        json_object_get(json_config, "filters"),
+                                        plugins,
+                                        sizeof(plugins) / sizeof(plugins[0]));
+
+    json_decref(json_config);
+
+    return result;
+}
+
+void signal_handler(int signum)
+{
+    if (signum == SIGINT || signum == SIGTERM || signum == SIGHUP)
+    {
+        terminate_flag = 1;
+    }
+}
@@ -0,0 +1,158 @@
+#ifndef __CHAFI_PLUGIN_H__
+#define __CHAFI_PLUGIN_H__ 1
+
+// Channel filter, it selects the events and the waveforms of a set of channels.
+//
+// Configuration:
+//   "channels": a channel or an array of channels
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <jansson.h>
+
+#include "events.h"
+#include "filter_plugin.h"
+#include "filter_kernels.h"
+
+struct chafi_config
+{
+    uint64_t selected_channels[4];
+    unsigned int verbosity;
+};
+
+extern inline
+bool chafi_init(json_t *json_config, void *zmq_context, unsigned int verbosity, void **user_config)
+{
+    (void)zmq_context;
+
+    struct chafi_config *config = calloc(1, sizeof(struct chafi_config));
+
+    if (!config)
+    {
+        printf("ERROR: chafi: Unable to allocate the configuration\n");
+
+        return false;
+    }
+
+    const size_t channels_number = filter_read_channels(json_object_get(json_config, "channels"), config->selected_channels);
+
+    if (channels_number == 0)
+    {
+        printf("ERROR: chafi: No channels were selected\n");
+
+        free(config);
+
+        return false;
+    }
+
+    config->verbosity = verbosity;
+
+    if (verbosity > 0)
+    {
+        printf("chafi: Selected channel(s):");
+        for (unsigned int channel = 0; channel <= UINT8_MAX; channel++)
+        {
+            if (filter_channel_selected(config->selected_channels, channel))
+            {
+                printf("\t%u", channel);
+            }
+        }
+        printf("\n");
+    }
+
+    (*user_config) = config;
+
+    return true;
+}
+
+//! The selected events are compacted at the beginning of the buffer
+extern inline
+bool chafi_process(struct filter_batch *batch, void *user_config)
+{
+    const struct chafi_config *config = user_config;
+
+    size_t events_number = 0;
+    size_t selected_number = 0;
+    size_t output_offset = 0;
+
+    if (batch->type == FILTER_WAVEFORMS)
+    {
+        size_t input_offset = 0;
+
+        while (input_offset + waveform_header_size() <= batch->size)
+        {
+            const uint8_t this_channel = batch->buffer[input_offset + 8];
+            const size_t this_size = filter_waveform_size(batch->buffer + input_offset);
+
+            if (input_offset + this_size > batch->size)
+            {
+                printf("ERROR: chafi: The waveform at offset %zu exceeds the buffer size %zu\n", input_offset, batch->size);
+
+                break;
+            }
+
+            if (filter_channel_selected(config->selected_channels, this_channel))
+            {
+                // The waveforms do not overlap, since the output lags behind
+                memmove(batch->buffer + output_offset, batch->buffer + input_offset, this_size);
+
+                output_offset += this_size;
+                selected_number += 1;
+            }
+
+            if (config->verbosity > 2)
+            {
+                printf("chafi: this_channel: %" PRIu8 "; this_size: %zu; input_offset: %zu\n", this_channel, this_size, input_offset);
+            }
+
+            events_number += 1;
+            input_offset += this_size;
+        }
+    }
+    else
+    {
+        if ((batch->size % sizeof(struct event_PSD)) != 0)
+        {
+            printf("ERROR: chafi: The buffer size is not a multiple of %zu\n", sizeof(struct event_PSD));
+
+            return false;
+        }
+
+        events_number = batch->size / sizeof(struct event_PSD);
+        selected_number = filter_select_channels((struct event_PSD *)batch->buffer, events_number, config->selected_channels);
+
+        output_offset = selected_number * sizeof(struct event_PSD);
+    }
+
+    if (config->verbosity > 1)
+    {
+        printf("chafi: size: %zu; events_number: %zu; selected_number: %zu; output_size: %zu\n", batch->size, events_number, selected_number, output_offset);
+    }
+
+    batch->size = output_offset;
+
+    return true;
+}
+
+extern inline
+void chafi_close(void *user_config)
+{
+    free(user_config);
+}
+
+static const struct filter_plugin chafi_plugin = {
+    "chafi",
+    true,
+    true,
+    chafi_init,
+    chafi_process,
+    NULL,
+    chafi_close
+};
+
+#endif
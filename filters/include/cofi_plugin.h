@@ -0,0 +1,1108 @@
+#ifndef __COFI_PLUGIN_H__
+#define __COFI_PLUGIN_H__ 1
+
+// Coincidence filter, it selects the events that are in coincidence with a set
+// of reference channels in a defined time window.
+// The coincidences are searched also across consecutive batches, the events are
+// held until all the events of their coincidence window arrived. The events
+// that arrive after the search of their coincidence window are counted as late
+// and they are considered anticoincidences. If the timestamps jump back by
+// more than the whole coincidence window the digitizer was restarted, the
+// window is flushed and the search starts anew.
+// The anticoincidences are published on a socket of the filter.
+//
+// Configuration:
+//   "references": a reference channel or an array of reference channels
+//   "left_window": left coincidence window width in nanoseconds
+//   "right_window": right coincidence window width in nanoseconds
+//   "ns_per_sample": nanoseconds per sample
+//   "multiplicity": event minimum multiplicity excluding the reference channel
+//   "keep_reference": keep the reference events even without coincidences
+//   "anticoincidences_address": enables the anticoincidences, publishing them
+//                               on a socket bound to this address
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <zmq.h>
+#include <jansson.h>
+
+#include "defaults.h"
+#include "events.h"
+#include "socket_functions.h"
+#include "radix_sort.h"
+#include "filter_plugin.h"
+
+#define COFI_INITIAL_RING_SIZE 1024
+
+struct window_event
+{
+    size_t index;
+    uint64_t timestamp;
+    uint8_t channel;
+    uint8_t group_counter;
+    // The event is not in the coincidence window of any reference event
+    bool anticoincidence;
+    // Sequence number of the message that holds the event
+    uint32_t message;
+    size_t size;
+};
+
+struct coincidence_settings
+{
+    // Bitmask of the reference channels
+    uint64_t reference_channels[4];
+    int64_t left_window;
+    int64_t right_window;
+    size_t multiplicity;
+    bool keep_reference_event;
+    bool enable_anticoincidences;
+};
+
+struct window_message
+{
+    uint8_t *buffer;
+    size_t buffer_size;
+    // Number of the events of the message that are still in the window
+    size_t events_number;
+};
+
+// The coincidence window holds the recent events across the messages, so that
+// the coincidences are searched also between consecutive messages.
+// The pointers to the events are stored in a ring buffer sorted by timestamp,
+// while the events stay in the buffers of the received messages, that are
+// released when all their events left the window.
+// The events are processed in order as possible reference events once all
+// the events of their coincidence window arrived, and they leave the window
+// when they cannot be in the coincidence window of the following reference
+// events anymore, at that point they are anticoincidences if no reference
+// event found them.
+struct coincidence_window
+{
+    enum filter_data_types type;
+
+    // Ring buffer of the messages, the capacity is a power of two
+    struct window_message *messages;
+    size_t messages_capacity;
+    size_t messages_first;
+    size_t messages_number;
+    // Sequence number of the first message in the ring
+    uint32_t messages_sequence;
+
+    // Ring buffer of the events, the capacity is a power of two
+    struct window_event *events;
+    size_t events_capacity;
+    size_t events_first;
+    size_t events_number;
+    // Buffer used to merge the overlapping messages
+    struct window_event *merge_buffer;
+    size_t merge_buffer_capacity;
+
+    // Index of the first event not yet processed as a reference event
+    size_t next_event;
+    // Edges of the coincidence window of the last reference event, the
+    // window_references are the events from the reference channels inside
+    size_t window_start;
+    size_t window_end;
+    size_t window_references;
+
+    uint64_t newest_timestamp;
+    uint64_t last_processed_timestamp;
+    bool processed_any;
+
+    // The biggest of the released message buffers, it is reused for the
+    // output instead of allocating a new buffer for every message
+    uint8_t *spare_buffer;
+    size_t spare_capacity;
+
+    // Events that arrived after the search of their coincidence window
+    size_t late_events;
+    size_t restarts;
+};
+
+// Generic buffer for the output of events, both event_PSD as well as
+// event_waveform. It grows as needed, the buffer of the coincidences is given
+// to the batches and replaced by a spare buffer of the window, while the one of
+// the anticoincidences is reused.
+struct cofi_output_buffer
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
+struct cofi_config
+{
+    struct coincidence_settings settings;
+
+    // The events and the waveforms are searched in separate windows
+    struct coincidence_window window_events;
+    struct coincidence_window window_waveforms;
+
+    struct window_event *pointers_events_input;
+    size_t pointers_events_input_capacity;
+    // Scratch buffer for the radix sort of the pointers
+    struct window_event *pointers_sorting_buffer;
+    size_t pointers_sorting_buffer_capacity;
+
+    struct cofi_output_buffer output_coincidences;
+    struct cofi_output_buffer output_anticoincidences;
+
+    void *anticoincidences_socket;
+
+    unsigned int verbosity;
+};
+
+extern inline
+bool cofi_is_reference(const struct coincidence_settings *settings, uint8_t channel)
+{
+    return (settings->reference_channels[channel / 64] >> (channel % 64)) & 1;
+}
+
+extern inline
+int cofi_compare_events(const void *a, const void *b)
+{
+    const struct window_event *event_a = (const struct window_event *)a;
+    const struct window_event *event_b = (const struct window_event *)b;
+
+    if (event_a->timestamp < event_b->timestamp)
+    {
+        return -1;
+    }
+    else if (event_a->timestamp > event_b->timestamp)
+    {
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+// Enlarges the array at least to entries_number, doubling its capacity so
+// that a growing array is reallocated only a few times. On failure the array
+// is left untouched and false is returned.
+extern inline
+bool cofi_reserve_array(size_t entries_number, size_t *capacity, void **entries_array, size_t sizeof_type)
+{
+    if (entries_number <= (*capacity))
+    {
+        return true;
+    }
+
+    const size_t new_capacity = (entries_number > 2 * (*capacity)) ? entries_number : 2 * (*capacity);
+
+    void *new_elements_array = realloc((*entries_array), new_capacity * sizeof_type);
+
+    if (!new_elements_array)
+    {
+        printf("ERROR: cofi_reserve_array(): Unable to allocate entries_array memory\n");
+
+        return false;
+    }
+
+    (*entries_array) = new_elements_array;
+    (*capacity) = new_capacity;
+
+    return true;
+}
+
+// Enlarges a ring buffer at least to entries_number, keeping the capacity a
+// power of two. The used entries are moved to the beginning of the new buffer.
+extern inline
+bool cofi_reserve_ring(size_t entries_number, size_t *capacity, size_t *first, size_t used_entries, void **ring, size_t sizeof_type)
+{
+    if (entries_number <= (*capacity))
+    {
+        return true;
+    }
+
+    size_t new_capacity = ((*capacity) > 0) ? (*capacity) : COFI_INITIAL_RING_SIZE;
+
+    while (new_capacity < entries_number)
+    {
+        new_capacity *= 2;
+    }
+
+    uint8_t *new_ring = malloc(new_capacity * sizeof_type);
+
+    if (!new_ring)
+    {
+        printf("ERROR: cofi_reserve_ring(): Unable to allocate ring memory\n");
+
+        return false;
+    }
+
+    if (used_entries > 0)
+    {
+        const uint8_t *old_ring = (*ring);
+
+        // Number of entries before the end of the old buffer
+        const size_t head_entries = ((*capacity) - (*first) < used_entries) ? (*capacity) - (*first) : used_entries;
+
+        memcpy(new_ring, old_ring + (*first) * sizeof_type, head_entries * sizeof_type);
+        memcpy(new_ring + head_entries * sizeof_type, old_ring, (used_entries - head_entries) * sizeof_type);
+    }
+
+    free(*ring);
+
+    (*ring) = new_ring;
+    (*capacity) = new_capacity;
+    (*first) = 0;
+
+    return true;
+}
+
+extern inline
+bool cofi_output_append(struct cofi_output_buffer *output, const void *data, size_t size)
+{
+    if (!cofi_reserve_array(output->size + size, &output->capacity, (void **)&output->data, sizeof(uint8_t)))
+    {
+        return false;
+    }
+
+    memcpy(output->data + output->size, data, size);
+    output->size += size;
+
+    return true;
+}
+
+// Sends the output buffer, if it is not empty, and clears it.
+// Returns true if a message was sent.
+extern inline
+bool cofi_send_output(void *output_socket, enum filter_data_types type, struct cofi_output_buffer *output, const char *description, unsigned int verbosity)
+{
+    if (output->size == 0)
+    {
+        return false;
+    }
+
+    char new_topic[defaults_all_topic_buffer_size];
+
+    if (type == FILTER_EVENTS)
+    {
+        snprintf(new_topic, defaults_all_topic_buffer_size, "data_abcd_events_v0_s%zu", output->size);
+    }
+    else
+    {
+        snprintf(new_topic, defaults_all_topic_buffer_size, "data_abcd_waveforms_v0_s%zu", output->size);
+    }
+
+    send_byte_message(output_socket, new_topic, (void *)output->data, output->size, 0);
+
+    if (verbosity > 0)
+    {
+        printf("Sending message with %s with topic: %s\n", description, new_topic);
+    }
+
+    output->size = 0;
+
+    return true;
+}
+
+extern inline
+struct window_event *window_at(const struct coincidence_window *window, size_t index)
+{
+    return &window->events[(window->events_first + index) & (window->events_capacity - 1)];
+}
+
+// The events older than this threshold are late, since they should have been
+// in the coincidence window of an already processed reference event, or they
+// should have been processed before it.
+// Thus it is also the oldest timestamp of the following reference events.
+extern inline
+int64_t window_late_threshold(const struct coincidence_window *window, const struct coincidence_settings *settings)
+{
+    const int64_t last_processed = window->last_processed_timestamp;
+    const int64_t right_edge = last_processed + settings->right_window;
+
+    return (right_edge > last_processed) ? right_edge : last_processed;
+}
+
+extern inline
+bool window_is_late(const struct coincidence_window *window, const struct coincidence_settings *settings, uint64_t timestamp)
+{
+    if (!window->processed_any)
+    {
+        return false;
+    }
+
+    return (int64_t)timestamp < window_late_threshold(window, settings);
+}
+
+// The digitizer was restarted if the timestamp went back from the last
+// processed reference by more than the whole coincidence window, smaller
+// jumps only make the events late.
+extern inline
+bool window_is_restart(const struct coincidence_window *window, const struct coincidence_settings *settings, uint64_t timestamp)
+{
+    if (!window->processed_any)
+    {
+        return false;
+    }
+
+    const int64_t width = settings->left_window + settings->right_window;
+    const int64_t jump = (int64_t)window->last_processed_timestamp - (int64_t)timestamp;
+
+    return jump > 0 && jump > width;
+}
+
+// Keeps the buffer as the spare buffer of the window if it is bigger than the
+// current one, the other buffer is freed.
+extern inline
+void window_keep_spare(struct coincidence_window *window, uint8_t *buffer, size_t capacity)
+{
+    if (!buffer)
+    {
+        return;
+    }
+
+    if (capacity > window->spare_capacity)
+    {
+        free(window->spare_buffer);
+
+        window->spare_buffer = buffer;
+        window->spare_capacity = capacity;
+    }
+    else
+    {
+        free(buffer);
+    }
+}
+
+// Adds the sorted events of a message to the window, that takes the ownership
+// of the message buffer. None of the events shall be late.
+extern inline
+bool window_add_message(struct coincidence_window *window, uint8_t *buffer, size_t buffer_size, const struct window_event *pointers, size_t events_number)
+{
+    if (!cofi_reserve_ring(window->messages_number + 1,
+                      &window->messages_capacity,
+                      &window->messages_first,
+                      window->messages_number,
+                      (void **)&window->messages,
+                      sizeof(struct window_message)) ||
+        !cofi_reserve_ring(window->events_number + events_number,
+                      &window->events_capacity,
+                      &window->events_first,
+                      window->events_number,
+                      (void **)&window->events,
+                      sizeof(struct window_event)))
+    {
+        return false;
+    }
+
+    // The new events go after all the events with a lower or equal timestamp.
+    // Since they are not late, they go after the processed events and after
+    // the edges of the coincidence window.
+    size_t low = window->next_event;
+    size_t high = window->events_number;
+
+    while (low < high)
+    {
+        const size_t middle = low + (high - low) / 2;
+
+        if (window_at(window, middle)->timestamp <= pointers[0].timestamp)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    const size_t position = low;
+    const size_t overlap_number = window->events_number - position;
+
+    if (!cofi_reserve_array(overlap_number,
+                       &window->merge_buffer_capacity,
+                       (void **)&window->merge_buffer,
+                       sizeof(struct window_event)))
+    {
+        return false;
+    }
+
+    const uint32_t message = window->messages_sequence + (uint32_t)window->messages_number;
+
+    struct window_message *this_message = &window->messages[(window->messages_first + window->messages_number) & (window->messages_capacity - 1)];
+
+    this_message->buffer = buffer;
+    this_message->buffer_size = buffer_size;
+    this_message->events_number = events_number;
+
+    window->messages_number += 1;
+
+    // Usually the messages do not overlap and the events are just appended
+    for (size_t i = 0; i < overlap_number; i++)
+    {
+        window->merge_buffer[i] = *window_at(window, position + i);
+    }
+
+    size_t i = 0;
+    size_t j = 0;
+
+    for (size_t k = position; k < window->events_number + events_number; k++)
+    {
+        if (j >= events_number || (i < overlap_number && window->merge_buffer[i].timestamp <= pointers[j].timestamp))
+        {
+            *window_at(window, k) = window->merge_buffer[i];
+            i += 1;
+        }
+        else
+        {
+            struct window_event *this_event = window_at(window, k);
+
+            *this_event = pointers[j];
+            this_event->message = message;
+
+            j += 1;
+        }
+    }
+
+    window->events_number += events_number;
+
+    if (pointers[events_number - 1].timestamp > window->newest_timestamp)
+    {
+        window->newest_timestamp = pointers[events_number - 1].timestamp;
+    }
+
+    return true;
+}
+
+// Appends an event to the output, with the given group_counter for event_PSD
+extern inline
+bool window_append_event(const struct coincidence_window *window, const struct window_event *pointer_event, uint8_t group_counter, struct cofi_output_buffer *output)
+{
+    const struct window_message *this_message = &window->messages[(window->messages_first + (uint32_t)(pointer_event->message - window->messages_sequence)) & (window->messages_capacity - 1)];
+
+    const uint8_t *event_data = this_message->buffer + pointer_event->index;
+
+    if (window->type == FILTER_EVENTS)
+    {
+        // For events we need to manage the group_counter member so we
+        // need to modify the events. We cannot simply memcpy() them to
+        // the output buffer.
+        struct event_PSD this_event;
+
+        memcpy(&this_event, event_data, sizeof(struct event_PSD));
+        this_event.group_counter = group_counter;
+
+        return cofi_output_append(output, &this_event, sizeof(struct event_PSD));
+    }
+    else
+    {
+        return cofi_output_append(output, event_data, pointer_event->size);
+    }
+}
+
+// Processes the events whose coincidence window is complete, or all of them if
+// flush is true. The coincidence groups are appended to the output, with the
+// reference event first, followed by the coincident events in time order.
+// Returns the number of events in the coincidence groups.
+extern inline
+size_t window_search(struct coincidence_window *window, const struct coincidence_settings *settings, bool flush, struct cofi_output_buffer *output, unsigned int verbosity)
+{
+    size_t coincidences_number = 0;
+
+    while (window->next_event < window->events_number)
+    {
+        struct window_event *reference_event = window_at(window, window->next_event);
+
+        // Coincidence windows might be bigger than timestamps and
+        // thus edges could be negative, so we must use signed ints,
+        // this is going to bother the compiler because the
+        // timestamps are unsigned.
+        const int64_t left_edge = reference_event->timestamp - settings->left_window;
+        const int64_t right_edge = reference_event->timestamp + settings->right_window;
+
+        // All the events of the window arrived only if there are newer events
+        if (!flush && right_edge > (int64_t)window->newest_timestamp)
+        {
+            break;
+        }
+
+        window->next_event += 1;
+        window->last_processed_timestamp = reference_event->timestamp;
+        window->processed_any = true;
+
+        if (!cofi_is_reference(settings, reference_event->channel))
+        {
+            continue;
+        }
+
+        // The edges only move forward, since the reference events are sorted,
+        // and the counter of the reference channels is updated while moving
+        while (window->window_end < window->events_number && (int64_t)window_at(window, window->window_end)->timestamp < right_edge)
+        {
+            if (cofi_is_reference(settings, window_at(window, window->window_end)->channel))
+            {
+                window->window_references += 1;
+            }
+
+            window->window_end += 1;
+        }
+
+        while (window->window_start < window->window_end && (int64_t)window_at(window, window->window_start)->timestamp <= left_edge)
+        {
+            if (cofi_is_reference(settings, window_at(window, window->window_start)->channel))
+            {
+                window->window_references -= 1;
+            }
+
+            window->window_start += 1;
+        }
+
+        const size_t found_coincidences = (window->window_end - window->window_start) - window->window_references;
+        const bool selected = (found_coincidences >= settings->multiplicity);
+
+        if (verbosity > 1 && found_coincidences > 0)
+        {
+            printf("    Reference timestamp: %" PRIu64 "; channel: %" PRIu8 "; event multiplicity: %zu%s\n", reference_event->timestamp, reference_event->channel, found_coincidences, selected ? " SELECTING GROUP!!!" : "");
+        }
+
+        // ---------------------------------------------------------------------
+        //  Storing the reference event to the coincidence group
+        // ---------------------------------------------------------------------
+        if (selected)
+        {
+            const uint8_t group_counter = (found_coincidences > 0xFF) ? 0xFF : (uint8_t)found_coincidences;
+
+            window_append_event(window, reference_event, group_counter, output);
+
+            reference_event->anticoincidence = false;
+            coincidences_number += 1 + found_coincidences;
+        }
+        else if (settings->keep_reference_event)
+        {
+            window_append_event(window, reference_event, 0, output);
+
+            reference_event->anticoincidence = false;
+            coincidences_number += 1;
+        }
+
+        // The events in the window are not anticoincidences even if the
+        // group is not selected
+        if (found_coincidences > 0)
+        {
+            for (size_t index = window->window_start; index < window->window_end; index++)
+            {
+                struct window_event *that_event = window_at(window, index);
+
+                if (!cofi_is_reference(settings, that_event->channel))
+                {
+                    if (selected)
+                    {
+                        window_append_event(window, that_event, 0, output);
+                    }
+
+                    that_event->anticoincidence = false;
+                }
+            }
+        }
+    }
+
+    return coincidences_number;
+}
+
+// Removes the processed events that cannot be in the coincidence window of the
+// following reference events, or all of them if flush is true. The removed
+// events that were not found by any reference event are appended to the output
+// if the anticoincidences are enabled.
+// Returns the number of removed events.
+extern inline
+size_t window_release(struct coincidence_window *window, const struct coincidence_settings *settings, bool flush, struct cofi_output_buffer *output)
+{
+    if (window->next_event == 0)
+    {
+        return 0;
+    }
+
+    // The following reference events are either in the window, not older
+    // than the next event, or in the following messages, not older than the
+    // late threshold
+    const int64_t late_threshold = window_late_threshold(window, settings);
+    const int64_t next_timestamp = (window->next_event < window->events_number) ? (int64_t)window_at(window, window->next_event)->timestamp : late_threshold;
+    const int64_t oldest_reference = (next_timestamp < late_threshold) ? next_timestamp : late_threshold;
+
+    size_t released_number = 0;
+
+    while (released_number < window->next_event &&
+           (flush || (int64_t)window_at(window, released_number)->timestamp + settings->left_window <= oldest_reference))
+    {
+        const struct window_event *this_event = window_at(window, released_number);
+
+        if (settings->enable_anticoincidences && this_event->anticoincidence)
+        {
+            window_append_event(window, this_event, this_event->group_counter, output);
+        }
+
+        released_number += 1;
+    }
+
+    if (released_number == 0)
+    {
+        return 0;
+    }
+
+    // Moving the edges of the coincidence window after the released events
+    while (window->window_start < released_number)
+    {
+        if (window->window_start < window->window_end && cofi_is_reference(settings, window_at(window, window->window_start)->channel))
+        {
+            window->window_references -= 1;
+        }
+
+        window->window_start += 1;
+    }
+
+    if (window->window_end < window->window_start)
+    {
+        window->window_end = window->window_start;
+        window->window_references = 0;
+    }
+
+    for (size_t index = 0; index < released_number; index++)
+    {
+        const struct window_event *this_event = window_at(window, index);
+
+        window->messages[(window->messages_first + (uint32_t)(this_event->message - window->messages_sequence)) & (window->messages_capacity - 1)].events_number -= 1;
+    }
+
+    window->events_first = (window->events_first + released_number) & (window->events_capacity - 1);
+    window->events_number -= released_number;
+    window->next_event -= released_number;
+    window->window_start -= released_number;
+    window->window_end -= released_number;
+
+    // The messages are released in order, even if a following message could
+    // be already empty
+    while (window->messages_number > 0 && window->messages[window->messages_first].events_number == 0)
+    {
+        window_keep_spare(window, window->messages[window->messages_first].buffer, window->messages[window->messages_first].buffer_size);
+
+        window->messages[window->messages_first].buffer = NULL;
+        window->messages_first = (window->messages_first + 1) & (window->messages_capacity - 1);
+        window->messages_number -= 1;
+        window->messages_sequence += 1;
+    }
+
+    return released_number;
+}
+
+extern inline
+void window_free(struct coincidence_window *window)
+{
+    for (size_t i = 0; i < window->messages_number; i++)
+    {
+        free(window->messages[(window->messages_first + i) & (window->messages_capacity - 1)].buffer);
+    }
+
+    free(window->messages);
+    free(window->events);
+    free(window->merge_buffer);
+    free(window->spare_buffer);
+
+    window->messages = NULL;
+    window->messages_capacity = 0;
+    window->messages_number = 0;
+    window->events = NULL;
+    window->events_capacity = 0;
+    window->events_number = 0;
+    window->merge_buffer = NULL;
+    window->merge_buffer_capacity = 0;
+    window->spare_buffer = NULL;
+    window->spare_capacity = 0;
+}
+
+//! Fills the pointers to the events of a message and returns their number,
+//! or zero if the message is malformed or the pointers could not be allocated
+extern inline
+size_t cofi_parse_message(const struct filter_batch *batch, struct window_event **pointers, size_t *pointers_capacity)
+{
+    const uint8_t *buffer = batch->buffer;
+    const size_t size = batch->size;
+
+    if (batch->type == FILTER_EVENTS)
+    {
+        const struct event_PSD *events = (const void *)buffer;
+
+        if ((size % sizeof(struct event_PSD)) != 0)
+        {
+            printf("ERROR: cofi: The buffer size is not a multiple of %zu\n", sizeof(struct event_PSD));
+
+            return 0;
+        }
+        else if (!cofi_reserve_array(size / sizeof(struct event_PSD), pointers_capacity, (void **)pointers, sizeof(struct window_event)))
+        {
+            printf("ERROR: cofi: Unable to allocate pointers_events_input buffer(s)\n");
+
+            return 0;
+        }
+
+        const size_t events_number = size / sizeof(struct event_PSD);
+
+        // Storing the timestamps to the generic pointers
+        for (size_t index = 0; index < events_number; index++)
+        {
+            const struct event_PSD this_event = events[index];
+
+            (*pointers)[index].index = index * sizeof(struct event_PSD);
+            (*pointers)[index].timestamp = this_event.timestamp;
+            (*pointers)[index].channel = this_event.channel;
+            (*pointers)[index].group_counter = 0;
+            (*pointers)[index].anticoincidence = true;
+            (*pointers)[index].size = sizeof(struct event_PSD);
+        }
+
+        return events_number;
+    }
+    else
+    {
+        // Overestimating the number of event_waveforms by using the
+        // buffer size and assuming that there are only empty waveforms
+        const size_t size_estimation = size / waveform_header_size();
+
+        if (!cofi_reserve_array(size_estimation, pointers_capacity, (void **)pointers, sizeof(struct window_event)))
+        {
+            printf("ERROR: cofi: Unable to allocate pointers_events_input buffer(s)\n");
+
+            return 0;
+        }
+
+        size_t events_counter = 0;
+        size_t input_offset = 0;
+
+        // Comparing also the events_counter against size to avoid
+        // accessing unauthorized memory areas
+        while (input_offset < size && events_counter < size_estimation)
+        {
+            uint64_t timestamp;
+            memcpy(&timestamp, buffer + input_offset, sizeof(timestamp));
+
+            const size_t this_size = filter_waveform_size(buffer + input_offset);
+
+            (*pointers)[events_counter].index = input_offset;
+            (*pointers)[events_counter].timestamp = timestamp;
+            (*pointers)[events_counter].channel = buffer[input_offset + 8];
+            (*pointers)[events_counter].group_counter = 0;
+            (*pointers)[events_counter].anticoincidence = true;
+            (*pointers)[events_counter].size = this_size;
+
+            input_offset += this_size;
+
+            events_counter += 1;
+        }
+
+        // In this case something went very wrong and we drop the message
+        if (size_estimation > events_counter && input_offset == size)
+        {
+            return events_counter;
+        }
+        else
+        {
+            printf("ERROR: cofi: Size estimation is less that then number of input events; size_estimation: %zu; events_counter: %zu;\n", size_estimation, events_counter);
+
+            return 0;
+        }
+    }
+}
+
+//! The coincidences that were found replace the events of the batch. The batch
+//! buffer is released by the host after sending it, so the following
+//! coincidences are written to the spare buffer of the window, that already
+//! has the size of a message, instead of growing a new buffer from scratch.
+extern inline
+void cofi_give_output(struct cofi_config *config, struct coincidence_window *window, struct filter_batch *batch)
+{
+    struct cofi_output_buffer *output = &config->output_coincidences;
+
+    // The input buffer is still here if the window did not take it
+    window_keep_spare(window, batch->buffer, batch->size);
+
+    if (output->size == 0)
+    {
+        // The output buffer is kept for the next coincidences
+        batch->buffer = NULL;
+        batch->size = 0;
+
+        return;
+    }
+
+    batch->buffer = output->data;
+    batch->size = output->size;
+
+    output->data = window->spare_buffer;
+    output->size = 0;
+    output->capacity = window->spare_capacity;
+
+    window->spare_buffer = NULL;
+    window->spare_capacity = 0;
+}
+
+extern inline
+void cofi_close(void *user_config)
+{
+    struct cofi_config *config = user_config;
+
+    window_free(&config->window_events);
+    window_free(&config->window_waveforms);
+
+    free(config->pointers_events_input);
+    free(config->pointers_sorting_buffer);
+    free(config->output_coincidences.data);
+    free(config->output_anticoincidences.data);
+
+    if (config->anticoincidences_socket)
+    {
+        const int oac = zmq_close(config->anticoincidences_socket);
+        if (oac != 0)
+        {
+            printf("ERROR: ZeroMQ Error on output socket for anticoincidences close: %s\n", zmq_strerror(errno));
+        }
+    }
+
+    free(config);
+}
+
+extern inline
+bool cofi_init(json_t *json_config, void *zmq_context, unsigned int verbosity, void **user_config)
+{
+    struct cofi_config *config = calloc(1, sizeof(struct cofi_config));
+
+    if (!config)
+    {
+        printf("ERROR: cofi: Unable to allocate the configuration\n");
+
+        return false;
+    }
+
+    config->verbosity = verbosity;
+    config->window_events.type = FILTER_EVENTS;
+    config->window_waveforms.type = FILTER_WAVEFORMS;
+
+    struct coincidence_settings *settings = &config->settings;
+
+    const size_t number_of_references = filter_read_channels(json_object_get(json_config, "references"), settings->reference_channels);
+
+    if (number_of_references == 0)
+    {
+        printf("ERROR: cofi: No reference channels were selected\n");
+
+        cofi_close(config);
+
+        return false;
+    }
+
+    const double left_coincidence_window_ns = filter_read_number(json_config, "left_window", defaults_cofi_coincidence_window_left);
+    const double right_coincidence_window_ns = filter_read_number(json_config, "right_window", defaults_cofi_coincidence_window_right);
+    const double ns_per_sample = filter_read_number(json_config, "ns_per_sample", defaults_cofi_ns_per_sample);
+    const char *anticoincidences_address = json_string_value(json_object_get(json_config, "anticoincidences_address"));
+
+    settings->left_window = (int64_t)(left_coincidence_window_ns / ns_per_sample);
+    settings->right_window = (int64_t)(right_coincidence_window_ns / ns_per_sample);
+    settings->multiplicity = filter_read_number(json_config, "multiplicity", defaults_cofi_multiplicity);
+    settings->keep_reference_event = json_is_true(json_object_get(json_config, "keep_reference"));
+    settings->enable_anticoincidences = (anticoincidences_address != NULL);
+
+    if (verbosity > 0)
+    {
+        printf("cofi: Reference channel(s):");
+        for (unsigned int channel = 0; channel <= UINT8_MAX; channel++)
+        {
+            if (cofi_is_reference(settings, channel))
+            {
+                printf("\t%u", channel);
+            }
+        }
+        printf("\n");
+        printf("cofi: Left coincidence window: %f, (clock steps: %" PRId64 ")\n", left_coincidence_window_ns, settings->left_window);
+        printf("cofi: Right coincidence window: %f, (clock steps: %" PRId64 ")\n", right_coincidence_window_ns, settings->right_window);
+        printf("cofi: Nanoseconds per sample: %f\n", ns_per_sample);
+        printf("cofi: Multiplicity: %zu\n", settings->multiplicity);
+        printf("cofi: Keep reference event: %s\n", settings->keep_reference_event ? "true" : "false");
+        printf("cofi: Enable anticoincidences: %s\n", settings->enable_anticoincidences ? "true" : "false");
+    }
+
+    if (settings->enable_anticoincidences)
+    {
+        if (verbosity > 0)
+        {
+            printf("cofi: Output socket address for anticoincidences: %s\n", anticoincidences_address);
+        }
+
+        config->anticoincidences_socket = zmq_socket(zmq_context, ZMQ_PUB);
+        if (!config->anticoincidences_socket)
+        {
+            printf("ERROR: ZeroMQ Error on output socket creation for anticoincidences\n");
+
+            cofi_close(config);
+
+            return false;
+        }
+
+        const int osa = zmq_bind(config->anticoincidences_socket, anticoincidences_address);
+        if (osa != 0)
+        {
+            printf("ERROR: ZeroMQ Error on output socket binding for anticoincidences: %s\n", zmq_strerror(errno));
+
+            cofi_close(config);
+
+            return false;
+        }
+    }
+
+    (*user_config) = config;
+
+    return true;
+}
+
+extern inline
+bool cofi_process(struct filter_batch *batch, void *user_config)
+{
+    struct cofi_config *config = user_config;
+    const struct coincidence_settings *settings = &config->settings;
+    const unsigned int verbosity = config->verbosity;
+
+    struct coincidence_window *window = (batch->type == FILTER_EVENTS) ? &config->window_events : &config->window_waveforms;
+
+    const size_t events_number = cofi_parse_message(batch, &config->pointers_events_input, &config->pointers_events_input_capacity);
+
+    struct window_event *pointers_events_input = config->pointers_events_input;
+
+    // =========================================================================
+    //  Sorting events' pointers
+    // =========================================================================
+    cofi_reserve_array(events_number,
+                       &config->pointers_sorting_buffer_capacity,
+                       (void **)&config->pointers_sorting_buffer,
+                       sizeof(struct window_event));
+
+    // Without the scratch buffer the radix sort tries to allocate its own, if
+    // that fails as well we resort to qsort
+    const enum radix_sort_error_t sorting_result = radix_sort_timestamps(pointers_events_input,
+                                                                         events_number,
+                                                                         sizeof(struct window_event),
+                                                                         offsetof(struct window_event, timestamp),
+                                                                         config->pointers_sorting_buffer);
+
+    if (sorting_result != RADIX_SORT_OK)
+    {
+        qsort(pointers_events_input, events_number, sizeof(struct window_event), cofi_compare_events);
+    }
+
+    size_t coincidences_number = 0;
+
+    // If the whole message is older than the searched events by more than
+    // the coincidence window, the digitizer was restarted and the window
+    // starts from scratch.
+    if (events_number > 0 && window_is_restart(window, settings, pointers_events_input[events_number - 1].timestamp))
+    {
+        printf("WARNING: Timestamps jumped back, flushing the coincidence window (restart)\n");
+
+        coincidences_number += window_search(window, settings, true, &config->output_coincidences, verbosity);
+        window_release(window, settings, true, &config->output_anticoincidences);
+
+        window->newest_timestamp = 0;
+        window->processed_any = false;
+        window->restarts += 1;
+
+        cofi_send_output(config->anticoincidences_socket, batch->type, &config->output_anticoincidences, "anticoincidences", verbosity);
+    }
+
+    // The late events are a prefix of the sorted events, they can only be
+    // anticoincidences
+    size_t late_number = 0;
+
+    while (late_number < events_number && window_is_late(window, settings, pointers_events_input[late_number].timestamp))
+    {
+        if (settings->enable_anticoincidences)
+        {
+            const struct window_event pointer_event = pointers_events_input[late_number];
+
+            cofi_output_append(&config->output_anticoincidences, batch->buffer + pointer_event.index, pointer_event.size);
+        }
+
+        late_number += 1;
+    }
+
+    if (late_number > 0)
+    {
+        window->late_events += late_number;
+
+        if (verbosity > 0)
+        {
+            printf("WARNING: Late events: %zu; total late events: %zu\n", late_number, window->late_events);
+        }
+    }
+
+    // =========================================================================
+    //  Coincidences determination
+    // =========================================================================
+    if (late_number < events_number)
+    {
+        if (window_add_message(window, batch->buffer, batch->size, pointers_events_input + late_number, events_number - late_number))
+        {
+            // The buffer is released by the window
+            batch->buffer = NULL;
+        }
+        else
+        {
+            printf("ERROR: cofi: Unable to allocate the coincidence window buffers, the message is lost\n");
+        }
+    }
+
+    coincidences_number += window_search(window, settings, false, &config->output_coincidences, verbosity);
+    const size_t released_number = window_release(window, settings, false, &config->output_anticoincidences);
+
+    if (verbosity > 1)
+    {
+        printf("cofi: events_number: %zu; coincidences_number: %zu; output_size: %zu; window events: %zu; released events: %zu; window messages: %zu;\n",
+               events_number, coincidences_number, config->output_coincidences.size, window->events_number, released_number, window->messages_number);
+    }
+
+    cofi_send_output(config->anticoincidences_socket, batch->type, &config->output_anticoincidences, "anticoincidences", verbosity);
+
+    cofi_give_output(config, window, batch);
+
+    return true;
+}
+
+//! Searches the events left in the window
+extern inline
+bool cofi_flush(struct filter_batch *batch, void *user_config)
+{
+    struct cofi_config *config = user_config;
+
+    struct coincidence_window *window = (batch->type == FILTER_EVENTS) ? &config->window_events : &config->window_waveforms;
+
+    window_search(window, &config->settings, true, &config->output_coincidences, config->verbosity);
+    window_release(window, &config->settings, true, &config->output_anticoincidences);
+
+    cofi_send_output(config->anticoincidences_socket, batch->type, &config->output_anticoincidences, "anticoincidences", config->verbosity);
+
+    if (config->verbosity > 0)
+    {
+        printf("cofi: %s: late events: %zu; restarts: %zu\n", (batch->type == FILTER_EVENTS) ? "Events" : "Waveforms", window->late_events, window->restarts);
+    }
+
+    cofi_give_output(config, window, batch);
+
+    return true;
+}
+
+static const struct filter_plugin cofi_plugin = {
+    "cofi",
+    true,
+    true,
+    cofi_init,
+    cofi_process,
+    cofi_flush,
+    cofi_close
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef __ENFI_PLUGIN_H__
+#define __ENFI_PLUGIN_H__ 1
+
+// Energy filter, it selects the events with min_energy <= qlong < max_energy.
+//
+// Configuration:
+//   "min_energy": minimum energy in ADC samples
+//   "max_energy": maximum energy in ADC samples
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <jansson.h>
+
+#include "defaults.h"
+#include "events.h"
+#include "filter_plugin.h"
+#include "filter_kernels.h"
+
+struct enfi_config
+{
+    float min_energy;
+    float max_energy;
+    struct filter_energy_window window;
+    unsigned int verbosity;
+};
+
+extern inline
+bool enfi_init(json_t *json_config, void *zmq_context, unsigned int verbosity, void **user_config)
+{
+    (void)zmq_context;
+
+    struct enfi_config *config = calloc(1, sizeof(struct enfi_config));
+
+    if (!config)
+    {
+        printf("ERROR: enfi: Unable to allocate the configuration\n");
+
+        return false;
+    }
+
+    config->min_energy = filter_read_number(json_config, "min_energy", defaults_enfi_min_energy);
+    config->max_energy = filter_read_number(json_config, "max_energy", defaults_enfi_max_energy);
+    config->window = filter_energy_window_from(config->min_energy, config->max_energy);
+    config->verbosity = verbosity;
+
+    if (verbosity > 0)
+    {
+        printf("enfi: Minimum energy: %f\n", config->min_energy);
+        printf("enfi: Maximum energy: %f\n", config->max_energy);
+        printf("enfi: Selected qlong: [%" PRIu32 ", %" PRIu32 ")\n", config->window.min, config->window.min + config->window.width);
+    }
+
+    (*user_config) = config;
+
+    return true;
+}
+
+//! The selected events are compacted at the beginning of the buffer
+extern inline
+bool enfi_process(struct filter_batch *batch, void *user_config)
+{
+    const struct enfi_config *config = user_config;
+
+    if ((batch->size % sizeof(struct event_PSD)) != 0)
+    {
+        printf("ERROR: enfi: The buffer size is not a multiple of %zu\n", sizeof(struct event_PSD));
+
+        return false;
+    }
+
+    const size_t events_number = batch->size / sizeof(struct event_PSD);
+
+    const size_t selected_number = filter_select_energy((struct event_PSD *)batch->buffer, events_number, config->window);
+
+    if (config->verbosity > 1)
+    {
+        printf("enfi: events_number: %zu; selected_number: %zu\n", events_number, selected_number);
+    }
+
+    batch->size = selected_number * sizeof(struct event_PSD);
+
+    return true;
+}
+
+extern inline
+void enfi_close(void *user_config)
+{
+    free(user_config);
+}
+
+static const struct filter_plugin enfi_plugin = {
+    "enfi",
+    true,
+    false,
+    enfi_init,
+    enfi_process,
+    NULL,
+    enfi_close
+};
+
+#endif
@@ -0,0 +1,499 @@
+#ifndef __FILTER_CHAIN_H__
+#define __FILTER_CHAIN_H__ 1
+
+// Host of a chain of filters, that runs in the same process.
+//
+// The host receives the data messages and runs the filters of the chain back
+// to back on the same buffer, then it publishes the result. The filters are
+// defined by a JSON array, each element is the configuration of a filter with
+// the name of the filter in the "filter" key, e.g.:
+//
+//   [
+//     { "filter": "chafi", "channels": [0, 1] },
+//     { "filter": "enfi", "min_energy": 400, "max_energy": 60000 }
+//   ]
+//
+// The standalone filters are chains with a single filter.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <zmq.h>
+#include <jansson.h>
+
+#include "defaults.h"
+#include "events.h"
+#include "socket_functions.h"
+#include "files_functions.h"
+#include "filter_plugin.h"
+
+struct filter_chain_settings
+{
+    // The input address may also be a file, with the form 'file://<path_to_file>'
+    const char *input_address;
+    const char *output_address;
+    const char *subscribe_topic;
+    unsigned int base_period;
+    // Number of events in the messages read from an ade file
+    size_t ade_buffer_size;
+    // The messages that are not data are forwarded to the output
+    bool forward_unknown;
+    // The topics carry the sequence number of the message of their data type,
+    // as in 'data_abcd_events_v0_n<msg_ID>_s<size>'
+    bool numbered_topics;
+    unsigned int verbosity;
+    // Set by the signal handler of the program to stop the chain
+    unsigned int *terminate_flag;
+};
+
+struct filter_stage
+{
+    const struct filter_plugin *plugin;
+    void *user_config;
+};
+
+extern inline
+const struct filter_plugin *filter_chain_find_plugin(const char *name, const struct filter_plugin *plugins[], size_t plugins_number)
+{
+    for (size_t i = 0; i < plugins_number; i++)
+    {
+        if (strcmp(plugins[i]->name, name) == 0)
+        {
+            return plugins[i];
+        }
+    }
+
+    return NULL;
+}
+
+//! Initializes the filters of the chain, on failure the filters that were
+//! already initialized are closed and zero is returned.
+//! Returns the number of stages.
+extern inline
+size_t filter_chain_init(json_t *json_chain, const struct filter_plugin *plugins[], size_t plugins_number,
+                         void *zmq_context, unsigned int verbosity, struct filter_stage **stages)
+{
+    if (!json_is_array(json_chain) || json_array_size(json_chain) == 0)
+    {
+        printf("ERROR: The filters chain should be a non-empty array\n");
+
+        return 0;
+    }
+
+    const size_t stages_number = json_array_size(json_chain);
+
+    (*stages) = calloc(stages_number, sizeof(struct filter_stage));
+
+    if (!(*stages))
+    {
+        printf("ERROR: Unable to allocate the filters chain\n");
+
+        return 0;
+    }
+
+    size_t index;
+    json_t *json_stage;
+
+    json_array_foreach(json_chain, index, json_stage)
+    {
+        const char *name = json_string_value(json_object_get(json_stage, "filter"));
+        const struct filter_plugin *plugin = (name) ? filter_chain_find_plugin(name, plugins, plugins_number) : NULL;
+
+        if (!plugin)
+        {
+            printf("ERROR: Unknown filter in stage %zu: %s\n", index, (name) ? name : "(missing)");
+        }
+        else if (!plugin->init(json_stage, zmq_context, verbosity, &(*stages)[index].user_config))
+        {
+            printf("ERROR: Unable to initialize filter in stage %zu: %s\n", index, name);
+        }
+        else
+        {
+            (*stages)[index].plugin = plugin;
+
+            if (verbosity > 0)
+            {
+                printf("Stage %zu: %s\n", index, name);
+            }
+
+            continue;
+        }
+
+        for (size_t i = 0; i < index; i++)
+        {
+            (*stages)[i].plugin->close((*stages)[i].user_config);
+        }
+
+        free(*stages);
+        (*stages) = NULL;
+
+        return 0;
+    }
+
+    return stages_number;
+}
+
+//! Runs the batch through the stages from first_stage to the end of the chain.
+//! The batches that are emptied or that are not accepted by a filter are
+//! dropped. Returns true if there is something to send.
+extern inline
+bool filter_chain_process(struct filter_stage *stages, size_t stages_number, size_t first_stage,
+                          struct filter_batch *batch, unsigned int verbosity)
+{
+    for (size_t i = first_stage; i < stages_number && batch->size > 0; i++)
+    {
+        const struct filter_plugin *plugin = stages[i].plugin;
+
+        if (!filter_accepts(plugin, batch->type))
+        {
+            if (verbosity > 1)
+            {
+                printf("Stage %zu (%s): dropping unsupported data type\n", i, plugin->name);
+            }
+
+            batch->size = 0;
+        }
+        else
+        {
+            const size_t input_size = batch->size;
+
+            if (!plugin->process(batch, stages[i].user_config))
+            {
+                printf("ERROR: Stage %zu (%s): unable to process the batch, dropping it\n", i, plugin->name);
+
+                batch->size = 0;
+            }
+
+            if (verbosity > 1)
+            {
+                printf("Stage %zu (%s): input size: %zu; output size: %zu\n", i, plugin->name, input_size, batch->size);
+            }
+        }
+    }
+
+    return batch->size > 0;
+}
+
+//! Publishes the batch, msg_IDs holds the sequence numbers of the events and
+//! of the waveforms messages, that are updated
+extern inline
+void filter_chain_send(void *output_socket, const struct filter_batch *batch, bool numbered_topics, size_t msg_IDs[2], unsigned int verbosity)
+{
+    char new_topic[defaults_all_topic_buffer_size];
+
+    const char *type_name = (batch->type == FILTER_EVENTS) ? "events" : "waveforms";
+    size_t *msg_ID = &msg_IDs[(batch->type == FILTER_EVENTS) ? 0 : 1];
+
+    if (numbered_topics)
+    {
+        snprintf(new_topic, defaults_all_topic_buffer_size, "data_abcd_%s_v0_n%zu_s%zu", type_name, *msg_ID, batch->size);
+    }
+    else
+    {
+        snprintf(new_topic, defaults_all_topic_buffer_size, "data_abcd_%s_v0_s%zu", type_name, batch->size);
+    }
+
+    (*msg_ID) += 1;
+
+    send_byte_message(output_socket, new_topic, (void *)batch->buffer, batch->size, 0);
+
+    if (verbosity > 0)
+    {
+        printf("Sending message with topic: %s\n", new_topic);
+    }
+}
+
+//! Runs the chain until the terminate flag is set, or until the end of the
+//! input file. Returns EXIT_SUCCESS or EXIT_FAILURE, as the main functions.
+extern inline
+int filter_chain_run(const struct filter_chain_settings *settings, json_t *json_chain,
+                     const struct filter_plugin *plugins[], size_t plugins_number)
+{
+    const unsigned int verbosity = settings->verbosity;
+
+    const enum input_sources_t input_source = get_input_source_type(settings->input_address);
+
+    char *input_filename = NULL;
+    size_t ade_buffer_size = 0;
+
+    get_filename_and_buffersize(settings->input_address, &input_filename, &ade_buffer_size);
+
+    ade_buffer_size = (ade_buffer_size != 0) ? ade_buffer_size : settings->ade_buffer_size;
+
+    if (verbosity > 0)
+    {
+        if (input_source == SOCKET_INPUT)
+        {
+            printf("Input socket address: %s\n", settings->input_address);
+        }
+        else
+        {
+            printf("Input file name: %s (buffer size: %zu)\n", input_filename, ade_buffer_size);
+        }
+
+        printf("Output socket address: %s\n", settings->output_address);
+        printf("Verbosity: %u\n", verbosity);
+        printf("Base period: %u\n", settings->base_period);
+    }
+
+    // Creates a ZeroMQ context
+    void *context = zmq_ctx_new();
+    if (!context)
+    {
+        printf("ERROR: ZeroMQ Error on context creation");
+        return EXIT_FAILURE;
+    }
+
+    // The filters may create their own sockets with the context
+    struct filter_stage *stages = NULL;
+    const size_t stages_number = filter_chain_init(json_chain, plugins, plugins_number, context, verbosity, &stages);
+
+    if (stages_number == 0)
+    {
+        free(input_filename);
+        zmq_ctx_destroy(context);
+        return EXIT_FAILURE;
+    }
+
+    // Creating an input_socket even if we are going to read data from a
+    // file, it should not hurt and it makes things easier
+    void *input_socket = zmq_socket(context, ZMQ_SUB);
+    if (!input_socket)
+    {
+        printf("ERROR: ZeroMQ Error on input socket creation\n");
+        return EXIT_FAILURE;
+    }
+
+    void *output_socket = zmq_socket(context, ZMQ_PUB);
+    if (!output_socket)
+    {
+        printf("ERROR: ZeroMQ Error on output socket creation\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *input_file = NULL;
+
+    if (input_source == SOCKET_INPUT)
+    {
+        const int is = zmq_connect(input_socket, settings->input_address);
+        if (is != 0)
+        {
+            printf("ERROR: ZeroMQ Error on input socket connection: %s\n", zmq_strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        // Subscribe to data topic
+        zmq_setsockopt(input_socket, ZMQ_SUBSCRIBE, settings->subscribe_topic, strlen(settings->subscribe_topic));
+    }
+    else
+    {
+        input_file = fopen(input_filename, "rb");
+
+        if (!input_file)
+        {
+            printf("ERROR: Error on opening file %s: %s\n", input_filename, zmq_strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    free(input_filename);
+
+    const int os = zmq_bind(output_socket, settings->output_address);
+    if (os != 0)
+    {
+        printf("ERROR: ZeroMQ Error on output socket binding: %s\n", zmq_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // Wait a bit to prevent the slow-joiner syndrome
+    struct timespec slow_joiner_wait;
+    slow_joiner_wait.tv_sec = defaults_all_slow_joiner_wait / 1000;
+    slow_joiner_wait.tv_nsec = (defaults_all_slow_joiner_wait % 1000) * 1000000L;
+    nanosleep(&slow_joiner_wait, NULL);
+
+    // Setting up the wait for the main loop
+    struct timespec wait;
+    wait.tv_sec = settings->base_period / 1000;
+    wait.tv_nsec = (settings->base_period % 1000) * 1000000L;
+
+    size_t counter = 0;
+    size_t msg_counter = 0;
+    size_t msg_ID = 0;
+    // The sequence numbers of the events and of the waveforms messages
+    size_t msg_IDs[2] = {0, 0};
+
+    while (*settings->terminate_flag == 0)
+    {
+        char *topic;
+        uint8_t *input_buffer;
+        size_t size;
+
+        int result = EXIT_FAILURE;
+
+        if (input_source == RAW_FILE_INPUT)
+        {
+            result = read_byte_message_from_adr(input_file, &topic, (void **)(&input_buffer), &size, true, 0);
+        }
+        else if (input_source == EVENTS_FILE_INPUT)
+        {
+            size = ade_buffer_size * sizeof(struct event_PSD);
+            result = read_byte_message_from_ade(input_file, &topic, (void **)(&input_buffer), &size, true, 0);
+        }
+        else
+        {
+            result = receive_byte_message(input_socket, &topic, (void **)(&input_buffer), &size, true, 0);
+        }
+
+        if (result == EXIT_FAILURE)
+        {
+            printf("[%zu] ERROR: Some error occurred while receiving messages!!!\n", counter);
+
+            if (input_source != SOCKET_INPUT)
+            {
+                *settings->terminate_flag = 1;
+            }
+        }
+        else if (size == 0 && result == EXIT_SUCCESS)
+        {
+            if (verbosity > 3)
+            {
+                printf("[%zu] No message available\n", counter);
+            }
+        }
+        else if (size > 0 && result == EXIT_SUCCESS)
+        {
+            if (verbosity > 0)
+            {
+                printf("[%zu] Message received!!! (topic: %s)\n", counter, topic);
+            }
+
+            struct filter_batch batch = {filter_data_type(topic), input_buffer, size};
+
+            if (batch.type == FILTER_NO_DATA)
+            {
+                if (settings->forward_unknown)
+                {
+                    if (verbosity > 0)
+                    {
+                        printf("WARNING: Forwarding unknown message\n");
+                    }
+
+                    send_byte_message(output_socket, topic, (void *)batch.buffer, batch.size, 0);
+                }
+            }
+            else
+            {
+                const clock_t chain_start = clock();
+
+                if (filter_chain_process(stages, stages_number, 0, &batch, verbosity))
+                {
+                    filter_chain_send(output_socket, &batch, settings->numbered_topics, msg_IDs, verbosity);
+                    msg_ID += 1;
+                }
+
+                const clock_t chain_stop = clock();
+
+                if (verbosity > 0)
+                {
+                    const float elaboration_time = (float)(chain_stop - chain_start) / CLOCKS_PER_SEC * 1000;
+                    const float elaboration_speed = size / elaboration_time * 1000.0 / 1024.0 / 1024.0;
+
+                    printf("size: %zu; output_size: %zu; ratio: %.2f%%; elaboration_time: %f ms; elaboration_speed: %f MBi/s\n", size, batch.size, batch.size / (float)size * 100, elaboration_time, elaboration_speed);
+                }
+            }
+
+            msg_counter += 1;
+
+            // Remember to free buffers, the filters might have replaced the
+            // input buffer
+            free(topic);
+            free(batch.buffer);
+        }
+        else
+        {
+            printf("[%zu] ERROR: What?!?!?!\n", counter);
+        }
+
+        counter += 1;
+
+        // Putting a delay in order not to fill-up the queues
+        nanosleep(&wait, NULL);
+
+        if (verbosity > 3)
+        {
+            printf("counter: %zu; msg_counter: %zu, msg_ID: %zu\n", counter, msg_counter, msg_ID);
+        }
+    }
+
+    // =========================================================================
+    //  Closing up
+    // =========================================================================
+
+    // The events held by a filter are flushed through the following filters
+    const enum filter_data_types types[2] = {FILTER_EVENTS, FILTER_WAVEFORMS};
+
+    for (size_t i = 0; i < stages_number; i++)
+    {
+        for (size_t t = 0; t < 2 && stages[i].plugin->flush; t++)
+        {
+            if (!filter_accepts(stages[i].plugin, types[t]))
+            {
+                continue;
+            }
+
+            struct filter_batch batch = {types[t], NULL, 0};
+
+            if (stages[i].plugin->flush(&batch, stages[i].user_config) &&
+                filter_chain_process(stages, stages_number, i + 1, &batch, verbosity))
+            {
+                filter_chain_send(output_socket, &batch, settings->numbered_topics, msg_IDs, verbosity);
+            }
+
+            free(batch.buffer);
+        }
+    }
+
+    for (size_t i = 0; i < stages_number; i++)
+    {
+        stages[i].plugin->close(stages[i].user_config);
+    }
+
+    free(stages);
+
+    if (input_file)
+    {
+        fclose(input_file);
+    }
+
+    // Wait a bit to allow the sockets to deliver
+    nanosleep(&slow_joiner_wait, NULL);
+
+    const int ic = zmq_close(input_socket);
+    if (ic != 0)
+    {
+        printf("ERROR: ZeroMQ Error on input socket close: %s\n", zmq_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    const int oc = zmq_close(output_socket);
+    if (oc != 0)
+    {
+        printf("ERROR: ZeroMQ Error on output socket close: %s\n", zmq_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    const int cc = zmq_ctx_destroy(context);
+    if (cc != 0)
+    {
+        printf("ERROR: ZeroMQ Error on context destroy: %s\n", zmq_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
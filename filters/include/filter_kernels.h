@@ -0,0 +1,174 @@
+#ifndef __FILTER_KERNELS_H__
+#define __FILTER_KERNELS_H__ 1
+
+// Selection kernels for arrays of event_PSD, the selected events are
+// compacted in place at the beginning of the array.
+//
+// The events are processed in blocks: first the predicate is evaluated for
+// the whole block into an array of flags, with no branches so that the
+// compiler can vectorise the loop, then the block is compacted. A block
+// where all the events are selected is not copied if no event was discarded
+// before it, thus an array where all the events are selected is not written
+// at all. A block where no events are selected is skipped.
+//
+// The energy window is converted to an integer window on qlong, so that the
+// predicate is a single unsigned comparison:
+//
+//   min_energy <= qlong < max_energy  <=>  (qlong - min) < (max - min)
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "events.h"
+
+#define FILTER_KERNEL_BLOCK_SIZE 64
+
+struct filter_energy_window
+{
+    uint32_t min;
+    uint32_t width;
+};
+
+//! Converts a threshold on the energy to the smallest qlong that satisfies
+//! it, the result is in the range [0, UINT16_MAX + 1]
+extern inline
+uint32_t filter_energy_threshold(double energy)
+{
+    if (!(energy > 0))
+    {
+        return 0;
+    }
+    else if (energy > UINT16_MAX)
+    {
+        return UINT16_MAX + 1;
+    }
+    else
+    {
+        return (uint32_t)ceil(energy);
+    }
+}
+
+extern inline
+struct filter_energy_window filter_energy_window_from(double min_energy, double max_energy)
+{
+    struct filter_energy_window window = {0, 0};
+
+    if (isnan(min_energy) || isnan(max_energy))
+    {
+        return window;
+    }
+
+    const uint32_t min = filter_energy_threshold(min_energy);
+    const uint32_t max = filter_energy_threshold(max_energy);
+
+    window.min = min;
+    window.width = (max > min) ? (max - min) : 0;
+
+    return window;
+}
+
+extern inline
+void filter_flags_energy(const struct event_PSD *events, size_t events_number,
+                         struct filter_energy_window window, uint8_t *flags)
+{
+    for (size_t i = 0; i < events_number; i++)
+    {
+        flags[i] = ((uint32_t)events[i].qlong - window.min) < window.width;
+    }
+}
+
+extern inline
+void filter_flags_channels(const struct event_PSD *events, size_t events_number,
+                           const uint64_t channels_mask[4], uint8_t *flags)
+{
+    for (size_t i = 0; i < events_number; i++)
+    {
+        const uint8_t channel = events[i].channel;
+
+        flags[i] = (channels_mask[channel >> 6] >> (channel & 63)) & 1;
+    }
+}
+
+//! Compacts a block of events according to its flags, returns the new
+//! number of selected events
+extern inline
+size_t filter_compact_block(struct event_PSD *events, size_t block_start, size_t block_size,
+                            const uint8_t *flags, size_t selected_number)
+{
+    size_t block_selected = 0;
+
+    for (size_t i = 0; i < block_size; i++)
+    {
+        block_selected += flags[i];
+    }
+
+    if (block_selected == block_size && selected_number == block_start)
+    {
+        // Nothing was discarded up to now, the events are already in place
+        return selected_number + block_size;
+    }
+    else if (block_selected == 0)
+    {
+        return selected_number;
+    }
+
+    for (size_t i = 0; i < block_size; i++)
+    {
+        // The destination never overtakes the source, thus the event can
+        // be always written and the index advanced only if it is selected
+        events[selected_number] = events[block_start + i];
+        selected_number += flags[i];
+    }
+
+    return selected_number;
+}
+
+//! Selects the events with min_energy <= qlong < max_energy,
+//! returns the number of selected events
+extern inline
+size_t filter_select_energy(struct event_PSD *events, size_t events_number,
+                            struct filter_energy_window window)
+{
+    uint8_t flags[FILTER_KERNEL_BLOCK_SIZE];
+
+    size_t selected_number = 0;
+
+    for (size_t block_start = 0; block_start < events_number; block_start += FILTER_KERNEL_BLOCK_SIZE)
+    {
+        const size_t remaining = events_number - block_start;
+        const size_t block_size = (remaining < FILTER_KERNEL_BLOCK_SIZE) ? remaining : FILTER_KERNEL_BLOCK_SIZE;
+
+        filter_flags_energy(events + block_start, block_size, window, flags);
+
+        selected_number = filter_compact_block(events, block_start, block_size, flags, selected_number);
+    }
+
+    return selected_number;
+}
+
+//! Selects the events whose channel is set in the 256-bit channels mask,
+//! returns the number of selected events
+extern inline
+size_t filter_select_channels(struct event_PSD *events, size_t events_number,
+                              const uint64_t channels_mask[4])
+{
+    uint8_t flags[FILTER_KERNEL_BLOCK_SIZE];
+
+    size_t selected_number = 0;
+
+    for (size_t block_start = 0; block_start < events_number; block_start += FILTER_KERNEL_BLOCK_SIZE)
+    {
+        const size_t remaining = events_number - block_start;
+        const size_t block_size = (remaining < FILTER_KERNEL_BLOCK_SIZE) ? remaining : FILTER_KERNEL_BLOCK_SIZE;
+
+        filter_flags_channels(events + block_start, block_size, channels_mask, flags);
+
+        selected_number = filter_compact_block(events, block_start, block_size, flags, selected_number);
+    }
+
+    return selected_number;
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef __FILTER_PLUGIN_H__
+#define __FILTER_PLUGIN_H__ 1
+
+// Interface of the filters that can be chained in the same process.
+//
+// A filter is defined by a filter_plugin structure, that holds its name and
+// the functions that are called by the host:
+//
+// - init: reads the configuration of the filter from a json_t object, as
+//   defined in the jansson library, and allocates the state of the filter.
+//   The json_t object is destroyed after the call, so the filter shall copy
+//   the values that it needs. The ZeroMQ context of the host is given to the
+//   filters that open their own sockets.
+//   Returns false if the configuration is not valid.
+// - process: filters a batch of events. The filter may modify the buffer of
+//   the batch in place, e.g. compacting the selected events at its beginning
+//   and reducing the size, or it may replace the buffer with a new one. In the
+//   latter case the filter becomes the owner of the previous buffer and it
+//   shall free it, or keep it for later, while the host becomes the owner of
+//   the new buffer. A batch with a zero size is not passed to the following
+//   filters.
+// - flush: optional, called at the end of the run for each data type to get
+//   the events still held by the filter. The batch is empty when the function
+//   is called and the filter may give it a new buffer.
+// - close: frees the state of the filter.
+//
+// The host calls process only for the data types that the filter accepts,
+// the batches of the other types are dropped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <jansson.h>
+
+#include "events.h"
+
+enum filter_data_types
+{
+    FILTER_NO_DATA = 0,
+    FILTER_EVENTS = 1,
+    FILTER_WAVEFORMS = 2
+};
+
+struct filter_batch
+{
+    enum filter_data_types type;
+    // The buffer is allocated with malloc() and it is owned by the host
+    uint8_t *buffer;
+    size_t size;
+};
+
+typedef bool (*filter_init_fn)(json_t *json_config, void *zmq_context, unsigned int verbosity, void **user_config);
+typedef bool (*filter_process_fn)(struct filter_batch *batch, void *user_config);
+typedef bool (*filter_flush_fn)(struct filter_batch *batch, void *user_config);
+typedef void (*filter_close_fn)(void *user_config);
+
+struct filter_plugin
+{
+    const char *name;
+    bool accepts_events;
+    bool accepts_waveforms;
+
+    filter_init_fn init;
+    filter_process_fn process;
+    filter_flush_fn flush;
+    filter_close_fn close;
+};
+
+extern inline
+enum filter_data_types filter_data_type(const char *topic)
+{
+    if (strstr(topic, "data_abcd_events_v0") == topic)
+    {
+        return FILTER_EVENTS;
+    }
+    else if (strstr(topic, "data_abcd_waveforms_v0") == topic)
+    {
+        return FILTER_WAVEFORMS;
+    }
+    else
+    {
+        return FILTER_NO_DATA;
+    }
+}
+
+extern inline
+bool filter_accepts(const struct filter_plugin *plugin, enum filter_data_types type)
+{
+    return (type == FILTER_EVENTS && plugin->accepts_events) ||
+           (type == FILTER_WAVEFORMS && plugin->accepts_waveforms);
+}
+
+//! Size of the serialized event_waveform that starts at the given position
+extern inline
+size_t filter_waveform_size(const uint8_t *event)
+{
+    uint32_t samples_number;
+    uint8_t gates_number;
+
+    memcpy(&samples_number, event + 9, sizeof(samples_number));
+    memcpy(&gates_number, event + 13, sizeof(gates_number));
+
+    return waveform_header_size() + samples_number * sizeof(uint16_t) + gates_number * samples_number * sizeof(uint8_t);
+}
+
+//! Reads the channel list of a filter configuration, that may be a single
+//! integer or an array of integers, to a bitmask of the channels.
+//! Returns the number of valid channels.
+extern inline
+size_t filter_read_channels(json_t *json_channels, uint64_t channels_mask[4])
+{
+    memset(channels_mask, 0, 4 * sizeof(uint64_t));
+
+    size_t channels_number = 0;
+
+    if (json_is_integer(json_channels))
+    {
+        const json_int_t channel = json_integer_value(json_channels);
+
+        if (0 <= channel && channel <= UINT8_MAX)
+        {
+            channels_mask[channel / 64] |= UINT64_C(1) << (channel % 64);
+            channels_number += 1;
+        }
+        else
+        {
+            printf("WARNING: Invalid channel: %" JSON_INTEGER_FORMAT "\n", channel);
+        }
+    }
+    else if (json_is_array(json_channels))
+    {
+        size_t index;
+        json_t *value;
+
+        json_array_foreach(json_channels, index, value)
+        {
+            const json_int_t channel = json_is_integer(value) ? json_integer_value(value) : -1;
+
+            if (0 <= channel && channel <= UINT8_MAX)
+            {
+                channels_mask[channel / 64] |= UINT64_C(1) << (channel % 64);
+                channels_number += 1;
+            }
+            else
+            {
+                printf("WARNING: Invalid channel at index: %zu\n", index);
+            }
+        }
+    }
+
+    return channels_number;
+}
+
+extern inline
+bool filter_channel_selected(const uint64_t channels_mask[4], uint8_t channel)
+{
+    return (channels_mask[channel / 64] >> (channel % 64)) & 1;
+}
+
+//! Reads a number from a filter configuration, with a default value
+extern inline
+double filter_read_number(json_t *json_config, const char *key, double default_value)
+{
+    json_t *value = json_object_get(json_config, key);
+
+    return json_is_number(value) ? json_number_value(value) : default_value;
+}
+
+#endif
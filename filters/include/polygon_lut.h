@@ -0,0 +1,316 @@
+#ifndef __POLYGON_LUT_H__
+#define __POLYGON_LUT_H__
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "point_in_polygon.h"
+
+/******************************************************************************/
+/* A polygon lookup table is a grid of cells over the bounding box of a       */
+/* polygon. Each cell is either completely outside, completely inside or it   */
+/* is crossed by an edge of the polygon. Only the points in the edge cells    */
+/* need the exact winding number test, that is computed only with the edges  */
+/* that span the row of the cell.                                             */
+/******************************************************************************/
+enum polygon_lut_cell_t {
+    POLYGON_LUT_OUTSIDE = 0,
+    POLYGON_LUT_INSIDE = 1,
+    POLYGON_LUT_EDGE = 2
+};
+
+struct PolygonLUT_t {
+    struct BoundingBox_t bounding_box;
+    size_t width;
+    size_t height;
+    // Cells per unit along the axes
+    data_type x_scale;
+    data_type y_scale;
+    // Cells stored by rows of width cells, NULL for polygons without area
+    uint8_t *cells;
+    // Indexes of the edges that span each row, the edges of a row are
+    // stored from row_edges[row_offsets[row]] to row_edges[row_offsets[row + 1]]
+    size_t *row_offsets;
+    size_t *row_edges;
+};
+
+extern inline size_t polygon_lut_column(const struct PolygonLUT_t *lut, data_type x)
+{
+    const data_type position = floor((x - lut->bounding_box.top_left.x) * lut->x_scale);
+
+    return (position <= 0) ? 0 : ((position >= lut->width) ? lut->width - 1 : (size_t)position);
+}
+
+extern inline size_t polygon_lut_row(const struct PolygonLUT_t *lut, data_type y)
+{
+    const data_type position = floor((y - lut->bounding_box.bottom_right.y) * lut->y_scale);
+
+    return (position <= 0) ? 0 : ((position >= lut->height) ? lut->height - 1 : (size_t)position);
+}
+
+/******************************************************************************/
+/* compute_polygon_lut(): rasterizes the polygon on a width x height grid     */
+/*                                                                            */
+/*  Input:  polygon[]:  Vertex points of a polygon                            */
+/*                      WARNING: The polygon shall have n+1 points with       */
+/*                      polygon[n] = polygon[0]                               */
+/*          n: the number of points of the polygon, see warning.              */
+/*                                                                            */
+/*  Return: 0 on success, -1 if the cells could not be allocated             */
+/*                                                                            */
+/******************************************************************************/
+extern inline int compute_polygon_lut(struct PolygonLUT_t *lut, struct Point_t *polygon, size_t n, size_t width, size_t height)
+{
+    lut->bounding_box = compute_bounding_box(polygon, n);
+    lut->width = 0;
+    lut->height = 0;
+    lut->x_scale = 0;
+    lut->y_scale = 0;
+    lut->cells = NULL;
+    lut->row_offsets = NULL;
+    lut->row_edges = NULL;
+
+    const data_type bounding_box_width = lut->bounding_box.bottom_right.x - lut->bounding_box.top_left.x;
+    const data_type bounding_box_height = lut->bounding_box.top_left.y - lut->bounding_box.bottom_right.y;
+
+    // No point is inside the bounding box of a polygon without area
+    if (bounding_box_width <= 0 || bounding_box_height <= 0 || width == 0 || height == 0) {
+        return 0;
+    }
+
+    lut->cells = (uint8_t *)calloc(width * height, sizeof(uint8_t));
+    lut->row_offsets = (size_t *)calloc(height + 1, sizeof(size_t));
+
+    if (lut->cells == NULL || lut->row_offsets == NULL) {
+        free(lut->cells);
+        free(lut->row_offsets);
+        lut->cells = NULL;
+        lut->row_offsets = NULL;
+
+        return -1;
+    }
+
+    lut->width = width;
+    lut->height = height;
+    lut->x_scale = width / bounding_box_width;
+    lut->y_scale = height / bounding_box_height;
+
+    // The edges are rasterized column by column, marking the cells between
+    // the extremes of the edge in each column.
+    for (size_t i = 0; i < n; ++i)
+    {
+        const struct Point_t P0 = polygon[i];
+        const struct Point_t P1 = polygon[i + 1];
+
+        const data_type min_x = (P0.x < P1.x) ? P0.x : P1.x;
+        const data_type max_x = (P0.x < P1.x) ? P1.x : P0.x;
+
+        const size_t first_column = polygon_lut_column(lut, min_x);
+        const size_t last_column = polygon_lut_column(lut, max_x);
+
+        for (size_t column = first_column; column <= last_column; ++column)
+        {
+            data_type min_y = (P0.y < P1.y) ? P0.y : P1.y;
+            data_type max_y = (P0.y < P1.y) ? P1.y : P0.y;
+
+            if (P0.x != P1.x) {
+                // Clipping the edge to the column
+                const data_type column_left = lut->bounding_box.top_left.x + column / lut->x_scale;
+                const data_type column_right = lut->bounding_box.top_left.x + (column + 1) / lut->x_scale;
+
+                const data_type left = (min_x > column_left) ? min_x : column_left;
+                const data_type right = (max_x < column_right) ? max_x : column_right;
+
+                const data_type slope = (P1.y - P0.y) / (P1.x - P0.x);
+                const data_type y_left = P0.y + slope * (left - P0.x);
+                const data_type y_right = P0.y + slope * (right - P0.x);
+
+                min_y = (y_left < y_right) ? y_left : y_right;
+                max_y = (y_left < y_right) ? y_right : y_left;
+            }
+
+            const size_t first_row = polygon_lut_row(lut, min_y);
+            const size_t last_row = polygon_lut_row(lut, max_y);
+
+            for (size_t row = first_row; row <= last_row; ++row)
+            {
+                lut->cells[row * width + column] = POLYGON_LUT_EDGE;
+            }
+        }
+    }
+
+    // The edges are listed in the rows that they span, the row of a point is
+    // monotonic with its y, thus the edges crossed by the horizontal line of a
+    // point are certainly listed in its row.
+    // The first pass counts the edges of each row, the second one stores them.
+    for (size_t pass = 0; pass < 2; ++pass)
+    {
+        if (pass == 1) {
+            for (size_t row = 0; row < height; ++row)
+            {
+                lut->row_offsets[row + 1] += lut->row_offsets[row];
+            }
+
+            lut->row_edges = (size_t *)malloc(lut->row_offsets[height] * sizeof(size_t));
+
+            if (lut->row_edges == NULL) {
+                free(lut->cells);
+                free(lut->row_offsets);
+                lut->cells = NULL;
+                lut->row_offsets = NULL;
+
+                return -1;
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const data_type min_y = (polygon[i].y < polygon[i + 1].y) ? polygon[i].y : polygon[i + 1].y;
+            const data_type max_y = (polygon[i].y < polygon[i + 1].y) ? polygon[i + 1].y : polygon[i].y;
+
+            const size_t first_row = polygon_lut_row(lut, min_y);
+            const size_t last_row = polygon_lut_row(lut, max_y);
+
+            for (size_t row = first_row; row <= last_row; ++row)
+            {
+                if (pass == 0) {
+                    lut->row_offsets[row + 1] += 1;
+                } else {
+                    lut->row_edges[lut->row_offsets[row]] = i;
+                    lut->row_offsets[row] += 1;
+                }
+            }
+        }
+    }
+
+    // The second pass moved the offsets to the end of the rows
+    for (size_t row = height; row > 0; --row)
+    {
+        lut->row_offsets[row] = lut->row_offsets[row - 1];
+    }
+    lut->row_offsets[0] = 0;
+
+    // The cells next to the edges are tested exactly as well, so that the
+    // rounding of the coordinates of a point cannot move it to a cell that
+    // was not crossed by the edges. They are marked in a temporary state.
+    const uint8_t near_edge = POLYGON_LUT_EDGE + 1;
+
+    for (size_t row = 0; row < height; ++row)
+    {
+        for (size_t column = 0; column < width; ++column)
+        {
+            if (lut->cells[row * width + column] != POLYGON_LUT_EDGE) {
+                continue;
+            }
+
+            for (size_t r = (row > 0) ? row - 1 : 0; r <= row + 1 && r < height; ++r)
+            {
+                for (size_t c = (column > 0) ? column - 1 : 0; c <= column + 1 && c < width; ++c)
+                {
+                    if (lut->cells[r * width + c] != POLYGON_LUT_EDGE) {
+                        lut->cells[r * width + c] = near_edge;
+                    }
+                }
+            }
+        }
+    }
+
+    // The other cells are completely inside or outside, as their centers
+    for (size_t row = 0; row < height; ++row)
+    {
+        for (size_t column = 0; column < width; ++column)
+        {
+            uint8_t *cell = &lut->cells[row * width + column];
+
+            if (*cell == near_edge) {
+                *cell = POLYGON_LUT_EDGE;
+            } else if (*cell != POLYGON_LUT_EDGE) {
+                struct Point_t center;
+                center.x = lut->bounding_box.top_left.x + (column + 0.5) / lut->x_scale;
+                center.y = lut->bounding_box.bottom_right.y + (row + 0.5) / lut->y_scale;
+
+                *cell = (point_winding_number(center, polygon, n) != 0) ? POLYGON_LUT_INSIDE : POLYGON_LUT_OUTSIDE;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
+/* point_winding_number_row(): winding number test with the edges of a row,   */
+/*                             the same as point_winding_number()             */
+/******************************************************************************/
+extern inline int point_winding_number_row(struct Point_t P, const struct PolygonLUT_t *lut, struct Point_t* polygon, size_t row)
+{
+    int wn = 0;
+
+    for (size_t j = lut->row_offsets[row]; j < lut->row_offsets[row + 1]; ++j)
+    {
+        const size_t i = lut->row_edges[j];
+
+        if (polygon[i].y <= P.y)
+        {
+            if (polygon[i + 1].y > P.y)
+            {
+                if (is_left(polygon[i], polygon[i + 1], P) > 0)
+                {
+                    ++wn;
+                }
+            }
+        }
+        else
+        {
+            if (polygon[i + 1].y  <= P.y)
+            {
+                if (is_left(polygon[i], polygon[i + 1], P) < 0)
+                {
+                    --wn;
+                }
+            }
+        }
+    }
+
+    return wn;
+}
+
+extern inline void free_polygon_lut(struct PolygonLUT_t *lut)
+{
+    free(lut->cells);
+    free(lut->row_offsets);
+    free(lut->row_edges);
+
+    lut->cells = NULL;
+    lut->row_offsets = NULL;
+    lut->row_edges = NULL;
+}
+
+/******************************************************************************/
+/* point_in_polygon_lut(): tests a point using the lookup table, falling back */
+/*                         to the winding number in the edge cells            */
+/*                                                                            */
+/*  Input:  P: the point, it shall be in the bounding box of the table,       */
+/*          lut: the lookup table of the polygon,                             */
+/*          polygon[], n: the polygon, as for point_winding_number()          */
+/*                                                                            */
+/*  Return: 0 only when P is outside                                          */
+/*                                                                            */
+/******************************************************************************/
+extern inline int point_in_polygon_lut(struct Point_t P, const struct PolygonLUT_t *lut, struct Point_t* polygon, size_t n)
+{
+    if (lut->cells == NULL) {
+        return point_winding_number(P, polygon, n);
+    }
+
+    const size_t row = polygon_lut_row(lut, P.y);
+    const uint8_t cell = lut->cells[row * lut->width + polygon_lut_column(lut, P.x)];
+
+    if (cell == POLYGON_LUT_EDGE) {
+        return point_winding_number_row(P, lut, polygon, row);
+    }
+
+    return (cell == POLYGON_LUT_INSIDE);
+}
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef __PUFI_PLUGIN_H__
+#define __PUFI_PLUGIN_H__ 1
+
+// Pulse shape filter, it selects the events inside polygons on the
+// (energy, PSD) plane, with PSD = (qlong - qshort) / qlong.
+// The channels without a polygon are not filtered.
+//
+// Configuration:
+//   "polygons": array of channel configurations, e.g.:
+//               [{ "id": [1, 2], "polygon": [{"x": 0, "y": 0}, {"x": 100, "y": 0}, {"x": 100, "y": 0.5}] }]
+//   "polygons_file": JSON file with the polygons array, used if "polygons" is missing
+//   "lut_size": number of cells per axis of the lookup tables of the polygons
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <jansson.h>
+
+#include "defaults.h"
+#include "events.h"
+#include "point_in_polygon.h"
+#include "polygon_lut.h"
+#include "filter_plugin.h"
+
+struct pufi_config
+{
+    struct Point_t *all_polygons[ABCD_MAX_NUMBER_OF_CHANNELS];
+    struct PolygonLUT_t all_luts[ABCD_MAX_NUMBER_OF_CHANNELS];
+    size_t all_number_of_points[ABCD_MAX_NUMBER_OF_CHANNELS];
+    unsigned int verbosity;
+};
+
+extern inline
+void pufi_close(void *user_config)
+{
+    struct pufi_config *config = user_config;
+
+    for (int channel = 0; channel < ABCD_MAX_NUMBER_OF_CHANNELS; channel += 1)
+    {
+        if (config->all_polygons[channel] != NULL)
+        {
+            free(config->all_polygons[channel]);
+            free_polygon_lut(&config->all_luts[channel]);
+        }
+    }
+
+    free(config);
+}
+
+//! Reads the polygons array, returns the number of valid configurations
+extern inline
+size_t pufi_read_polygons(json_t *json_polygons, size_t lut_size, struct pufi_config *config)
+{
+    const unsigned int verbosity = config->verbosity;
+
+    size_t polygons_counter = 0;
+    size_t index;
+    json_t *value;
+
+    json_array_foreach(json_polygons, index, value) {
+        // The id may be a single integer or an array of integers
+        json_t *json_id = json_object_get(value, "id");
+
+        unsigned int channel_ids[ABCD_MAX_NUMBER_OF_CHANNELS];
+        unsigned int channel_ids_counter = 0;
+
+        if (json_id != NULL && json_is_integer(json_id)) {
+            const int id = json_number_value(json_id);
+
+            if (0 <= id && id < ABCD_MAX_NUMBER_OF_CHANNELS) {
+                channel_ids[channel_ids_counter] = id;
+                channel_ids_counter += 1;
+
+                if (verbosity > 0)
+                {
+                    printf("Found single channel %d\n", id);
+                }
+            } else {
+                printf("ERROR: Channel ids out of range, got: %d, skipping it\n", id);
+            }
+        } else if (json_id != NULL && json_is_array(json_id)) {
+            size_t id_index;
+            json_t *id_value;
+
+            json_array_foreach(json_id, id_index, id_value) {
+                if (id_value != NULL && json_is_integer(id_value) && channel_ids_counter < ABCD_MAX_NUMBER_OF_CHANNELS) {
+                    const int id = json_number_value(id_value);
+
+                    if (0 <= id && id < ABCD_MAX_NUMBER_OF_CHANNELS) {
+                        channel_ids[channel_ids_counter] = id;
+                        channel_ids_counter += 1;
+
+                        if (verbosity > 0)
+                        {
+                            printf("Found channel %d\n", id);
+                        }
+                    } else {
+                        printf("ERROR: Channel id out of range, got: %d, skipping it\n", id);
+                    }
+                }
+            }
+        } else {
+            printf("ERROR: Unable to find channel id, skipping this configuration\n");
+            continue;
+        }
+
+        json_t *json_polygon = json_object_get(value, "polygon");
+
+        if (!json_is_array(json_polygon))
+        {
+            printf("ERROR: The polygon definition should be an array, skipping this configuration\n");
+            continue;
+        }
+
+        const size_t number_of_points = json_array_size(json_polygon);
+
+        if (number_of_points < 3)
+        {
+            printf("ERROR: Polygon for has less than 3 points, skipping this configuration\n");
+            continue;
+        }
+
+        for (unsigned int id_index = 0; id_index < channel_ids_counter; id_index += 1) {
+            // Recreating the polygon for all the channels so there would
+            // not be a double free for repeated channels
+            struct Point_t *polygon = (struct Point_t *)calloc((number_of_points + 1), sizeof(struct Point_t));
+
+            if (polygon == NULL)
+            {
+                printf("ERROR: Unable to allocate memory for polygon\n");
+                continue;
+            }
+
+            size_t index;
+            json_t *json_point;
+
+            json_array_foreach(json_polygon, index, json_point) {
+                polygon[index].x = json_number_value(json_object_get(json_point, "x"));
+                polygon[index].y = json_number_value(json_object_get(json_point, "y"));
+            }
+
+            // Close the loop
+            polygon[number_of_points].x = polygon[0].x;
+            polygon[number_of_points].y = polygon[0].y;
+
+            // The lookup table is computed over the bounding box of the
+            // polygon, so that most of the events are classified without
+            // computing the winding number
+            struct PolygonLUT_t lut;
+
+            if (compute_polygon_lut(&lut, polygon, number_of_points, lut_size, lut_size) != 0)
+            {
+                printf("ERROR: Unable to allocate memory for polygon lookup table\n");
+                free(polygon);
+                continue;
+            }
+
+            unsigned int channel = channel_ids[id_index];
+
+            // A channel repeated in the configuration takes the last polygon
+            if (config->all_polygons[channel] != NULL)
+            {
+                free(config->all_polygons[channel]);
+                free_polygon_lut(&config->all_luts[channel]);
+            }
+
+            config->all_polygons[channel] = polygon;
+            config->all_luts[channel] = lut;
+            config->all_number_of_points[channel] = number_of_points;
+
+            if (verbosity > 0)
+            {
+                printf("Loaded polygon for channel %u with %zu points\n", channel, number_of_points);
+            }
+        }
+
+        polygons_counter++;
+    }
+
+    return polygons_counter;
+}
+
+extern inline
+bool pufi_init(json_t *json_config, void *zmq_context, unsigned int verbosity, void **user_config)
+{
+    (void)zmq_context;
+
+    struct pufi_config *config = calloc(1, sizeof(struct pufi_config));
+
+    if (!config)
+    {
+        printf("ERROR: pufi: Unable to allocate the configuration\n");
+
+        return false;
+    }
+
+    config->verbosity = verbosity;
+
+    const size_t lut_size = filter_read_number(json_config, "lut_size", defaults_pufi_lut_size);
+
+    json_t *json_polygons = json_incref(json_object_get(json_config, "polygons"));
+
+    if (!json_polygons)
+    {
+        const char *polygon_file_name = json_string_value(json_object_get(json_config, "polygons_file"));
+
+        if (!polygon_file_name)
+        {
+            printf("ERROR: pufi: The polygons are not defined\n");
+
+            pufi_close(config);
+
+            return false;
+        }
+
+        json_error_t error;
+        json_polygons = json_load_file(polygon_file_name, 0, &error);
+
+        if (!json_polygons)
+        {
+            printf("ERROR: Parse error while reading polygon file: %s (source: %s, line: %d, column: %d, position: %d)\n", error.text, error.source, error.line, error.column, error.position);
+
+            pufi_close(config);
+
+            return false;
+        }
+    }
+
+    if (!json_is_array(json_polygons))
+    {
+        printf("ERROR: The polygons definition does not contain a single array\n");
+
+        json_decref(json_polygons);
+        pufi_close(config);
+
+        return false;
+    }
+
+    const size_t polygons_counter = pufi_read_polygons(json_polygons, lut_size, config);
+
+    json_decref(json_polygons);
+
+    if (polygons_counter == 0)
+    {
+        printf("ERROR: No valid polygons loaded\n");
+
+        pufi_close(config);
+
+        return false;
+    }
+
+    if (verbosity > 0) {
+        printf("Lookup table size: %zu x %zu\n", lut_size, lut_size);
+        printf("Number of polygons: %zu\n", polygons_counter);
+    }
+
+    if (verbosity > 1) {
+        for (size_t channel = 0; channel < ABCD_MAX_NUMBER_OF_CHANNELS; channel += 1)
+        {
+            if (config->all_polygons[channel] != NULL) {
+                const struct PolygonLUT_t *lut = &config->all_luts[channel];
+
+                printf("Channel %zu\n", channel);
+
+                for (size_t index_point = 0; index_point < config->all_number_of_points[channel] + 1; index_point++)
+                {
+                    printf("[i: %zu] point x: %f; y: %f;\n", index_point, config->all_polygons[channel][index_point].x, config->all_polygons[channel][index_point].y);
+                }
+                printf("Bounding box: x: [%f, %f]; y: [%f, %f];\n", lut->bounding_box.top_left.x,
+                                                                    lut->bounding_box.bottom_right.x,
+                                                                    lut->bounding_box.bottom_right.y,
+                                                                    lut->bounding_box.top_left.y);
+
+                size_t edge_cells = 0;
+
+                for (size_t cell = 0; cell < lut->width * lut->height; cell++)
+                {
+                    edge_cells += (lut->cells[cell] == POLYGON_LUT_EDGE);
+                }
+
+                printf("Lookup table: %zu x %zu; edge cells: %zu;\n", lut->width, lut->height, edge_cells);
+            }
+        }
+    }
+
+    (*user_config) = config;
+
+    return true;
+}
+
+//! The selected events are compacted at the beginning of the buffer
+extern inline
+bool pufi_process(struct filter_batch *batch, void *user_config)
+{
+    const struct pufi_config *config = user_config;
+    const unsigned int verbosity = config->verbosity;
+
+    if ((batch->size % sizeof(struct event_PSD)) != 0)
+    {
+        printf("ERROR: pufi: The buffer size is not a multiple of %zu\n", sizeof(struct event_PSD));
+
+        return false;
+    }
+
+    const size_t events_number = batch->size / sizeof(struct event_PSD);
+
+    size_t bounding_box_selected_number = 0;
+    size_t polygon_selected_number = 0;
+    size_t selected_number = 0;
+
+    struct event_PSD *events = (void *)batch->buffer;
+
+    for (size_t i = 0; i < events_number; i++)
+    {
+        const struct event_PSD this_event = events[i];
+
+        const uint8_t channel = this_event.channel;
+        struct Point_t *polygon = config->all_polygons[channel];
+
+        // Not filtering events without a polygon
+        if (polygon == NULL)
+        {
+            if (verbosity > 2)
+            {
+                printf("Channel %" PRIu8 " has no polygon, keeping it\n", channel);
+            }
+
+            events[selected_number] = this_event;
+
+            selected_number++;
+        } else {
+            // We cast everything to double because the winding algorithm is
+            // expecting two variables of the same type.
+            const double energy = this_event.qlong;
+            const double PSD = (energy - this_event.qshort) / energy;
+            const struct Point_t point = {energy, PSD};
+
+            const struct PolygonLUT_t *lut = &config->all_luts[channel];
+            size_t number_of_points = config->all_number_of_points[channel];
+
+            if (point_in_bounding_box(point, lut->bounding_box))
+            {
+                bounding_box_selected_number++;
+
+                // The result is zero only when the point is outside the polygon
+                const int inside = point_in_polygon_lut(point, lut, polygon, number_of_points);
+
+                if (verbosity > 1)
+                {
+                    printf("Point in bounding box i: %zu; ch: %" PRIu8 "; energy: %f; PSD: %f; inside: %d;\n", i, channel, energy, PSD, inside);
+                }
+
+                if (inside != 0)
+                {
+                    events[selected_number] = this_event;
+
+                    selected_number++;
+                    polygon_selected_number++;
+
+                    if (verbosity > 1)
+                    {
+                        printf("Point selected!!!\n");
+                    }
+                }
+            }
+        }
+    }
+
+    if (verbosity > 0)
+    {
+        printf("pufi: events_number: %zu; bounding_box_selected_number: %zu; polygon_selected_number: %zu; selected_number: %zu;\n", events_number, bounding_box_selected_number, polygon_selected_number, selected_number);
+    }
+
+    batch->size = selected_number * sizeof(struct event_PSD);
+
+    return true;
+}
+
+static const struct filter_plugin pufi_plugin = {
+    "pufi",
+    true,
+    false,
+    pufi_init,
+    pufi_process,
+    NULL,
+    pufi_close
+};
+
+#endif
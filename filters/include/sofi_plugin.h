@@ -0,0 +1,307 @@
+#ifndef __SOFI_PLUGIN_H__
+#define __SOFI_PLUGIN_H__ 1
+
+// Sorting filter, it sorts the events according to their timestamps.
+// By default the events are sorted only within each batch, with a reorder
+// horizon they are sorted across the batches, see sorting_stream.h
+//
+// Configuration:
+//   "horizon_time": reorder horizon in nanoseconds
+//   "horizon_events": reorder horizon in number of events
+//   "restart_time": minimum backward jump of the timestamps, in nanoseconds,
+//                   that is considered a restart of the digitizer; the jump
+//                   shall also be larger than the horizon time
+//   "ns_per_sample": nanoseconds per sample
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <jansson.h>
+
+#include "defaults.h"
+#include "events.h"
+#include "sorting_stream.h"
+#include "filter_plugin.h"
+
+struct sofi_config
+{
+    bool streaming;
+    uint64_t horizon_time;
+    size_t horizon_events;
+    // Backward jump of the timestamps considered as a restart
+    uint64_t restart_time;
+
+    // The two types of data messages are sorted independently
+    struct sorting_stream stream_events;
+    struct sorting_stream stream_waveforms;
+
+    struct event_pointer *pointers_events_input;
+    size_t pointers_events_input_capacity;
+    // Scratch buffer for the radix sort of the pointers
+    struct event_pointer *pointers_sorting_buffer;
+    size_t pointers_sorting_buffer_capacity;
+
+    // Buffer for the sorted events, it is swapped with the buffer of the
+    // batches so that they are reused to reduce the memory allocations
+    uint8_t *buffer_output;
+    size_t buffer_output_capacity;
+
+    unsigned int verbosity;
+};
+
+extern inline
+bool sofi_init(json_t *json_config, void *zmq_context, unsigned int verbosity, void **user_config)
+{
+    (void)zmq_context;
+
+    struct sofi_config *config = calloc(1, sizeof(struct sofi_config));
+
+    if (!config)
+    {
+        printf("ERROR: sofi: Unable to allocate the configuration\n");
+
+        return false;
+    }
+
+    const double horizon_time_ns = filter_read_number(json_config, "horizon_time", defaults_sofi_horizon_time);
+    const double horizon_events = filter_read_number(json_config, "horizon_events", defaults_sofi_horizon_events);
+    const double restart_time_ns = filter_read_number(json_config, "restart_time", defaults_sofi_restart_time);
+    const double ns_per_sample = filter_read_number(json_config, "ns_per_sample", defaults_sofi_ns_per_sample);
+
+    config->streaming = (horizon_time_ns > 0 || horizon_events > 0);
+    config->horizon_time = (horizon_time_ns > 0) ? (uint64_t)(horizon_time_ns / ns_per_sample) : 0;
+    config->horizon_events = (horizon_events > 0) ? (size_t)horizon_events : 0;
+
+    // With only the events horizon any late message would be a restart
+    const uint64_t restart_time = (restart_time_ns > 0) ? (uint64_t)(restart_time_ns / ns_per_sample) : 0;
+
+    config->restart_time = (restart_time > config->horizon_time) ? restart_time : config->horizon_time;
+    config->verbosity = verbosity;
+
+    if (verbosity > 0)
+    {
+        printf("sofi: Reorder horizon time: %f ns\n", horizon_time_ns);
+        printf("sofi: Reorder horizon events: %zu\n", config->horizon_events);
+        printf("sofi: Restart time: %f ns\n", config->restart_time * ns_per_sample);
+        printf("sofi: ns per sample: %f\n", ns_per_sample);
+    }
+
+    (*user_config) = config;
+
+    return true;
+}
+
+// Determines the number of the oldest pending events that can be emitted
+extern inline
+size_t sofi_ready_events(const struct sorting_stream *stream, uint64_t horizon_time, size_t horizon_events)
+{
+    size_t ready_time = 0;
+    size_t ready_events = 0;
+
+    if (horizon_time > 0 && stream->newest_timestamp > horizon_time)
+    {
+        const uint64_t watermark = stream->newest_timestamp - horizon_time;
+
+        ready_time = sorting_stream_older_than(stream, watermark);
+    }
+
+    if (horizon_events > 0 && stream->pointers_number > horizon_events)
+    {
+        ready_events = stream->pointers_number - horizon_events;
+    }
+
+    return (ready_time > ready_events) ? ready_time : ready_events;
+}
+
+//! Replaces the events of the batch with the emitted events, the buffer of
+//! the batch is reused if it is big enough
+extern inline
+bool sofi_emit(struct sorting_stream *stream, size_t events_number, struct filter_batch *batch)
+{
+    size_t output_capacity = batch->size;
+
+    batch->size = sorting_stream_emit(stream, events_number, &batch->buffer, &output_capacity);
+
+    return (events_number == 0 || batch->size > 0);
+}
+
+extern inline
+bool sofi_process(struct filter_batch *batch, void *user_config)
+{
+    struct sofi_config *config = user_config;
+
+    const int search_type = (batch->type == FILTER_EVENTS) ? EVENTS_SEARCH : WAVEFORMS_SEARCH;
+
+    const size_t events_number = sorting_stream_parse_message(search_type, batch->buffer, batch->size,
+                                                              &config->pointers_events_input,
+                                                              &config->pointers_events_input_capacity);
+
+    if (!sorting_stream_reserve((void **)&config->pointers_sorting_buffer,
+                                &config->pointers_sorting_buffer_capacity,
+                                events_number,
+                                sizeof(struct event_pointer)))
+    {
+        printf("ERROR: sofi: Unable to allocate the sorting buffer, using qsort\n");
+    }
+
+    sorting_stream_sort_pointers(config->pointers_events_input, events_number, config->pointers_sorting_buffer);
+
+    if (!config->streaming)
+    {
+        // The events are reordered in the output buffer, that is swapped
+        // with the input buffer
+        if (!sorting_stream_reserve((void **)&config->buffer_output,
+                                    &config->buffer_output_capacity,
+                                    batch->size,
+                                    sizeof(uint8_t)))
+        {
+            printf("ERROR: sofi: Unable to allocate the output buffer\n");
+
+            return false;
+        }
+
+        size_t output_offset = 0;
+
+        for (size_t index = 0; index < events_number; index++)
+        {
+            const struct event_pointer pointer_event = config->pointers_events_input[index];
+
+            memcpy(config->buffer_output + output_offset, batch->buffer + pointer_event.index, pointer_event.size);
+            output_offset += pointer_event.size;
+        }
+
+        uint8_t *output = config->buffer_output;
+
+        config->buffer_output = batch->buffer;
+        config->buffer_output_capacity = batch->size;
+
+        batch->buffer = output;
+        batch->size = output_offset;
+
+        return true;
+    }
+
+    struct sorting_stream *stream = (batch->type == FILTER_EVENTS) ? &config->stream_events : &config->stream_waveforms;
+
+    // If all the events are older than the last emitted event, by more than
+    // the horizon and the restart time, the digitizer was restarted. The
+    // pending events are emitted before the new ones, to start from scratch.
+    // Smaller jumps are counted as late events.
+    const bool restart = (events_number > 0 && stream->emitted_any &&
+                          config->pointers_events_input[events_number - 1].timestamp < stream->last_emitted_timestamp &&
+                          (stream->last_emitted_timestamp - config->pointers_events_input[events_number - 1].timestamp) > config->restart_time);
+
+    const size_t restart_number = restart ? stream->pointers_number : 0;
+
+    if (restart)
+    {
+        printf("WARNING: Timestamps jumped back, flushing the pending events (restart)\n");
+
+        stream->restarts += 1;
+    }
+
+    uint8_t *restart_output = NULL;
+    size_t restart_output_capacity = 0;
+    const size_t restart_output_size = sorting_stream_emit(stream, restart_number, &restart_output, &restart_output_capacity);
+
+    // Even without pending events, the new events are compared only with
+    // the ones after the restart
+    if (restart)
+    {
+        stream->emitted_any = false;
+        stream->newest_timestamp = 0;
+    }
+
+    const size_t previous_late_events = stream->late_events;
+
+    if (!sorting_stream_add(stream, batch->buffer, config->pointers_events_input, events_number, 0))
+    {
+        printf("ERROR: sofi: Unable to allocate the streaming buffers, the message is lost\n");
+    }
+
+    if (config->verbosity > 0 && stream->late_events > previous_late_events)
+    {
+        printf("WARNING: Late events: %zu; total late events: %zu\n", stream->late_events - previous_late_events, stream->late_events);
+    }
+
+    const size_t emit_number = sofi_ready_events(stream, config->horizon_time, config->horizon_events);
+
+    if (config->verbosity > 1)
+    {
+        printf("sofi: Emitted events: %zu; pending events: %zu\n", emit_number, stream->pointers_number - emit_number);
+    }
+
+    const bool emitted = sofi_emit(stream, emit_number, batch);
+
+    // The events before the restart go in front of the new ones
+    if (restart_output_size > 0)
+    {
+        uint8_t *output = realloc(restart_output, restart_output_size + batch->size);
+
+        if (!output)
+        {
+            printf("ERROR: sofi: Unable to allocate the output buffer, the events before the restart are lost\n");
+
+            free(restart_output);
+        }
+        else
+        {
+            memcpy(output + restart_output_size, batch->buffer, batch->size);
+
+            free(batch->buffer);
+
+            batch->buffer = output;
+            batch->size += restart_output_size;
+        }
+    }
+    else
+    {
+        free(restart_output);
+    }
+
+    return emitted;
+}
+
+extern inline
+bool sofi_flush(struct filter_batch *batch, void *user_config)
+{
+    struct sofi_config *config = user_config;
+
+    struct sorting_stream *stream = (batch->type == FILTER_EVENTS) ? &config->stream_events : &config->stream_waveforms;
+
+    if (config->verbosity > 0 && config->streaming)
+    {
+        printf("sofi: %s: late events: %zu; restarts: %zu\n", (batch->type == FILTER_EVENTS) ? "Events" : "Waveforms", stream->late_events, stream->restarts);
+    }
+
+    return sofi_emit(stream, stream->pointers_number, batch);
+}
+
+extern inline
+void sofi_close(void *user_config)
+{
+    struct sofi_config *config = user_config;
+
+    sorting_stream_free(&config->stream_events);
+    sorting_stream_free(&config->stream_waveforms);
+
+    free(config->pointers_events_input);
+    free(config->pointers_sorting_buffer);
+    free(config->buffer_output);
+    free(config);
+}
+
+static const struct filter_plugin sofi_plugin = {
+    "sofi",
+    true,
+    true,
+    sofi_init,
+    sofi_process,
+    sofi_flush,
+    sofi_close
+};
+
+#endif
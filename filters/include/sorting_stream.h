@@ -0,0 +1,564 @@
+#ifndef __SORTING_STREAM_H__
+#define __SORTING_STREAM_H__ 1
+
+// Sorting of the events across the data messages, shared by sofi and mefi.
+//
+// The events of the messages are indexed by pointers, that store their
+// position in the message, their timestamp and their size, so that both
+// event_PSD and event_waveform messages are handled in the same way.
+// A sorting_stream holds a copy of the events that could not be sent yet,
+// sorted according to their timestamps. The oldest events are removed from
+// the stream when they are older than a watermark decided by the caller.
+//
+// The removal does not move the pending events: the pointers are advanced
+// past the removed ones and the data of the removed events is left in place.
+// Both are compacted by the next addition, that needs to touch all the
+// pending pointers anyways for the merge, and the data only when the removed
+// data is at least as big as the pending data, so that each byte is copied
+// a bounded number of times on average.
+//
+// The messages of sofi are sorted before the addition, thus they are merged
+// with the pending events in a single pass. The messages that are not sorted
+// are sorted together with the pending events.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "events.h"
+#include "radix_sort.h"
+
+struct event_pointer
+{
+    size_t index;
+    uint64_t timestamp;
+    size_t size;
+};
+
+enum search_types
+{
+    NO_SEARCH = 0,
+    EVENTS_SEARCH = 1,
+    WAVEFORMS_SEARCH = 2
+};
+
+struct sorting_stream
+{
+    // Copy of the data of the pending events
+    uint8_t *data;
+    size_t data_size;
+    size_t data_capacity;
+    // Size of the data of the removed events, that is still in data
+    size_t removed_data_size;
+    // Buffer used to compact the data after the removal of the events
+    uint8_t *compacted_data;
+    size_t compacted_data_capacity;
+    // Pointers to the pending events, sorted after each addition.
+    // The removed pointers are still in front of them, the allocated array
+    // starts at pointers - pointers_offset.
+    struct event_pointer *pointers;
+    size_t pointers_number;
+    size_t pointers_offset;
+    size_t pointers_capacity;
+    struct event_pointer *sorting_buffer;
+    size_t sorting_buffer_capacity;
+
+    uint64_t newest_timestamp;
+    uint64_t last_emitted_timestamp;
+    bool emitted_any;
+
+    // Events that arrived after newer events were already emitted
+    size_t late_events;
+    size_t restarts;
+};
+
+//! Enlarges the array if it is smaller than entries_number, on failure the
+//! array is left untouched and false is returned
+extern inline
+bool sorting_stream_reserve(void **array, size_t *capacity, size_t entries_number, size_t sizeof_type)
+{
+    if (entries_number <= *capacity && *array)
+    {
+        return true;
+    }
+
+    // Some room for the next messages, to reduce the reallocations
+    const size_t new_capacity = (entries_number > 2 * (*capacity)) ? entries_number : 2 * (*capacity);
+
+    void *new_array = realloc(*array, (new_capacity > 0 ? new_capacity : 1) * sizeof_type);
+
+    if (!new_array)
+    {
+        return false;
+    }
+
+    *array = new_array;
+    *capacity = new_capacity;
+
+    return true;
+}
+
+extern inline
+int sorting_stream_compare_events(const void *a, const void *b)
+{
+    const struct event_pointer *event_a = (const struct event_pointer *)a;
+    const struct event_pointer *event_b = (const struct event_pointer *)b;
+
+    if (event_a->timestamp < event_b->timestamp)
+    {
+        return -1;
+    }
+    else if (event_a->timestamp > event_b->timestamp)
+    {
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+//! Sorts the pointers with the radix sort, or with qsort if the scratch
+//! buffer could not be allocated
+extern inline
+void sorting_stream_sort_pointers(struct event_pointer *pointers, size_t events_number, struct event_pointer *sorting_buffer)
+{
+    const enum radix_sort_error_t sorting_result = radix_sort_timestamps(pointers,
+                                                                         events_number,
+                                                                         sizeof(struct event_pointer),
+                                                                         offsetof(struct event_pointer, timestamp),
+                                                                         sorting_buffer);
+
+    if (sorting_result != RADIX_SORT_OK)
+    {
+        qsort(pointers, events_number, sizeof(struct event_pointer), sorting_stream_compare_events);
+    }
+}
+
+//! Merges the two sorted runs of pointers [0, first_number) and
+//! [first_number, first_number + second_number). The second run is copied to
+//! the buffer and the merge proceeds from the back, so that the first run is
+//! moved only past the events that are older than its own.
+//! Events with the same timestamp keep their order.
+extern inline
+void sorting_stream_merge_pointers(struct event_pointer *pointers, size_t first_number, size_t second_number,
+                                   struct event_pointer *buffer)
+{
+    memcpy(buffer, pointers + first_number, second_number * sizeof(struct event_pointer));
+
+    size_t first_index = first_number;
+    size_t second_index = second_number;
+    size_t output_index = first_number + second_number;
+
+    while (second_index > 0)
+    {
+        if (first_index > 0 && pointers[first_index - 1].timestamp > buffer[second_index - 1].timestamp)
+        {
+            pointers[--output_index] = pointers[--first_index];
+        }
+        else
+        {
+            pointers[--output_index] = buffer[--second_index];
+        }
+    }
+}
+
+//! Determines the type of data from the topic of a message
+extern inline
+int sorting_stream_search_type(const char *topic)
+{
+    if (strstr(topic, "data_abcd_events_v0") == topic)
+    {
+        return EVENTS_SEARCH;
+    }
+    else if (strstr(topic, "data_abcd_waveforms_v0") == topic)
+    {
+        return WAVEFORMS_SEARCH;
+    }
+    else
+    {
+        return NO_SEARCH;
+    }
+}
+
+//! Fills the pointers to the events of a message and returns their number,
+//! or zero if the message is malformed or the pointers could not be allocated
+extern inline
+size_t sorting_stream_parse_message(int search_type, const uint8_t *buffer, size_t size,
+                                    struct event_pointer **pointers, size_t *pointers_capacity)
+{
+    if (search_type == EVENTS_SEARCH)
+    {
+        if ((size % sizeof(struct event_PSD)) != 0)
+        {
+            printf("ERROR: The buffer size is not a multiple of %zu\n", sizeof(struct event_PSD));
+
+            return 0;
+        }
+
+        const size_t events_number = size / sizeof(struct event_PSD);
+
+        if (!sorting_stream_reserve((void **)pointers, pointers_capacity, events_number, sizeof(struct event_pointer)))
+        {
+            printf("ERROR: Unable to allocate the events pointers\n");
+
+            return 0;
+        }
+
+        const struct event_PSD *events = (const struct event_PSD *)buffer;
+
+        for (size_t index = 0; index < events_number; index++)
+        {
+            (*pointers)[index].index = index * sizeof(struct event_PSD);
+            (*pointers)[index].timestamp = events[index].timestamp;
+            (*pointers)[index].size = sizeof(struct event_PSD);
+        }
+
+        return events_number;
+    }
+    else if (search_type == WAVEFORMS_SEARCH)
+    {
+        // Overestimating the number of event_waveforms by using the buffer
+        // size and assuming that there are only empty waveforms
+        const size_t size_estimation = size / waveform_header_size();
+
+        if (!sorting_stream_reserve((void **)pointers, pointers_capacity, size_estimation, sizeof(struct event_pointer)))
+        {
+            printf("ERROR: Unable to allocate the events pointers\n");
+
+            return 0;
+        }
+
+        size_t events_number = 0;
+        size_t input_offset = 0;
+
+        while ((input_offset + waveform_header_size()) <= size && events_number < size_estimation)
+        {
+            uint64_t timestamp;
+            uint32_t samples_number;
+            uint8_t gates_number;
+
+            memcpy(&timestamp, buffer + input_offset, sizeof(timestamp));
+            memcpy(&samples_number, buffer + input_offset + 9, sizeof(samples_number));
+            memcpy(&gates_number, buffer + input_offset + 13, sizeof(gates_number));
+
+            const size_t this_size = waveform_header_size() + samples_number * sizeof(uint16_t) + gates_number * samples_number * sizeof(uint8_t);
+
+            if (input_offset + this_size > size)
+            {
+                printf("ERROR: Waveform exceeding the message size, at offset: %zu\n", input_offset);
+
+                return 0;
+            }
+
+            (*pointers)[events_number].index = input_offset;
+            (*pointers)[events_number].timestamp = timestamp;
+            (*pointers)[events_number].size = this_size;
+
+            input_offset += this_size;
+            events_number += 1;
+        }
+
+        return events_number;
+    }
+
+    return 0;
+}
+
+//! Moves the pending pointers to the start of their array and, if the data
+//! of the removed events is at least as big as the one of the pending
+//! events, copies the pending data to a compacted buffer.
+//! If the compacted buffer could not be allocated the data is left as is.
+extern inline
+void sorting_stream_compact(struct sorting_stream *stream)
+{
+    if (stream->pointers_offset > 0)
+    {
+        struct event_pointer *const pointers_start = stream->pointers - stream->pointers_offset;
+
+        memmove(pointers_start, stream->pointers, stream->pointers_number * sizeof(struct event_pointer));
+
+        stream->pointers = pointers_start;
+        stream->pointers_capacity += stream->pointers_offset;
+        stream->pointers_offset = 0;
+    }
+
+    const size_t pending_size = stream->data_size - stream->removed_data_size;
+
+    if (stream->removed_data_size == 0 || stream->removed_data_size < pending_size)
+    {
+        return;
+    }
+
+    if (!sorting_stream_reserve((void **)&stream->compacted_data, &stream->compacted_data_capacity, pending_size, sizeof(uint8_t)))
+    {
+        return;
+    }
+
+    size_t compacted_offset = 0;
+
+    for (size_t i = 0; i < stream->pointers_number; i++)
+    {
+        struct event_pointer *const pointer_event = &stream->pointers[i];
+
+        memcpy(stream->compacted_data + compacted_offset, stream->data + pointer_event->index, pointer_event->size);
+
+        pointer_event->index = compacted_offset;
+        compacted_offset += pointer_event->size;
+    }
+
+    uint8_t *const temp_data = stream->data;
+    stream->data = stream->compacted_data;
+    stream->compacted_data = temp_data;
+
+    const size_t temp_capacity = stream->data_capacity;
+    stream->data_capacity = stream->compacted_data_capacity;
+    stream->compacted_data_capacity = temp_capacity;
+
+    stream->data_size = compacted_offset;
+    stream->removed_data_size = 0;
+}
+
+//! Copies the events of a message to the stream, sorting them together with
+//! the pending events. The offset is added to the timestamps of the copies.
+//! Returns false if the buffers could not be allocated.
+extern inline
+bool sorting_stream_add(struct sorting_stream *stream, const uint8_t *buffer,
+                        const struct event_pointer *pointers, size_t events_number,
+                        int64_t offset)
+{
+    if (events_number == 0)
+    {
+        return true;
+    }
+
+    sorting_stream_compact(stream);
+
+    // The data of the message ends with the event with the highest index
+    size_t data_size = 0;
+
+    for (size_t i = 0; i < events_number; i++)
+    {
+        const size_t event_end = pointers[i].index + pointers[i].size;
+
+        data_size = (event_end > data_size) ? event_end : data_size;
+    }
+
+    const size_t total_events = stream->pointers_number + events_number;
+
+    if (!sorting_stream_reserve((void **)&stream->data, &stream->data_capacity, stream->data_size + data_size, sizeof(uint8_t)) ||
+        !sorting_stream_reserve((void **)&stream->pointers, &stream->pointers_capacity, total_events, sizeof(struct event_pointer)))
+    {
+        return false;
+    }
+
+    // Without the scratch buffer the sort allocates its own
+    const bool has_sorting_buffer = sorting_stream_reserve((void **)&stream->sorting_buffer,
+                                                           &stream->sorting_buffer_capacity,
+                                                           total_events,
+                                                           sizeof(struct event_pointer));
+
+    memcpy(stream->data + stream->data_size, buffer, data_size);
+
+    struct event_pointer *const new_pointers = stream->pointers + stream->pointers_number;
+
+    bool message_sorted = true;
+
+    for (size_t i = 0; i < events_number; i++)
+    {
+        struct event_pointer this_pointer = pointers[i];
+
+        this_pointer.index += stream->data_size;
+
+        if (offset != 0)
+        {
+            const int64_t corrected = (int64_t)this_pointer.timestamp + offset;
+
+            this_pointer.timestamp = (corrected > 0) ? (uint64_t)corrected : 0;
+
+            // All the events start with their timestamp
+            memcpy(stream->data + this_pointer.index, &this_pointer.timestamp, sizeof(uint64_t));
+        }
+
+        if (stream->emitted_any && this_pointer.timestamp < stream->last_emitted_timestamp)
+        {
+            stream->late_events += 1;
+        }
+
+        if (this_pointer.timestamp > stream->newest_timestamp)
+        {
+            stream->newest_timestamp = this_pointer.timestamp;
+        }
+
+        if (i > 0 && this_pointer.timestamp < new_pointers[i - 1].timestamp)
+        {
+            message_sorted = false;
+        }
+
+        new_pointers[i] = this_pointer;
+    }
+
+    stream->data_size += data_size;
+
+    // The pending events are sorted, thus if the message is sorted too the
+    // two runs are merged, otherwise all the pointers are sorted again
+    if (!message_sorted || !has_sorting_buffer)
+    {
+        sorting_stream_sort_pointers(stream->pointers, total_events, has_sorting_buffer ? stream->sorting_buffer : NULL);
+    }
+    else if (stream->pointers_number > 0 && new_pointers[0].timestamp < stream->pointers[stream->pointers_number - 1].timestamp)
+    {
+        sorting_stream_merge_pointers(stream->pointers, stream->pointers_number, events_number, stream->sorting_buffer);
+    }
+
+    stream->pointers_number = total_events;
+
+    return true;
+}
+
+//! Returns the number of the pending events older than the watermark
+extern inline
+size_t sorting_stream_older_than(const struct sorting_stream *stream, uint64_t watermark)
+{
+    size_t low = 0;
+    size_t high = stream->pointers_number;
+
+    while (low < high)
+    {
+        const size_t middle = low + (high - low) / 2;
+
+        if (stream->pointers[middle].timestamp < watermark)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+//! Returns the size of the data of the oldest events_number events
+extern inline
+size_t sorting_stream_data_size(const struct sorting_stream *stream, size_t events_number)
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < events_number; i++)
+    {
+        size += stream->pointers[i].size;
+    }
+
+    return size;
+}
+
+//! Drops all the pending events
+extern inline
+void sorting_stream_clear(struct sorting_stream *stream)
+{
+    if (stream->pointers_offset > 0)
+    {
+        stream->pointers -= stream->pointers_offset;
+        stream->pointers_capacity += stream->pointers_offset;
+        stream->pointers_offset = 0;
+    }
+
+    stream->pointers_number = 0;
+
+    stream->data_size = 0;
+    stream->removed_data_size = 0;
+}
+
+//! Removes the oldest events_number events, without moving the remaining
+//! ones, that are compacted by the next sorting_stream_add().
+//! Returns false if there are not so many pending events, in which case all
+//! the events are dropped.
+extern inline
+bool sorting_stream_remove(struct sorting_stream *stream, size_t events_number)
+{
+    if (events_number == 0)
+    {
+        return true;
+    }
+
+    if (events_number > stream->pointers_number)
+    {
+        sorting_stream_clear(stream);
+
+        return false;
+    }
+
+    stream->last_emitted_timestamp = stream->pointers[events_number - 1].timestamp;
+    stream->emitted_any = true;
+
+    if (events_number == stream->pointers_number)
+    {
+        // Without pending events all the data can be overwritten
+        sorting_stream_clear(stream);
+
+        return true;
+    }
+
+    stream->removed_data_size += sorting_stream_data_size(stream, events_number);
+
+    stream->pointers += events_number;
+    stream->pointers_offset += events_number;
+    stream->pointers_capacity -= events_number;
+    stream->pointers_number -= events_number;
+
+    return true;
+}
+
+//! Copies the oldest events_number events to the output buffer, enlarging
+//! it if needed, and removes them from the stream. Returns the output size.
+extern inline
+size_t sorting_stream_emit(struct sorting_stream *stream, size_t events_number,
+                           uint8_t **output, size_t *output_capacity)
+{
+    if (events_number == 0)
+    {
+        return 0;
+    }
+
+    const size_t output_size = sorting_stream_data_size(stream, events_number);
+
+    if (!sorting_stream_reserve((void **)output, output_capacity, output_size, sizeof(uint8_t)))
+    {
+        printf("ERROR: Unable to allocate the output buffer, dropping the pending events\n");
+
+        sorting_stream_clear(stream);
+
+        return 0;
+    }
+
+    size_t output_offset = 0;
+
+    for (size_t i = 0; i < events_number; i++)
+    {
+        const struct event_pointer pointer_event = stream->pointers[i];
+
+        memcpy((*output) + output_offset, stream->data + pointer_event.index, pointer_event.size);
+        output_offset += pointer_event.size;
+    }
+
+    sorting_stream_remove(stream, events_number);
+
+    return output_size;
+}
+
+extern inline
+void sorting_stream_free(struct sorting_stream *stream)
+{
+    free(stream->data);
+    free(stream->compacted_data);
+    free(stream->pointers ? stream->pointers - stream->pointers_offset : NULL);
+    free(stream->sorting_buffer);
+
+    memset(stream, 0, sizeof(struct sorting_stream));
+}
+
+#endif
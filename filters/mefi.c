@@ -0,0 +1,767 @@
+/*
+ * (C) Copyright 2026 European Union, Cristiano Lino Fontana
+ *
+ * This file is part of ABCD.
+ *
+ * ABCD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ABCD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// This macro is to use nanosleep even with compilation flag: -std=c99
+#define _POSIX_C_SOURCE 199309L
+// This macro is to enable snprintf() in macOS
+#define _C99_SOURCE
+
+// For nanosleep()
+#include <time.h>
+// Fot getopt
+#include <getopt.h>
+// For malloc
+#include <stdlib.h>
+// For memcpy
+#include <string.h>
+// For ints with fixed size
+#include <stdint.h>
+#include <inttypes.h>
+// For kernel signals management
+#include <signal.h>
+// For snprintf()
+#include <stdio.h>
+// For boolean datatype
+#include <stdbool.h>
+// For errno
+#include <errno.h>
+
+#include <zmq.h>
+
+#include "defaults.h"
+#include "events.h"
+#include "socket_functions.h"
+#include "sorting_stream.h"
+
+#define MAX_SOURCES 64
+// The events and the waveforms are merged independently
+#define DATA_TYPES 2
+
+// Events of one type coming from a source
+struct source_stream
+{
+    struct sorting_stream stream;
+    struct timespec last_message;
+    bool received_any;
+    bool idle;
+};
+
+struct source
+{
+    char *address;
+    void *socket;
+    // Clock offset in timestamp units, added to the timestamps
+    int64_t offset;
+    size_t messages_number;
+    struct source_stream data[DATA_TYPES];
+};
+
+unsigned int terminate_flag = 0;
+
+// Handle standard signals
+// SIGTERM (from kill): terminates kindly forcing the status to the closing branch of the state machine.
+// SIGINT (from ctrl-c): same behaviour as SIGTERM
+// SIGHUP (from shell processes): same behaviour as SIGTERM
+
+void signal_handler(int signum);
+
+void print_usage(const char *name)
+{
+    printf("Usage: %s [options]\n", name);
+    printf("\n");
+    printf("Datastream filter that merges the data streams of several sources in a single time ordered stream.\n");
+    printf("The events of each source are sorted and kept until all the active sources have sent events newer\n");
+    printf("than them, by at least the reorder horizon. Then the events of all the sources are merged by timestamp.\n");
+    printf("A source that does not send data for more than the idle timeout does not hold back the others,\n");
+    printf("when it sends data again its events older than the already sent ones are forwarded anyway and counted as late.\n");
+    printf("If the timestamps of a source jump back by more than the horizon and the restart time, the source was restarted:\n");
+    printf("all the pending events are flushed and the source starts anew.\n");
+    printf("The events and the waveforms are merged independently.\n");
+    printf("\n");
+    printf("Optional arguments:\n");
+    printf("\t-h: Display this message\n");
+    printf("\t-v: Set verbose execution, repeating the option increases the verbosity level\n");
+    printf("\n");
+    printf("\t-A <address>: Input socket address, repeat the option for each source (maximum %d), default: %s\n", MAX_SOURCES, defaults_abcd_data_address_sub);
+    printf("\t-D <address>: Output socket address for merged data, default: %s\n", defaults_mefi_data_address);
+    printf("\t-T <period>: Set base period in milliseconds, default: %d\n", defaults_mefi_base_period);
+    printf("\n");
+    printf("\t-O <source>:<offset>: Clock offset in nanoseconds added to the timestamps of the source,\n");
+    printf("\t                      the source is the index of the corresponding -A option, starting from 0\n");
+    printf("\t-w <horizon>: Reorder horizon of each source in nanoseconds, default: %f\n", defaults_mefi_horizon_time);
+    printf("\t-i <timeout>: Idle timeout of the sources in milliseconds, default: %d\n", defaults_mefi_idle_timeout);
+    printf("\t-r <time>: Minimum backward jump of the timestamps of a source that is a restart, in nanoseconds, default: %f\n", defaults_mefi_restart_time);
+    printf("\t-n <ns_per_sample>: Nanoseconds per sample, default: %f\n", defaults_mefi_ns_per_sample);
+
+    return;
+}
+
+double elapsed_ms(const struct timespec *now, const struct timespec *then);
+bool source_restarted(const struct sorting_stream *stream, uint64_t newest_timestamp, int64_t offset, uint64_t restart_time);
+void send_events(void *output_socket, int search_type, uint8_t *buffer, size_t size, unsigned int verbosity);
+size_t merge_sources(struct source *sources, size_t sources_number, unsigned int type,
+                     uint64_t horizon_time, bool flush,
+                     uint8_t **output, size_t *output_capacity,
+                     uint64_t *last_emitted_timestamp, bool *emitted_any);
+
+int main(int argc, char *argv[])
+{
+    // Register the handler for SIGTERM (from kill), SIGINT (from ctrl-c)
+    signal(SIGTERM, signal_handler);
+    signal(SIGINT, signal_handler);
+    signal(SIGHUP, signal_handler);
+
+    unsigned int verbosity = 0;
+    unsigned int base_period = defaults_mefi_base_period;
+    char *output_address = defaults_mefi_data_address;
+    double horizon_time_ns = defaults_mefi_horizon_time;
+    double restart_time_ns = defaults_mefi_restart_time;
+    unsigned int idle_timeout = defaults_mefi_idle_timeout;
+    double ns_per_sample = defaults_mefi_ns_per_sample;
+
+    struct source sources[MAX_SOURCES];
+    memset(sources, 0, sizeof(sources));
+    size_t sources_number = 0;
+
+    // The offsets are converted after the parsing, as ns_per_sample might
+    // be given after them
+    double offsets_ns[MAX_SOURCES];
+    memset(offsets_ns, 0, sizeof(offsets_ns));
+
+    int c = 0;
+    while ((c = getopt(argc, argv, "hA:D:T:O:w:i:r:n:v")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        case 'A':
+            if (sources_number < MAX_SOURCES)
+            {
+                sources[sources_number].address = optarg;
+                sources_number += 1;
+            }
+            else
+            {
+                printf("WARNING: Too many sources, ignoring: %s\n", optarg);
+            }
+            break;
+        case 'D':
+            output_address = optarg;
+            break;
+        case 'T':
+            base_period = atoi(optarg);
+            break;
+        case 'O':
+        {
+            char *separator = NULL;
+            const unsigned long index = strtoul(optarg, &separator, 0);
+
+            if (!separator || *separator != ':' || index >= MAX_SOURCES)
+            {
+                printf("ERROR: Invalid clock offset: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+
+            offsets_ns[index] = atof(separator + 1);
+            break;
+        }
+        case 'w':
+            horizon_time_ns = atof(optarg);
+            break;
+        case 'i':
+            idle_timeout = atoi(optarg);
+            break;
+        case 'r':
+            restart_time_ns = atof(optarg);
+            break;
+        case 'n':
+            ns_per_sample = atof(optarg);
+            break;
+        case 'v':
+            verbosity += 1;
+            break;
+        default:
+            printf("Unknown command: %c", c);
+            break;
+        }
+    }
+
+    if (sources_number == 0)
+    {
+        sources[0].address = defaults_abcd_data_address_sub;
+        sources_number = 1;
+    }
+
+    for (size_t i = 0; i < sources_number; i++)
+    {
+        sources[i].offset = (int64_t)(offsets_ns[i] / ns_per_sample);
+    }
+
+    const uint64_t horizon_time = (horizon_time_ns > 0) ? (uint64_t)(horizon_time_ns / ns_per_sample) : 0;
+    const uint64_t restart_time_samples = (restart_time_ns > 0) ? (uint64_t)(restart_time_ns / ns_per_sample) : 0;
+    // Jumps within the horizon are only late events
+    const uint64_t restart_time = (restart_time_samples > horizon_time) ? restart_time_samples : horizon_time;
+
+    if (verbosity > 0)
+    {
+        printf("Sources number: %zu\n", sources_number);
+        for (size_t i = 0; i < sources_number; i++)
+        {
+            printf("\tSource: %zu; address: %s; offset: %f ns (%" PRId64 " samples)\n", i, sources[i].address, offsets_ns[i], sources[i].offset);
+        }
+        printf("Output socket address: %s\n", output_address);
+        printf("Verbosity: %u\n", verbosity);
+        printf("Base period: %u\n", base_period);
+        printf("Reorder horizon: %f ns\n", horizon_time_ns);
+        printf("Idle timeout: %u ms\n", idle_timeout);
+        printf("Restart time: %f ns\n", restart_time * ns_per_sample);
+        printf("ns per sample: %f\n", ns_per_sample);
+    }
+
+    // Creates a ZeroMQ context
+    void *context = zmq_ctx_new();
+    if (!context)
+    {
+        printf("ERROR: ZeroMQ Error on context creation");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < sources_number; i++)
+    {
+        sources[i].socket = zmq_socket(context, ZMQ_SUB);
+        if (!sources[i].socket)
+        {
+            printf("ERROR: ZeroMQ Error on input socket creation\n");
+            return EXIT_FAILURE;
+        }
+
+        const int is = zmq_connect(sources[i].socket, sources[i].address);
+        if (is != 0)
+        {
+            printf("ERROR: ZeroMQ Error on input socket connection: %s\n", zmq_strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        // Subscribe to data topic
+        zmq_setsockopt(sources[i].socket, ZMQ_SUBSCRIBE, "data_abcd", strlen("data_abcd"));
+    }
+
+    void *output_socket = zmq_socket(context, ZMQ_PUB);
+    if (!output_socket)
+    {
+        printf("ERROR: ZeroMQ Error on output socket creation\n");
+        return EXIT_FAILURE;
+    }
+
+    const int osc = zmq_bind(output_socket, output_address);
+    if (osc != 0)
+    {
+        printf("ERROR: ZeroMQ Error on output socket binding: %s\n", zmq_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // Wait a bit to prevent the slow-joiner syndrome
+    struct timespec slow_joiner_wait;
+    slow_joiner_wait.tv_sec = defaults_all_slow_joiner_wait / 1000;
+    slow_joiner_wait.tv_nsec = (defaults_all_slow_joiner_wait % 1000) * 1000000L;
+    nanosleep(&slow_joiner_wait, NULL);
+
+    struct timespec wait;
+    wait.tv_sec = base_period / 1000;
+    wait.tv_nsec = (base_period % 1000) * 1000000L;
+
+    struct event_pointer *pointers_events_input = NULL;
+    size_t pointers_events_input_capacity = 0;
+    struct event_pointer *pointers_sorting_buffer = NULL;
+    size_t pointers_sorting_buffer_capacity = 0;
+
+    uint8_t *buffer_output = NULL;
+    size_t buffer_output_capacity = 0;
+
+    uint64_t last_emitted_timestamps[DATA_TYPES] = {0, 0};
+    bool emitted_any[DATA_TYPES] = {false, false};
+    const int search_types[DATA_TYPES] = {EVENTS_SEARCH, WAVEFORMS_SEARCH};
+
+    // The idle timeouts of the sources that never sent anything start now
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    for (size_t i = 0; i < sources_number; i++)
+    {
+        for (unsigned int t = 0; t < DATA_TYPES; t++)
+        {
+            sources[i].data[t].last_message = start_time;
+        }
+    }
+
+    size_t loops_counter = 0;
+    size_t msg_ID = 0;
+
+    while (terminate_flag == 0)
+    {
+        // =====================================================================
+        //  Messages reception
+        // =====================================================================
+        for (size_t i = 0; i < sources_number; i++)
+        {
+            struct source *this_source = &sources[i];
+
+            bool available = true;
+
+            while (available)
+            {
+                char *topic;
+                uint8_t *buffer_input;
+                size_t size;
+
+                const int result = receive_byte_message(this_source->socket, &topic, (void **)(&buffer_input), &size, true, 0);
+
+                if (result == EXIT_FAILURE)
+                {
+                    printf("[%zu] ERROR: Some error occurred while receiving messages from source: %zu\n", loops_counter, i);
+
+                    available = false;
+                }
+                else if (size == 0)
+                {
+                    available = false;
+                }
+                else
+                {
+                    if (verbosity > 0)
+                    {
+                        printf("[%zu] Message received from source: %zu (topic: %s)\n", loops_counter, i, topic);
+                    }
+
+                    this_source->messages_number += 1;
+
+                    const int search_type = sorting_stream_search_type(topic);
+
+                    if (search_type == NO_SEARCH)
+                    {
+                        if (verbosity > 0)
+                        {
+                            printf("WARNING: Forwarding unknown message\n");
+                        }
+
+                        send_byte_message(output_socket, topic, (void *)buffer_input, size, 0);
+                    }
+                    else
+                    {
+                        const unsigned int t = (search_type == EVENTS_SEARCH) ? 0 : 1;
+                        struct source_stream *this_data = &this_source->data[t];
+
+                        const size_t events_number = sorting_stream_parse_message(search_type, buffer_input, size,
+                                                                                  &pointers_events_input,
+                                                                                  &pointers_events_input_capacity);
+
+                        if (sorting_stream_reserve((void **)&pointers_sorting_buffer, &pointers_sorting_buffer_capacity,
+                                                   events_number, sizeof(struct event_pointer)))
+                        {
+                            sorting_stream_sort_pointers(pointers_events_input, events_number, pointers_sorting_buffer);
+                        }
+                        else
+                        {
+                            sorting_stream_sort_pointers(pointers_events_input, events_number, NULL);
+                        }
+
+                        // The newest timestamp of the source would hold back
+                        // the watermark after a restart, and its old events
+                        // would not be merged with the new ones. All the
+                        // pending events are flushed and the source starts
+                        // from the new timestamps.
+                        if (events_number > 0 && this_data->received_any &&
+                            source_restarted(&this_data->stream, pointers_events_input[events_number - 1].timestamp,
+                                             this_source->offset, restart_time))
+                        {
+                            printf("WARNING: Source: %zu; timestamps jumped back, flushing the pending events (restart)\n", i);
+
+                            const size_t output_size = merge_sources(sources, sources_number, t, horizon_time, true,
+                                                                     &buffer_output, &buffer_output_capacity,
+                                                                     &last_emitted_timestamps[t], &emitted_any[t]);
+
+                            if (output_size > 0)
+                            {
+                                send_events(output_socket, search_types[t], buffer_output, output_size, verbosity);
+                                msg_ID += 1;
+                            }
+
+                            // The following events are not late with respect
+                            // to the ones before the restart
+                            last_emitted_timestamps[t] = 0;
+                            emitted_any[t] = false;
+
+                            for (size_t j = 0; j < sources_number; j++)
+                            {
+                                sources[j].data[t].stream.emitted_any = false;
+                            }
+
+                            this_data->stream.newest_timestamp = 0;
+                            this_data->stream.restarts += 1;
+                        }
+
+                        const size_t previous_late_events = this_data->stream.late_events;
+
+                        if (!sorting_stream_add(&this_data->stream, buffer_input, pointers_events_input, events_number, this_source->offset))
+                        {
+                            printf("ERROR: Unable to allocate the buffers of source: %zu, the message is lost\n", i);
+                        }
+
+                        if (verbosity > 0 && this_data->stream.late_events > previous_late_events)
+                        {
+                            printf("WARNING: Source: %zu; late events: %zu; total late events: %zu\n", i, this_data->stream.late_events - previous_late_events, this_data->stream.late_events);
+                        }
+
+                        if (this_data->idle && verbosity > 0)
+                        {
+                            printf("Source: %zu is active again\n", i);
+                        }
+
+                        clock_gettime(CLOCK_MONOTONIC, &this_data->last_message);
+                        this_data->received_any = true;
+                        this_data->idle = false;
+                    }
+
+                    free(topic);
+                    free(buffer_input);
+                }
+            }
+        }
+
+        // =====================================================================
+        //  Idle sources
+        // =====================================================================
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        for (size_t i = 0; i < sources_number; i++)
+        {
+            for (unsigned int t = 0; t < DATA_TYPES; t++)
+            {
+                struct source_stream *this_data = &sources[i].data[t];
+
+                if (!this_data->idle && elapsed_ms(&now, &this_data->last_message) > idle_timeout)
+                {
+                    this_data->idle = true;
+
+                    if (verbosity > 0 && this_data->received_any)
+                    {
+                        printf("Source: %zu is idle for the %s\n", i, (t == 0) ? "events" : "waveforms");
+                    }
+                }
+            }
+        }
+
+        // =====================================================================
+        //  Merging of the sources
+        // =====================================================================
+        for (unsigned int t = 0; t < DATA_TYPES; t++)
+        {
+            const size_t output_size = merge_sources(sources, sources_number, t, horizon_time, false,
+                                                     &buffer_output, &buffer_output_capacity,
+                                                     &last_emitted_timestamps[t], &emitted_any[t]);
+
+            if (output_size > 0)
+            {
+                send_events(output_socket, search_types[t], buffer_output, output_size, verbosity);
+                msg_ID += 1;
+            }
+        }
+
+        loops_counter += 1;
+
+        // Putting a delay in order not to fill-up the queues
+        nanosleep(&wait, NULL);
+
+        if (verbosity > 3)
+        {
+            printf("loops_counter: %zu; msg_ID: %zu\n", loops_counter, msg_ID);
+        }
+    }
+
+    // =========================================================================
+    //  Closing up
+    // =========================================================================
+
+    // Flushing the pending events
+    for (unsigned int t = 0; t < DATA_TYPES; t++)
+    {
+        const size_t output_size = merge_sources(sources, sources_number, t, horizon_time, true,
+                                                 &buffer_output, &buffer_output_capacity,
+                                                 &last_emitted_timestamps[t], &emitted_any[t]);
+
+        if (output_size > 0)
+        {
+            send_events(output_socket, search_types[t], buffer_output, output_size, verbosity);
+        }
+    }
+
+    for (size_t i = 0; i < sources_number; i++)
+    {
+        if (verbosity > 0)
+        {
+            printf("Source: %zu; messages: %zu; late events: %zu; late waveforms: %zu; restarts: %zu\n",
+                   i, sources[i].messages_number,
+                   sources[i].data[0].stream.late_events,
+                   sources[i].data[1].stream.late_events,
+                   sources[i].data[0].stream.restarts + sources[i].data[1].stream.restarts);
+        }
+
+        for (unsigned int t = 0; t < DATA_TYPES; t++)
+        {
+            sorting_stream_free(&sources[i].data[t].stream);
+        }
+    }
+
+    free(pointers_events_input);
+    free(pointers_sorting_buffer);
+    free(buffer_output);
+
+    // Wait a bit to allow the sockets to deliver
+    nanosleep(&slow_joiner_wait, NULL);
+
+    for (size_t i = 0; i < sources_number; i++)
+    {
+        const int ic = zmq_close(sources[i].socket);
+        if (ic != 0)
+        {
+            printf("ERROR: ZeroMQ Error on input socket close: %s\n", zmq_strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    const int occ = zmq_close(output_socket);
+    if (occ != 0)
+    {
+        printf("ERROR: ZeroMQ Error on output socket close: %s\n", zmq_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    const int cc = zmq_ctx_destroy(context);
+    if (cc != 0)
+    {
+        printf("ERROR: ZeroMQ Error on context destroy: %s\n", zmq_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void signal_handler(int signum)
+{
+    if (signum == SIGINT || signum == SIGTERM || signum == SIGHUP)
+    {
+        terminate_flag = 1;
+    }
+}
+
+double elapsed_ms(const struct timespec *now, const struct timespec *then)
+{
+    return (now->tv_sec - then->tv_sec) * 1000.0 + (now->tv_nsec - then->tv_nsec) / 1000000.0;
+}
+
+void send_events(void *output_socket, int search_type, uint8_t *buffer, size_t size, unsigned int verbosity)
+{
+    char new_topic[defaults_all_topic_buffer_size];
+
+    if (search_type == EVENTS_SEARCH)
+    {
+        snprintf(new_topic, defaults_all_topic_buffer_size, "data_abcd_events_v0_s%zu", size);
+    }
+    else
+    {
+        snprintf(new_topic, defaults_all_topic_buffer_size, "data_abcd_waveforms_v0_s%zu", size);
+    }
+
+    send_byte_message(output_socket, new_topic, (void *)buffer, size, 0);
+
+    if (verbosity > 0)
+    {
+        printf("Sending message with topic: %s\n", new_topic);
+    }
+}
+
+// Binary min-heap of the sources, ordered by the timestamp of their next
+// event to be merged
+struct merge_heap
+{
+    size_t sources[MAX_SOURCES];
+    size_t size;
+};
+
+bool heap_before(const struct source *sources, const size_t *cursors, unsigned int type, size_t a, size_t b)
+{
+    const uint64_t timestamp_a = sources[a].data[type].stream.pointers[cursors[a]].timestamp;
+    const uint64_t timestamp_b = sources[b].data[type].stream.pointers[cursors[b]].timestamp;
+
+    // On equal timestamps the source order is kept
+    return (timestamp_a < timestamp_b) || (timestamp_a == timestamp_b && a < b);
+}
+
+void heap_sift_down(struct merge_heap *heap, const struct source *sources, const size_t *cursors, unsigned int type, size_t position)
+{
+    while (true)
+    {
+        const size_t left = 2 * position + 1;
+        const size_t right = 2 * position + 2;
+        size_t smallest = position;
+
+        if (left < heap->size && heap_before(sources, cursors, type, heap->sources[left], heap->sources[smallest]))
+        {
+            smallest = left;
+        }
+        if (right < heap->size && heap_before(sources, cursors, type, heap->sources[right], heap->sources[smallest]))
+        {
+            smallest = right;
+        }
+
+        if (smallest == position)
+        {
+            return;
+        }
+
+        const size_t temp = heap->sources[position];
+        heap->sources[position] = heap->sources[smallest];
+        heap->sources[smallest] = temp;
+
+        position = smallest;
+    }
+}
+
+// Determines if the newest timestamp of a message, before the offset
+// correction, jumped back from the newest timestamp of the source by more
+// than the restart time.
+bool source_restarted(const struct sorting_stream *stream, uint64_t newest_timestamp, int64_t offset, uint64_t restart_time)
+{
+    const int64_t corrected = (int64_t)newest_timestamp + offset;
+    const uint64_t newest = (corrected > 0) ? (uint64_t)corrected : 0;
+
+    return (newest < stream->newest_timestamp) && (stream->newest_timestamp - newest) > restart_time;
+}
+
+// Merges the events of all the sources that are older than the watermark,
+// or all the pending events if flush is true. The watermark is the oldest
+// among the newest timestamps of the active sources, minus the horizon.
+// Returns the size of the output.
+size_t merge_sources(struct source *sources, size_t sources_number, unsigned int type,
+                     uint64_t horizon_time, bool flush,
+                     uint8_t **output, size_t *output_capacity,
+                     uint64_t *last_emitted_timestamp, bool *emitted_any)
+{
+    uint64_t watermark = UINT64_MAX;
+
+    if (!flush)
+    {
+        for (size_t i = 0; i < sources_number; i++)
+        {
+            const struct source_stream *this_data = &sources[i].data[type];
+
+            if (!this_data->idle)
+            {
+                // An active source that did not send anything yet holds
+                // back all the others
+                const uint64_t newest = this_data->received_any ? this_data->stream.newest_timestamp : 0;
+                const uint64_t source_watermark = (newest > horizon_time) ? newest - horizon_time : 0;
+
+                watermark = (source_watermark < watermark) ? source_watermark : watermark;
+            }
+        }
+    }
+
+    size_t ready_events[MAX_SOURCES];
+    size_t cursors[MAX_SOURCES];
+    size_t output_size = 0;
+
+    struct merge_heap heap;
+    heap.size = 0;
+
+    for (size_t i = 0; i < sources_number; i++)
+    {
+        const struct sorting_stream *stream = &sources[i].data[type].stream;
+
+        ready_events[i] = flush ? stream->pointers_number : sorting_stream_older_than(stream, watermark);
+        cursors[i] = 0;
+
+        if (ready_events[i] > 0)
+        {
+            output_size += sorting_stream_data_size(stream, ready_events[i]);
+
+            heap.sources[heap.size] = i;
+            heap.size += 1;
+        }
+    }
+
+    if (output_size == 0)
+    {
+        return 0;
+    }
+
+    if (!sorting_stream_reserve((void **)output, output_capacity, output_size, sizeof(uint8_t)))
+    {
+        printf("ERROR: Unable to allocate the output buffer\n");
+
+        return 0;
+    }
+
+    for (size_t position = heap.size; position > 0; position--)
+    {
+        heap_sift_down(&heap, sources, cursors, type, position - 1);
+    }
+
+    // k-way merge of the ready events of the sources
+    size_t output_offset = 0;
+
+    while (heap.size > 0)
+    {
+        const size_t i = heap.sources[0];
+        const struct sorting_stream *stream = &sources[i].data[type].stream;
+        const struct event_pointer pointer_event = stream->pointers[cursors[i]];
+
+        memcpy((*output) + output_offset, stream->data + pointer_event.index, pointer_event.size);
+        output_offset += pointer_event.size;
+
+        *last_emitted_timestamp = pointer_event.timestamp;
+        *emitted_any = true;
+
+        cursors[i] += 1;
+
+        if (cursors[i] >= ready_events[i])
+        {
+            heap.size -= 1;
+            heap.sources[0] = heap.sources[heap.size];
+        }
+
+        heap_sift_down(&heap, sources, cursors, type, 0);
+    }
+
+    for (size_t i = 0; i < sources_number; i++)
+    {
+        struct sorting_stream *stream = &sources[i].data[type].stream;
+
+        sorting_stream_remove(stream, ready_events[i]);
+
+        // The events of any source are late if older than the merged ones
+        stream->last_emitted_timestamp = *last_emitted_timestamp;
+        stream->emitted_any = *emitted_any;
+    }
+
+    return output_size;
+}
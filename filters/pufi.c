@@ -17,37 +17,28 @@
  * along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+
 // This macro is to use nanosleep even with compilation flag: -std=c99
 #define _POSIX_C_SOURCE 199309L
 // This macro is to enable snprintf() in macOS
 #define _C99_SOURCE
 
-// For nanosleep()
-#include <time.h>
 // Fot getopt
 #include <getopt.h>
 // For malloc
 #include <stdlib.h>
-#include <string.h>
-// For ints with fixed size
-#include <stdint.h>
-#include <inttypes.h>
 // For kernel signals management
 #include <signal.h>
 // For snprintf()
 #include <stdio.h>
 // For boolean datatype
 #include <stdbool.h>
-// For the time functions for ISO time
-#include <time.h>
 
-#include <zmq.h>
 #include <jansson.h>
 
 #include "defaults.h"
-#include "events.h"
-#include "socket_functions.h"
-#include "point_in_polygon.h"
+#include "filter_chain.h"
+#include "pufi_plugin.h"
 
 unsigned int terminate_flag = 0;
 
@@ -73,28 +64,39 @@ int main(int argc, char *argv[])
     signal(SIGINT, signal_handler);
     signal(SIGHUP, signal_handler);
 
-    unsigned int verbosity = 0;
-    unsigned int base_period = defaults_pufi_base_period;
-    char *input_address = defaults_abcd_data_address_sub;
-    char *output_address = defaults_pufi_data_address;
+    struct filter_chain_settings settings;
+    settings.input_address = defaults_abcd_data_address_sub;
+    settings.output_address = defaults_pufi_data_address;
+    settings.subscribe_topic = defaults_abcd_data_events_topic;
+    settings.base_period = defaults_pufi_base_period;
+    settings.ade_buffer_size = defaults_cofi_ade_buffer_size;
+    settings.forward_unknown = false;
+    settings.numbered_topics = false;
+    settings.verbosity = 0;
+    settings.terminate_flag = &terminate_flag;
+
+    unsigned int lut_size = defaults_pufi_lut_size;
 
     int c = 0;
-    while ((c = getopt(argc, argv, "hA:D:T:v")) != -1) {
+    while ((c = getopt(argc, argv, "hA:D:T:g:v")) != -1) {
         switch (c) {
             case 'h':
                 print_usage(argv[0]);
                 return EXIT_SUCCESS;
             case 'A':
-                input_address = optarg;
+                settings.input_address = optarg;
                 break;
             case 'D':
-                output_address = optarg;
+                settings.output_address = optarg;
                 break;
             case 'T':
-                base_period = atoi(optarg);
+                settings.base_period = atoi(optarg);
+                break;
+            case 'g':
+                lut_size = atoi(optarg);
                 break;
             case 'v':
-                verbosity += 1;
+                settings.verbosity += 1;
                 break;
             default:
                 printf("Unknown command: %c", c);
@@ -110,426 +112,22 @@ int main(int argc, char *argv[])
         return EXIT_SUCCESS;
     }
 
-    const char *polygon_file_name = argv[optind];
-
-    json_error_t error;
-    json_t *json_config = json_load_file(polygon_file_name, 0, &error);
-
-    if (!json_config)
-    {
-        printf("ERROR: Parse error while reading polygon file: %s (source: %s, line: %d, column: %d, position: %d)\n", error.text, error.source, error.line, error.column, error.position);
-
-        return EXIT_FAILURE;
-    }
-
-    if (!json_is_array(json_config))
-    {
-        printf("ERROR: JSON file does not contain a single array\n");
-
-        json_decref(json_config);
-
-        return EXIT_FAILURE;
-    }
-
-    struct Point_t *all_polygons[ABCD_MAX_NUMBER_OF_CHANNELS];
-    struct BoundingBox_t all_bounding_boxes[ABCD_MAX_NUMBER_OF_CHANNELS];
-    size_t all_number_of_points[ABCD_MAX_NUMBER_OF_CHANNELS];
+    // The filter is a chain with a single stage, that reads the polygons
+    json_t *json_stage = json_object();
+    json_object_set_new(json_stage, "filter", json_string(pufi_plugin.name));
+    json_object_set_new(json_stage, "polygons_file", json_string(argv[optind]));
+    json_object_set_new(json_stage, "lut_size", json_integer(lut_size));
 
-    for (int channel = 0; channel < ABCD_MAX_NUMBER_OF_CHANNELS; channel += 1)
-    {
-        all_polygons[channel] = NULL;
-        all_number_of_points[channel] = 0;
-    }
+    json_t *json_chain = json_array();
+    json_array_append_new(json_chain, json_stage);
 
-    size_t polygons_counter = 0;
-    size_t index;
-    json_t *value;
-
-    json_array_foreach(json_config, index, value) {
-        // The id may be a single integer or an array of integers
-        json_t *json_id = json_object_get(value, "id");
-
-        unsigned int channel_ids[ABCD_MAX_NUMBER_OF_CHANNELS];
-        unsigned int channel_ids_counter = 0;
-
-        if (json_id != NULL && json_is_integer(json_id)) {
-            const int id = json_number_value(json_id);
-
-            if (0 <= id && id < ABCD_MAX_NUMBER_OF_CHANNELS) {
-                channel_ids[channel_ids_counter] = id;
-                channel_ids_counter += 1;
-
-                if (verbosity > 0)
-                {
-                    printf("Found single channel %d\n", id);
-                }
-            } else {
-                printf("ERROR: Channel ids out of range, got: %d, skipping it\n", id);
-            }
-        } else if (json_id != NULL && json_is_array(json_id)) {
-            size_t id_index;
-            json_t *id_value;
-
-            json_array_foreach(json_id, id_index, id_value) {
-                if (id_value != NULL && json_is_integer(id_value)) {
-                    const int id = json_number_value(id_value);
-
-                    if (0 <= id && id < ABCD_MAX_NUMBER_OF_CHANNELS) {
-                        channel_ids[channel_ids_counter] = id;
-                        channel_ids_counter += 1;
-
-                        if (verbosity > 0)
-                        {
-                            printf("Found channel %d\n", id);
-                        }
-                    } else {
-                        printf("ERROR: Channel id out of range, got: %d, skipping it\n", id);
-                    }
-                }
-            }
-        } else {
-            printf("ERROR: Unable to find channel id, skipping this configuration\n");
-            continue;
-        }
-
-        json_t *json_polygon = json_object_get(value, "polygon");
-
-        if (!json_is_array(json_polygon))
-        {
-            printf("ERROR: The polygon definition should be an array, skipping this configuration\n");
-            continue;
-        }
-
-        const size_t number_of_points = json_array_size(json_polygon);
-
-        if (number_of_points < 3)
-        {
-            printf("ERROR: Polygon for has less than 3 points, skipping this configuration\n");
-            continue;
-        }
+    const struct filter_plugin *plugins[] = {&pufi_plugin};
 
-        for (unsigned int id_index = 0; id_index < channel_ids_counter; id_index += 1) {
-            // Recreating the polygon for all the channels so there would
-            // not be a double free for repeated channels
-            struct Point_t *polygon = (struct Point_t *)calloc((number_of_points + 1), sizeof(struct Point_t));
+    const int result = filter_chain_run(&settings, json_chain, plugins, 1);
 
-            if (polygon == NULL)
-            {
-                printf("ERROR: Unable to allocate memory for polygon\n");
-                continue;
-            }
+    json_decref(json_chain);
 
-            size_t index;
-            json_t *json_point;
-
-            json_array_foreach(json_polygon, index, json_point) {
-                polygon[index].x = json_number_value(json_object_get(json_point, "x"));
-                polygon[index].y = json_number_value(json_object_get(json_point, "y"));
-            }
-
-            // Close the loop
-            polygon[number_of_points].x = polygon[0].x;
-            polygon[number_of_points].y = polygon[0].y;
-
-            struct BoundingBox_t bounding_box = compute_bounding_box(polygon, number_of_points);
-
-            unsigned int channel = channel_ids[id_index];
-
-            all_polygons[channel] = polygon;
-            all_bounding_boxes[channel] = bounding_box;
-            all_number_of_points[channel] = number_of_points;
-
-            if (verbosity > 0)
-            {
-                printf("Loaded polygon for channel %u with %zu points\n", channel, number_of_points);
-            }
-        }
-
-        polygons_counter++;
-    }
-
-    json_decref(json_config);
-
-    if (polygons_counter == 0)
-    {
-        printf("ERROR: No valid polygons loaded\n");
-        return EXIT_FAILURE;
-    }
-
-    if (verbosity > 0) {
-        printf("Input socket address: %s\n", input_address);
-        printf("Output socket address: %s\n", output_address);
-        printf("Verbosity: %u\n", verbosity);
-        printf("Base period: %u\n", base_period);
-        printf("Number of polygons: %zu\n", polygons_counter);
-    }
-
-    if (verbosity > 1) {
-        for (size_t channel = 0; channel < ABCD_MAX_NUMBER_OF_CHANNELS; channel += 1)
-        {
-            if (all_polygons[channel] != NULL) {
-                printf("Channel %zu\n", channel);
-
-                for (size_t index_point = 0; index_point < all_number_of_points[channel] + 1; index_point++)
-                {
-                    printf("[i: %zu] point x: %f; y: %f;\n", index_point, all_polygons[channel][index_point].x, all_polygons[channel][index_point].y);
-                }
-                printf("Bounding box: x: [%f, %f]; y: [%f, %f];\n", all_bounding_boxes[channel].top_left.x,
-                                                                    all_bounding_boxes[channel].bottom_right.x,
-                                                                    all_bounding_boxes[channel].bottom_right.y,
-                                                                    all_bounding_boxes[channel].top_left.y);
-            }
-        }
-    }
-
-    // Creates a ZeroMQ context
-    void *context = zmq_ctx_new();
-    if (!context)
-    {
-        printf("ERROR: ZeroMQ Error on context creation");
-        return EXIT_FAILURE;
-    }
-
-    void *input_socket = zmq_socket(context, ZMQ_SUB);
-    if (!input_socket)
-    {
-        printf("ERROR: ZeroMQ Error on input socket creation\n");
-        return EXIT_FAILURE;
-    }
-
-    void *output_socket = zmq_socket(context, ZMQ_PUB);
-    if (!output_socket)
-    {
-        printf("ERROR: ZeroMQ Error on output socket creation\n");
-        return EXIT_FAILURE;
-    }
-
-    const int is = zmq_connect(input_socket, input_address);
-    if (is != 0)
-    {
-        printf("ERROR: ZeroMQ Error on input socket binding: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-
-    const int os = zmq_bind(output_socket, output_address);
-    if (os != 0)
-    {
-        printf("ERROR: ZeroMQ Error on output socket connection: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-
-    // Subscribe to data topic
-    zmq_setsockopt(input_socket, ZMQ_SUBSCRIBE, defaults_abcd_data_events_topic, strlen(defaults_abcd_data_events_topic));
-
-    // Wait a bit to prevent the slow-joiner syndrome
-    struct timespec slow_joiner_wait;
-    slow_joiner_wait.tv_sec = defaults_all_slow_joiner_wait / 1000;
-    slow_joiner_wait.tv_nsec = (defaults_all_slow_joiner_wait % 1000) * 1000000L;
-    nanosleep(&slow_joiner_wait, NULL);
-
-    // Setting up the wait for the main loop
-    struct timespec wait;
-    wait.tv_sec = base_period / 1000;
-    wait.tv_nsec = (base_period % 1000) * 1000000L;
-
-    size_t counter = 0;
-    size_t msg_counter = 0;
-    size_t msg_ID = 0;
-
-    while (terminate_flag == 0)
-    {
-        char *topic;
-        char *input_buffer;
-        size_t size;
-
-        const int result = receive_byte_message(input_socket, &topic, (void **)(&input_buffer), &size, true, verbosity);
-
-        if (result == EXIT_FAILURE)
-        {
-            printf("[%zu] ERROR: Some error occurred!!!\n", counter);
-        }
-        else if (size == 0 && result == EXIT_SUCCESS)
-        {
-            if (verbosity > 2)
-            {
-                printf("[%zu] No message available\n", counter);
-            }
-        }
-        else if (size > 0 && result == EXIT_SUCCESS)
-        {
-            if (verbosity > 0)
-            {
-                printf("[%zu] Message received!!! (topic: %s)\n", counter, topic);
-            }
-
-            // Check if the topic is the right one
-            if (strstr(topic, "data_abcd_events_v0") == topic)
-            {
-                const clock_t event_start = clock();
-
-                const size_t events_number = size / sizeof(struct event_PSD);
-
-                size_t bounding_box_selected_number = 0;
-                size_t polygon_selected_number = 0;
-                size_t selected_number = 0;
-
-                struct event_PSD *events = (void *)input_buffer;
-
-                if ((size % sizeof(struct event_PSD)) != 0)
-                {
-                    printf("[%zu] ERROR: The buffer size is not a multiple of %zu\n", counter, sizeof(struct event_PSD));
-                }
-                else
-                {
-                    struct event_PSD *selected_events = malloc(sizeof(struct event_PSD) * events_number);
-
-                    if (selected_events == NULL)
-                    {
-                        printf("[%zu] ERROR: Unable to allocate output buffer\n", counter);
-                    }
-                    else
-                    {
-                        for (size_t i = 0; i < events_number; i++)
-                        {
-                            const struct event_PSD this_event = events[i];
-                            //printf("i: %zu, ch: %d, t: %lu\n", i, this_event.channel, this_event.timestamp);
-
-                            const uint8_t channel = this_event.channel;
-                            struct Point_t *polygon = all_polygons[channel];
-
-                            // Not filtering events without a polygon
-                            if (polygon == NULL)
-                            {
-                                if (verbosity > 2)
-                                {
-                                    printf("Channel %" PRIu8 " has no polygon, keeping it\n", channel);
-                                }
-
-                                selected_events[selected_number] = this_event;
-
-                                selected_number++;
-                            } else {
-                                // We cast everything to double because the winding algorithm is
-                                // expecting two variables of the same type.
-                                const double energy = this_event.qlong;
-                                const double PSD = (energy - this_event.qshort) / energy;
-                                const struct Point_t point = {energy, PSD};
-
-                                struct BoundingBox_t bounding_box = all_bounding_boxes[channel];
-                                size_t number_of_points = all_number_of_points[channel];
-
-                                if (point_in_bounding_box(point, bounding_box))
-                                {
-                                    bounding_box_selected_number++;
-
-                                    const int winding_number = point_winding_number(point, polygon, number_of_points);
-
-                                    if (verbosity > 1)
-                                    {
-                                        printf("Point in bounding box i: %zu; ch: %" PRIu8 "; energy: %f; PSD: %f; winding_number: %d;\n", i, channel, energy, PSD, winding_number);
-                                    }
-
-                                    // The winding number is zero only when the point is outside the polygon
-                                    if (winding_number != 0)
-                                    {
-                                        selected_events[selected_number] = this_event;
-
-                                        selected_number++;
-                                        polygon_selected_number++;
-
-                                        if (verbosity > 1)
-                                        {
-                                            printf("Point selected!!!\n");
-                                        }
-                                    }
-                                }
-                            }
-                        }
-
-                        const size_t output_size = selected_number * sizeof(struct event_PSD);
-
-                        // Compute the new topic
-                        char new_topic[defaults_all_topic_buffer_size];
-                        snprintf(new_topic, defaults_all_topic_buffer_size, "data_abcd_events_v0_s%zu", output_size);
-
-                        send_byte_message(output_socket, new_topic, (void *)selected_events, output_size, verbosity);
-                        msg_ID += 1;
-
-                        if (verbosity > 0)
-                        {
-                            printf("Sending message with topic: %s\n", new_topic);
-                        }
-
-                        free(selected_events);
-                    }
-                }
-
-                const clock_t event_stop = clock();
-
-                if (verbosity > 0)
-                {
-                    const float elaboration_time = (float)(event_stop - event_start) / CLOCKS_PER_SEC * 1000; // ms
-                    const float elaboration_speed = events_number / (elaboration_time / 1000.0);
-
-                    printf("size: %zu; events_number: %zu; bounding_box_selected_number: %zu; polygon_selected_number: %zu; selected_number: %zu; ratio: %.2f%%; elaboration_time: %f ms; elaboration_speed: %.0f events/s\n", size, events_number, bounding_box_selected_number, polygon_selected_number, selected_number, selected_number / (float)events_number * 100, elaboration_time, elaboration_speed);
-                }
-            }
-
-            msg_counter += 1;
-
-            // Remember to free buffers
-            free(topic);
-            free(input_buffer);
-        }
-        else
-        {
-            printf("[%zu] ERROR: What?!?!?!\n", counter);
-        }
-
-        counter += 1;
-
-        // Putting a delay in order not to fill-up the queues
-        nanosleep(&wait, NULL);
-
-        if (verbosity > 2)
-        {
-            printf("counter: %zu; msg_counter: %zu, msg_ID: %zu\n", counter, msg_counter, msg_ID);
-        }
-    }
-
-    for (int channel = 0; channel < ABCD_MAX_NUMBER_OF_CHANNELS; channel += 1)
-    {
-        if (all_polygons[channel] != NULL)
-        {
-            free(all_polygons[channel]);
-        }
-    }
-
-    // Wait a bit to allow the sockets to deliver
-    nanosleep(&slow_joiner_wait, NULL);
-
-    const int ic = zmq_close(input_socket);
-    if (ic != 0)
-    {
-        printf("ERROR: ZeroMQ Error on input socket close: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-    
-    const int oc = zmq_close(output_socket);
-    if (oc != 0)
-    {
-        printf("ERROR: ZeroMQ Error on output socket close: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-    
-    const int cc = zmq_ctx_destroy(context);
-    if (cc != 0)
-    {
-        printf("ERROR: ZeroMQ Error on context destroy: %s\n", zmq_strerror(errno));
-        return EXIT_FAILURE;
-    }
-    
-    return EXIT_SUCCESS;
+    return result;
 }
 
 void print_usage(const char *name) {
@@ -555,6 +153,8 @@ void print_usage(const char *name) {
     printf("\t-A <address>: Input socket address, default: %s\n", defaults_abcd_data_address_sub);
     printf("\t-D <address>: Output socket address for coincidence data, default: %s\n", defaults_pufi_data_address);
     printf("\t-T <period>: Set base period in milliseconds, default: %d\n", defaults_pufi_base_period);
+    printf("\t-g <size>: Number of cells per axis of the lookup tables of the polygons, default: %d\n", defaults_pufi_lut_size);
+    printf("\t           The events in the cells crossed by the polygon edges are tested exactly.\n");
 
     return;
 }
@@ -9,6 +9,15 @@
 #include <iostream>
 #include <algorithm>
 #include <cstdint>
+#include <utility>
+#include <iterator>
+#include <string>
+#include <cstdio>
+
+// For the segment files of the disk tier
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 namespace binary_fifo {
     // Definition of a standard long int type, in order to be able to change it easily
@@ -22,39 +31,447 @@ namespace binary_fifo {
     typedef std::chrono::time_point <clock, nanoseconds> time_point;
     typedef std::vector <uint8_t> binary_data;
 
+    // Read-only view of a stored datum, it avoids copying the data when it is
+    // passed to the callbacks or returned to the users.
+    // It is valid until the next modification of the FIFO.
+    class binary_view
+    {
+        public:
+            const uint8_t *pointer;
+            size_t length;
+
+            binary_view(const uint8_t *Pointer = nullptr, size_t Length = 0) : \
+                pointer(Pointer), length(Length) {};
+            binary_view(const binary_data &Data) : \
+                pointer(Data.data()), length(Data.size()) {};
+
+            inline const uint8_t *data() const { return pointer; }
+            inline size_t size() const { return length; }
+            inline bool empty() const { return length == 0; }
+            inline const uint8_t *begin() const { return pointer; }
+            inline const uint8_t *end() const { return pointer + length; }
+            inline uint8_t operator[](size_t index) const { return pointer[index]; }
+
+            inline binary_data copy() const { return binary_data(begin(), end()); }
+    };
+
     class datum
     {
         public:
             binary_data data;
             time_point timestamp;
 
-            datum(binary_data Buffer, time_point Timestamp = clock::now()) : \
-                data(Buffer), timestamp(Timestamp) {};
+            // Position of the data in the ring arena, if the FIFO uses it
+            size_t offset;
+            size_t length;
+
+            // The data is moved in the datum, to avoid copying big messages
+            datum(binary_data &&Buffer, time_point Timestamp = clock::now()) : \
+                data(std::move(Buffer)), timestamp(Timestamp), offset(0), length(data.size()) {};
+            datum(size_t Offset, size_t Length, time_point Timestamp) : \
+                timestamp(Timestamp), offset(Offset), length(Length) {};
             ~datum() {};
+
+            datum(datum &&) = default;
+            datum &operator=(datum &&) = default;
+            datum(const datum &) = delete;
+            datum &operator=(const datum &) = delete;
     };
 
-    inline bool operator<(datum a, datum b)
+    inline bool operator<(const datum &a, const datum &b)
     {
         return a.timestamp < b.timestamp;
     }
 
-    inline bool operator>(datum a, datum b)
+    inline bool operator>(const datum &a, const datum &b)
     {
         return a.timestamp > b.timestamp;
     }
 
+    // Append-only file of the disk tier, with the same format of
+    // binary_fifo::save_to_file(). The index of the records is kept in
+    // memory and the data is read through a memory mapping of the file.
+    class segment
+    {
+        public:
+            struct record
+            {
+                time_point timestamp;
+                // Position of the data in the file, after the record header
+                size_t offset;
+                size_t length;
+            };
+
+            std::string path;
+            int file_descriptor;
+            size_t file_size;
+
+            std::vector<record> index;
+
+            uint8_t *mapping;
+            size_t mapped_size;
+
+            // No more records are appended after a write error
+            bool sealed;
+
+            segment(const std::string &Path) : \
+                path(Path), file_descriptor(-1), file_size(0), mapping(nullptr), mapped_size(0),
+                sealed(false)
+            {
+                file_descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+            };
+
+            ~segment()
+            {
+                _unmap();
+
+                if (file_descriptor >= 0)
+                {
+                    ::close(file_descriptor);
+                    std::remove(path.c_str());
+                }
+            };
+
+            segment(segment &&other) : \
+                path(std::move(other.path)), file_descriptor(other.file_descriptor),
+                file_size(other.file_size), index(std::move(other.index)),
+                mapping(other.mapping), mapped_size(other.mapped_size), sealed(other.sealed)
+            {
+                other.file_descriptor = -1;
+                other.mapping = nullptr;
+                other.mapped_size = 0;
+            };
+            segment &operator=(segment &&) = delete;
+            segment(const segment &) = delete;
+            segment &operator=(const segment &) = delete;
+
+            inline bool is_open() const
+            {
+                return file_descriptor >= 0;
+            }
+
+            inline void _unmap()
+            {
+                if (mapping)
+                {
+                    ::munmap(mapping, mapped_size);
+                }
+
+                mapping = nullptr;
+                mapped_size = 0;
+            }
+
+            //! Maps the whole file, if it grew since the last mapping
+            inline bool _map()
+            {
+                if (mapped_size == file_size)
+                {
+                    return true;
+                }
+
+                _unmap();
+
+                void *new_mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+
+                if (new_mapping == MAP_FAILED)
+                {
+                    return false;
+                }
+
+                mapping = reinterpret_cast<uint8_t*>(new_mapping);
+                mapped_size = file_size;
+
+                return true;
+            }
+
+            inline bool append(const binary_view &data, time_point timestamp, long_int since)
+            {
+                const long_uint size = data.size();
+
+                uint8_t header[sizeof(long_int) + sizeof(long_uint)];
+                std::copy(reinterpret_cast<const uint8_t*>(&since),
+                          reinterpret_cast<const uint8_t*>(&since) + sizeof(long_int),
+                          header);
+                std::copy(reinterpret_cast<const uint8_t*>(&size),
+                          reinterpret_cast<const uint8_t*>(&size) + sizeof(long_uint),
+                          header + sizeof(long_int));
+
+                if (!_write(header, sizeof(header)) || !_write(data.data(), data.size()))
+                {
+                    // The partial record is not indexed and no other record
+                    // is appended after it, only the indexed part is mapped
+                    sealed = true;
+
+                    return false;
+                }
+
+                index.push_back({timestamp, file_size + sizeof(header), data.size()});
+
+                file_size += sizeof(header) + data.size();
+
+                return true;
+            }
+
+            inline bool _write(const uint8_t *buffer, size_t size)
+            {
+                while (size > 0)
+                {
+                    const ssize_t written = ::write(file_descriptor, buffer, size);
+
+                    if (written <= 0)
+                    {
+                        return false;
+                    }
+
+                    buffer += written;
+                    size -= written;
+                }
+
+                return true;
+            }
+
+            inline time_point first_timestamp() const
+            {
+                return index.front().timestamp;
+            }
+
+            inline time_point last_timestamp() const
+            {
+                return index.back().timestamp;
+            }
+
+            //! Calls fn(timestamp, data) for the records in the time range,
+            //! with the same selection of binary_fifo
+            template <class function_type>
+            inline void for_each(time_point begin, time_point end, function_type &fn)
+            {
+                if (index.empty() || !_map())
+                {
+                    return;
+                }
+
+                auto before = [](const record &r, const time_point &t) {
+                    return r.timestamp < t;
+                };
+
+                const auto start = (begin < end) ? std::lower_bound(index.begin(), index.end(), begin, before)
+                                                 : index.begin();
+                const auto stop = std::lower_bound(start, index.end(), end, before);
+
+                for (auto it = start; it != stop; it++)
+                {
+                    fn(it->timestamp, binary_view(mapping + it->offset, it->length));
+                }
+            }
+    };
+
+    // Second tier of the FIFO, the data dropped from the memory is appended
+    // to the segment files up to a disk budget. When the budget is exceeded,
+    // the oldest segment file is deleted.
+    // The timestamps must be increasing, older timestamps are raised to the
+    // newest one. The segment files are deleted with the FIFO.
+    class disk_tier
+    {
+        public:
+            std::string directory;
+            size_t budget;
+            size_t segment_size;
+
+            std::deque<segment> segments;
+
+            size_t stored_count;
+            size_t stored_bytes;
+
+            size_t evicted_segments;
+            size_t evicted_bytes;
+            // Data that could not be written
+            size_t rejected_count;
+
+            size_t segments_created;
+
+            disk_tier() : \
+                budget(0), segment_size(0), stored_count(0), stored_bytes(0),
+                evicted_segments(0), evicted_bytes(0), rejected_count(0), segments_created(0) {};
+
+            disk_tier(disk_tier &&) = default;
+            disk_tier &operator=(disk_tier &&) = default;
+
+            inline bool enabled() const
+            {
+                return budget > 0;
+            }
+
+            //! A zero budget disables the tier and deletes the segment files
+            inline void configure(const std::string &Directory, size_t Budget, size_t Segment_Size)
+            {
+                segments.clear();
+                stored_count = 0;
+                stored_bytes = 0;
+
+                directory = Directory.empty() ? std::string(".") : Directory;
+                budget = Budget;
+
+                // At least a few segments in the budget, so that deleting the
+                // oldest one does not drop most of the data
+                segment_size = std::max<size_t>(std::min(Segment_Size, budget / 4), 1);
+            }
+
+            inline bool append(const binary_view &data, time_point timestamp, long_int since)
+            {
+                const size_t record_size = sizeof(long_int) + sizeof(long_uint) + data.size();
+
+                if (record_size > budget)
+                {
+                    rejected_count += 1;
+                    return false;
+                }
+
+                if (!segments.empty() && !segments.back().index.empty())
+                {
+                    const time_point last = segments.back().last_timestamp();
+
+                    if (timestamp < last)
+                    {
+                        since += (last - timestamp).count();
+                        timestamp = last;
+                    }
+                }
+
+                if (segments.empty() || segments.back().sealed ||
+                    (!segments.back().index.empty() && segments.back().file_size + record_size > segment_size))
+                {
+                    segments_created += 1;
+
+                    const std::string path = directory + "/fifo_segment_"
+                                           + std::to_string(::getpid()) + "_"
+                                           + std::to_string(segments_created) + ".bin";
+
+                    segments.emplace_back(path);
+
+                    if (!segments.back().is_open())
+                    {
+                        segments.pop_back();
+                        rejected_count += 1;
+                        return false;
+                    }
+                }
+
+                if (!segments.back().append(data, timestamp, since))
+                {
+                    rejected_count += 1;
+                    return false;
+                }
+
+                stored_count += 1;
+                stored_bytes += record_size;
+
+                while (stored_bytes > budget && segments.size() > 1)
+                {
+                    evicted_segments += 1;
+                    evicted_bytes += segments.front().file_size;
+
+                    stored_count -= segments.front().index.size();
+                    stored_bytes -= segments.front().file_size;
+
+                    segments.pop_front();
+                }
+
+                return true;
+            }
+
+            inline bool empty() const
+            {
+                return stored_count == 0;
+            }
+
+            inline time_point first_timestamp() const
+            {
+                for (const auto &this_segment: segments)
+                {
+                    if (!this_segment.index.empty())
+                    {
+                        return this_segment.first_timestamp();
+                    }
+                }
+
+                return time_point();
+            }
+
+            template <class function_type>
+            inline void for_each(time_point begin, time_point end, function_type &fn)
+            {
+                for (auto &this_segment: segments)
+                {
+                    if (this_segment.index.empty())
+                    {
+                        continue;
+                    }
+                    // The segments after this one are all younger
+                    if (!(this_segment.first_timestamp() < end))
+                    {
+                        break;
+                    }
+                    if (begin < end && this_segment.last_timestamp() < begin)
+                    {
+                        continue;
+                    }
+
+                    this_segment.for_each(begin, end, fn);
+                }
+            }
+    };
+
+    // The data is kept sorted by timestamp, so that the time ranges are found
+    // with a binary search.
+    // The time ranges are selected with: begin <= timestamp < end, if begin is
+    // not before end then all the data before end is selected.
+    //
+    // With a disk tier, the data dropped from the memory is appended to the
+    // segment files and the queries read from both tiers.
+    //
+    // With a memory budget the data is copied in a preallocated ring arena,
+    // instead of being kept in its own vector. The oldest data is evicted
+    // when a new datum does not fit in the arena, so the memory usage is
+    // bounded also during the rate spikes. In this mode the timestamps must
+    // be increasing, older timestamps are raised to the newest one.
     class binary_fifo
     {
         public:
+            typedef typename std::deque<datum>::iterator iterator;
+
+            // The data in the arena is aligned to this size, so that it can be
+            // accessed as an array of numbers
+            static constexpr size_t arena_alignment = 8;
+
             nanoseconds expiration_time;
 
             std::tm epoch_struct;
             time_point epoch;
 
             std::deque<datum> buffer;
+
+            // Total size of the stored data
+            size_t stored_bytes;
+
+            // The ring arena is used only if it is not empty.
+            // The stored data is between arena_head and arena_tail, that may
+            // wrap around the end of the arena.
+            binary_data arena;
+            size_t arena_head;
+            size_t arena_tail;
+
+            // Data dropped to respect the memory budget
+            size_t evicted_count;
+            size_t evicted_bytes;
+            // Data bigger than the whole arena, that could not be stored
+            size_t rejected_count;
+
+            disk_tier disk;
             
             binary_fifo(nanoseconds Expiration_Time = nanoseconds()) : \
-                expiration_time(Expiration_Time)
+                expiration_time(Expiration_Time), stored_bytes(0),
+                arena_head(0), arena_tail(0),
+                evicted_count(0), evicted_bytes(0), rejected_count(0)
             {
                 epoch_struct.tm_sec = 0;
                 epoch_struct.tm_min = 0;
@@ -74,6 +491,10 @@ namespace binary_fifo {
 
             ~binary_fifo() {};
 
+            // The data is not copyable, so neither is the FIFO
+            binary_fifo(binary_fifo &&) = default;
+            binary_fifo &operator=(binary_fifo &&) = default;
+
             inline void set_expiration_time(long_int new_interval)
             {
                 expiration_time = nanoseconds(new_interval);
@@ -84,201 +505,379 @@ namespace binary_fifo {
                 return expiration_time.count();
             }
 
-            inline void update()
+            //! Allocates the ring arena and drops the stored data.
+            //! A zero budget reverts to storing each datum in its own vector.
+            inline void set_memory_budget(size_t budget)
             {
-                if (expiration_time > nanoseconds(0))
+                buffer.clear();
+                stored_bytes = 0;
+
+                // The budget is rounded down so that the aligned positions
+                // never pass the end of the arena
+                binary_data new_arena(budget - budget % arena_alignment);
+                arena.swap(new_arena);
+                arena_head = 0;
+                arena_tail = 0;
+            }
+
+            inline size_t get_memory_budget() const
+            {
+                return arena.size();
+            }
+
+            inline bool uses_arena() const
+            {
+                return !arena.empty();
+            }
+
+            inline size_t get_evicted_count() const
+            {
+                return evicted_count;
+            }
+
+            inline size_t get_evicted_bytes() const
+            {
+                return evicted_bytes;
+            }
+
+            inline size_t get_rejected_count() const
+            {
+                return rejected_count;
+            }
+
+            //! Enables the disk tier, a zero budget disables it
+            inline void set_disk_tier(const std::string &directory, size_t budget, size_t segment_size)
+            {
+                disk.configure(directory, budget, segment_size);
+            }
+
+            inline size_t get_disk_budget() const
+            {
+                return disk.budget;
+            }
+
+            inline size_t disk_count() const
+            {
+                return disk.stored_count;
+            }
+
+            inline size_t disk_size() const
+            {
+                return disk.stored_bytes;
+            }
+
+            inline size_t get_disk_evicted_segments() const
+            {
+                return disk.evicted_segments;
+            }
+
+            inline size_t get_disk_rejected_count() const
+            {
+                return disk.rejected_count;
+            }
+
+            //! Returns the timestamp of the oldest stored datum, in either
+            //! tier, or the epoch if the FIFO is empty
+            inline time_point get_oldest_timestamp() const
+            {
+                if (!disk.empty())
                 {
-                    const time_point now = std::chrono::system_clock::now();
+                    return disk.first_timestamp();
+                }
+
+                return buffer.empty() ? epoch : buffer.front().timestamp;
+            }
+
+            inline binary_view view(const datum &d) const
+            {
+                if (uses_arena())
+                {
+                    return binary_view(arena.data() + d.offset, d.length);
+                }
+                else
+                {
+                    return binary_view(d.data);
+                }
+            }
 
-                    for (auto it = buffer.begin(); it != buffer.end(); it++)
+            //! Removes the oldest data up to the given position, moving it
+            //! to the disk tier if it is enabled
+            inline void _erase_front(iterator last)
+            {
+                for (auto it = buffer.begin(); it != last; it++)
+                {
+                    stored_bytes -= it->length;
+
+                    if (disk.enabled())
                     {
-                        const nanoseconds time_difference = now - it->timestamp;
+                        disk.append(view(*it), it->timestamp, (it->timestamp - epoch).count());
+                    }
+                }
+
+                buffer.erase(buffer.begin(), last);
+
+                if (buffer.empty())
+                {
+                    arena_head = 0;
+                    arena_tail = 0;
+                }
+                else
+                {
+                    arena_head = buffer.front().offset;
+                }
+            }
 
-                        if (time_difference > expiration_time)
+            //! Finds the position of a datum in the arena, evicting the
+            //! oldest data until it fits
+            inline size_t _arena_reserve(size_t length)
+            {
+                while (!buffer.empty())
+                {
+                    if (arena_head < arena_tail)
+                    {
+                        // The free space is at the end and at the beginning
+                        if (arena_tail + length <= arena.size())
                         {
-                            buffer.pop_front();
+                            return arena_tail;
                         }
-                        else
+                        else if (length <= arena_head)
                         {
-                            break;
+                            return 0;
                         }
                     }
+                    else if (arena_tail + length <= arena_head)
+                    {
+                        // The data wraps around, the free space is in between
+                        return arena_tail;
+                    }
+
+                    evicted_count += 1;
+                    evicted_bytes += buffer.front().length;
+
+                    _erase_front(std::next(buffer.begin()));
                 }
+
+                return 0;
             }
 
-            
-            inline void push(binary_data data)
+            inline void update()
+            {
+                if (expiration_time > nanoseconds(0))
+                {
+                    const time_point now = std::chrono::system_clock::now();
+
+                    _erase_front(_find_first_younger(now - expiration_time));
+                }
+            }
+
+            //! Stores a datum in the ring arena, evicting the oldest data if
+            //! there is not enough space, and returns where its data shall be
+            //! written, so that it can be received directly in the arena.
+            //! It returns nullptr if the datum is bigger than the whole arena.
+            inline uint8_t *arena_push(size_t length, time_point timestamp = clock::now())
             {
-                buffer.emplace_back(data, clock::now());
+                if (length > arena.size())
+                {
+                    rejected_count += 1;
+                    return nullptr;
+                }
+
+                if (!buffer.empty() && timestamp < buffer.back().timestamp)
+                {
+                    timestamp = buffer.back().timestamp;
+                }
+
+                const size_t offset = _arena_reserve(length);
+
+                const size_t end = offset + length;
+                arena_tail = end + (arena_alignment - end % arena_alignment) % arena_alignment;
+
+                stored_bytes += length;
+
+                buffer.emplace_back(offset, length, timestamp);
+
+                return arena.data() + offset;
+            }
+
+            //! Copies the data in the ring arena
+            inline void _push_arena(const uint8_t *data, size_t length, time_point timestamp)
+            {
+                uint8_t *destination = arena_push(length, timestamp);
+
+                if (destination)
+                {
+                    std::copy(data, data + length, destination);
+                }
+            }
+
+            //! The data is moved in the FIFO, the timestamps are usually
+            //! increasing, otherwise the datum is inserted in its position
+            inline void push(binary_data &&data, time_point timestamp = clock::now())
+            {
+                if (uses_arena())
+                {
+                    _push_arena(data.data(), data.size(), timestamp);
+                    return;
+                }
+
+                stored_bytes += data.size();
+
+                if (buffer.empty() || !(timestamp < buffer.back().timestamp))
+                {
+                    buffer.emplace_back(std::move(data), timestamp);
+                }
+                else
+                {
+                    const iterator position = std::upper_bound(buffer.begin(), buffer.end(), timestamp,
+                                                               [](const time_point &t, const datum &d) {
+                                                                   return t < d.timestamp;
+                                                               });
+
+                    buffer.emplace(position, std::move(data), timestamp);
+                }
 
                 //update();
             }
 
-            inline void push_vector(std::vector<binary_data> data)
+            inline void push_vector(std::vector<binary_data> &&data)
             {
+                const time_point now = clock::now();
+
                 for (binary_data &these_data: data)
                 {
-                    buffer.emplace_back(these_data, clock::now());
+                    push(std::move(these_data), now);
                 }
 
                 //update();
             }
             
-            inline typename std::deque<datum>::iterator _find_first_younger(time_point timestamp)
+            inline iterator _find_first_younger(time_point timestamp)
             {
                 //update();
 
-                for (auto it = buffer.begin(); it != buffer.end(); it++)
+                return std::lower_bound(buffer.begin(), buffer.end(), timestamp,
+                                        [](const datum &d, const time_point &t) {
+                                            return d.timestamp < t;
+                                        });
+            }
+
+            //! Returns the first and the past-the-end data of the time range
+            inline std::pair<iterator, iterator> _find_range(time_point begin, time_point end)
+            {
+                const iterator start = (begin < end) ? _find_first_younger(begin) : buffer.begin();
+                const iterator stop = _find_first_younger(end);
+
+                return std::make_pair(start, stop);
+            }
+
+            //! Calls fn(timestamp, data) for the data in the time range,
+            //! first from the disk tier and then from the memory
+            template <class function_type>
+            inline void _for_each(time_point begin, time_point end, function_type fn)
+            {
+                disk.for_each(begin, end, fn);
+
+                const auto range = _find_range(begin, end);
+
+                for (auto it = range.first; it != range.second; it++)
                 {
-                    if (timestamp <= (it->timestamp))
-                    {
-                        return it;
-                    }
+                    fn(it->timestamp, view(*it));
                 }
-
-                return buffer.end();
             }
 
             template <class returned_type>
             inline returned_type reduce( \
-                                        std::function<returned_type (returned_type, binary_data)> fn, \
+                                        std::function<returned_type (returned_type, const binary_view&)> fn, \
                                         time_point begin = clock::now() + nanoseconds(1000000000ULL), \
                                         time_point end = clock::now(), \
                                         returned_type initial_aggregate = returned_type())
             {
                 //update();
 
-                typename std::deque<datum>::iterator start = buffer.begin();
-
-                if (begin < end)
-                {
-                    start = binary_fifo::_find_first_younger(begin);
-                }
-
                 returned_type aggregate = initial_aggregate;
 
-                for (auto it = start; it != buffer.end(); it++)
-                {
-                    if (end > (it->timestamp))
-                    {
-                        aggregate = fn(aggregate, it->data);
-                    }
-                    else
-                    {
-                        return aggregate;
-                    }
-                }
+                _for_each(begin, end, [&](const time_point&, const binary_view &data) {
+                    aggregate = fn(aggregate, data);
+                });
 
                 return aggregate;
             }
 
             template <class returned_type>
             inline returned_type reduce( \
-                                        returned_type (*fn)(returned_type, binary_data), \
+                                        returned_type (*fn)(returned_type, const binary_view&), \
                                         time_point begin = clock::now() + nanoseconds(1000000000ULL), \
                                         time_point end = clock::now(), \
                                         returned_type initial_aggregate = returned_type())
             {
-                std::function<returned_type(returned_type, binary_data)> func(fn);
+                std::function<returned_type(returned_type, const binary_view&)> func(fn);
                 return reduce(func, begin, end, initial_aggregate);
             }
 
-            inline std::vector<binary_data> filter(std::function<bool (binary_data)> fn, \
+            inline std::vector<binary_view> filter(std::function<bool (const binary_view&)> fn, \
                                                    time_point begin = clock::now() + nanoseconds(1000000000ULL), \
                                                    time_point end = clock::now())
             {
                 //update();
 
-                typename std::deque<datum>::iterator start = buffer.begin();
-
-                if (begin < end)
-                {
-                    start = binary_fifo::_find_first_younger(begin);
-                }
+                std::vector<binary_view> result;
 
-                std::vector<binary_data> result;
-
-                for (auto it = start; it != buffer.end(); it++)
-                {
-                    if (end > (it->timestamp))
-                    {
-                        if(fn(it->data))
-                        {
-                            result.push_back(it->data);
-                        }
-                    }
-                    else
+                _for_each(begin, end, [&](const time_point&, const binary_view &data) {
+                    if (fn(data))
                     {
-                        return result;
+                        result.push_back(data);
                     }
-                }
+                });
 
                 return result;
             }
 
-            inline std::vector<binary_data> filter(bool (*fn)(binary_data), \
+            inline std::vector<binary_view> filter(bool (*fn)(const binary_view&), \
                                                    time_point begin = clock::now() + nanoseconds(1000000000ULL), \
                                                    time_point end = clock::now())
             {
-                std::function<bool(binary_data)> func(fn);
+                std::function<bool(const binary_view&)> func(fn);
                 return filter(func, begin, end);
             }
 
             template <class returned_type>
-            inline std::vector<returned_type> map(std::function<returned_type (binary_data)> fn, \
+            inline std::vector<returned_type> map(std::function<returned_type (const binary_view&)> fn, \
                                                   time_point begin = clock::now() + nanoseconds(1000000000ULL), \
                                                   time_point end = clock::now())
             {
                 //update();
 
-                typename std::deque<datum>::iterator start = buffer.begin();
-
-                if (begin < end)
-                {
-                    start = binary_fifo::_find_first_younger(begin);
-                }
-
-                std::vector<binary_data> result;
+                std::vector<returned_type> result;
 
-                for (auto it = start; it != buffer.end(); it++)
-                {
-                    if (end > (it->timestamp))
-                    {
-                        result.push_back(fn(it->data));
-                    }
-                    else
-                    {
-                        return result;
-                    }
-                }
+                _for_each(begin, end, [&](const time_point&, const binary_view &data) {
+                    result.push_back(fn(data));
+                });
 
                 return result;
             }
 
             template <class returned_type>
-            inline std::vector<returned_type> map(returned_type (*fn)(binary_data), \
+            inline std::vector<returned_type> map(returned_type (*fn)(const binary_view&), \
                                                   time_point begin = clock::now() + nanoseconds(1000000000ULL), \
                                                   time_point end = clock::now())
             {
-                std::function<returned_type(binary_data)> func(fn);
+                std::function<returned_type(const binary_view&)> func(fn);
                 return map(func, begin, end);
             }
 
-            inline unsigned int count()
+            inline size_t count() const
             {
-                std::function<unsigned int(unsigned int, binary_data)> sum = [](unsigned int a, binary_data) -> unsigned int {return a + 1;};
-                return reduce(sum);
+                return buffer.size();
             }
 
-            inline unsigned int size()
+            inline size_t size() const
             {
-                std::function<size_t(size_t, binary_data)> sum = [](size_t a, binary_data data) -> unsigned int {return a + (data.size() * sizeof(uint8_t));};
-                return reduce(sum);
+                return stored_bytes;
             }
 
             inline void sort_buffer()
             {
-                std::sort(buffer.begin(), buffer.end());
+                std::stable_sort(buffer.begin(), buffer.end());
             };
 
             inline bool save_to_file(std::string filename, \
@@ -295,36 +894,20 @@ namespace binary_fifo {
                     return false;
                 }
 
-                typename std::deque<datum>::iterator start = buffer.begin();
+                _for_each(begin, end, [&](const time_point &timestamp, const binary_view &data) {
+                    const nanoseconds time_since_epoch = timestamp - epoch;
+                    const long_int since = time_since_epoch.count();
 
-                if (begin < end)
-                {
-                    start = binary_fifo::_find_first_younger(begin);
-                }
-
-                for (auto it = start; it != buffer.end(); it++)
-                {
-                    if (end > (it->timestamp))
-                    {
-                        const nanoseconds time_since_epoch = it->timestamp - epoch;
-                        const long_int since = time_since_epoch.count();
+                    const long_uint size = data.size() * sizeof(uint8_t);
 
-                        const binary_data data = it->data;
-                        const long_uint size = data.size() * sizeof(uint8_t);
+                    const char *since_pointer = reinterpret_cast<const char*>(&since);
+                    const char *size_pointer = reinterpret_cast<const char*>(&size);
+                    const char *data_pointer = reinterpret_cast<const char*>(data.data());
 
-                        const char *since_pointer = reinterpret_cast<const char*>(&since);
-                        const char *size_pointer = reinterpret_cast<const char*>(&size);
-                        const char *data_pointer = reinterpret_cast<const char*>(data.data());
-
-                        out_file.write(since_pointer, sizeof(long_int));
-                        out_file.write(size_pointer, sizeof(long_uint));
-                        out_file.write(data_pointer, data.size() * sizeof(uint8_t));
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
+                    out_file.write(since_pointer, sizeof(long_int));
+                    out_file.write(size_pointer, sizeof(long_uint));
+                    out_file.write(data_pointer, data.size() * sizeof(uint8_t));
+                });
 
                 out_file.close();
 
@@ -339,33 +922,34 @@ namespace binary_fifo {
                 std::ifstream in_file;
                 in_file.open(filename, std::ios::in | std::ios::binary);
 
-                while (in_file.good())
+                while (in_file.read(reinterpret_cast<char*>(&since), sizeof(long_int)) &&
+                       in_file.read(reinterpret_cast<char*>(&size), sizeof(long_uint)))
                 {
-                    in_file.read(reinterpret_cast<char*>(&since), sizeof(long_int));
-                    in_file.read(reinterpret_cast<char*>(&size), sizeof(long_uint));
-
                     binary_data data(size);
 
-                    in_file.read(reinterpret_cast<char*>(data.data()), sizeof(uint8_t) * size);
+                    if (!in_file.read(reinterpret_cast<char*>(data.data()), sizeof(uint8_t) * size))
+                    {
+                        break;
+                    }
 
                     const nanoseconds time_since_epoch = nanoseconds(since);
 
                     const time_point timestamp = epoch + time_since_epoch;
 
-                    buffer.emplace_back(data, timestamp);
+                    push(std::move(data), timestamp);
                 }
 
                 in_file.close();
 
-                sort_buffer();
-
                 //update();
             }
 
-            inline std::vector<binary_data> get_data(time_point begin = clock::now() + nanoseconds(1000000000ULL), \
-                                              time_point end = clock::now())
+            //! Returns views of the data, valid until the next modification
+            //! of the FIFO. Use binary_view::copy() to keep the data.
+            inline std::vector<binary_view> get_data(time_point begin = clock::now() + nanoseconds(1000000000ULL), \
+                                                     time_point end = clock::now())
             {
-                std::function<binary_data(binary_data)> identity = [](binary_data a) -> binary_data {return a;};
+                std::function<binary_view(const binary_view&)> identity = [](const binary_view &a) -> binary_view {return a;};
                 return map(identity, begin, end);
             }
 
@@ -375,29 +959,14 @@ namespace binary_fifo {
             {
                 //update();
 
-                typename std::deque<datum>::iterator start = buffer.begin();
-
-                if (begin < end)
-                {
-                    start = binary_fifo::_find_first_younger(begin);
-                }
-
                 std::vector<long_int> result;
 
-                for (auto it = start; it != buffer.end(); it++)
-                {
-                    if (end > (it->timestamp))
-                    {
-                        const nanoseconds time_since_epoch = it->timestamp - this_epoch;
-                        const long_int since = time_since_epoch.count();
+                _for_each(begin, end, [&](const time_point &timestamp, const binary_view&) {
+                    const nanoseconds time_since_epoch = timestamp - this_epoch;
+                    const long_int since = time_since_epoch.count();
 
-                        result.push_back(since);
-                    }
-                    else
-                    {
-                        return result;
-                    }
-                }
+                    result.push_back(since);
+                });
 
                 return result;
             }
@@ -12,6 +12,8 @@
 #define defaults_enfi_base_period 10
 #define defaults_cofi_base_period 10
 #define defaults_chafi_base_period 10
+#define defaults_mefi_base_period 10
+#define defaults_fichain_base_period 10
 #define defaults_fifo_base_period 100
 #define defaults_califo_base_period 100
 #define defaults_replay_base_period 100
@@ -62,6 +64,12 @@
 #define defaults_chafi_ip "127.0.0.1"
 #define defaults_chafi_data_address "tcp://*:16209"
 
+#define defaults_mefi_ip "127.0.0.1"
+#define defaults_mefi_data_address "tcp://*:16210"
+
+#define defaults_fichain_ip "127.0.0.1"
+#define defaults_fichain_data_address "tcp://*:16211"
+
 #define defaults_fifo_ip "127.0.0.1"
 #define defaults_fifo_status_address "tcp://*:16198"
 #define defaults_fifo_reply_address "tcp://*:16199"
@@ -95,10 +103,12 @@
 #define defaults_spec_status_topic "status_spec"
 #define defaults_spec_events_topic "events_spec"
 #define defaults_spec_data_histograms_topic "data_spec_histograms"
+#define defaults_spec_data_deltas_topic "data_spec_deltas"
 
 #define defaults_tofcalc_status_topic "status_tofcalc"
 #define defaults_tofcalc_events_topic "events_tofcalc"
 #define defaults_tofcalc_data_histograms_topic "data_tofcalc_histograms"
+#define defaults_tofcalc_data_deltas_topic "data_tofcalc_deltas"
 
 #define defaults_fifo_status_topic "status_fifo"
 #define defaults_fifo_events_topic "events_fifo"
@@ -147,6 +157,7 @@
 #define defaults_absp_waveforms_expected_number_of_samples 1024
 #define defaults_absp_counter_restarts_max 3
 #define defaults_absp_counter_resets_max 3
+#define defaults_absp_parallel_readout false
 
 #define defaults_dasa_verbosity 0
 #define defaults_dasa_publish_timeout 3
@@ -156,6 +167,9 @@
 
 #define defaults_spec_verbosity 0
 #define defaults_spec_publish_timeout 5
+#define defaults_spec_workers_number 1
+#define defaults_spec_worker_min_events 4096
+#define defaults_spec_keyframe_period 10
 #define defaults_spec_bins_qshort 128
 #define defaults_spec_bins_E 2200
 #define defaults_spec_bins_PSD 110
@@ -175,24 +189,44 @@
 
 #define defaults_replay_skip 0
 
+#define defaults_pufi_lut_size 256
+
 #define defaults_enfi_min_energy 400.0
 #define defaults_enfi_max_energy 60000.0
 
 #define defaults_cofi_coincidence_window_left 200.0
 #define defaults_cofi_coincidence_window_right 200.0
 #define defaults_cofi_ns_per_sample (2.0 / 1024.0)
-#define defaults_cofi_coincidence_buffer_multiplier 2
 #define defaults_cofi_multiplicity 1
 #define defaults_cofi_ade_buffer_size 1000
 
+#define defaults_sofi_horizon_time 0.0
+#define defaults_sofi_horizon_events 0
+#define defaults_sofi_restart_time 1e9
+#define defaults_sofi_ns_per_sample (2.0 / 1024.0)
+
+#define defaults_mefi_horizon_time 0.0
+#define defaults_mefi_idle_timeout 1000
+#define defaults_mefi_restart_time 1e9
+#define defaults_mefi_ns_per_sample (2.0 / 1024.0)
+
+#define defaults_fichain_ade_buffer_size 1000
+#define defaults_fichain_topic_subscribe "data_abcd"
+
 #define defaults_chafi_topic_subscribe "data_abcd"
 
 #define defaults_gzad_topic_subscribe ""
+#define defaults_gzad_codec "zlib"
+#define defaults_gzad_threads 2
+#define defaults_gzad_jobs_per_thread 4
 #define defaults_unzad_topic_subscribe "compressed_"
 #define defaults_unzad_output_buffer_multiplier 4
+#define defaults_unzad_threads 2
+#define defaults_unzad_jobs_per_thread 4
 
 #define defaults_tofcalc_verbosity 0
 #define defaults_tofcalc_publish_timeout 5
+#define defaults_tofcalc_keyframe_period 10
 #define defaults_tofcalc_bins_ToF 400
 #define defaults_tofcalc_min_ToF -100
 #define defaults_tofcalc_max_ToF 100
@@ -207,6 +241,18 @@
 #define defaults_fifo_verbosity 1
 #define defaults_fifo_publish_timeout 3
 #define defaults_fifo_expiration_time (3600 * 1000000000ULL)
+// Memory budget of the ring storage in MiB, zero to disable it
+#define defaults_fifo_memory_budget 0
+// Disk tier for the expired data, the budget is in MiB and zero disables it
+#define defaults_fifo_disk_directory "."
+#define defaults_fifo_disk_budget 0
+#define defaults_fifo_disk_segment_size (64 * 1024 * 1024)
+// Size of the data frames of the binary replies
+#define defaults_fifo_reply_chunk_size (4 * 1024 * 1024)
+// Heartbeats of the reply connections in ms, a peer that stops answering is
+// disconnected and the frames of its reply are released
+#define defaults_fifo_reply_heartbeat_interval 1000
+#define defaults_fifo_reply_heartbeat_timeout 10000
 
 #define defaults_califo_config_file "config.json"
 #define defaults_califo_verbosity 1
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
+#include <limits.h>
 #include <inttypes.h>
 #include <stdio.h>
 
@@ -19,6 +20,12 @@
 #define counter_type uint64_t
 #endif
 
+// The lazy scaling is applied to the bins when the pending scale falls below
+// this value, so that the fill weights do not grow indefinitely
+#ifndef HISTOGRAM_LAZY_SCALE_MINIMUM
+#define HISTOGRAM_LAZY_SCALE_MINIMUM 1e-3
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 // Histogram declaration                                                      //
@@ -33,6 +40,15 @@ struct histogram_t
     data_type max;
 
     double bin_width;
+    // Used by the fast fills, to multiply instead of dividing
+    double inverse_bin_width;
+
+    // Lazy scaling, e.g. for the time decay: the value of a bin is
+    // histo[i] * scale and the fills add fill_weight = 1 / scale, so that a
+    // scaling does not need a pass over the bins. It is meaningful only with
+    // a floating point counter_type.
+    double scale;
+    counter_type fill_weight;
 
     counter_type *histo;
 };
@@ -77,6 +93,9 @@ extern inline histogram_t *histogram_create(unsigned int bins,
         new_histo->min = min;
         new_histo->max = max;
         new_histo->bin_width = (max - min) / bins;
+        new_histo->inverse_bin_width = 1.0 / new_histo->bin_width;
+        new_histo->scale = 1;
+        new_histo->fill_weight = 1;
 
         new_histo->histo = (counter_type*)calloc(sizeof(counter_type), bins);
 
@@ -172,7 +191,7 @@ extern inline data_type histogram_get_integral(const histogram_t *histo)
         sum += histo->histo[i];
     }
 
-    return sum * bin_width;
+    return sum * histo->scale * bin_width;
 }
 
 extern inline counter_type histogram_get_max(const histogram_t *histo)
@@ -187,7 +206,7 @@ extern inline counter_type histogram_get_max(const histogram_t *histo)
         }
     }
 
-    return max;
+    return max * histo->scale;
 }
 
 extern inline data_type histogram_get_mean_interval(const histogram_t *histo, data_type left_edge, data_type right_edge)
@@ -241,6 +260,9 @@ extern inline histogram_error_t histogram_reset(histogram_t *histo)
 
     memset(histo->histo, 0, sizeof(counter_type) * histo->bins);
 
+    histo->scale = 1;
+    histo->fill_weight = 1;
+
     return HISTOGRAM_OK;
 }
 
@@ -260,7 +282,7 @@ extern inline histogram_error_t histogram_fill(histogram_t *histo, data_type val
 
     if (0 <= bin && bin < histo->bins)
     {
-        histo->histo[bin] += 1;
+        histo->histo[bin] += histo->fill_weight;
     }
 
     if (histo->verbosity > 1)
@@ -271,6 +293,99 @@ extern inline histogram_error_t histogram_fill(histogram_t *histo, data_type val
     return HISTOGRAM_OK;
 }
 
+//! Fast path of histogram_fill(), meant for the inner loops of the analyses.
+//! It does not check the pointers nor prints debug messages, thus the
+//! histogram shall be valid. The bin is calculated multiplying by the inverse
+//! of the bin width, thus values that lie exactly on a bin edge might end up
+//! in a different bin than with histogram_fill().
+extern inline void histogram_fill_fast(histogram_t *histo, data_type value)
+{
+    const double norm_value = (value - histo->min) * histo->inverse_bin_width;
+
+    // The conversion to an integer is defined only within its range, the
+    // NaNs are discarded by the comparisons as well
+    if (0 <= norm_value && norm_value < UINT_MAX)
+    {
+        // The range of the histogram is checked on the bin index, that is
+        // what addresses the array
+        const unsigned int bin = (unsigned int)norm_value;
+
+        if (bin < histo->bins)
+        {
+            histo->histo[bin] += histo->fill_weight;
+        }
+    }
+}
+
+//! Fills the histogram with an array of values
+extern inline histogram_error_t histogram_fill_n(histogram_t *histo,
+                                                 const data_type *values,
+                                                 size_t number)
+{
+    if (histo == NULL) {
+        return HISTOGRAM_ERROR_EMPTY_HISTO;
+    }
+    if (histo->histo == NULL) {
+        return HISTOGRAM_ERROR_EMPTY_HISTO_ARRAY;
+    }
+
+    if (histo->verbosity > 1)
+    {
+        printf("histogram_fill_n(): number: %zu\n", number);
+    }
+
+    for (size_t i = 0; i < number; i++)
+    {
+        histogram_fill_fast(histo, values[i]);
+    }
+
+    return HISTOGRAM_OK;
+}
+
+//! Fills the histogram with an array of unsigned 16-bit values, as the
+//! energies of the events (e.g. qlong). The values are read every stride
+//! bytes, so they can be taken directly from an array of structs.
+//! The loop has no branches: the values out of range are counted in the first
+//! bin with a null weight.
+extern inline histogram_error_t histogram_fill_n_uint16(histogram_t *histo,
+                                                        const uint16_t *values,
+                                                        size_t number,
+                                                        size_t stride)
+{
+    if (histo == NULL) {
+        return HISTOGRAM_ERROR_EMPTY_HISTO;
+    }
+    if (histo->histo == NULL) {
+        return HISTOGRAM_ERROR_EMPTY_HISTO_ARRAY;
+    }
+
+    if (histo->verbosity > 1)
+    {
+        printf("histogram_fill_n_uint16(): number: %zu, stride: %zu\n", number, stride);
+    }
+
+    const double min = histo->min;
+    const double inverse_bin_width = histo->inverse_bin_width;
+    const double bins = histo->bins;
+    const counter_type fill_weight = histo->fill_weight;
+
+    const uint8_t *pointer = (const uint8_t*)values;
+
+    for (size_t i = 0; i < number; i++)
+    {
+        uint16_t value;
+        memcpy(&value, pointer + i * stride, sizeof(value));
+
+        const double norm_value = (value - min) * inverse_bin_width;
+        const unsigned int valid = (0 <= norm_value && norm_value < bins);
+        const double clamped_value = valid ? norm_value : 0;
+
+        histo->histo[(unsigned int)clamped_value] += valid ? fill_weight : 0;
+    }
+
+    return HISTOGRAM_OK;
+}
+
 extern inline histogram_error_t histogram_add_to(histogram_t *output_histo, const histogram_t* input_histo)
 {
     if (output_histo == NULL || input_histo == NULL) {
@@ -288,9 +403,22 @@ extern inline histogram_error_t histogram_add_to(histogram_t *output_histo, cons
         printf("histogram_add_to()\n");
     }
 
-    for (unsigned int i = 0; i < output_histo->bins; i++)
+    if (output_histo->scale == input_histo->scale)
     {
-        output_histo->histo[i] += input_histo->histo[i];
+        for (unsigned int i = 0; i < output_histo->bins; i++)
+        {
+            output_histo->histo[i] += input_histo->histo[i];
+        }
+    }
+    else
+    {
+        // Bringing the input to the pending scale of the output
+        const double factor = input_histo->scale / output_histo->scale;
+
+        for (unsigned int i = 0; i < output_histo->bins; i++)
+        {
+            output_histo->histo[i] += input_histo->histo[i] * factor;
+        }
     }
 
     return HISTOGRAM_OK;
@@ -313,9 +441,22 @@ extern inline histogram_error_t histogram_subtract_from(histogram_t *output_hist
         printf("histogram_subtract_from()\n");
     }
 
-    for (unsigned int i = 0; i < output_histo->bins; i++)
+    if (output_histo->scale == input_histo->scale)
+    {
+        for (unsigned int i = 0; i < output_histo->bins; i++)
+        {
+            output_histo->histo[i] -= input_histo->histo[i];
+        }
+    }
+    else
     {
-        output_histo->histo[i] -= input_histo->histo[i];
+        // Bringing the input to the pending scale of the output
+        const double factor = input_histo->scale / output_histo->scale;
+
+        for (unsigned int i = 0; i < output_histo->bins; i++)
+        {
+            output_histo->histo[i] -= input_histo->histo[i] * factor;
+        }
     }
 
     return HISTOGRAM_OK;
@@ -335,13 +476,19 @@ extern inline histogram_error_t histogram_scale(histogram_t *histo, double scali
         printf("histogram_scale()\n");
     }
 
+    // The pending lazy scaling is applied as well
+    const double total_scaling_factor = scaling_factor * histo->scale;
+
     const unsigned int bins = histo->bins;
 
     for (unsigned int i = 0; i < bins; i++)
     {
-        histo->histo[i] = (histo->histo[i] * scaling_factor);
+        histo->histo[i] = (histo->histo[i] * total_scaling_factor);
     }
 
+    histo->scale = 1;
+    histo->fill_weight = 1;
+
     return HISTOGRAM_OK;
 }
 
@@ -359,15 +506,57 @@ extern inline histogram_error_t histogram_counts_clear_minimum(histogram_t *hist
         printf("histogram_counts_clear_minimum()\n");
     }
 
+    // The pending lazy scaling is applied as well
+    const double scale = histo->scale;
+
     const unsigned int bins = histo->bins;
 
     for (unsigned int i = 0; i < bins; i++)
     {
-        if (histo->histo[i] < minimum) {
+        const counter_type value = histo->histo[i] * scale;
+
+        if (value < minimum) {
             histo->histo[i] = 0;
+        } else {
+            histo->histo[i] = value;
         }
     }
 
+    histo->scale = 1;
+    histo->fill_weight = 1;
+
+    return HISTOGRAM_OK;
+}
+
+//! Scales the histogram without a pass over the bins, updating the weight
+//! of the next fills. The bins are updated only when the pending scale
+//! falls below HISTOGRAM_LAZY_SCALE_MINIMUM, clearing the bins below the
+//! minimum as histogram_counts_clear_minimum() does.
+extern inline histogram_error_t histogram_scale_lazy(histogram_t *histo,
+                                                     double scaling_factor,
+                                                     counter_type minimum)
+{
+    if (histo == NULL) {
+        return HISTOGRAM_ERROR_EMPTY_HISTO;
+    }
+    if (histo->histo == NULL) {
+        return HISTOGRAM_ERROR_EMPTY_HISTO_ARRAY;
+    }
+
+    if (histo->verbosity > 0)
+    {
+        printf("histogram_scale_lazy()\n");
+    }
+
+    histo->scale *= scaling_factor;
+
+    if (histo->scale < HISTOGRAM_LAZY_SCALE_MINIMUM)
+    {
+        return histogram_counts_clear_minimum(histo, minimum);
+    }
+
+    histo->fill_weight = 1.0 / histo->scale;
+
     return HISTOGRAM_OK;
 }
 
@@ -465,6 +654,9 @@ extern inline histogram_error_t histogram_reconfigure(histogram_t *histo,
     }
    
     histo->bin_width = (histo->max - histo->min) / histo->bins;
+    histo->inverse_bin_width = 1.0 / histo->bin_width;
+    histo->scale = 1;
+    histo->fill_weight = 1;
 
     free(histo->histo);
 
@@ -546,7 +738,7 @@ extern inline json_t *histogram_data_to_json(histogram_t *histo)
 
     for (unsigned int i = 0; i < histo->bins; i++)
     {
-        json_array_append_new(json_histo, json_real(histo->histo[i]));
+        json_array_append_new(json_histo, json_real(histo->histo[i] * histo->scale));
     }
 
     return json_histo;
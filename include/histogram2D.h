@@ -6,6 +6,8 @@
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <inttypes.h>
 #include <stdio.h>
 
@@ -19,11 +21,34 @@
 #define counter_type uint64_t
 #endif
 
+// The lazy scaling is applied to the bins when the pending scale falls below
+// this value, so that the fill weights do not grow indefinitely
+#ifndef HISTOGRAM2D_LAZY_SCALE_MINIMUM
+#define HISTOGRAM2D_LAZY_SCALE_MINIMUM 1e-3
+#endif
+
+// Side of the square tiles of the tiled storage
+#ifndef HISTOGRAM2D_TILE_SIZE
+#define HISTOGRAM2D_TILE_SIZE 32
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 // Histogram declaration                                                      //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
+
+// The dense storage allocates all the bins at the creation.
+// The tiled storage groups the bins in square tiles of HISTOGRAM2D_TILE_SIZE
+// bins per side, that are allocated only when one of their bins is filled,
+// so that the memory usage follows the occupied phase space instead of the
+// configured grid. Tiles that are emptied by the time decay are released.
+enum histogram2D_storage_t
+{
+    HISTOGRAM2D_STORAGE_DENSE,
+    HISTOGRAM2D_STORAGE_TILED
+};
+
 struct histogram2D_t
 {
     unsigned int verbosity;
@@ -37,8 +62,28 @@ struct histogram2D_t
 
     double bin_width_x;
     double bin_width_y;
+    // Used by the fast fills, to multiply instead of dividing
+    double inverse_bin_width_x;
+    double inverse_bin_width_y;
+
+    // Lazy scaling, e.g. for the time decay: the value of a bin is its
+    // counter times scale and the fills add fill_weight = 1 / scale, so that
+    // a scaling does not need a pass over the bins. It is meaningful only
+    // with a floating point counter_type.
+    double scale;
+    counter_type fill_weight;
+
+    enum histogram2D_storage_t storage;
 
+    // Dense storage, NULL with the tiled storage
     counter_type *histo;
+
+    // Tiled storage, NULL with the dense storage.
+    // The tiles are indexed as: t_x + tiles_x * t_y,
+    // their bins as: (i_x % HISTOGRAM2D_TILE_SIZE) + HISTOGRAM2D_TILE_SIZE * (i_y % HISTOGRAM2D_TILE_SIZE)
+    unsigned int tiles_x;
+    unsigned int tiles_y;
+    counter_type **tiles;
 };
 
 enum histogram2D_error_t
@@ -57,19 +102,78 @@ enum histogram2D_error_t
 
 typedef struct histogram2D_t histogram2D_t;
 typedef enum histogram2D_error_t histogram2D_error_t;
+typedef enum histogram2D_storage_t histogram2D_storage_t;
 
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 // Histogram creation and destruction                                         //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
-extern inline histogram2D_t *histogram2D_create(unsigned int bins_x,
-                                                data_type min_x,
-                                                data_type max_x,
-                                                unsigned int bins_y,
-                                                data_type min_y,
-                                                data_type max_y,
-                                                unsigned int verbosity)
+//! Allocates the storage of the bins, according to histo->storage
+extern inline histogram2D_error_t histogram2D_allocate_storage(histogram2D_t *histo)
+{
+    histo->tiles_x = (histo->bins_x + HISTOGRAM2D_TILE_SIZE - 1) / HISTOGRAM2D_TILE_SIZE;
+    histo->tiles_y = (histo->bins_y + HISTOGRAM2D_TILE_SIZE - 1) / HISTOGRAM2D_TILE_SIZE;
+
+    histo->histo = NULL;
+    histo->tiles = NULL;
+
+    if (histo->storage == HISTOGRAM2D_STORAGE_TILED)
+    {
+        histo->tiles = (counter_type**)calloc(sizeof(counter_type*), histo->tiles_x * histo->tiles_y);
+
+        if (histo->tiles == NULL)
+        {
+            return HISTOGRAM2D_ERROR_MALLOC;
+        }
+    }
+    else
+    {
+        histo->histo = (counter_type*)calloc(sizeof(counter_type), histo->bins_x * histo->bins_y);
+
+        if (histo->histo == NULL)
+        {
+            return HISTOGRAM2D_ERROR_MALLOC;
+        }
+    }
+
+    return HISTOGRAM2D_OK;
+}
+
+//! Releases the tiles, without releasing the array of their pointers
+extern inline void histogram2D_free_tiles(histogram2D_t *histo)
+{
+    const unsigned int tiles_number = histo->tiles_x * histo->tiles_y;
+
+    for (unsigned int t = 0; t < tiles_number; t++)
+    {
+        free(histo->tiles[t]);
+        histo->tiles[t] = NULL;
+    }
+}
+
+extern inline void histogram2D_free_storage(histogram2D_t *histo)
+{
+    if (histo->tiles != NULL)
+    {
+        histogram2D_free_tiles(histo);
+    }
+
+    free(histo->tiles);
+    free(histo->histo);
+
+    histo->tiles = NULL;
+    histo->histo = NULL;
+}
+
+extern inline histogram2D_t *histogram2D_create_with_storage(unsigned int bins_x,
+                                                             data_type min_x,
+                                                             data_type max_x,
+                                                             unsigned int bins_y,
+                                                             data_type min_y,
+                                                             data_type max_y,
+                                                             histogram2D_storage_t storage,
+                                                             unsigned int verbosity)
 {
     histogram2D_t *new_histo = (histogram2D_t*)malloc(sizeof(histogram2D_t));
 
@@ -88,11 +192,15 @@ extern inline histogram2D_t *histogram2D_create(unsigned int bins_x,
         new_histo->min_y = min_y;
         new_histo->max_y = max_y;
         new_histo->bin_width_y = (max_y - min_y) / bins_y;
+        new_histo->inverse_bin_width_x = 1.0 / new_histo->bin_width_x;
+        new_histo->inverse_bin_width_y = 1.0 / new_histo->bin_width_y;
+        new_histo->scale = 1;
+        new_histo->fill_weight = 1;
+        new_histo->storage = storage;
 
-        new_histo->histo = (counter_type*)calloc(sizeof(counter_type), bins_x * bins_y);
-
-        if (new_histo->histo == NULL)
+        if (histogram2D_allocate_storage(new_histo) != HISTOGRAM2D_OK)
         {
+            histogram2D_free_storage(new_histo);
             free(new_histo);
 
             return NULL;
@@ -102,16 +210,30 @@ extern inline histogram2D_t *histogram2D_create(unsigned int bins_x,
     return new_histo;
 }
 
+extern inline histogram2D_t *histogram2D_create(unsigned int bins_x,
+                                                data_type min_x,
+                                                data_type max_x,
+                                                unsigned int bins_y,
+                                                data_type min_y,
+                                                data_type max_y,
+                                                unsigned int verbosity)
+{
+    return histogram2D_create_with_storage(bins_x, min_x, max_x,
+                                           bins_y, min_y, max_y,
+                                           HISTOGRAM2D_STORAGE_DENSE,
+                                           verbosity);
+}
+
 extern inline histogram2D_error_t histogram2D_destroy(histogram2D_t *histo)
 {
     if (histo == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO;
     }
-    if (histo->histo == NULL) {
+    if (histo->histo == NULL && histo->tiles == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
     }
 
-    free(histo->histo);
+    histogram2D_free_storage(histo);
     free(histo);
 
     return HISTOGRAM2D_OK;
@@ -129,6 +251,141 @@ extern inline unsigned int histogram2D_get_index(const histogram2D_t *histo,
     return i_x + histo->bins_x * i_y;
 }
 
+//! Returns the index of the tile of a bin. With the dense storage the tiles
+//! are only regions of the bins, that can be merged or reset separately.
+extern inline unsigned int histogram2D_get_tile_index(const histogram2D_t *histo,
+                                                      unsigned int i_x,
+                                                      unsigned int i_y)
+{
+    return (i_x / HISTOGRAM2D_TILE_SIZE) + histo->tiles_x * (i_y / HISTOGRAM2D_TILE_SIZE);
+}
+
+//! Returns the pointer to the counter of a bin, allocating its tile if needed.
+//! Returns NULL if the tile could not be allocated.
+extern inline counter_type *histogram2D_get_counter(histogram2D_t *histo,
+                                                    unsigned int i_x,
+                                                    unsigned int i_y)
+{
+    if (histo->tiles == NULL)
+    {
+        return histo->histo + histogram2D_get_index(histo, i_x, i_y);
+    }
+
+    const unsigned int tile_index = histogram2D_get_tile_index(histo, i_x, i_y);
+
+    counter_type *tile = histo->tiles[tile_index];
+
+    if (tile == NULL)
+    {
+        tile = (counter_type*)calloc(sizeof(counter_type), HISTOGRAM2D_TILE_SIZE * HISTOGRAM2D_TILE_SIZE);
+
+        if (tile == NULL)
+        {
+            return NULL;
+        }
+
+        histo->tiles[tile_index] = tile;
+    }
+
+    return tile + (i_x % HISTOGRAM2D_TILE_SIZE) + HISTOGRAM2D_TILE_SIZE * (i_y % HISTOGRAM2D_TILE_SIZE);
+}
+
+//! Returns the value of a bin, with the pending lazy scaling applied and
+//! without allocating its tile
+extern inline counter_type histogram2D_get_bin(const histogram2D_t *histo,
+                                               unsigned int i_x,
+                                               unsigned int i_y)
+{
+    if (histo->tiles == NULL)
+    {
+        return histo->histo[histogram2D_get_index(histo, i_x, i_y)] * histo->scale;
+    }
+
+    const unsigned int tile_index = histogram2D_get_tile_index(histo, i_x, i_y);
+
+    const counter_type *tile = histo->tiles[tile_index];
+
+    if (tile == NULL)
+    {
+        return 0;
+    }
+
+    return tile[(i_x % HISTOGRAM2D_TILE_SIZE) + HISTOGRAM2D_TILE_SIZE * (i_y % HISTOGRAM2D_TILE_SIZE)] * histo->scale;
+}
+
+//! The allocated bins are accessed as segments of contiguous bins along x,
+//! which are the rows of the tiles or the whole array for the dense storage.
+extern inline unsigned int histogram2D_get_segments_number(const histogram2D_t *histo)
+{
+    if (histo->tiles == NULL)
+    {
+        return 1;
+    }
+
+    return histo->tiles_x * histo->tiles_y * HISTOGRAM2D_TILE_SIZE;
+}
+
+//! Returns the counters of a segment, or NULL if the segment is not allocated.
+//! The counters do not include the pending lazy scaling.
+//! first_index is set to the index of the first bin of the segment, as given
+//! by histogram2D_get_index(), and length to the number of its bins.
+extern inline const counter_type *histogram2D_get_segment(const histogram2D_t *histo,
+                                                          unsigned int segment,
+                                                          unsigned int *first_index,
+                                                          unsigned int *length)
+{
+    if (histo->tiles == NULL)
+    {
+        *first_index = 0;
+        *length = histo->bins_x * histo->bins_y;
+
+        return histo->histo;
+    }
+
+    const unsigned int tile_index = segment / HISTOGRAM2D_TILE_SIZE;
+    const unsigned int row = segment % HISTOGRAM2D_TILE_SIZE;
+
+    const counter_type *tile = histo->tiles[tile_index];
+
+    const unsigned int first_x = (tile_index % histo->tiles_x) * HISTOGRAM2D_TILE_SIZE;
+    const unsigned int i_y = (tile_index / histo->tiles_x) * HISTOGRAM2D_TILE_SIZE + row;
+
+    if (tile == NULL || i_y >= histo->bins_y)
+    {
+        return NULL;
+    }
+
+    const unsigned int remaining_x = histo->bins_x - first_x;
+
+    *first_index = histogram2D_get_index(histo, first_x, i_y);
+    *length = (remaining_x < HISTOGRAM2D_TILE_SIZE) ? remaining_x : HISTOGRAM2D_TILE_SIZE;
+
+    return tile + HISTOGRAM2D_TILE_SIZE * row;
+}
+
+//! Returns the number of allocated bins, that is the memory usage of the bins
+extern inline size_t histogram2D_get_allocated_bins(const histogram2D_t *histo)
+{
+    if (histo->tiles == NULL)
+    {
+        return (size_t)histo->bins_x * histo->bins_y;
+    }
+
+    const unsigned int tiles_number = histo->tiles_x * histo->tiles_y;
+
+    size_t allocated_bins = 0;
+
+    for (unsigned int t = 0; t < tiles_number; t++)
+    {
+        if (histo->tiles[t] != NULL)
+        {
+            allocated_bins += HISTOGRAM2D_TILE_SIZE * HISTOGRAM2D_TILE_SIZE;
+        }
+    }
+
+    return allocated_bins;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 // Operations on the histogram2Ds                                               //
@@ -139,7 +396,7 @@ extern inline histogram2D_error_t histogram2D_reset(histogram2D_t *histo)
     if (histo == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO;
     }
-    if (histo->histo == NULL) {
+    if (histo->histo == NULL && histo->tiles == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
     }
 
@@ -148,7 +405,17 @@ extern inline histogram2D_error_t histogram2D_reset(histogram2D_t *histo)
         printf("histogram2D_reset()\n");
     }
 
-    memset(histo->histo, 0, sizeof(counter_type) * histo->bins_x * histo->bins_y);
+    if (histo->tiles != NULL)
+    {
+        histogram2D_free_tiles(histo);
+    }
+    else
+    {
+        memset(histo->histo, 0, sizeof(counter_type) * histo->bins_x * histo->bins_y);
+    }
+
+    histo->scale = 1;
+    histo->fill_weight = 1;
 
     return HISTOGRAM2D_OK;
 }
@@ -160,7 +427,7 @@ extern inline histogram2D_error_t histogram2D_fill(histogram2D_t *histo,
     if (histo == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO;
     }
-    if (histo->histo == NULL) {
+    if (histo->histo == NULL && histo->tiles == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
     }
 
@@ -174,8 +441,14 @@ extern inline histogram2D_error_t histogram2D_fill(histogram2D_t *histo,
 
     if (0 <= bin_x && bin_x < histo->bins_x && 0 <= bin_y && bin_y < histo->bins_y)
     {
-        const unsigned int index = histogram2D_get_index(histo, bin_x, bin_y);
-        histo->histo[index] += 1;
+        counter_type *counter = histogram2D_get_counter(histo, bin_x, bin_y);
+
+        if (counter == NULL)
+        {
+            return HISTOGRAM2D_ERROR_MALLOC;
+        }
+
+        *counter += histo->fill_weight;
     }
 
     if (histo->verbosity > 1)
@@ -189,12 +462,266 @@ extern inline histogram2D_error_t histogram2D_fill(histogram2D_t *histo,
     return HISTOGRAM2D_OK;
 }
 
+//! Fast path of histogram2D_fill(), meant for the inner loops of the analyses.
+//! It does not check the pointers nor prints debug messages, thus the
+//! histogram shall be valid. The bins are calculated multiplying by the
+//! inverse of the bin widths, thus values that lie exactly on a bin edge might
+//! end up in a different bin than with histogram2D_fill().
+//! With the tiled storage the tiles are allocated on their first fill.
+//! Returns the index of the tile of the filled bin, as given by
+//! histogram2D_get_tile_index(), or -1 if the values are out of range.
+extern inline int histogram2D_fill_fast(histogram2D_t *histo,
+                                        data_type value_x,
+                                        data_type value_y)
+{
+    const double norm_value_x = (value_x - histo->min_x) * histo->inverse_bin_width_x;
+    const double norm_value_y = (value_y - histo->min_y) * histo->inverse_bin_width_y;
+
+    // The conversions to integers are defined only within their range, the
+    // NaNs are discarded by the comparisons as well
+    if (!(0 <= norm_value_x && norm_value_x < UINT_MAX &&
+          0 <= norm_value_y && norm_value_y < UINT_MAX))
+    {
+        return -1;
+    }
+
+    const unsigned int i_x = (unsigned int)norm_value_x;
+    const unsigned int i_y = (unsigned int)norm_value_y;
+
+    // The ranges of the histogram are checked on the bin indexes, that are
+    // what address the storage
+    if (i_x < histo->bins_x && i_y < histo->bins_y)
+    {
+        counter_type *counter = histogram2D_get_counter(histo, i_x, i_y);
+
+        // The event is lost if the tile could not be allocated
+        if (counter != NULL)
+        {
+            *counter += histo->fill_weight;
+        }
+
+        return (int)histogram2D_get_tile_index(histo, i_x, i_y);
+    }
+
+    return -1;
+}
+
+//! Fills the histogram with two arrays of values.
+//! If tile_indexes is not NULL, it receives for each pair of values the tile
+//! index returned by histogram2D_fill_fast(), or -1 if they are out of range.
+extern inline histogram2D_error_t histogram2D_fill_n(histogram2D_t *histo,
+                                                     const data_type *values_x,
+                                                     const data_type *values_y,
+                                                     size_t number,
+                                                     int *tile_indexes)
+{
+    if (histo == NULL) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO;
+    }
+    if (histo->histo == NULL && histo->tiles == NULL) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
+    }
+
+    if (histo->verbosity > 1)
+    {
+        printf("histogram2D_fill_n(): number: %zu\n", number);
+    }
+
+    if (tile_indexes == NULL)
+    {
+        for (size_t i = 0; i < number; i++)
+        {
+            histogram2D_fill_fast(histo, values_x[i], values_y[i]);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < number; i++)
+        {
+            tile_indexes[i] = histogram2D_fill_fast(histo, values_x[i], values_y[i]);
+        }
+    }
+
+    return HISTOGRAM2D_OK;
+}
+
+extern inline histogram2D_error_t histogram2D_add_to(histogram2D_t *output_histo, const histogram2D_t* input_histo)
+{
+    if (output_histo == NULL || input_histo == NULL) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO;
+    }
+    if ((output_histo->histo == NULL && output_histo->tiles == NULL) ||
+        (input_histo->histo == NULL && input_histo->tiles == NULL)) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
+    }
+    if (output_histo->bins_x != input_histo->bins_x || output_histo->bins_y != input_histo->bins_y) {
+        return HISTOGRAM2D_ERROR_DIFFERENT_SIZE;
+    }
+
+    if (output_histo->verbosity > 0)
+    {
+        printf("histogram2D_add_to()\n");
+    }
+
+    // Bringing the input to the pending scale of the output
+    const double factor = input_histo->scale / output_histo->scale;
+
+    if (output_histo->tiles == NULL && input_histo->tiles == NULL && factor == 1)
+    {
+        const unsigned int bins = (output_histo->bins_x * output_histo->bins_y);
+
+        for (unsigned int i = 0; i < bins; i++)
+        {
+            output_histo->histo[i] += input_histo->histo[i];
+        }
+
+        return HISTOGRAM2D_OK;
+    }
+
+    // Only the non null bins of the input are added, so that no tiles are
+    // allocated in the output for empty regions
+    const unsigned int segments_number = histogram2D_get_segments_number(input_histo);
+
+    for (unsigned int s = 0; s < segments_number; s++)
+    {
+        unsigned int first_index = 0;
+        unsigned int length = 0;
+
+        const counter_type *segment = histogram2D_get_segment(input_histo, s, &first_index, &length);
+
+        if (segment == NULL)
+        {
+            continue;
+        }
+
+        for (unsigned int i = 0; i < length; i++)
+        {
+            if (segment[i] != 0)
+            {
+                const unsigned int index = first_index + i;
+
+                counter_type *counter = histogram2D_get_counter(output_histo,
+                                                                index % output_histo->bins_x,
+                                                                index / output_histo->bins_x);
+
+                if (counter == NULL)
+                {
+                    return HISTOGRAM2D_ERROR_MALLOC;
+                }
+
+                *counter += segment[i] * factor;
+            }
+        }
+    }
+
+    return HISTOGRAM2D_OK;
+}
+
+//! Adds the bins of a single tile of the input to the output, so that a
+//! sparsely filled histogram can be merged without a pass over all its bins.
+//! The two histograms may use different storages.
+extern inline histogram2D_error_t histogram2D_add_tile_to(histogram2D_t *output_histo,
+                                                          const histogram2D_t* input_histo,
+                                                          unsigned int tile_index)
+{
+    if (output_histo == NULL || input_histo == NULL) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO;
+    }
+    if ((output_histo->histo == NULL && output_histo->tiles == NULL) ||
+        (input_histo->histo == NULL && input_histo->tiles == NULL)) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
+    }
+    if (output_histo->bins_x != input_histo->bins_x || output_histo->bins_y != input_histo->bins_y) {
+        return HISTOGRAM2D_ERROR_DIFFERENT_SIZE;
+    }
+    if (tile_index >= input_histo->tiles_x * input_histo->tiles_y) {
+        return HISTOGRAM2D_ERROR_GENERIC;
+    }
+
+    if (input_histo->tiles != NULL && input_histo->tiles[tile_index] == NULL)
+    {
+        return HISTOGRAM2D_OK;
+    }
+
+    // Bringing the input to the pending scale of the output
+    const double factor = input_histo->scale / output_histo->scale;
+
+    const unsigned int first_x = (tile_index % input_histo->tiles_x) * HISTOGRAM2D_TILE_SIZE;
+    const unsigned int first_y = (tile_index / input_histo->tiles_x) * HISTOGRAM2D_TILE_SIZE;
+    const unsigned int last_x = (first_x + HISTOGRAM2D_TILE_SIZE < input_histo->bins_x) ? first_x + HISTOGRAM2D_TILE_SIZE : input_histo->bins_x;
+    const unsigned int last_y = (first_y + HISTOGRAM2D_TILE_SIZE < input_histo->bins_y) ? first_y + HISTOGRAM2D_TILE_SIZE : input_histo->bins_y;
+
+    for (unsigned int i_y = first_y; i_y < last_y; i_y++)
+    {
+        const counter_type *row = (input_histo->tiles != NULL)
+                                ? input_histo->tiles[tile_index] + HISTOGRAM2D_TILE_SIZE * (i_y - first_y)
+                                : input_histo->histo + histogram2D_get_index(input_histo, first_x, i_y);
+
+        for (unsigned int i_x = first_x; i_x < last_x; i_x++)
+        {
+            const counter_type value = row[i_x - first_x];
+
+            if (value != 0)
+            {
+                counter_type *counter = histogram2D_get_counter(output_histo, i_x, i_y);
+
+                if (counter == NULL)
+                {
+                    return HISTOGRAM2D_ERROR_MALLOC;
+                }
+
+                *counter += value * factor;
+            }
+        }
+    }
+
+    return HISTOGRAM2D_OK;
+}
+
+//! Clears the bins of a single tile. With the tiled storage the tile is kept
+//! allocated, as it is likely to be filled again. The lazy scaling is not
+//! reset, as it applies to the whole histogram.
+extern inline histogram2D_error_t histogram2D_reset_tile(histogram2D_t *histo, unsigned int tile_index)
+{
+    if (histo == NULL) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO;
+    }
+    if (histo->histo == NULL && histo->tiles == NULL) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
+    }
+    if (tile_index >= histo->tiles_x * histo->tiles_y) {
+        return HISTOGRAM2D_ERROR_GENERIC;
+    }
+
+    if (histo->tiles != NULL)
+    {
+        if (histo->tiles[tile_index] != NULL)
+        {
+            memset(histo->tiles[tile_index], 0, sizeof(counter_type) * HISTOGRAM2D_TILE_SIZE * HISTOGRAM2D_TILE_SIZE);
+        }
+
+        return HISTOGRAM2D_OK;
+    }
+
+    const unsigned int first_x = (tile_index % histo->tiles_x) * HISTOGRAM2D_TILE_SIZE;
+    const unsigned int first_y = (tile_index / histo->tiles_x) * HISTOGRAM2D_TILE_SIZE;
+    const unsigned int last_x = (first_x + HISTOGRAM2D_TILE_SIZE < histo->bins_x) ? first_x + HISTOGRAM2D_TILE_SIZE : histo->bins_x;
+    const unsigned int last_y = (first_y + HISTOGRAM2D_TILE_SIZE < histo->bins_y) ? first_y + HISTOGRAM2D_TILE_SIZE : histo->bins_y;
+
+    for (unsigned int i_y = first_y; i_y < last_y; i_y++)
+    {
+        memset(histo->histo + histogram2D_get_index(histo, first_x, i_y), 0, sizeof(counter_type) * (last_x - first_x));
+    }
+
+    return HISTOGRAM2D_OK;
+}
+
 extern inline histogram2D_error_t histogram2D_scale(histogram2D_t *histo, double scaling_factor)
 {
     if (histo == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO;
     }
-    if (histo->histo == NULL) {
+    if (histo->histo == NULL && histo->tiles == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
     }
 
@@ -203,6 +730,32 @@ extern inline histogram2D_error_t histogram2D_scale(histogram2D_t *histo, double
         printf("histogram2D_scale()\n");
     }
 
+    // The pending lazy scaling is applied as well
+    scaling_factor *= histo->scale;
+
+    histo->scale = 1;
+    histo->fill_weight = 1;
+
+    if (histo->tiles != NULL)
+    {
+        const unsigned int tiles_number = histo->tiles_x * histo->tiles_y;
+
+        for (unsigned int t = 0; t < tiles_number; t++)
+        {
+            counter_type *tile = histo->tiles[t];
+
+            if (tile != NULL)
+            {
+                for (unsigned int i = 0; i < (HISTOGRAM2D_TILE_SIZE * HISTOGRAM2D_TILE_SIZE); i++)
+                {
+                    tile[i] = (tile[i] * scaling_factor);
+                }
+            }
+        }
+
+        return HISTOGRAM2D_OK;
+    }
+
     const unsigned int bins = (histo->bins_x * histo->bins_y);
 
     for (unsigned int i = 0; i < bins; i++)
@@ -218,7 +771,7 @@ extern inline histogram2D_error_t histogram2D_counts_clear_minimum(histogram2D_t
     if (histo == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO;
     }
-    if (histo->histo == NULL) {
+    if (histo->histo == NULL && histo->tiles == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
     }
 
@@ -227,18 +780,99 @@ extern inline histogram2D_error_t histogram2D_counts_clear_minimum(histogram2D_t
         printf("histogram2D_counts_clear_minimum()\n");
     }
 
+    // The pending lazy scaling is applied as well
+    const double scale = histo->scale;
+
+    histo->scale = 1;
+    histo->fill_weight = 1;
+
+    if (histo->tiles != NULL)
+    {
+        const unsigned int tiles_number = histo->tiles_x * histo->tiles_y;
+
+        for (unsigned int t = 0; t < tiles_number; t++)
+        {
+            counter_type *tile = histo->tiles[t];
+
+            if (tile != NULL)
+            {
+                bool empty = true;
+
+                for (unsigned int i = 0; i < (HISTOGRAM2D_TILE_SIZE * HISTOGRAM2D_TILE_SIZE); i++)
+                {
+                    const counter_type value = tile[i] * scale;
+
+                    if (value < minimum) {
+                        tile[i] = 0;
+                    } else {
+                        tile[i] = value;
+                    }
+
+                    if (tile[i] != 0) {
+                        empty = false;
+                    }
+                }
+
+                // The tiles emptied by the time decay are released
+                if (empty)
+                {
+                    free(tile);
+                    histo->tiles[t] = NULL;
+                }
+            }
+        }
+
+        return HISTOGRAM2D_OK;
+    }
+
     const unsigned int bins = (histo->bins_x * histo->bins_y);
 
     for (unsigned int i = 0; i < bins; i++)
     {
-        if (histo->histo[i] < minimum) {
+        const counter_type value = histo->histo[i] * scale;
+
+        if (value < minimum) {
             histo->histo[i] = 0;
+        } else {
+            histo->histo[i] = value;
         }
     }
 
     return HISTOGRAM2D_OK;
 }
 
+//! Scales the histogram without a pass over the bins, updating the weight
+//! of the next fills. The bins are updated only when the pending scale
+//! falls below HISTOGRAM2D_LAZY_SCALE_MINIMUM, clearing the bins below the
+//! minimum as histogram2D_counts_clear_minimum() does.
+extern inline histogram2D_error_t histogram2D_scale_lazy(histogram2D_t *histo,
+                                                         double scaling_factor,
+                                                         counter_type minimum)
+{
+    if (histo == NULL) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO;
+    }
+    if (histo->histo == NULL && histo->tiles == NULL) {
+        return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
+    }
+
+    if (histo->verbosity > 0)
+    {
+        printf("histogram2D_scale_lazy()\n");
+    }
+
+    histo->scale *= scaling_factor;
+
+    if (histo->scale < HISTOGRAM2D_LAZY_SCALE_MINIMUM)
+    {
+        return histogram2D_counts_clear_minimum(histo, minimum);
+    }
+
+    histo->fill_weight = 1.0 / histo->scale;
+
+    return HISTOGRAM2D_OK;
+}
+
 extern inline histogram2D_error_t histogram2D_reconfigure(histogram2D_t *histo,
                                                           unsigned int bins_x,
                                                           data_type min_x,
@@ -251,7 +885,7 @@ extern inline histogram2D_error_t histogram2D_reconfigure(histogram2D_t *histo,
     if (histo == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO;
     }
-    if (histo->histo == NULL) {
+    if (histo->histo == NULL && histo->tiles == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
     }
 
@@ -281,17 +915,16 @@ extern inline histogram2D_error_t histogram2D_reconfigure(histogram2D_t *histo,
    
     histo->bin_width_x = (histo->max_x - histo->min_x) / histo->bins_x;
     histo->bin_width_y = (histo->max_y - histo->min_y) / histo->bins_y;
+    histo->inverse_bin_width_x = 1.0 / histo->bin_width_x;
+    histo->inverse_bin_width_y = 1.0 / histo->bin_width_y;
 
-    free(histo->histo);
+    histo->scale = 1;
+    histo->fill_weight = 1;
 
-    histo->histo = (counter_type*)calloc(sizeof(counter_type), histo->bins_x * histo->bins_y);
+    // The storage type is kept
+    histogram2D_free_storage(histo);
 
-    if (histo->histo == NULL)
-    {
-        return HISTOGRAM2D_ERROR_MALLOC;
-    }
-
-    return HISTOGRAM2D_OK;
+    return histogram2D_allocate_storage(histo);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -304,7 +937,7 @@ extern inline histogram2D_error_t histogram2D_reconfigure_json(histogram2D_t *hi
     if (histo == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO;
     }
-    if (histo->histo == NULL) {
+    if (histo->histo == NULL && histo->tiles == NULL) {
         return HISTOGRAM2D_ERROR_EMPTY_HISTO_ARRAY;
     }
     if (new_config == NULL) {
@@ -372,9 +1005,22 @@ extern inline json_t *histogram2D_data_to_json(histogram2D_t *histo)
         return NULL;
     }
 
-    for (unsigned int i = 0; i < (histo->bins_x * histo->bins_y); i++)
+    if (histo->tiles != NULL)
     {
-        json_array_append_new(json_histo, json_real(histo->histo[i]));
+        for (unsigned int i_y = 0; i_y < histo->bins_y; i_y++)
+        {
+            for (unsigned int i_x = 0; i_x < histo->bins_x; i_x++)
+            {
+                json_array_append_new(json_histo, json_real(histogram2D_get_bin(histo, i_x, i_y)));
+            }
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < (histo->bins_x * histo->bins_y); i++)
+        {
+            json_array_append_new(json_histo, json_real(histo->histo[i] * histo->scale));
+        }
     }
 
     return json_histo;
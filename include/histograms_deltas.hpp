@@ -0,0 +1,300 @@
+#ifndef __HISTOGRAMS_DELTAS_HPP__
+#define __HISTOGRAMS_DELTAS_HPP__ 1
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <zlib.h>
+#include <jansson.h>
+
+// Incremental binary publication of histograms.
+// Instead of publishing all the bins of all the histograms as a JSON array,
+// only the bins that changed since the last publication are sent, as a list
+// of sparse entries. Periodically a keyframe is sent, with all the non null
+// bins, so that a client may start from an empty histogram.
+//
+// The published message is composed of:
+//
+//  - header_size: uint32_t
+//  - header:      char[header_size], a JSON object
+//  - payload:     the binary entries, compressed with zlib if the header
+//                 has the "compression" entry set to "zlib"
+//
+// The header has the same structure of the JSON publication of the module,
+// but the histograms data arrays are replaced by descriptors:
+//
+//  {"config": {...}, "full": true, "entries": N, "offset": O, "scale": S}
+//
+// where "offset" is the position in bytes of the entries in the uncompressed
+// payload. The entries carry the counters of the bins without the pending
+// lazy scaling (e.g. the time decay), the values of the bins are the
+// counters multiplied by "scale". Thus a decay, that changes only the scale,
+// does not change the entries. The entries of a histogram are stored as:
+//
+//  - values:  double[N]
+//  - indexes: uint32_t[N], indexes of the bins in the data array
+//  - padding: uint32_t if N is odd, to keep the next values aligned
+//
+// If "full" is true the histogram shall be cleared before applying the
+// entries, otherwise the entries replace the values of the previous
+// publication. Messages may be lost on the PUB sockets, thus after a missed
+// msg_ID a client shall wait for the next keyframe.
+//
+// The histograms are added as blocks of contiguous bins, so that the
+// histograms with a sparse storage are scanned and copied only where they
+// are allocated. The bins of a block that disappears are published as zeros.
+
+namespace histograms_deltas
+{
+    class publisher
+    {
+        public:
+            // Number of publications between two keyframes
+            unsigned int keyframe_period;
+            unsigned int publications_number;
+            bool keyframe;
+
+            // Copies of the published histograms, to determine the changes.
+            // The blocks are identified by the index of their first bin.
+            struct published_histogram
+            {
+                size_t bins_number = 0;
+                std::map<size_t, std::vector<double>> blocks;
+            };
+
+            std::map<std::string, published_histogram> last_published;
+
+            std::vector<uint8_t> payload;
+            std::vector<uint8_t> compressed_payload;
+
+            publisher(unsigned int Keyframe_period = 10) : \
+                keyframe_period(Keyframe_period), publications_number(0), keyframe(true) {};
+            ~publisher() {};
+
+            //! Starts a new publication, deciding if it is a keyframe
+            inline void begin()
+            {
+                keyframe = (keyframe_period == 0) || (publications_number % keyframe_period == 0);
+                publications_number += 1;
+
+                payload.clear();
+            }
+
+            //! Forces a keyframe at the next publication, e.g. after a reconfiguration
+            inline void reset()
+            {
+                publications_number = 0;
+                last_published.clear();
+            }
+
+            //! Adds the changed bins of a histogram to the payload and returns
+            //! the descriptor of its entries.
+            //! The key shall be unique for each histogram, e.g. "3/energy".
+            //! The scale is the pending lazy scaling of the bins, that is
+            //! published in the descriptor and not applied to the entries.
+            template <typename T>
+            json_t *add(const std::string &key, const T *bins, size_t bins_number, double scale = 1)
+            {
+                begin_histogram(key, bins_number, scale);
+                add_block(0, bins, bins_number);
+
+                return end_histogram();
+            }
+
+            //! Adds a histogram2D_t scanning only its allocated segments.
+            //! It is a template so that this header does not depend on
+            //! histogram2D.h, which shall be included where it is used.
+            template <typename histogram2D_type>
+            json_t *add_histogram2D(const std::string &key, const histogram2D_type *histo)
+            {
+                begin_histogram(key, histo->bins_x * histo->bins_y, histo->scale);
+
+                const unsigned int segments_number = histogram2D_get_segments_number(histo);
+
+                for (unsigned int s = 0; s < segments_number; s++)
+                {
+                    unsigned int first_index = 0;
+                    unsigned int length = 0;
+
+                    const auto segment = histogram2D_get_segment(histo, s, &first_index, &length);
+
+                    if (segment != nullptr)
+                    {
+                        add_block(first_index, segment, length);
+                    }
+                }
+
+                return end_histogram();
+            }
+
+            //! Starts adding a histogram block by block
+            inline void begin_histogram(const std::string &key, size_t bins_number, double scale = 1)
+            {
+                current = &last_published[key];
+                current_scale = scale;
+
+                // A new or resized histogram is always sent in full
+                current_full = keyframe || (current->bins_number != bins_number);
+
+                if (current->bins_number != bins_number)
+                {
+                    current->bins_number = bins_number;
+                    current->blocks.clear();
+                }
+
+                current_values_offset = payload.size();
+                current_indexes.clear();
+                current_blocks.clear();
+            }
+
+            //! Adds a block of contiguous bins, starting at the bin first_index
+            template <typename T>
+            void add_block(size_t first_index, const T *bins, size_t bins_number)
+            {
+                std::vector<double> &last = current_blocks[first_index];
+
+                // The previous copy of the block is moved to the new blocks
+                const auto previous = current->blocks.find(first_index);
+
+                if (previous != current->blocks.end())
+                {
+                    last.swap(previous->second);
+                    current->blocks.erase(previous);
+                }
+
+                if (last.size() != bins_number)
+                {
+                    last.assign(bins_number, 0);
+                }
+
+                // The values are appended while scanning the bins, the
+                // indexes are appended after all of them.
+                for (size_t i = 0; i < bins_number; i++)
+                {
+                    const double value = bins[i];
+
+                    if ((current_full && value != 0) || (!current_full && value != last[i]))
+                    {
+                        append_entry(first_index + i, value);
+                    }
+
+                    last[i] = value;
+                }
+            }
+
+            //! Ends the histogram and returns the descriptor of its entries
+            inline json_t *end_histogram()
+            {
+                // The blocks that were not added anymore are now empty
+                if (!current_full)
+                {
+                    for (const auto &pair: current->blocks)
+                    {
+                        for (size_t i = 0; i < pair.second.size(); i++)
+                        {
+                            if (pair.second[i] != 0)
+                            {
+                                append_entry(pair.first + i, 0);
+                            }
+                        }
+                    }
+                }
+
+                current->blocks.swap(current_blocks);
+                current_blocks.clear();
+
+                append(current_indexes.data(), current_indexes.size() * sizeof(uint32_t));
+
+                if (current_indexes.size() % 2 == 1)
+                {
+                    const uint32_t padding = 0;
+                    append(&padding, sizeof(padding));
+                }
+
+                json_t *descriptor = json_object();
+
+                json_object_set_new_nocheck(descriptor, "full", current_full ? json_true() : json_false());
+                json_object_set_new_nocheck(descriptor, "entries", json_integer(current_indexes.size()));
+                json_object_set_new_nocheck(descriptor, "offset", json_integer(current_values_offset));
+                json_object_set_new_nocheck(descriptor, "scale", json_real(current_scale));
+
+                return descriptor;
+            }
+
+            //! Builds the message with the given header, adding to it the
+            //! entries that describe the payload.
+            //! Returns false if the header could not be encoded.
+            inline bool finish(json_t *header, std::vector<uint8_t> &message)
+            {
+                const uLong payload_size = payload.size();
+
+                uLongf compressed_size = compressBound(payload_size);
+                compressed_payload.resize(compressed_size);
+
+                // The fastest compression level is enough, as most of the
+                // payload is made of sequences of indexes.
+                const int result = compress2(compressed_payload.data(), &compressed_size,
+                                             payload.data(), payload_size,
+                                             Z_BEST_SPEED);
+
+                const bool compressed = (result == Z_OK && compressed_size < payload_size);
+
+                json_object_set_new_nocheck(header, "keyframe", keyframe ? json_true() : json_false());
+                json_object_set_new_nocheck(header, "compression", json_string(compressed ? "zlib" : "none"));
+                json_object_set_new_nocheck(header, "payload_size", json_integer(payload_size));
+
+                char *header_string = json_dumps(header, JSON_COMPACT);
+
+                if (!header_string)
+                {
+                    return false;
+                }
+
+                const uint32_t header_size = strlen(header_string);
+
+                const uint8_t *data = compressed ? compressed_payload.data() : payload.data();
+                const size_t data_size = compressed ? compressed_size : payload_size;
+
+                message.resize(sizeof(header_size) + header_size + data_size);
+
+                memcpy(message.data(), &header_size, sizeof(header_size));
+                memcpy(message.data() + sizeof(header_size), header_string, header_size);
+                memcpy(message.data() + sizeof(header_size) + header_size, data, data_size);
+
+                free(header_string);
+
+                return true;
+            }
+
+        private:
+            // Status of the histogram that is being added
+            published_histogram *current = nullptr;
+            bool current_full = true;
+            double current_scale = 1;
+            size_t current_values_offset = 0;
+            std::vector<uint32_t> current_indexes;
+            std::map<size_t, std::vector<double>> current_blocks;
+
+            inline void append_entry(size_t index, double value)
+            {
+                current_indexes.push_back(index);
+
+                append(&value, sizeof(value));
+            }
+
+            inline void append(const void *data, size_t size)
+            {
+                const size_t previous_size = payload.size();
+
+                payload.resize(previous_size + size);
+
+                memcpy(payload.data() + previous_size, data, size);
+            }
+    };
+}
+
+#endif
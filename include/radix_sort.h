@@ -0,0 +1,702 @@
+#ifndef __RADIX_SORT_H__
+#define __RADIX_SORT_H__ 1
+
+// Stable LSD radix sort of arrays of structures on their uint64_t timestamp.
+//
+// The structures are sorted by value, they are identified by their size and
+// by the offset of the timestamp within them, e.g.:
+//
+//   radix_sort_timestamps(events, N, sizeof(struct event_PSD),
+//                         offsetof(struct event_PSD, timestamp), NULL);
+//
+// The timestamps in a message usually span a narrow range, thus the keys are
+// taken relative to the minimum timestamp and only the bytes of the range are
+// sorted, skipping also the bytes that have the same value for all the keys.
+// An already sorted array is detected while searching for the minimum and it
+// is left untouched. An almost sorted array is sorted with an insertion sort,
+// which is interrupted if the elements are moved too much. If the array is
+// made of a few sorted runs, e.g. the blocks of events of a few channels, the
+// runs are merged instead, as it takes less passes over the data than the
+// radix sort.
+//
+// The sort needs a scratch buffer with the same size of the array; if the
+// buffer is NULL it is allocated and freed on each call.
+//
+// If RADIX_SORT_PARALLEL is defined before including this header, the
+// radix_sort_timestamps_parallel() function is also available, which
+// distributes the counting and the scattering of each byte over several
+// threads. It requires linking against pthreads.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifdef RADIX_SORT_PARALLEL
+#include <pthread.h>
+#endif
+
+#include "events.h"
+
+#define RADIX_SORT_BITS 8
+#define RADIX_SORT_BUCKETS (1 << RADIX_SORT_BITS)
+#define RADIX_SORT_MAX_PASSES (64 / RADIX_SORT_BITS)
+// Below this size an insertion sort is faster than counting the buckets
+#define RADIX_SORT_SMALL_SIZE 64
+// Average moves per element allowed to the insertion sort of the almost
+// sorted arrays, before resorting to the radix sort
+#define RADIX_SORT_INSERTION_MOVES 2
+#define RADIX_SORT_INSERTION_MAX_SIZE 64
+
+enum radix_sort_error_t
+{
+    RADIX_SORT_OK = 0,
+    RADIX_SORT_ERROR_ALLOCATION = 1
+};
+
+//! Reads the key of the element at the given index
+extern inline
+uint64_t radix_sort_get_key(const uint8_t *array, size_t index, size_t element_size, size_t key_offset)
+{
+    uint64_t key;
+
+    memcpy(&key, array + index * element_size + key_offset, sizeof(key));
+
+    return key;
+}
+
+//! Determines the range of the keys and returns the number of descents,
+//! i.e. the number of sorted runs minus one
+extern inline
+size_t radix_sort_check(const uint8_t *array, size_t number, size_t element_size, size_t key_offset,
+                        uint64_t *minimum, uint64_t *maximum)
+{
+    size_t descents = 0;
+
+    uint64_t previous = radix_sort_get_key(array, 0, element_size, key_offset);
+    uint64_t min = previous;
+    uint64_t max = previous;
+
+    for (size_t i = 1; i < number; i++)
+    {
+        const uint64_t key = radix_sort_get_key(array, i, element_size, key_offset);
+
+        descents += (key < previous);
+        min = (key < min) ? key : min;
+        max = (key > max) ? key : max;
+
+        previous = key;
+    }
+
+    *minimum = min;
+    *maximum = max;
+
+    return descents;
+}
+
+//! Determines the number of bytes of the keys that need sorting
+extern inline
+unsigned int radix_sort_passes(uint64_t range)
+{
+    unsigned int passes = 0;
+
+    while (passes < RADIX_SORT_MAX_PASSES && (range >> (passes * RADIX_SORT_BITS)) > 0)
+    {
+        passes += 1;
+    }
+
+    return passes;
+}
+
+//! Determines the number of merges needed to sort an array with the given
+//! number of descents, as each merge halves the number of the sorted runs
+extern inline
+unsigned int radix_sort_merges(size_t descents)
+{
+    unsigned int merges = 0;
+
+    while ((((size_t)1) << merges) < descents + 1)
+    {
+        merges += 1;
+    }
+
+    return merges;
+}
+
+//! Stable insertion sort, that gives up after moving the elements by
+//! max_moves positions in total. Returns true if the array was sorted.
+extern inline
+bool radix_sort_insertion_generic(uint8_t *array, size_t number, size_t element_size, size_t key_offset,
+                                  size_t max_moves)
+{
+    // The bigger elements are never sorted with this function
+    uint8_t current[RADIX_SORT_INSERTION_MAX_SIZE];
+
+    size_t moves = 0;
+
+    for (size_t i = 1; i < number; i++)
+    {
+        const uint64_t key = radix_sort_get_key(array, i, element_size, key_offset);
+
+        size_t j = i;
+
+        while (j > 0 && key < radix_sort_get_key(array, j - 1, element_size, key_offset))
+        {
+            j -= 1;
+        }
+
+        if (j < i)
+        {
+            memcpy(current, array + i * element_size, element_size);
+
+            for (size_t k = i; k > j; k--)
+            {
+                memcpy(array + k * element_size, array + (k - 1) * element_size, element_size);
+            }
+
+            memcpy(array + j * element_size, current, element_size);
+
+            moves += i - j;
+
+            if (moves > max_moves)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//! Selects an insertion sort with a constant element size
+extern inline
+bool radix_sort_insertion(uint8_t *array, size_t number, size_t element_size, size_t key_offset,
+                          size_t max_moves)
+{
+    switch (element_size)
+    {
+        case 16:
+            return radix_sort_insertion_generic(array, number, 16, key_offset, max_moves);
+        case 24:
+            return radix_sort_insertion_generic(array, number, 24, key_offset, max_moves);
+        case 32:
+            return radix_sort_insertion_generic(array, number, 32, key_offset, max_moves);
+        default:
+            return radix_sort_insertion_generic(array, number, element_size, key_offset, max_moves);
+    }
+}
+
+//! Counts the occurrences of the bytes of the keys, for the passes from
+//! first_pass to last_pass excluded
+extern inline
+void radix_sort_count(const uint8_t *array, size_t begin, size_t end,
+                      size_t element_size, size_t key_offset, uint64_t minimum,
+                      unsigned int first_pass, unsigned int last_pass,
+                      size_t counts[][RADIX_SORT_BUCKETS])
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        const uint64_t key = radix_sort_get_key(array, i, element_size, key_offset) - minimum;
+
+        for (unsigned int p = first_pass; p < last_pass; p++)
+        {
+            counts[p][(key >> (p * RADIX_SORT_BITS)) & (RADIX_SORT_BUCKETS - 1)] += 1;
+        }
+    }
+}
+
+//! Moves the elements to their buckets, the offsets are updated
+extern inline
+void radix_sort_scatter_generic(const uint8_t *source, uint8_t *destination, size_t begin, size_t end,
+                                size_t element_size, size_t key_offset, uint64_t minimum,
+                                unsigned int shift, size_t *offsets)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        const uint64_t key = radix_sort_get_key(source, i, element_size, key_offset) - minimum;
+        const size_t bucket = (key >> shift) & (RADIX_SORT_BUCKETS - 1);
+
+        memcpy(destination + offsets[bucket] * element_size, source + i * element_size, element_size);
+
+        offsets[bucket] += 1;
+    }
+}
+
+//! Selects a scatter with a constant element size for the common structures,
+//! so that the copies are inlined by the compiler
+extern inline
+void radix_sort_scatter(const uint8_t *source, uint8_t *destination, size_t begin, size_t end,
+                        size_t element_size, size_t key_offset, uint64_t minimum,
+                        unsigned int shift, size_t *offsets)
+{
+    switch (element_size)
+    {
+        case 16:
+            radix_sort_scatter_generic(source, destination, begin, end, 16, key_offset, minimum, shift, offsets);
+            break;
+        case 24:
+            radix_sort_scatter_generic(source, destination, begin, end, 24, key_offset, minimum, shift, offsets);
+            break;
+        case 32:
+            radix_sort_scatter_generic(source, destination, begin, end, 32, key_offset, minimum, shift, offsets);
+            break;
+        default:
+            radix_sort_scatter_generic(source, destination, begin, end, element_size, key_offset, minimum, shift, offsets);
+            break;
+    }
+}
+
+//! Merges the pairs of consecutive sorted runs of the source to the
+//! destination and returns the number of merged runs
+extern inline
+size_t radix_sort_merge_runs_generic(const uint8_t *source, uint8_t *destination, size_t number,
+                                     size_t element_size, size_t key_offset)
+{
+    size_t runs = 0;
+    size_t begin = 0;
+
+    while (begin < number)
+    {
+        size_t middle = begin + 1;
+
+        while (middle < number && radix_sort_get_key(source, middle - 1, element_size, key_offset) <= radix_sort_get_key(source, middle, element_size, key_offset))
+        {
+            middle += 1;
+        }
+
+        size_t end = middle;
+
+        while (end < number && (end == middle || radix_sort_get_key(source, end - 1, element_size, key_offset) <= radix_sort_get_key(source, end, element_size, key_offset)))
+        {
+            end += 1;
+        }
+
+        size_t i = begin;
+        size_t j = middle;
+        size_t k = begin;
+
+        while (i < middle && j < end)
+        {
+            // Taking the left element on equal keys keeps the sort stable
+            if (radix_sort_get_key(source, j, element_size, key_offset) < radix_sort_get_key(source, i, element_size, key_offset))
+            {
+                memcpy(destination + k * element_size, source + j * element_size, element_size);
+                j += 1;
+            }
+            else
+            {
+                memcpy(destination + k * element_size, source + i * element_size, element_size);
+                i += 1;
+            }
+
+            k += 1;
+        }
+
+        memcpy(destination + k * element_size, source + i * element_size, (middle - i) * element_size);
+        k += middle - i;
+        memcpy(destination + k * element_size, source + j * element_size, (end - j) * element_size);
+
+        runs += 1;
+        begin = end;
+    }
+
+    return runs;
+}
+
+//! Selects a merge with a constant element size, as for the scatter
+extern inline
+size_t radix_sort_merge_runs(const uint8_t *source, uint8_t *destination, size_t number,
+                             size_t element_size, size_t key_offset)
+{
+    switch (element_size)
+    {
+        case 16:
+            return radix_sort_merge_runs_generic(source, destination, number, 16, key_offset);
+        case 24:
+            return radix_sort_merge_runs_generic(source, destination, number, 24, key_offset);
+        case 32:
+            return radix_sort_merge_runs_generic(source, destination, number, 32, key_offset);
+        default:
+            return radix_sort_merge_runs_generic(source, destination, number, element_size, key_offset);
+    }
+}
+
+//! Sorts the array on the uint64_t keys at key_offset in each element.
+//! Returns RADIX_SORT_ERROR_ALLOCATION, leaving the array untouched, if the
+//! scratch buffer could not be allocated.
+extern inline
+enum radix_sort_error_t radix_sort_timestamps(void *array, size_t number,
+                                              size_t element_size, size_t key_offset,
+                                              void *buffer)
+{
+    if (number < 2)
+    {
+        return RADIX_SORT_OK;
+    }
+
+    uint8_t *source = (uint8_t *)array;
+
+    uint64_t minimum = 0;
+    uint64_t maximum = 0;
+
+    const size_t descents = radix_sort_check(source, number, element_size, key_offset, &minimum, &maximum);
+
+    if (descents == 0)
+    {
+        return RADIX_SORT_OK;
+    }
+
+    if (element_size <= RADIX_SORT_INSERTION_MAX_SIZE)
+    {
+        // The events are often displaced by only a few positions, e.g. the
+        // events in coincidence on different channels. An interrupted
+        // insertion sort leaves a permutation of the array, that is still
+        // stable for the following sort.
+        const size_t max_moves = (number < RADIX_SORT_SMALL_SIZE) ? SIZE_MAX : RADIX_SORT_INSERTION_MOVES * number;
+
+        if (radix_sort_insertion(source, number, element_size, key_offset, max_moves))
+        {
+            return RADIX_SORT_OK;
+        }
+    }
+
+    uint8_t *destination = (uint8_t *)buffer;
+
+    if (!buffer)
+    {
+        destination = (uint8_t *)malloc(number * element_size);
+
+        if (!destination)
+        {
+            return RADIX_SORT_ERROR_ALLOCATION;
+        }
+    }
+
+    uint8_t *const scratch = destination;
+
+    const unsigned int passes = radix_sort_passes(maximum - minimum);
+
+    const unsigned int merges = radix_sort_merges(descents);
+
+    if (merges < passes)
+    {
+        while (radix_sort_merge_runs(source, destination, number, element_size, key_offset) > 1)
+        {
+            uint8_t *const temp = source;
+            source = destination;
+            destination = temp;
+        }
+
+        // The last merge wrote to the destination
+        source = destination;
+    }
+    else
+    {
+        size_t counts[RADIX_SORT_MAX_PASSES][RADIX_SORT_BUCKETS];
+        memset(counts, 0, passes * sizeof(counts[0]));
+
+        radix_sort_count(source, 0, number, element_size, key_offset, minimum, 0, passes, counts);
+
+        for (unsigned int p = 0; p < passes; p++)
+        {
+            const unsigned int shift = p * RADIX_SORT_BITS;
+            const uint64_t first_key = radix_sort_get_key(source, 0, element_size, key_offset) - minimum;
+
+            // All the keys have the same byte, this pass would not move anything
+            if (counts[p][(first_key >> shift) & (RADIX_SORT_BUCKETS - 1)] == number)
+            {
+                continue;
+            }
+
+            size_t offsets[RADIX_SORT_BUCKETS];
+            size_t total = 0;
+
+            for (unsigned int b = 0; b < RADIX_SORT_BUCKETS; b++)
+            {
+                offsets[b] = total;
+                total += counts[p][b];
+            }
+
+            radix_sort_scatter(source, destination, 0, number, element_size, key_offset, minimum, shift, offsets);
+
+            uint8_t *const temp = source;
+            source = destination;
+            destination = temp;
+        }
+    }
+
+    if (source != (uint8_t *)array)
+    {
+        memcpy(array, source, number * element_size);
+    }
+
+    if (!buffer)
+    {
+        free(scratch);
+    }
+
+    return RADIX_SORT_OK;
+}
+
+//! Sorts an array of event_PSD on their timestamps
+extern inline
+enum radix_sort_error_t radix_sort_events_PSD(struct event_PSD *events, size_t number,
+                                              struct event_PSD *buffer)
+{
+    return radix_sort_timestamps(events, number, sizeof(struct event_PSD),
+                                 offsetof(struct event_PSD, timestamp), buffer);
+}
+
+#ifdef RADIX_SORT_PARALLEL
+
+// Status of a thread of the parallel sort, each thread works on a
+// contiguous chunk of the array
+struct radix_sort_chunk
+{
+    const uint8_t *source;
+    uint8_t *destination;
+    size_t begin;
+    size_t end;
+    size_t element_size;
+    size_t key_offset;
+    uint64_t minimum;
+    unsigned int first_pass;
+    unsigned int last_pass;
+    unsigned int shift;
+    size_t counts[RADIX_SORT_MAX_PASSES][RADIX_SORT_BUCKETS];
+    size_t offsets[RADIX_SORT_BUCKETS];
+};
+
+extern inline
+void *radix_sort_chunk_count(void *arg)
+{
+    struct radix_sort_chunk *chunk = (struct radix_sort_chunk *)arg;
+
+    for (unsigned int p = chunk->first_pass; p < chunk->last_pass; p++)
+    {
+        memset(chunk->counts[p], 0, sizeof(chunk->counts[p]));
+    }
+
+    radix_sort_count(chunk->source, chunk->begin, chunk->end,
+                     chunk->element_size, chunk->key_offset, chunk->minimum,
+                     chunk->first_pass, chunk->last_pass, chunk->counts);
+
+    return NULL;
+}
+
+extern inline
+void *radix_sort_chunk_scatter(void *arg)
+{
+    struct radix_sort_chunk *chunk = (struct radix_sort_chunk *)arg;
+
+    radix_sort_scatter(chunk->source, chunk->destination, chunk->begin, chunk->end,
+                       chunk->element_size, chunk->key_offset, chunk->minimum,
+                       chunk->shift, chunk->offsets);
+
+    return NULL;
+}
+
+//! Runs the function on all the chunks, the last chunk runs in the
+//! calling thread. If a thread could not be created its chunk is processed
+//! in the calling thread as well.
+extern inline
+void radix_sort_run_chunks(struct radix_sort_chunk *chunks, unsigned int threads_number,
+                           void *(*function)(void *))
+{
+    pthread_t threads[threads_number];
+    bool started[threads_number];
+
+    for (unsigned int t = 0; t < threads_number - 1; t++)
+    {
+        started[t] = (pthread_create(&threads[t], NULL, function, &chunks[t]) == 0);
+
+        if (!started[t])
+        {
+            function(&chunks[t]);
+        }
+    }
+
+    function(&chunks[threads_number - 1]);
+
+    for (unsigned int t = 0; t < threads_number - 1; t++)
+    {
+        if (started[t])
+        {
+            pthread_join(threads[t], NULL);
+        }
+    }
+}
+
+//! Same as radix_sort_timestamps() but the counting and the scattering are
+//! distributed over threads_number threads. Each chunk scatters its elements
+//! to the positions that follow the ones of the previous chunks in the same
+//! bucket, so the sort stays stable.
+extern inline
+enum radix_sort_error_t radix_sort_timestamps_parallel(void *array, size_t number,
+                                                       size_t element_size, size_t key_offset,
+                                                       void *buffer, unsigned int threads_number)
+{
+    // The threads are worth only for big arrays
+    if (threads_number < 2 || number < threads_number * RADIX_SORT_BUCKETS * 16)
+    {
+        return radix_sort_timestamps(array, number, element_size, key_offset, buffer);
+    }
+
+    uint8_t *source = (uint8_t *)array;
+
+    uint64_t minimum = 0;
+    uint64_t maximum = 0;
+
+    const size_t descents = radix_sort_check(source, number, element_size, key_offset, &minimum, &maximum);
+
+    if (descents == 0)
+    {
+        return RADIX_SORT_OK;
+    }
+
+    const unsigned int passes = radix_sort_passes(maximum - minimum);
+
+    // The almost sorted arrays are not worth the threads
+    if (radix_sort_merges(descents) < passes)
+    {
+        return radix_sort_timestamps(array, number, element_size, key_offset, buffer);
+    }
+
+    if (element_size <= RADIX_SORT_INSERTION_MAX_SIZE)
+    {
+        if (radix_sort_insertion(source, number, element_size, key_offset, RADIX_SORT_INSERTION_MOVES * number))
+        {
+            return RADIX_SORT_OK;
+        }
+    }
+
+    struct radix_sort_chunk *chunks = (struct radix_sort_chunk *)malloc(threads_number * sizeof(struct radix_sort_chunk));
+
+    if (!chunks)
+    {
+        return RADIX_SORT_ERROR_ALLOCATION;
+    }
+
+    uint8_t *destination = (uint8_t *)buffer;
+
+    if (!buffer)
+    {
+        destination = (uint8_t *)malloc(number * element_size);
+
+        if (!destination)
+        {
+            free(chunks);
+
+            return RADIX_SORT_ERROR_ALLOCATION;
+        }
+    }
+
+    uint8_t *const scratch = destination;
+
+    for (unsigned int t = 0; t < threads_number; t++)
+    {
+        chunks[t].source = source;
+        chunks[t].begin = (number / threads_number) * t;
+        chunks[t].end = (t == threads_number - 1) ? number : (number / threads_number) * (t + 1);
+        chunks[t].element_size = element_size;
+        chunks[t].key_offset = key_offset;
+        chunks[t].minimum = minimum;
+        chunks[t].first_pass = 0;
+        chunks[t].last_pass = passes;
+    }
+
+    radix_sort_run_chunks(chunks, threads_number, radix_sort_chunk_count);
+
+    // The total counts do not depend on the order of the elements, thus they
+    // are used to skip the passes in which all the keys have the same byte.
+    size_t totals[RADIX_SORT_MAX_PASSES][RADIX_SORT_BUCKETS];
+    memset(totals, 0, sizeof(totals));
+
+    for (unsigned int t = 0; t < threads_number; t++)
+    {
+        for (unsigned int p = 0; p < passes; p++)
+        {
+            for (unsigned int b = 0; b < RADIX_SORT_BUCKETS; b++)
+            {
+                totals[p][b] += chunks[t].counts[p][b];
+            }
+        }
+    }
+
+    // The counts of the chunks instead change after every scatter
+    bool outdated_counts = false;
+
+    for (unsigned int p = 0; p < passes; p++)
+    {
+        const unsigned int shift = p * RADIX_SORT_BITS;
+
+        bool skip = false;
+
+        for (unsigned int b = 0; b < RADIX_SORT_BUCKETS; b++)
+        {
+            skip = skip || (totals[p][b] == number);
+        }
+
+        if (skip)
+        {
+            continue;
+        }
+
+        if (outdated_counts)
+        {
+            for (unsigned int t = 0; t < threads_number; t++)
+            {
+                chunks[t].source = source;
+                chunks[t].first_pass = p;
+                chunks[t].last_pass = p + 1;
+            }
+
+            radix_sort_run_chunks(chunks, threads_number, radix_sort_chunk_count);
+        }
+
+        size_t total = 0;
+
+        for (unsigned int b = 0; b < RADIX_SORT_BUCKETS; b++)
+        {
+            for (unsigned int t = 0; t < threads_number; t++)
+            {
+                chunks[t].offsets[b] = total;
+                total += chunks[t].counts[p][b];
+            }
+        }
+
+        for (unsigned int t = 0; t < threads_number; t++)
+        {
+            chunks[t].source = source;
+            chunks[t].destination = destination;
+            chunks[t].shift = shift;
+        }
+
+        radix_sort_run_chunks(chunks, threads_number, radix_sort_chunk_scatter);
+
+        uint8_t *const temp = source;
+        source = destination;
+        destination = temp;
+
+        outdated_counts = true;
+    }
+
+    if (source != (uint8_t *)array)
+    {
+        memcpy(array, source, number * element_size);
+    }
+
+    if (!buffer)
+    {
+        free(scratch);
+    }
+
+    free(chunks);
+
+    return RADIX_SORT_OK;
+}
+
+#endif
+
+#endif
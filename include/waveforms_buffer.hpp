@@ -0,0 +1,283 @@
+#ifndef __WAVEFORMS_BUFFER_HPP__
+#define __WAVEFORMS_BUFFER_HPP__ 1
+
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+// Helpers to write waveforms directly in their binary wire format, without
+// creating an intermediate event_waveform for each record.
+// The wire format of a waveform is:
+//
+//  - timestamp:            uint64_t
+//  - channel:              uint8_t
+//  - samples_number:       uint32_t
+//  - additional_waveforms: uint8_t
+//  - samples:              uint16_t[samples_number]
+//  - additional samples:   uint8_t[samples_number * additional_waveforms]
+//
+// This header is independent from events.h and events.hpp, so it can be used
+// by both the C and C++ flavours of the event_waveform.
+
+namespace waveforms_buffer {
+    constexpr size_t timestamp_offset = 0;
+    constexpr size_t channel_offset = timestamp_offset + sizeof(uint64_t);
+    constexpr size_t samples_number_offset = channel_offset + sizeof(uint8_t);
+    constexpr size_t additional_waveforms_offset = samples_number_offset + sizeof(uint32_t);
+    constexpr size_t header_size = additional_waveforms_offset + sizeof(uint8_t);
+
+    inline size_t record_size(uint32_t samples_number,
+                              uint8_t additional_waveforms)
+    {
+        return header_size
+               + sizeof(uint16_t) * samples_number
+               + sizeof(uint8_t) * samples_number * additional_waveforms;
+    }
+
+    //! Returns the size of the record starting at the given pointer
+    inline size_t record_size(const uint8_t *record)
+    {
+        uint32_t samples_number;
+        uint8_t additional_waveforms;
+
+        memcpy(&samples_number, record + samples_number_offset, sizeof(samples_number));
+        memcpy(&additional_waveforms, record + additional_waveforms_offset, sizeof(additional_waveforms));
+
+        return record_size(samples_number, additional_waveforms);
+    }
+
+    inline uint8_t get_channel(const uint8_t *record)
+    {
+        return record[channel_offset];
+    }
+
+    inline void set_channel(uint8_t *record, uint8_t channel)
+    {
+        record[channel_offset] = channel;
+    }
+
+    //! Buffer shared by the writers of readouts running concurrently.
+    //! The writers claim the space of each record under a mutex and then
+    //! write the samples without locks, so the records of the different
+    //! readouts are interleaved in the buffer.
+    //! The buffer is grown only when no writer is writing in it: the writers
+    //! hold a shared lock on grow_mutex from append() until the next append()
+    //! or close().
+    class concurrent_buffer
+    {
+        public:
+            std::vector<uint8_t> &buffer;
+
+            // Bytes claimed by the writers, the buffer might be bigger
+            size_t used;
+
+            // Records of the failed readouts, as offsets and sizes
+            std::vector<std::pair<size_t, size_t>> discarded;
+
+            std::mutex claim_mutex;
+            std::shared_mutex grow_mutex;
+
+            concurrent_buffer(std::vector<uint8_t> &Buffer) : \
+                buffer(Buffer), used(Buffer.size()) {};
+
+            //! Claims the space of a record and returns its offset
+            inline size_t claim(size_t size)
+            {
+                std::lock_guard<std::mutex> claim_lock(claim_mutex);
+
+                const size_t offset = used;
+                used += size;
+
+                if (used > buffer.size())
+                {
+                    std::unique_lock<std::shared_mutex> grow_lock(grow_mutex);
+
+                    // std::vector::resize() would grow the capacity only up
+                    // to the requested size
+                    buffer.resize(std::max(used, 2 * buffer.size()));
+                }
+
+                return offset;
+            }
+
+            inline void discard(const std::vector<std::pair<size_t, size_t>> &records)
+            {
+                std::lock_guard<std::mutex> claim_lock(claim_mutex);
+
+                discarded.insert(discarded.end(), records.begin(), records.end());
+            }
+
+            //! Removes the discarded records and the unused space at the end.
+            //! It must be called after all the writers were closed.
+            inline void finish()
+            {
+                std::sort(discarded.begin(), discarded.end());
+
+                size_t write_offset = discarded.empty() ? used : discarded.front().first;
+                size_t read_offset = write_offset;
+
+                for (size_t i = 0; i < discarded.size(); i++)
+                {
+                    read_offset = discarded[i].first + discarded[i].second;
+
+                    const size_t next = (i + 1 < discarded.size()) ? discarded[i + 1].first : used;
+
+                    memmove(buffer.data() + write_offset, buffer.data() + read_offset, next - read_offset);
+
+                    write_offset += next - read_offset;
+                }
+
+                discarded.clear();
+
+                buffer.resize(write_offset);
+                used = write_offset;
+            }
+    };
+
+    //! Appends waveforms records to a byte buffer, reserving the space in place.
+    //! The pointers returned by append() and additional() are valid only until
+    //! the next call to append(), as the buffer might be reallocated.
+    //! The first_channel is added to the channels, to convert them to the
+    //! global numbering while writing the headers.
+    class writer
+    {
+        public:
+            std::vector<uint8_t> &buffer;
+
+            // Offset of the first byte written by this writer, used to
+            // discard all the records of a failed readout.
+            const size_t start;
+            size_t last_record;
+            size_t records_number;
+
+            const uint8_t first_channel;
+
+            // Only for the concurrent readouts
+            concurrent_buffer *shared;
+            std::shared_lock<std::shared_mutex> write_lock;
+            std::vector<std::pair<size_t, size_t>> records;
+
+            writer(std::vector<uint8_t> &Buffer, uint8_t First_Channel = 0) : \
+                buffer(Buffer), start(Buffer.size()), last_record(Buffer.size()), records_number(0),
+                first_channel(First_Channel), shared(nullptr) {};
+            writer(concurrent_buffer &Shared, uint8_t First_Channel = 0) : \
+                buffer(Shared.buffer), start(0), last_record(0), records_number(0),
+                first_channel(First_Channel), shared(&Shared) {};
+            ~writer() { close(); };
+
+            writer(const writer &) = delete;
+            writer &operator=(const writer &) = delete;
+
+            //! Releases the buffer to the other writers, the pointers returned
+            //! by append() and additional() are no longer valid
+            inline void close()
+            {
+                if (write_lock.owns_lock())
+                {
+                    write_lock.unlock();
+                }
+            }
+
+            //! Reserves a new record at the end of the buffer, writes its
+            //! header and returns the pointer to its samples.
+            inline uint16_t *append(uint64_t timestamp,
+                                    uint8_t channel,
+                                    uint32_t samples_number,
+                                    uint8_t additional_waveforms = 0)
+            {
+                const size_t this_record_size = record_size(samples_number, additional_waveforms);
+
+                if (shared)
+                {
+                    close();
+
+                    last_record = shared->claim(this_record_size);
+                    records.emplace_back(last_record, this_record_size);
+
+                    write_lock = std::shared_lock<std::shared_mutex>(shared->grow_mutex);
+                }
+                else
+                {
+                    last_record = buffer.size();
+
+                    // std::vector grows geometrically, thus if the buffer was
+                    // properly reserved this does not reallocate.
+                    buffer.resize(last_record + this_record_size);
+                }
+
+                channel += first_channel;
+
+                uint8_t *const record = buffer.data() + last_record;
+
+                memcpy(record + timestamp_offset, &timestamp, sizeof(timestamp));
+                memcpy(record + channel_offset, &channel, sizeof(channel));
+                memcpy(record + samples_number_offset, &samples_number, sizeof(samples_number));
+                memcpy(record + additional_waveforms_offset, &additional_waveforms, sizeof(additional_waveforms));
+
+                records_number += 1;
+
+                return reinterpret_cast<uint16_t*>(record + header_size);
+            }
+
+            //! Returns the pointer to an additional waveform of the last record
+            inline uint8_t *additional(uint8_t index)
+            {
+                uint8_t *const record = buffer.data() + last_record;
+
+                uint32_t samples_number;
+                memcpy(&samples_number, record + samples_number_offset, sizeof(samples_number));
+
+                return record + header_size
+                              + sizeof(uint16_t) * samples_number
+                              + sizeof(uint8_t) * samples_number * index;
+            }
+
+            //! Removes all the records written by this writer
+            inline void discard()
+            {
+                if (shared)
+                {
+                    close();
+
+                    shared->discard(records);
+                    records.clear();
+                }
+                else
+                {
+                    buffer.resize(start);
+                    last_record = start;
+                }
+
+                records_number = 0;
+            }
+
+            inline size_t get_records_number() const
+            {
+                return records_number;
+            }
+
+            //! Size in bytes of the records written by this writer
+            inline size_t size() const
+            {
+                if (shared)
+                {
+                    size_t total = 0;
+
+                    for (const auto &record: records)
+                    {
+                        total += record.second;
+                    }
+
+                    return total;
+                }
+
+                return buffer.size() - start;
+            }
+    };
+}
+
+#endif
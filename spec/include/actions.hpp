@@ -14,7 +14,13 @@ namespace actions
         void publish_message(status&, std::string, json_t*);
         bool publish_status(status&);
         bool publish_data(status&);
+        bool publish_deltas(status&);
         bool read_socket(status&);
+
+        void fill_partial_spectra(const status&, partial_spectra&, const struct event_PSD*, size_t);
+        void merge_partial_spectra(status&);
+        void reset_channel(status&, unsigned int);
+        void reset_all_channels(status&);
     }
 
     state start(status&);
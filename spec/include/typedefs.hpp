@@ -7,8 +7,13 @@
 #include <map>
 #include <cstdint>
 #include <set>
+#include <array>
+#include <vector>
+#include <memory>
 
 #include "defaults.h"
+#include "histograms_deltas.hpp"
+#include "workers_pool.hpp"
 
 #define counter_type double
 
@@ -17,6 +22,7 @@ extern "C" {
 
 #include "histogram.h"
 #include "histogram2D.h"
+#include "events.h"
 }
 
 enum spectra_types {
@@ -32,6 +38,35 @@ enum PSD_types {
     BASELINE_VS_ENERGY_PSD = 3,
 };
 
+// Histograms filled by a worker thread, indexed by channel.
+// They are merged into the histograms of the status at each publication.
+struct partial_spectra
+{
+    std::array<histogram_t*, 256> histos_E;
+    std::array<histogram2D_t*, 256> histos_PSD;
+    std::array<unsigned int, 256> counts;
+
+    // Tiles of the PSD histograms filled since the last merge, so that only
+    // those are merged and cleared
+    std::array<std::vector<unsigned int>, 256> touched_tiles;
+    std::array<std::vector<bool>, 256> tiles_flags;
+
+    // Events of a slice grouped by channel, to fill the histograms of each
+    // channel with the batch fills. The buffers are reused between slices.
+    std::array<std::vector<struct event_PSD>, 256> channels_events;
+    std::vector<unsigned int> filled_channels;
+    std::vector<double> energies;
+    std::vector<double> psds;
+    std::vector<int> tile_indexes;
+
+    partial_spectra()
+    {
+        histos_E.fill(nullptr);
+        histos_PSD.fill(nullptr);
+        counts.fill(0);
+    }
+};
+
 struct status
 {
     std::string status_address = defaults_spec_status_address;
@@ -68,6 +103,11 @@ struct status
     std::map<unsigned int, unsigned int> counts_partial;
     std::map<unsigned int, unsigned int> counts_total;
 
+    unsigned int workers_number = defaults_spec_workers_number;
+    std::vector<partial_spectra> partials = std::vector<partial_spectra>(defaults_spec_workers_number);
+    // Threads of the workers but the first one, that is the main thread
+    std::unique_ptr<workers_pool> workers = std::make_unique<workers_pool>(defaults_spec_workers_number - 1);
+
     unsigned int publish_timeout = defaults_spec_publish_timeout;
 
     bool time_decay_enabled = defaults_tofcalc_time_decay_enabled;
@@ -75,6 +115,13 @@ struct status
     double time_decay_minimum = defaults_tofcalc_time_decay_minimum;
 
     bool disable_bidimensional_plot = false;
+    // Tiled storage of the PSD histograms, allocated only where they are filled
+    bool sparse_bidimensional_plot = false;
+
+    // The histograms may be published as JSON and/or as binary deltas
+    bool publish_json = true;
+    bool publish_binary = false;
+    histograms_deltas::publisher deltas_publisher = histograms_deltas::publisher(defaults_spec_keyframe_period);
 };
 
 struct state
@@ -0,0 +1,138 @@
+#ifndef __WORKERS_POOL_HPP__
+#define __WORKERS_POOL_HPP__ 1
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Threads that are created once and then run a job each at every call of
+// run(), so that the elaboration of a message does not pay the creation of
+// the threads. The calling thread takes care of the first job.
+// Every call of run() is a generation, that all the threads shall confirm,
+// even those without a job, before run() returns. So no thread may look at the
+// jobs of a generation after they are gone.
+class workers_pool
+{
+public:
+    workers_pool(unsigned int Threads_number)
+    {
+        for (unsigned int index = 0; index < Threads_number; index++)
+        {
+            threads.emplace_back(&workers_pool::work, this, index);
+        }
+    }
+
+    ~workers_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            stopping = true;
+        }
+
+        start_condition.notify_all();
+
+        for (auto &thread: threads)
+        {
+            thread.join();
+        }
+    }
+
+    workers_pool(const workers_pool&) = delete;
+    workers_pool& operator=(const workers_pool&) = delete;
+
+    //! Number of jobs that may run concurrently, including the calling thread
+    size_t size() const
+    {
+        return threads.size() + 1;
+    }
+
+    //! Runs the jobs concurrently and returns when all of them are done.
+    //! There shall not be more jobs than size().
+    void run(const std::vector<std::function<void()>> &Jobs)
+    {
+        if (Jobs.empty())
+        {
+            return;
+        }
+
+        if (threads.empty())
+        {
+            Jobs[0]();
+
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            jobs = &Jobs;
+            pending = threads.size();
+            generation += 1;
+        }
+
+        start_condition.notify_all();
+
+        Jobs[0]();
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        done_condition.wait(lock, [this]{ return pending == 0; });
+
+        jobs = nullptr;
+    }
+
+private:
+    void work(unsigned int index)
+    {
+        unsigned long int last_generation = 0;
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true)
+        {
+            start_condition.wait(lock, [&]{ return stopping || generation != last_generation; });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            last_generation = generation;
+
+            // The jobs stay valid until this thread confirms the generation
+            const std::vector<std::function<void()>> *these_jobs = jobs;
+
+            // The first job is run by the calling thread
+            if (index + 1 < these_jobs->size())
+            {
+                lock.unlock();
+                (*these_jobs)[index + 1]();
+                lock.lock();
+            }
+
+            pending -= 1;
+
+            if (pending == 0)
+            {
+                done_condition.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+
+    const std::vector<std::function<void()>> *jobs = nullptr;
+    size_t pending = 0;
+    unsigned long int generation = 0;
+    bool stopping = false;
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <cstring>
 
 #include <map>
+// For std::max
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 // For std::this_thread::sleep_for
@@ -85,6 +87,8 @@ void print_usage(const std::string &name = std::string("spec")) {
     std::cout << "\t-T <period>: Set base period in milliseconds, default: ";
     std::cout << defaults_spec_base_period << std::endl;
     std::cout << "\t-f <config_file>: Set config file, default: none" << std::endl;
+    std::cout << "\t-w <workers>: Number of threads that fill the histograms, default: ";
+    std::cout << defaults_spec_workers_number << std::endl;
     std::cout << "\t-v: Set verbose execution" << std::endl;
     std::cout << "\t-V: Set verbose execution with more details" << std::endl;
 
@@ -115,9 +119,10 @@ int main(int argc, char *argv[])
     std::string commands_address = defaults_spec_commands_address;
     std::string config_file;
     unsigned int base_period = defaults_spec_base_period;
+    unsigned int workers_number = defaults_spec_workers_number;
 
     int c = 0;
-    while ((c = getopt(argc, argv, "hA:S:D:C:T:f:vV")) != -1) {
+    while ((c = getopt(argc, argv, "hA:S:D:C:T:f:w:vV")) != -1) {
         switch (c) {
             case 'h':
                 print_usage(std::string(argv[0]));
@@ -145,6 +150,14 @@ int main(int argc, char *argv[])
             case 'f':
                 config_file = optarg;
                 break;
+            case 'w':
+                try
+                {
+                    workers_number = std::max(1ul, std::stoul(optarg));
+                }
+                catch (std::logic_error &e)
+                { }
+                break;
             case 'v':
                 verbosity = 1;
                 break;
@@ -169,6 +182,9 @@ int main(int argc, char *argv[])
     global_status.PSD_normalize = true;
     global_status.disable_bidimensional_plot = false;
     global_status.config_file = config_file;
+    global_status.workers_number = workers_number;
+    global_status.partials.resize(workers_number);
+    global_status.workers = std::make_unique<workers_pool>(workers_number - 1);
 
     if (global_status.verbosity > 0) {
         std::cout << "ABCD data socket address: " << abcd_data_address << std::endl;
@@ -177,6 +193,7 @@ int main(int argc, char *argv[])
         std::cout << "Commands socket address: " << commands_address << std::endl;
         std::cout << "Verbosity: " << verbosity << std::endl;
         std::cout << "Base period: " << base_period << std::endl;
+        std::cout << "Workers number: " << workers_number << std::endl;
     }
 
     state current_state = states::START;
@@ -10,6 +10,8 @@
 #include <cstdint>
 #include <ctime>
 #include <limits>
+#include <array>
+#include <functional>
 
 extern "C" {
 #include <zmq.h>
@@ -59,13 +61,18 @@ void add_channel(status &global_status, unsigned int channel)
                                                            defaults_spec_max_E,
                                                            global_status.verbosity);
 
-        global_status.histos_PSD[channel] = histogram2D_create(defaults_spec_bins_E,
-                                                              defaults_spec_min_E,
-                                                              defaults_spec_max_E,
-                                                              defaults_spec_bins_PSD,
-                                                              defaults_spec_min_PSD,
-                                                              defaults_spec_max_PSD,
-                                                              global_status.verbosity);
+        const histogram2D_storage_t storage_PSD = global_status.sparse_bidimensional_plot ?
+                                                  HISTOGRAM2D_STORAGE_TILED :
+                                                  HISTOGRAM2D_STORAGE_DENSE;
+
+        global_status.histos_PSD[channel] = histogram2D_create_with_storage(defaults_spec_bins_E,
+                                                                           defaults_spec_min_E,
+                                                                           defaults_spec_max_E,
+                                                                           defaults_spec_bins_PSD,
+                                                                           defaults_spec_min_PSD,
+                                                                           defaults_spec_max_PSD,
+                                                                           storage_PSD,
+                                                                           global_status.verbosity);
         global_status.counts_partial[channel] = 0;
         global_status.counts_total[channel] = 0;
 
@@ -148,6 +155,338 @@ void add_channel(status &global_status, unsigned int channel)
     }
 }
 
+/******************************************************************************/
+/* Spectra accumulation                                                       */
+/******************************************************************************/
+
+//! Creates the partial histograms of a channel, with the same configuration
+//! of the histograms in the status.
+bool create_partial_spectra(const status &global_status,
+                            partial_spectra &partial,
+                            unsigned int channel)
+{
+    const auto histo_E_it = global_status.histos_E.find(channel);
+    const auto histo_PSD_it = global_status.histos_PSD.find(channel);
+
+    if (histo_E_it == global_status.histos_E.end() || !histo_E_it->second ||
+        histo_PSD_it == global_status.histos_PSD.end() || !histo_PSD_it->second)
+    {
+        return false;
+    }
+
+    const histogram_t *const histo_E = histo_E_it->second;
+    const histogram2D_t *const histo_PSD = histo_PSD_it->second;
+
+    if (!partial.histos_E[channel])
+    {
+        partial.histos_E[channel] = histogram_create(histo_E->bins,
+                                                     histo_E->min,
+                                                     histo_E->max,
+                                                     0);
+    }
+
+    if (!partial.histos_PSD[channel])
+    {
+        partial.histos_PSD[channel] = histogram2D_create_with_storage(histo_PSD->bins_x,
+                                                                      histo_PSD->min_x,
+                                                                      histo_PSD->max_x,
+                                                                      histo_PSD->bins_y,
+                                                                      histo_PSD->min_y,
+                                                                      histo_PSD->max_y,
+                                                                      histo_PSD->storage,
+                                                                      0);
+
+        if (partial.histos_PSD[channel])
+        {
+            const histogram2D_t *const partial_PSD = partial.histos_PSD[channel];
+
+            partial.tiles_flags[channel].assign(partial_PSD->tiles_x * partial_PSD->tiles_y, false);
+            partial.touched_tiles[channel].clear();
+        }
+    }
+
+    return partial.histos_E[channel] && partial.histos_PSD[channel];
+}
+
+//! Fills the partial histograms of a worker with a slice of the events.
+//! It runs concurrently with the other workers, thus it shall only read the
+//! status. All the channels of the events shall have been already added.
+//! The events are grouped by channel, so that the histograms of each channel
+//! are filled with the batch fills.
+void actions::generic::fill_partial_spectra(const status &global_status,
+                                            partial_spectra &partial,
+                                            const struct event_PSD *events,
+                                            size_t events_number)
+{
+    for (size_t i = 0; i < events_number; i++)
+    {
+        const event_PSD this_event = events[i];
+
+        const unsigned int channel = this_event.channel;
+
+        // The partial histograms are created the first time that a channel
+        // is seen by this worker
+        if ((partial.histos_E[channel] && partial.histos_PSD[channel]) ||
+            create_partial_spectra(global_status, partial, channel))
+        {
+            if (partial.channels_events[channel].empty())
+            {
+                partial.filled_channels.push_back(channel);
+            }
+
+            partial.channels_events[channel].push_back(this_event);
+        }
+
+        partial.counts[channel] += 1;
+    }
+
+    for (const unsigned int channel: partial.filled_channels)
+    {
+        std::vector<struct event_PSD> &channel_events = partial.channels_events[channel];
+
+        const size_t channel_events_number = channel_events.size();
+
+        // The energy histogram is filled directly from the field of the events
+        const uint16_t *energies_field = &channel_events[0].qlong;
+
+        if (global_status.spectra_type == QSHORT_SPECTRA) {
+            energies_field = &channel_events[0].qshort;
+        } else if (global_status.spectra_type == BASELINE_SPECTRA) {
+            energies_field = &channel_events[0].baseline;
+        }
+
+        histogram_fill_n_uint16(partial.histos_E[channel], energies_field, channel_events_number, sizeof(struct event_PSD));
+
+        partial.energies.resize(channel_events_number);
+        partial.psds.resize(channel_events_number);
+        partial.tile_indexes.resize(channel_events_number);
+
+        for (size_t i = 0; i < channel_events_number; i++)
+        {
+            const event_PSD this_event = channel_events[i];
+
+            // We can directly convert these to double because we only do
+            // calculations using doubles anyways.
+            const double qshort = this_event.qshort;
+            const double qlong = this_event.qlong;
+            const double baseline = this_event.baseline;
+            double energy = 0;
+            double psd = 0;
+
+            if (global_status.spectra_type == QLONG_SPECTRA) {
+                energy = qlong;
+            } else if (global_status.spectra_type == QSHORT_SPECTRA) {
+                energy = qshort;
+            } else if (global_status.spectra_type == BASELINE_SPECTRA) {
+                energy = baseline;
+            } else {
+                energy = qlong;
+            }
+
+            double PSD_normalization = energy;
+
+            if (global_status.PSD_normalize) {
+                PSD_normalization = energy;
+
+                // Correct the PSD_normalization value to something that should not cause an error
+                if (PSD_normalization == 0) {
+                    PSD_normalization = std::numeric_limits<double>::min();
+                }
+            } else {
+                PSD_normalization = 1.0;
+            }
+
+            if (global_status.PSD_type == QTAIL_VS_ENERGY_PSD) {
+                psd = (qlong - qshort) / PSD_normalization;
+            } else if (global_status.PSD_type == QSHORT_VS_ENERGY_PSD) {
+                psd = qshort / PSD_normalization;
+            } else if (global_status.PSD_type == QLONG_VS_ENERGY_PSD) {
+                psd = qlong / PSD_normalization;
+            } else if (global_status.PSD_type == BASELINE_VS_ENERGY_PSD) {
+                psd = baseline / PSD_normalization;
+            } else {
+                psd = (qlong - qshort) / energy;
+            }
+
+            if (global_status.verbosity > 1)
+            {
+                char time_buffer[BUFFER_SIZE];
+                time_string(time_buffer, BUFFER_SIZE, NULL);
+                std::cout << '[' << time_buffer << "] ";
+                std::cout << "Event: " << i << "; ";
+                std::cout << "Channel: " << channel << "; ";
+                std::cout << "qshort: " << qshort << "; ";
+                std::cout << "qlong: " << qlong << "; ";
+                std::cout << "PSD: " << psd << "; ";
+                std::cout << std::endl;
+            }
+
+            partial.energies[i] = energy;
+            partial.psds[i] = psd;
+        }
+
+        histogram2D_fill_n(partial.histos_PSD[channel],
+                           partial.energies.data(),
+                           partial.psds.data(),
+                           channel_events_number,
+                           partial.tile_indexes.data());
+
+        for (const int tile_index: partial.tile_indexes)
+        {
+            if (tile_index >= 0 && !partial.tiles_flags[channel][tile_index])
+            {
+                partial.tiles_flags[channel][tile_index] = true;
+                partial.touched_tiles[channel].push_back(tile_index);
+            }
+        }
+
+        channel_events.clear();
+    }
+
+    partial.filled_channels.clear();
+}
+
+//! Adds the partial histograms of all the workers to the histograms in the
+//! status, and resets them. Only the tiles of the PSD histograms that were
+//! filled are merged and cleared, as they are usually a small fraction.
+void actions::generic::merge_partial_spectra(status &global_status)
+{
+    for (auto &partial: global_status.partials)
+    {
+        for (unsigned int channel = 0; channel < partial.counts.size(); channel++)
+        {
+            if (partial.counts[channel] == 0)
+            {
+                continue;
+            }
+
+            const auto histo_E_it = global_status.histos_E.find(channel);
+            const auto histo_PSD_it = global_status.histos_PSD.find(channel);
+
+            if (histo_E_it != global_status.histos_E.end() && partial.histos_E[channel])
+            {
+                histogram_add_to(histo_E_it->second, partial.histos_E[channel]);
+                histogram_reset(partial.histos_E[channel]);
+            }
+
+            if (histo_PSD_it != global_status.histos_PSD.end() && partial.histos_PSD[channel])
+            {
+                for (const unsigned int tile_index: partial.touched_tiles[channel])
+                {
+                    histogram2D_add_tile_to(histo_PSD_it->second, partial.histos_PSD[channel], tile_index);
+                    histogram2D_reset_tile(partial.histos_PSD[channel], tile_index);
+
+                    partial.tiles_flags[channel][tile_index] = false;
+                }
+            }
+
+            partial.touched_tiles[channel].clear();
+
+            global_status.counts_partial[channel] += partial.counts[channel];
+            global_status.counts_total[channel] += partial.counts[channel];
+
+            partial.counts[channel] = 0;
+        }
+    }
+}
+
+//! Resets the partial histograms of a channel of a worker, dropping the
+//! events that were not merged yet.
+void reset_partial_spectra(partial_spectra &partial, unsigned int channel)
+{
+    if (partial.histos_E[channel])
+    {
+        histogram_reset(partial.histos_E[channel]);
+    }
+
+    if (partial.histos_PSD[channel])
+    {
+        for (const unsigned int tile_index: partial.touched_tiles[channel])
+        {
+            histogram2D_reset_tile(partial.histos_PSD[channel], tile_index);
+
+            partial.tiles_flags[channel][tile_index] = false;
+        }
+    }
+
+    partial.touched_tiles[channel].clear();
+
+    partial.counts[channel] = 0;
+}
+
+//! Resets the histograms and the counts of a channel. The partial histograms
+//! of the workers are reset as well, otherwise the next merge would bring
+//! their counts back.
+void actions::generic::reset_channel(status &global_status, unsigned int channel)
+{
+    const auto histo_E_it = global_status.histos_E.find(channel);
+
+    if (histo_E_it != global_status.histos_E.end() && histo_E_it->second)
+    {
+        histogram_reset(histo_E_it->second);
+    }
+
+    const auto histo_PSD_it = global_status.histos_PSD.find(channel);
+
+    if (histo_PSD_it != global_status.histos_PSD.end() && histo_PSD_it->second)
+    {
+        histogram2D_reset(histo_PSD_it->second);
+    }
+
+    global_status.counts_partial[channel] = 0;
+    global_status.counts_total[channel] = 0;
+
+    for (auto &partial: global_status.partials)
+    {
+        if (channel < partial.counts.size())
+        {
+            reset_partial_spectra(partial, channel);
+        }
+    }
+}
+
+//! Resets the histograms and the counts of all the channels, together with
+//! the partial histograms of the workers.
+void actions::generic::reset_all_channels(status &global_status)
+{
+    for (auto &pair: global_status.histos_E)
+    {
+        histogram_t *const histo_E = pair.second;
+
+        if (histo_E)
+        {
+            histogram_reset(histo_E);
+        }
+    }
+
+    for (auto &pair: global_status.histos_PSD)
+    {
+        histogram2D_t *const histo_PSD = pair.second;
+
+        if (histo_PSD != NULL)
+        {
+            histogram2D_reset(histo_PSD);
+        }
+    }
+
+    for (auto &pair: global_status.counts_partial)
+    {
+        pair.second = 0;
+    }
+    for (auto &pair: global_status.counts_total)
+    {
+        pair.second = 0;
+    }
+
+    for (auto &partial: global_status.partials)
+    {
+        for (unsigned int channel = 0; channel < partial.counts.size(); channel++)
+        {
+            reset_partial_spectra(partial, channel);
+        }
+    }
+}
+
 /******************************************************************************/
 /* Generic actions                                                            */
 /******************************************************************************/
@@ -180,6 +519,30 @@ void actions::generic::clear_memory(status &global_status)
 
     global_status.counts_partial.clear();
     global_status.counts_total.clear();
+
+    for (auto &partial: global_status.partials)
+    {
+        for (histogram_t *const histo_E: partial.histos_E)
+        {
+            if (histo_E)
+            {
+                histogram_destroy(histo_E);
+            }
+        }
+
+        for (histogram2D_t *const histo_PSD: partial.histos_PSD)
+        {
+            if (histo_PSD)
+            {
+                histogram2D_destroy(histo_PSD);
+            }
+        }
+
+        partial = partial_spectra();
+    }
+
+    // The clients need a keyframe after a reconfiguration
+    global_status.deltas_publisher.reset();
 }
 
 void actions::generic::publish_message(status &global_status,
@@ -203,6 +566,8 @@ void actions::generic::publish_message(status &global_status,
 
 bool actions::generic::publish_status(status &global_status)
 {
+    merge_partial_spectra(global_status);
+
     json_t *status_message = json_object();
     if (status_message == NULL)
     {
@@ -324,11 +689,11 @@ bool actions::generic::publish_status(status &global_status)
                     std::cout << std::endl;
                 }
 
-                histogram_scale(histo_E, time_decay_constant);
-                histogram2D_scale(histo_PSD, time_decay_constant);
-
-                histogram_counts_clear_minimum(histo_E, global_status.time_decay_minimum);
-                histogram2D_counts_clear_minimum(histo_PSD, global_status.time_decay_minimum);
+                // The decay is accumulated in the weights of the histograms,
+                // the bins are updated and cleared from the counts below the
+                // minimum only when the weights drift too much.
+                histogram_scale_lazy(histo_E, time_decay_constant, global_status.time_decay_minimum);
+                histogram2D_scale_lazy(histo_PSD, time_decay_constant, global_status.time_decay_minimum);
             }
         }
     }
@@ -338,6 +703,19 @@ bool actions::generic::publish_status(status &global_status)
 
 bool actions::generic::publish_data(status &global_status)
 {
+    // The histograms of the workers are merged only at the publications
+    merge_partial_spectra(global_status);
+
+    if (global_status.publish_binary)
+    {
+        actions::generic::publish_deltas(global_status);
+    }
+
+    if (!global_status.publish_json)
+    {
+        return true;
+    }
+
     json_t *status_message = json_object();
     if (status_message == NULL)
     {
@@ -444,6 +822,119 @@ bool actions::generic::publish_data(status &global_status)
     return true;
 }
 
+bool actions::generic::publish_deltas(status &global_status)
+{
+    histograms_deltas::publisher &deltas_publisher = global_status.deltas_publisher;
+
+    json_t *header = json_object();
+    json_t *active_channels = json_array();
+    json_t *channels_data = json_array();
+
+    if (header == NULL || active_channels == NULL || channels_data == NULL)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "ERROR: Unable to create deltas header json; ";
+        std::cout << std::endl;
+
+        json_decref(header);
+        json_decref(active_channels);
+        json_decref(channels_data);
+
+        return false;
+    }
+
+    const auto now = std::chrono::system_clock::now();
+    const auto pub_delta_time = std::chrono::duration_cast<std::chrono::duration<long int>>(now - global_status.last_publication);
+    const double pubtime = static_cast<double>(pub_delta_time.count());
+
+    deltas_publisher.begin();
+
+    for (const unsigned int &channel: global_status.active_channels)
+    {
+        histogram_t *const histo_E = global_status.histos_E[channel];
+        histogram2D_t *const histo_PSD = global_status.histos_PSD[channel];
+        const unsigned int channel_total_counts = global_status.counts_total[channel];
+        const unsigned int channel_partial_counts = global_status.counts_partial[channel];
+        const double channel_rate = channel_partial_counts / pubtime;
+
+        if (histo_E && histo_PSD) {
+            const std::string channel_key = std::to_string(channel);
+
+            json_t *histo_E_data = deltas_publisher.add(channel_key + "/energy", histo_E->histo, histo_E->bins, histo_E->scale);
+            json_object_set_new_nocheck(histo_E_data, "config", histogram_config_to_json(histo_E));
+
+            json_t *channel_data = json_object();
+
+            json_object_set_new_nocheck(channel_data, "id", json_integer(channel));
+            json_object_set_new_nocheck(channel_data, "enabled", json_true());
+            json_object_set_new_nocheck(channel_data, "rate", json_real(channel_rate));
+            json_object_set_new_nocheck(channel_data, "counts", json_integer(channel_total_counts));
+            json_object_set_new_nocheck(channel_data, "energy", histo_E_data);
+
+            if (!global_status.disable_bidimensional_plot) {
+                json_t *histo_PSD_data = deltas_publisher.add_histogram2D(channel_key + "/PSD", histo_PSD);
+                json_object_set_new_nocheck(histo_PSD_data, "config", histogram2D_config_to_json(histo_PSD));
+                json_object_set_new_nocheck(channel_data, "PSD", histo_PSD_data);
+            }
+
+            json_array_append_new(channels_data, channel_data);
+
+            json_array_append_new(active_channels, json_integer(channel));
+        }
+    }
+
+    json_object_set_new_nocheck(header, "data", channels_data);
+    json_object_set_new_nocheck(header, "active_channels", active_channels);
+
+    char time_buffer[BUFFER_SIZE];
+    time_string(time_buffer, BUFFER_SIZE, NULL);
+
+    json_object_set_new_nocheck(header, "module", json_string("spec"));
+    json_object_set_new_nocheck(header, "timestamp", json_string(time_buffer));
+    json_object_set_new_nocheck(header, "msg_ID", json_integer(global_status.data_msg_ID));
+
+    std::vector<uint8_t> message;
+
+    const bool result = deltas_publisher.finish(header, message);
+
+    json_decref(header);
+
+    if (!result)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "ERROR: Unable to encode the deltas header; ";
+        std::cout << std::endl;
+
+        return false;
+    }
+
+    if (global_status.verbosity > 0)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "Publishing deltas; ";
+        std::cout << "Keyframe: " << (deltas_publisher.keyframe ? "true" : "false") << "; ";
+        std::cout << "Payload size: " << deltas_publisher.payload.size() << "; ";
+        std::cout << "Message size: " << message.size() << "; ";
+        std::cout << std::endl;
+    }
+
+    send_byte_message(global_status.data_socket, defaults_spec_data_deltas_topic, message.data(), message.size(), 0);
+
+    // When both are published, the JSON message is sent with the same msg_ID
+    if (!global_status.publish_json)
+    {
+        global_status.data_msg_ID += 1;
+    }
+
+    return true;
+}
+
 bool actions::generic::read_socket(status &global_status)
 {
     void *abcd_data_socket = global_status.abcd_data_socket;
@@ -478,7 +969,7 @@ bool actions::generic::read_socket(status &global_status)
 
         if (topic_string.find(defaults_abcd_data_events_topic) == 0)
         {
-            const clock_t event_start = clock();
+            const auto event_start = std::chrono::steady_clock::now();
 
             const size_t data_size = size;
 
@@ -497,81 +988,51 @@ bool actions::generic::read_socket(status &global_status)
 
             struct event_PSD *events = reinterpret_cast<struct event_PSD*>(input_buffer);
 
+            // The channels are added by this thread, as it also modifies the
+            // configuration, before dispatching the events to the workers
+            std::array<bool, 256> found_channels;
+            found_channels.fill(false);
+
             for (size_t i = 0; i < events_number; i++)
             {
-                //std::cout << "i: " << i << "; Events number: " << events_number << "; " << std::endl;
-                const event_PSD this_event = events[i];
-
-                const unsigned int channel = this_event.channel;
-                // We can directly convert these to double because we only do
-                // calculations using doubles anyways.
-                const double qshort = this_event.qshort;
-                const double qlong = this_event.qlong;
-                const double baseline = this_event.baseline;
-                double energy = 0;
-                double psd = 0;
-
-                if (global_status.spectra_type == QLONG_SPECTRA) {
-                    energy = qlong;
-                } else if (global_status.spectra_type == QSHORT_SPECTRA) {
-                    energy = qshort;
-                } else if (global_status.spectra_type == BASELINE_SPECTRA) {
-                    energy = baseline;
-                } else {
-                    energy = qlong;
-                }
-
-                double PSD_normalization = energy;
-
-                if (global_status.PSD_normalize) {
-                    PSD_normalization = energy;
+                found_channels[events[i].channel] = true;
+            }
 
-                    // Correct the PSD_normalization value to something that should not cause an error
-                    if (PSD_normalization == 0) {
-                        PSD_normalization = std::numeric_limits<double>::min();
-                    }
-                } else {
-                    PSD_normalization = 1.0;
+            for (unsigned int channel = 0; channel < found_channels.size(); channel++)
+            {
+                if (found_channels[channel])
+                {
+                    add_channel(global_status, channel);
                 }
+            }
 
-                if (global_status.PSD_type == QTAIL_VS_ENERGY_PSD) {
-                    psd = (qlong - qshort) / PSD_normalization;
-                } else if (global_status.PSD_type == QSHORT_VS_ENERGY_PSD) {
-                    psd = qshort / PSD_normalization;
-                } else if (global_status.PSD_type == QLONG_VS_ENERGY_PSD) {
-                    psd = qlong / PSD_normalization;
-                } else if (global_status.PSD_type == BASELINE_VS_ENERGY_PSD) {
-                    psd = baseline / PSD_normalization;
-                } else {
-                    psd = (qlong - qshort) / energy;
-                }
+            // Small buffers are not worth the synchronization overhead
+            const size_t workers_number = std::max<size_t>(1, std::min<size_t>(global_status.workers->size(),
+                                                                               events_number / defaults_spec_worker_min_events));
+            const size_t slice_size = (events_number + workers_number - 1) / workers_number;
 
-                add_channel(global_status, channel);
+            std::vector<std::function<void()>> jobs;
 
-                if (global_status.verbosity > 1)
-                {
-                    char time_buffer[BUFFER_SIZE];
-                    time_string(time_buffer, BUFFER_SIZE, NULL);
-                    std::cout << '[' << time_buffer << "] ";
-                    std::cout << "Event: " << i << "; ";
-                    std::cout << "Channel: " << channel << "; ";
-                    std::cout << "qshort: " << qshort << "; ";
-                    std::cout << "qlong: " << qlong << "; ";
-                    std::cout << "PSD: " << psd << "; ";
-                    std::cout << std::endl;
-                }
+            for (size_t w = 0; w < workers_number; w++)
+            {
+                const size_t first = std::min(events_number, w * slice_size);
+                const size_t last = std::min(events_number, first + slice_size);
+
+                partial_spectra &partial = global_status.partials[w];
 
-                histogram_fill(global_status.histos_E[channel], energy);
-                histogram2D_fill(global_status.histos_PSD[channel], energy, psd);
-                global_status.counts_partial[channel] += 1;
-                global_status.counts_total[channel] += 1;
+                jobs.push_back([&global_status, &partial, events, first, last]{
+                    fill_partial_spectra(global_status, partial, events + first, last - first);
+                });
             }
 
-            const clock_t event_stop = clock();
+            // The main thread takes care of the first slice
+            global_status.workers->run(jobs);
+
+            const auto event_stop = std::chrono::steady_clock::now();
 
             if (global_status.verbosity > 0)
             {
-                const float elaboration_time = (float)(event_stop - event_start) / CLOCKS_PER_SEC * 1000;
+                const float elaboration_time = std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(event_stop - event_start).count();
                 const float elaboration_speed = data_size / elaboration_time * 1000.0 / 1024.0 / 1024.0;
                 const float elaboration_rate = events_number / elaboration_time * 1000.0;
 
@@ -826,6 +1287,8 @@ state actions::read_config(status &global_status)
         json_object_set_new_nocheck(new_config, "time_decay", json_time_decay);
 
         json_object_set_new_nocheck(new_config, "disable_bidimensional_plot", json_false());
+        json_object_set_new_nocheck(new_config, "sparse_bidimensional_plot", json_false());
+        json_object_set_new_nocheck(new_config, "sparse_bidimensional_plot_note", json_string("Allocates the PSD histograms in tiles only where they are filled, reducing the memory usage of large histograms"));
 
         json_object_set_new_nocheck(new_config, "spectra_type", json_string("qlong"));
         json_object_set_new_nocheck(new_config, "spectra_type_note", json_string("Defines which entry of the event_PSD is to be interpreted as the energy information"));
@@ -843,6 +1306,15 @@ state actions::read_config(status &global_status)
         json_object_set_new_nocheck(new_config, "PSD_normalize", json_true());
         json_object_set_new_nocheck(new_config, "PSD_normalize_note", json_string("Enables the normalization of the PSD parameter by the energy (default behavior)"));
 
+        json_object_set_new_nocheck(new_config, "publication_format", json_string("json"));
+        json_object_set_new_nocheck(new_config, "publication_format_note", json_string("Defines how the histograms are published, the binary format publishes only the bins that changed since the last publication"));
+        json_object_set_new_nocheck(new_config, "publication_format_possible_value0", json_string("json"));
+        json_object_set_new_nocheck(new_config, "publication_format_possible_value1", json_string("binary"));
+        json_object_set_new_nocheck(new_config, "publication_format_possible_value2", json_string("both"));
+
+        json_object_set_new_nocheck(new_config, "keyframe_period", json_integer(defaults_spec_keyframe_period));
+        json_object_set_new_nocheck(new_config, "keyframe_period_note", json_string("Number of binary publications between two publications of the full histograms"));
+
         global_status.config = new_config;
     }
 
@@ -869,6 +1341,20 @@ state actions::apply_config(status &global_status)
 
     global_status.disable_bidimensional_plot = disable_bidimensional_plot;
 
+    const bool sparse_bidimensional_plot = json_is_true(json_object_get(config, "sparse_bidimensional_plot"));
+
+    if (global_status.verbosity > 0) {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "Sparse bidimensional plot: " << (sparse_bidimensional_plot ? "true" : "false") << "; ";
+        std::cout << std::endl;
+    }
+
+    json_object_set_nocheck(config, "sparse_bidimensional_plot", (sparse_bidimensional_plot ? json_true() : json_false()));
+
+    global_status.sparse_bidimensional_plot = sparse_bidimensional_plot;
+
     json_t *json_time_decay = json_object_get(config, "time_decay");
 
     bool time_decay_enabled = defaults_spec_time_decay_enabled;
@@ -1003,6 +1489,50 @@ state actions::apply_config(status &global_status)
         global_status.PSD_normalize = json_is_true(json_PSD_normalize);
     }
 
+    const char *cstr_publication_format = json_string_value(json_object_get(config, "publication_format"));
+    const std::string publication_format = cstr_publication_format ? std::string(cstr_publication_format) : std::string("json");
+
+    if (global_status.verbosity > 0)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "Found publication format: '" << publication_format << "'; ";
+        std::cout << std::endl;
+    }
+
+    if (publication_format == std::string("json")) {
+        global_status.publish_json = true;
+        global_status.publish_binary = false;
+    } else if (publication_format == std::string("binary")) {
+        global_status.publish_json = false;
+        global_status.publish_binary = true;
+    } else if (publication_format == std::string("both")) {
+        global_status.publish_json = true;
+        global_status.publish_binary = true;
+    } else {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "ERROR: Invalid publication format, found: '" << publication_format << "'; ";
+        std::cout << std::endl;
+
+        global_status.publish_json = true;
+        global_status.publish_binary = false;
+
+        json_object_set_new_nocheck(config, "publication_format", json_string("json"));
+    }
+
+    json_t *json_keyframe_period = json_object_get(config, "keyframe_period");
+
+    if (json_keyframe_period != NULL && json_is_integer(json_keyframe_period) && json_integer_value(json_keyframe_period) >= 0) {
+        global_status.deltas_publisher.keyframe_period = json_integer_value(json_keyframe_period);
+    } else {
+        global_status.deltas_publisher.keyframe_period = defaults_spec_keyframe_period;
+    }
+
+    json_object_set_new_nocheck(config, "keyframe_period", json_integer(global_status.deltas_publisher.keyframe_period));
+
     json_t *json_channels = json_object_get(config, "channels");
 
     if (json_channels != NULL && json_is_array(json_channels))
@@ -1200,34 +1730,7 @@ state actions::receive_commands(status &global_status)
 
                     if (channel_string == std::string("all"))
                     {
-                        for (auto &pair: global_status.histos_E)
-                        {
-                            histogram_t *const histo_E = pair.second;
-
-                            if (histo_E)
-                            {
-                                histogram_reset(histo_E);
-                            }
-                        }
-
-                        for (auto &pair: global_status.histos_PSD)
-                        {
-                            histogram2D_t *const histo_PSD = pair.second;
-
-                            if (histo_PSD != NULL)
-                            {
-                                histogram2D_reset(histo_PSD);
-                            }
-                        }
-
-                        for (auto &pair: global_status.counts_partial)
-                        {
-                            pair.second = 0;
-                        }
-                        for (auto &pair: global_status.counts_total)
-                        {
-                            pair.second = 0;
-                        }
+                        actions::generic::reset_all_channels(global_status);
 
                         json_t *json_event_message = json_object();
                         json_object_set_new_nocheck(json_event_message, "type", json_string("event"));
@@ -1252,22 +1755,7 @@ state actions::receive_commands(status &global_status)
                         std::cout << std::endl;
                     }
 
-                    histogram_t *const histo_E = global_status.histos_E[channel];
-
-                    if (histo_E)
-                    {
-                        histogram_reset(histo_E);
-                    }
-
-                    histogram2D_t *const histo_PSD = global_status.histos_PSD[channel];
-
-                    if (histo_PSD != NULL)
-                    {
-                        histogram2D_reset(histo_PSD);
-                    }
-
-                    global_status.counts_partial[channel] = 0;
-                    global_status.counts_total[channel] = 0;
+                    actions::generic::reset_channel(global_status, channel);
 
                     std::string event_message = "Reset of channel: " + std::to_string(channel);
 
@@ -0,0 +1,132 @@
+// Measures the coincidences search of tofcalc on a replay of an events file.
+// The events are split in messages of a few sizes, and each message is sorted
+// and processed as read_socket does. The channels are those of the
+// DT5730_LaBr_CeBr configuration, to be used with:
+//   data/example_data_DT5730_Ch1_LaBr3_Ch6_CeBr3_Ch7_CeBr3_coincidence_events.ade
+//
+// Usage: bench_tofcalc_window <events_file> [repetitions]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "typedefs.hpp"
+#include "actions.hpp"
+
+extern "C" {
+#include "radix_sort.h"
+}
+
+static const double min_ToF = -80;
+static const double max_ToF = -30;
+
+static void setup_status(status &global_status)
+{
+    global_status.ns_per_sample = 0.001953125;
+    global_status.reference_channels.insert(1);
+    global_status.reference_mask.set(1);
+
+    for (const unsigned int channel: {6, 7})
+    {
+        struct channel_histograms &histos = global_status.channels_histos[channel];
+
+        histos.ToF = histogram_create(200, min_ToF, max_ToF, 0);
+        histos.E = histogram_create(512, 0, 40960, 0);
+        histos.EvsToF = histogram2D_create(200, min_ToF, max_ToF, 512, 0, 40960, 0);
+        histos.EvsE = histogram2D_create(512, 0, 40960, 512, 0, 40960, 0);
+    }
+
+    global_status.channels_counts.fill(0);
+}
+
+static void destroy_status(status &global_status)
+{
+    for (const unsigned int channel: {6, 7})
+    {
+        struct channel_histograms &histos = global_status.channels_histos[channel];
+
+        histogram_destroy(histos.ToF);
+        histogram_destroy(histos.E);
+        histogram2D_destroy(histos.EvsToF);
+        histogram2D_destroy(histos.EvsE);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <events_file> [repetitions]\n", argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    const unsigned int repetitions = (argc > 2) ? atoi(argv[2]) : 10;
+
+    std::ifstream file(argv[1], std::ios::binary);
+
+    if (!file)
+    {
+        fprintf(stderr, "ERROR: Unable to open file: %s\n", argv[1]);
+
+        return EXIT_FAILURE;
+    }
+
+    const std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    const size_t events_number = content.size() / sizeof(struct event_PSD);
+
+    std::vector<struct event_PSD> events(events_number);
+    memcpy(events.data(), content.data(), events_number * sizeof(struct event_PSD));
+
+    printf("Events: %zu; repetitions: %u\n", events_number, repetitions);
+
+    for (const size_t message_size: {100, 1000, 100000})
+    {
+        double total_duration = 0;
+        size_t found_coincidences = 0;
+
+        for (unsigned int repetition = 0; repetition < repetitions; repetition++)
+        {
+            status global_status;
+            setup_status(global_status);
+
+            std::vector<struct event_PSD> message;
+
+            found_coincidences = 0;
+
+            const auto start = std::chrono::steady_clock::now();
+
+            for (size_t first = 0; first < events_number; first += message_size)
+            {
+                const size_t last = std::min(first + message_size, events_number);
+
+                message.assign(events.begin() + first, events.begin() + last);
+
+                global_status.sorting_buffer.resize(message.size());
+                radix_sort_events_PSD(message.data(), message.size(), global_status.sorting_buffer.data());
+
+                found_coincidences += actions::generic::process_events(global_status,
+                                                                       message.data(),
+                                                                       message.size(),
+                                                                       min_ToF, max_ToF);
+            }
+
+            const auto stop = std::chrono::steady_clock::now();
+
+            total_duration += std::chrono::duration<double, std::milli>(stop - start).count();
+
+            destroy_status(global_status);
+        }
+
+        printf("Events per message: %zu; coincidences: %zu; average time: %.2f ms\n",
+               message_size, found_coincidences, total_duration / repetitions);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+
+#  (C) Copyright 2026 European Union, Cristiano Lino Fontana
+#
+#  This file is part of ABCD.
+#
+#  ABCD is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  ABCD is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with ABCD.  If not, see <http://www.gnu.org/licenses/>.
+
+# Generates the capture files used by test_caen_decoder, in the format
+# written by abcd with its -R option, together with the events that the
+# CAEN libraries return for them (CAEN_DGTZ_GetDPPEvents() and
+# CAEN_DGTZ_DecodeDPPWaveforms() for the DPP-PSD firmware,
+# CAEN_DGTZ_DecodeEvent() for the STD firmware).
+# The buffers are encoded following the CAEN documentation of the x730
+# family, independently from the C++ decoder.
+
+import os
+import struct
+
+CAPTURE_MAGIC = b"ABCDCAEN"
+CAPTURE_VERSION = 0
+
+FLAG_TT64 = 0x1
+FLAG_WAVEFORMS = 0x2
+FLAG_GATES = 0x4
+
+def capture_header(dpp_version, flags, model, channels_number, offset_step):
+    return CAPTURE_MAGIC + struct.pack("<IHHIIQ", CAPTURE_VERSION, dpp_version, flags, model, channels_number, offset_step)
+
+def words_to_bytes(words):
+    return struct.pack("<{}I".format(len(words)), *words)
+
+def readout_buffer(words):
+    data = words_to_bytes(words)
+    return struct.pack("<I", len(data)) + data
+
+#------------------------------------------------------------------------------#
+#  DPP-PSD                                                                     #
+#------------------------------------------------------------------------------#
+
+def PSD_format(samples_number, extras_option, samples_enabled, dual_trace):
+    return ((samples_number // 8) & 0xFFFF) \
+           | (extras_option << 24) \
+           | (samples_enabled << 27) \
+           | (1 << 28) \
+           | (1 << 29) \
+           | (1 << 30) \
+           | (dual_trace << 31)
+
+def PSD_channel_aggregate(couple, format_word, events, expected):
+    samples_number = (format_word & 0xFFFF) * 8
+    samples_enabled = (format_word >> 27) & 1
+    dual_trace = (format_word >> 31) & 1
+    extras_option = (format_word >> 24) & 0x7
+
+    words = [0, format_word]
+
+    for event in events:
+        odd, time_tag, extras, qshort, qlong, pur, samples = event
+
+        words.append((odd << 31) | (time_tag & 0x7FFFFFFF))
+
+        if samples_enabled:
+            for i in range(0, samples_number, 2):
+                words.append(samples[i] | (samples[i + 1] << 16))
+
+        words.append(extras)
+        words.append((qshort & 0x7FFF) | (pur << 15) | ((qlong & 0xFFFF) << 16))
+
+        baseline = (extras & 0xFFFF) // 4 if extras_option == 0 else 0
+
+        Ns = samples_number if samples_enabled else 0
+        trace1 = []
+        dtrace1 = []
+        dtrace2 = []
+
+        for i in range(0, Ns, 2):
+            if dual_trace:
+                trace1 += [samples[i] & 0x3FFF] * 2
+            else:
+                trace1 += [samples[i] & 0x3FFF, samples[i + 1] & 0x3FFF]
+
+            dtrace1 += [(samples[i] >> 14) & 1, (samples[i + 1] >> 14) & 1]
+            dtrace2 += [(samples[i] >> 15) & 1, (samples[i + 1] >> 15) & 1]
+
+        expected.append((couple * 2 + odd, time_tag & 0x7FFFFFFF, qshort & 0x7FFF, qlong & 0xFFFF,
+                         baseline, pur, extras, Ns, trace1, dtrace1, dtrace2))
+
+    words[0] = (1 << 31) | len(words)
+
+    return words
+
+def PSD_board_aggregate(counter, channel_aggregates):
+    couples_mask = 0
+    words = []
+
+    for couple, aggregate in sorted(channel_aggregates.items()):
+        couples_mask |= 1 << couple
+        words += aggregate
+
+    return [(0xA << 28) | (len(words) + 4), couples_mask, counter, 1000 * counter] + words
+
+def pulse(samples_number, height, gates):
+    samples = []
+
+    for i in range(samples_number):
+        value = 8000 - (height * i * (samples_number - i)) // (samples_number * samples_number // 4)
+        # The digital probes are in the two most significant bits
+        gate1 = 1 if gates[0] <= i < gates[1] else 0
+        gate2 = 1 if i % 5 == 0 else 0
+        samples.append((value & 0x3FFF) | (gate1 << 14) | (gate2 << 15))
+
+    return samples
+
+def make_PSD(directory):
+    buffers = []
+    expected = []
+
+    # First buffer: single trace on the couple 0, dual trace on the couple 3
+    aggregates = dict()
+
+    aggregates[0] = PSD_channel_aggregate(0, PSD_format(16, 0b010, 1, 0), [
+        (0, 100, (0x0001 << 16) | (1 << 13) | 0x155, 1000, 4000, 0, pulse(16, 3000, (4, 10))),
+        (1, 120, (0x0001 << 16) | 0x023, 900, 3500, 1, pulse(16, 2500, (2, 12))),
+        (0, 0x7FFFFFF0, (0x0001 << 16) | 0x3FF, 32767, 65535, 0, pulse(16, 100, (0, 16))),
+    ], expected)
+    aggregates[3] = PSD_channel_aggregate(3, PSD_format(24, 0b010, 1, 1), [
+        (1, 5000, (0x0002 << 16) | 0x001, 10, 20, 0, pulse(24, 1000, (8, 16))),
+    ], expected)
+
+    buffers.append(PSD_board_aggregate(0, aggregates))
+
+    # Second buffer: the samples are disabled (ES = 0), the samples number
+    # in the format must be ignored, and the extras carry the baseline
+    aggregates = dict()
+
+    aggregates[1] = PSD_channel_aggregate(1, PSD_format(32, 0b000, 0, 0), [
+        (0, 300, 4 * 2000, 11, 22, 0, None),
+        (1, 310, 4 * 2100 + 3, 33, 44, 1, None),
+        (0, 20, 4 * 1900, 55, 66, 0, None),
+    ], expected)
+
+    buffers.append(PSD_board_aggregate(1, aggregates))
+
+    # Third buffer: two board aggregates, the time tag of the channel 0
+    # rolls over with the extended time stamp
+    aggregates = dict()
+
+    aggregates[0] = PSD_channel_aggregate(0, PSD_format(8, 0b010, 1, 0), [
+        (0, 50, (0x0002 << 16) | 0x200, 1, 2, 0, pulse(8, 500, (1, 3))),
+    ], expected)
+
+    words = PSD_board_aggregate(2, aggregates)
+
+    aggregates = dict()
+
+    aggregates[7] = PSD_channel_aggregate(7, PSD_format(8, 0b010, 1, 1), [
+        (1, 70, (0x0003 << 16) | 0x100, 3, 4, 1, pulse(8, 700, (0, 8))),
+        (1, 60, (0x0003 << 16) | 0x101, 5, 6, 0, pulse(8, 800, (2, 4))),
+    ], expected)
+
+    words += PSD_board_aggregate(3, aggregates)
+
+    buffers.append(words)
+
+    with open(os.path.join(directory, "caen_psd_x730.cap"), "wb") as output_file:
+        output_file.write(capture_header(3, FLAG_TT64 | FLAG_WAVEFORMS | FLAG_GATES, 730, 16, 0x40000000))
+
+        for words in buffers:
+            output_file.write(readout_buffer(words))
+
+    # The events are sorted by channel as returned by CAEN_DGTZ_GetDPPEvents(),
+    # but buffer by buffer. Each buffer is listed separately.
+    with open(os.path.join(directory, "caen_psd_x730.txt"), "w") as output_file:
+        output_file.write("# Events as returned by the CAEN libraries for caen_psd_x730.cap\n")
+        output_file.write("# buffer <index>\n")
+        output_file.write("# event <channel> <TimeTag> <ChargeShort> <ChargeLong> <Baseline> <Pur> <Extras> <Ns>\n")
+        output_file.write("# followed by the lines: Trace1, DTrace1 and DTrace2\n")
+
+        boundaries = [0, 4, 7, 10]
+
+        for index in range(len(buffers)):
+            output_file.write("buffer {}\n".format(index))
+
+            events = expected[boundaries[index]:boundaries[index + 1]]
+
+            for event in sorted(events, key = lambda e: e[0]):
+                output_file.write("event {} {} {} {} {} {} {} {}\n".format(*event[:8]))
+                for trace in event[8:]:
+                    output_file.write(" ".join(str(value) for value in trace) + "\n")
+
+#------------------------------------------------------------------------------#
+#  STD                                                                         #
+#------------------------------------------------------------------------------#
+
+def make_STD(directory):
+    buffers = []
+    expected = []
+
+    def STD_event(counter, trigger_time_tag, channels, samples_number):
+        channels_mask = 0
+        data = []
+
+        for ch in channels:
+            channels_mask |= 1 << ch
+
+        event_samples = dict()
+
+        for ch in sorted(channels):
+            samples = [(counter * 97 + ch * 31 + i * 7) & 0x3FFF for i in range(samples_number)]
+            event_samples[ch] = samples
+
+            for i in range(0, samples_number, 2):
+                # The unused bits are set, they must be masked
+                data.append(samples[i] | 0xC000 | ((samples[i + 1] | 0xC000) << 16))
+
+        expected.append((trigger_time_tag, event_samples))
+
+        return [(0xA << 28) | (len(data) + 4),
+                (channels_mask & 0xFF),
+                ((channels_mask >> 8) & 0xFF) << 24 | counter,
+                trigger_time_tag] + data
+
+    buffers.append(STD_event(0, 1000, [0, 3, 9], 12) + STD_event(1, 2000, [0, 15], 12))
+    # The trigger time tag rolls over
+    buffers.append(STD_event(2, 0x3FFFFF00, [0], 6) + STD_event(3, 0x00000010, [0, 9], 6))
+
+    with open(os.path.join(directory, "caen_std_x730.cap"), "wb") as output_file:
+        output_file.write(capture_header(0, FLAG_WAVEFORMS, 730, 16, 0x40000000))
+
+        for words in buffers:
+            output_file.write(readout_buffer(words))
+
+    with open(os.path.join(directory, "caen_std_x730.txt"), "w") as output_file:
+        output_file.write("# Events as returned by the CAEN libraries for caen_std_x730.cap\n")
+        output_file.write("# buffer <index>\n")
+        output_file.write("# event <TriggerTimeTag>\n")
+        output_file.write("# channel <channel> <samples...>\n")
+
+        boundaries = [0, 2, 4]
+
+        for index in range(len(buffers)):
+            output_file.write("buffer {}\n".format(index))
+
+            for trigger_time_tag, event_samples in expected[boundaries[index]:boundaries[index + 1]]:
+                output_file.write("event {}\n".format(trigger_time_tag))
+
+                for ch, samples in sorted(event_samples.items()):
+                    output_file.write("channel {} ".format(ch) + " ".join(str(value) for value in samples) + "\n")
+
+if __name__ == "__main__":
+    directory = os.path.dirname(os.path.abspath(__file__))
+
+    make_PSD(directory)
+    make_STD(directory)
@@ -0,0 +1,592 @@
+// Checks the searches of the time ranges of binary_fifo against a linear scan
+// of the stored data, as the FIFO did before using the binary search: the
+// range starts from the first datum not older than begin and it stops at the
+// first datum not older than end. If begin is not before end the range starts
+// from the oldest datum.
+// The checks cover the empty FIFO, a single datum, ranges whose edges are
+// exactly on the timestamps of the data, with many equal timestamps, and the
+// wrapped ranges where begin is after end.
+// With a memory budget the data is stored in the ring arena, whose content
+// shall wrap around its end, respect the budget by evicting the oldest data,
+// and never move the data that was not evicted.
+// With a disk tier, the data dropped from the memory is spilled to the segment
+// files and it shall be read back together with the data in memory.
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "binary_fifo.hpp"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+using binary_fifo::time_point;
+using binary_fifo::nanoseconds;
+using binary_fifo::binary_data;
+using binary_fifo::binary_view;
+
+// Copy of the data pushed to the FIFO, in the order of the timestamps and of
+// the insertion for equal timestamps
+typedef std::vector<std::pair<time_point, binary_data>> reference_data;
+
+static reference_data linear_range(const reference_data &reference, time_point begin, time_point end)
+{
+    reference_data result;
+
+    size_t start = 0;
+
+    if (begin < end)
+    {
+        while (start < reference.size() && reference[start].first < begin)
+        {
+            start += 1;
+        }
+    }
+
+    for (size_t i = start; i < reference.size(); i++)
+    {
+        if (!(end > reference[i].first))
+        {
+            break;
+        }
+
+        result.push_back(reference[i]);
+    }
+
+    return result;
+}
+
+static void check_range(binary_fifo::binary_fifo &fifo, const reference_data &reference, time_point begin, time_point end)
+{
+    const reference_data expected = linear_range(reference, begin, end);
+
+    const std::vector<binary_view> data = fifo.get_data(begin, end);
+    const std::vector<binary_fifo::long_int> timestamps = fifo.get_timestamps(begin, end);
+
+    CHECK(data.size() == expected.size());
+    CHECK(timestamps.size() == expected.size());
+
+    if (data.size() != expected.size() || timestamps.size() != expected.size())
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        CHECK(data[i].copy() == expected[i].second);
+        CHECK(timestamps[i] == (expected[i].first - fifo.epoch).count());
+    }
+
+    std::function<size_t(size_t, const binary_view&)> sum_sizes = [](size_t sum, const binary_view &view) {
+        return sum + view.size();
+    };
+
+    size_t expected_sum = 0;
+    size_t expected_big = 0;
+
+    for (const auto &this_datum: expected)
+    {
+        expected_sum += this_datum.second.size();
+        expected_big += (this_datum.second.size() > 8) ? 1 : 0;
+    }
+
+    CHECK(fifo.reduce(sum_sizes, begin, end) == expected_sum);
+
+    std::function<bool(const binary_view&)> is_big = [](const binary_view &view) {
+        return view.size() > 8;
+    };
+
+    CHECK(fifo.filter(is_big, begin, end).size() == expected_big);
+}
+
+static binary_data random_data(std::mt19937_64 &generator)
+{
+    binary_data data(generator() % 20);
+
+    for (auto &byte: data)
+    {
+        byte = generator() & 0xFF;
+    }
+
+    return data;
+}
+
+static void test_empty()
+{
+    binary_fifo::binary_fifo fifo;
+    const reference_data reference;
+
+    const time_point t = fifo.epoch + nanoseconds(1000);
+
+    CHECK(fifo.count() == 0);
+    CHECK(fifo.size() == 0);
+
+    check_range(fifo, reference, t, t + nanoseconds(10));
+    check_range(fifo, reference, t, t);
+    check_range(fifo, reference, t + nanoseconds(10), t);
+    check_range(fifo, reference, time_point(), time_point());
+
+    fifo.update();
+
+    CHECK(fifo.count() == 0);
+}
+
+static void test_single()
+{
+    binary_fifo::binary_fifo fifo;
+    reference_data reference;
+
+    const time_point t = fifo.epoch + nanoseconds(1000);
+
+    fifo.push(binary_data{1, 2, 3}, t);
+    reference.emplace_back(t, binary_data{1, 2, 3});
+
+    CHECK(fifo.count() == 1);
+    CHECK(fifo.size() == 3);
+
+    const nanoseconds one(1);
+
+    // Ranges before, across and after the datum, with the edges on it
+    check_range(fifo, reference, t - one * 10, t - one);
+    check_range(fifo, reference, t - one, t);
+    check_range(fifo, reference, t - one, t + one);
+    check_range(fifo, reference, t, t + one);
+    check_range(fifo, reference, t, t);
+    check_range(fifo, reference, t + one, t + one * 10);
+
+    // Wrapped ranges
+    check_range(fifo, reference, t + one, t);
+    check_range(fifo, reference, t + one, t + one);
+    check_range(fifo, reference, t + one * 10, t - one);
+}
+
+static void test_random(unsigned int seed, bool out_of_order)
+{
+    std::mt19937_64 generator(seed);
+
+    binary_fifo::binary_fifo fifo;
+    reference_data reference;
+
+    const size_t data_number = 1 + generator() % 300;
+
+    // Few distinct timestamps, so that many data share a timestamp
+    const size_t timestamps_number = 1 + generator() % 50;
+
+    for (size_t i = 0; i < data_number; i++)
+    {
+        const binary_fifo::long_int step = out_of_order ? (generator() % timestamps_number) : (i * timestamps_number / data_number);
+        const time_point timestamp = fifo.epoch + nanoseconds(1000 + step * 100);
+
+        binary_data data = random_data(generator);
+
+        reference.emplace_back(timestamp, data);
+        fifo.push(std::move(data), timestamp);
+    }
+
+    std::stable_sort(reference.begin(), reference.end(),
+                     [](const std::pair<time_point, binary_data> &a, const std::pair<time_point, binary_data> &b) {
+                         return a.first < b.first;
+                     });
+
+    CHECK(fifo.count() == reference.size());
+
+    const nanoseconds one(1);
+
+    // Edges on the timestamps, right before and right after them
+    for (unsigned int i = 0; i < 200; i++)
+    {
+        const time_point a = reference[generator() % reference.size()].first + one * (static_cast<binary_fifo::long_int>(generator() % 3) - 1);
+        const time_point b = reference[generator() % reference.size()].first + one * (static_cast<binary_fifo::long_int>(generator() % 3) - 1);
+
+        check_range(fifo, reference, a, b);
+        check_range(fifo, reference, b, a);
+        check_range(fifo, reference, a, a);
+    }
+
+    // Ranges all before and all after the data
+    check_range(fifo, reference, fifo.epoch, reference.front().first - one);
+    check_range(fifo, reference, reference.back().first + one, reference.back().first + one * 1000);
+    check_range(fifo, reference, fifo.epoch, reference.back().first + one);
+}
+
+// The data in the arena shall be the newest pushed data that fits in the
+// arena, aligned and not overlapping
+static void check_arena(binary_fifo::binary_fifo &fifo, const std::vector<binary_data> &pushed, time_point last)
+{
+    CHECK(fifo.size() <= fifo.get_memory_budget());
+
+    const std::vector<binary_view> views = fifo.get_data(fifo.epoch, last + nanoseconds(1));
+
+    CHECK(views.size() == fifo.count());
+
+    size_t j = pushed.size();
+
+    for (size_t k = views.size(); k-- > 0;)
+    {
+        // The rejected data is not in the arena
+        do
+        {
+            j -= 1;
+        } while (j > 0 && pushed[j].size() > fifo.get_memory_budget());
+
+        CHECK(views[k].copy() == pushed[j]);
+        CHECK(reinterpret_cast<uintptr_t>(views[k].data()) % binary_fifo::binary_fifo::arena_alignment == 0);
+        CHECK(views[k].data() >= fifo.arena.data());
+        CHECK(views[k].data() + views[k].size() <= fifo.arena.data() + fifo.arena.size());
+    }
+
+    std::vector<std::pair<const uint8_t*, size_t>> regions;
+
+    for (const auto &view: views)
+    {
+        regions.emplace_back(view.data(), view.size());
+    }
+
+    std::sort(regions.begin(), regions.end());
+
+    for (size_t k = 1; k < regions.size(); k++)
+    {
+        CHECK(regions[k - 1].first + regions[k - 1].second <= regions[k].first);
+    }
+}
+
+static void test_arena_wrap_around()
+{
+    binary_fifo::binary_fifo fifo;
+
+    // Three data of 24 aligned bytes do not fit, the third one goes at the
+    // beginning of the arena after evicting the first one
+    fifo.set_memory_budget(64);
+
+    CHECK(fifo.uses_arena());
+    CHECK(fifo.get_memory_budget() == 64);
+
+    std::vector<binary_data> pushed;
+    bool wrapped = false;
+    const uint8_t *previous = nullptr;
+
+    for (unsigned int i = 0; i < 50; i++)
+    {
+        const time_point timestamp = fifo.epoch + nanoseconds(1000 + i);
+
+        pushed.push_back(binary_data(20, static_cast<uint8_t>(i)));
+        fifo.push(binary_data(pushed.back()), timestamp);
+
+        check_arena(fifo, pushed, timestamp);
+
+        const uint8_t *newest = fifo.view(fifo.buffer.back()).data();
+
+        wrapped = wrapped || (previous && newest < previous);
+        previous = newest;
+
+        CHECK(fifo.count() == std::min<size_t>(i + 1, 2));
+    }
+
+    CHECK(wrapped);
+    CHECK(fifo.get_evicted_count() == 48);
+    CHECK(fifo.get_evicted_bytes() == 48 * 20);
+    CHECK(fifo.get_rejected_count() == 0);
+}
+
+static void test_arena_eviction(unsigned int seed)
+{
+    std::mt19937_64 generator(seed);
+
+    binary_fifo::binary_fifo fifo;
+
+    fifo.set_memory_budget(64 + generator() % 5000);
+
+    // The budget is rounded down to the alignment
+    CHECK(fifo.get_memory_budget() % binary_fifo::binary_fifo::arena_alignment == 0);
+
+    const size_t budget = fifo.get_memory_budget();
+
+    std::vector<binary_data> pushed;
+    size_t rejected_number = 0;
+    size_t accepted_bytes = 0;
+
+    for (unsigned int i = 0; i < 500; i++)
+    {
+        const time_point timestamp = fifo.epoch + nanoseconds(1000 + i);
+
+        // Empty data, small data and data bigger than the whole arena
+        const size_t size = (generator() % 4 == 0) ? 0 : generator() % (budget / (1 + generator() % 8) + 3);
+
+        binary_data data(size);
+
+        for (auto &byte: data)
+        {
+            byte = generator() & 0xFF;
+        }
+
+        if (size > budget)
+        {
+            rejected_number += 1;
+        }
+        else
+        {
+            accepted_bytes += size;
+        }
+
+        pushed.push_back(data);
+
+        // The data is also written directly in the arena
+        if (i % 2 == 0)
+        {
+            fifo.push(std::move(data), timestamp);
+        }
+        else
+        {
+            uint8_t *destination = fifo.arena_push(data.size(), timestamp);
+
+            CHECK((destination != nullptr) == (size <= budget));
+
+            if (destination)
+            {
+                std::copy(data.begin(), data.end(), destination);
+            }
+        }
+
+        check_arena(fifo, pushed, timestamp);
+    }
+
+    CHECK(fifo.get_rejected_count() == rejected_number);
+    CHECK(fifo.size() + fifo.get_evicted_bytes() == accepted_bytes);
+
+    // The expired data is released as well
+    fifo.set_expiration_time(1);
+    fifo.update();
+
+    CHECK(fifo.count() == 0);
+    CHECK(fifo.size() == 0);
+}
+
+static void test_arena_views_after_eviction()
+{
+    binary_fifo::binary_fifo fifo;
+
+    fifo.set_memory_budget(128);
+
+    time_point timestamp = fifo.epoch + nanoseconds(1000);
+
+    fifo.push(binary_data(32, 0xAA), timestamp);
+    timestamp += nanoseconds(1);
+    fifo.push(binary_data(16, 0xBB), timestamp);
+
+    std::vector<binary_view> views = fifo.get_data(fifo.epoch, timestamp + nanoseconds(1));
+
+    CHECK(views.size() == 2);
+
+    if (views.size() != 2)
+    {
+        return;
+    }
+
+    const binary_data first_copy = views[0].copy();
+    const binary_data second_copy = views[1].copy();
+
+    // Filling the arena, the last datum wraps around and it evicts only the
+    // first datum
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        timestamp += nanoseconds(1);
+        fifo.push(binary_data(24, static_cast<uint8_t>(i)), timestamp);
+    }
+
+    CHECK(fifo.get_evicted_count() == 1);
+
+    const std::vector<binary_view> remaining = fifo.get_data(fifo.epoch, timestamp + nanoseconds(1));
+
+    CHECK(!remaining.empty() && remaining.front().copy() == second_copy);
+
+    // The data that was not evicted is not moved, so its view still reads it
+    CHECK(remaining.front().data() == views[1].data());
+    CHECK(views[1].copy() == second_copy);
+
+    // The view of the evicted datum still points in the arena, that is never
+    // reallocated by the eviction, but its bytes belong to the newer data.
+    // The copy taken before is not affected.
+    CHECK(views[0].data() >= fifo.arena.data());
+    CHECK(views[0].data() + views[0].size() <= fifo.arena.data() + fifo.arena.size());
+    CHECK(first_copy == binary_data(32, 0xAA));
+
+    for (const auto &view: remaining)
+    {
+        CHECK(view.copy() != first_copy);
+    }
+}
+
+static size_t count_segment_files(const std::string &directory)
+{
+    size_t files_number = 0;
+
+    DIR *dir = opendir(directory.c_str());
+
+    if (!dir)
+    {
+        return 0;
+    }
+
+    while (const struct dirent *entry = readdir(dir))
+    {
+        if (std::string(entry->d_name).find("fifo_segment_") == 0)
+        {
+            files_number += 1;
+        }
+    }
+
+    closedir(dir);
+
+    return files_number;
+}
+
+static void test_disk_tier(const std::string &directory, unsigned int seed, bool with_arena)
+{
+    std::mt19937_64 generator(seed);
+
+    {
+        binary_fifo::binary_fifo fifo;
+
+        if (with_arena)
+        {
+            // The data evicted from the arena is spilled to the disk
+            fifo.set_memory_budget(512);
+        }
+
+        // A disk budget that is exceeded only by some seeds
+        const size_t disk_budget = 4000 + generator() % 40000;
+
+        fifo.set_disk_tier(directory, disk_budget, 1024 * 1024);
+
+        CHECK(fifo.get_disk_budget() == disk_budget);
+
+        reference_data pushed;
+
+        for (unsigned int i = 0; i < 400; i++)
+        {
+            const time_point timestamp = fifo.epoch + nanoseconds(1000 + i * 10);
+
+            binary_data data = random_data(generator);
+
+            pushed.emplace_back(timestamp, data);
+            fifo.push(std::move(data), timestamp);
+
+            // Without the arena, the data is spilled when it expires
+            if (!with_arena && i % 50 == 49)
+            {
+                fifo.set_expiration_time((binary_fifo::clock::now() - (timestamp - nanoseconds(200))).count());
+                fifo.update();
+            }
+
+            CHECK(fifo.disk_size() <= disk_budget);
+        }
+
+        CHECK(fifo.disk_count() > 0);
+        CHECK(count_segment_files(directory) > 0);
+        CHECK(fifo.get_disk_rejected_count() == 0);
+
+        // The stored data is the newest pushed data, first from the disk and
+        // then from the memory
+        const size_t stored_number = fifo.disk_count() + fifo.count();
+
+        CHECK(stored_number <= pushed.size());
+
+        if (stored_number > pushed.size())
+        {
+            return;
+        }
+
+        const reference_data reference(pushed.end() - stored_number, pushed.end());
+
+        CHECK(fifo.get_oldest_timestamp() == reference.front().first);
+
+        if (fifo.get_disk_evicted_segments() == 0)
+        {
+            CHECK(stored_number == pushed.size());
+        }
+
+        const time_point last = reference.back().first + nanoseconds(1);
+
+        check_range(fifo, reference, fifo.epoch, last);
+        check_range(fifo, reference, last, fifo.epoch);
+
+        // Ranges across the boundary between the tiers and within them
+        for (unsigned int i = 0; i < 100; i++)
+        {
+            const time_point a = reference[generator() % reference.size()].first + nanoseconds(static_cast<binary_fifo::long_int>(generator() % 3) - 1);
+            const time_point b = reference[generator() % reference.size()].first + nanoseconds(static_cast<binary_fifo::long_int>(generator() % 3) - 1);
+
+            check_range(fifo, reference, a, b);
+        }
+    }
+
+    // The segment files are deleted with the FIFO
+    CHECK(count_segment_files(directory) == 0);
+}
+
+int main()
+{
+    test_empty();
+    test_single();
+
+    for (unsigned int seed = 0; seed < 100; seed++)
+    {
+        test_random(seed, false);
+        test_random(seed, true);
+    }
+
+    test_arena_wrap_around();
+    test_arena_views_after_eviction();
+
+    for (unsigned int seed = 0; seed < 20; seed++)
+    {
+        test_arena_eviction(seed);
+    }
+
+    char directory_template[] = "/tmp/test_binary_fifo_XXXXXX";
+
+    if (mkdtemp(directory_template) == nullptr)
+    {
+        fprintf(stderr, "Unable to create the directory of the disk tier\n");
+
+        failures += 1;
+    }
+    else
+    {
+        const std::string directory(directory_template);
+
+        for (unsigned int seed = 0; seed < 10; seed++)
+        {
+            test_disk_tier(directory, seed, true);
+            test_disk_tier(directory, seed, false);
+        }
+
+        rmdir(directory.c_str());
+    }
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
@@ -0,0 +1,445 @@
+// Regression test of the offline CAEN decoder (abcd/decoder) against the
+// live path of abcd.
+// The capture files in the data directory are decoded with the offline
+// decoder, while the events that the CAEN libraries return for the same
+// buffers are read from the text files and converted with the same code of
+// the live path. The two outputs must be identical.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#include "events.hpp"
+#include "waveforms_buffer.hpp"
+#include "caen_decoder.hpp"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+// Same layout of the CAEN_DGTZ_DPP_PSD_Event_t
+struct live_PSD_event
+{
+    uint32_t Format;
+    uint32_t TimeTag;
+    int16_t ChargeShort;
+    int16_t ChargeLong;
+    int16_t Baseline;
+    int16_t Pur;
+    uint32_t *Waveforms;
+    uint32_t Extras;
+};
+
+// Same members of the CAEN_DGTZ_DPP_PSD_Waveforms_t, with their storage
+struct live_PSD_waveforms
+{
+    uint32_t Ns;
+    uint16_t *Trace1;
+    uint8_t *DTrace1;
+    uint8_t *DTrace2;
+    uint8_t *DTrace3;
+    uint8_t *DTrace4;
+
+    std::vector<uint16_t> trace1;
+    std::vector<uint8_t> dtrace1;
+    std::vector<uint8_t> dtrace2;
+    std::vector<uint8_t> zeros;
+
+    void set_pointers()
+    {
+        Ns = trace1.size();
+        zeros.assign(Ns, 0);
+
+        Trace1 = trace1.data();
+        DTrace1 = dtrace1.data();
+        DTrace2 = dtrace2.data();
+        DTrace3 = zeros.data();
+        DTrace4 = zeros.data();
+    }
+};
+
+// Same members of the CAEN_DGTZ_UINT16_EVENT_t, with their storage
+struct live_STD_event
+{
+    uint32_t TriggerTimeTag;
+    uint32_t ChSize[CAEN_DECODER_MAX_CHANNELS];
+    uint16_t *DataChannel[CAEN_DECODER_MAX_CHANNELS];
+
+    std::vector<std::vector<uint16_t>> samples;
+};
+
+template <typename T>
+static std::vector<T> parse_values(const std::string &line)
+{
+    std::istringstream stream(line);
+    std::vector<T> values;
+    unsigned long value;
+
+    while (stream >> value)
+    {
+        values.push_back(value);
+    }
+
+    return values;
+}
+
+static bool read_capture(const std::string &file_name,
+                         caen_decoder::settings &settings,
+                         std::vector<std::vector<char>> &buffers)
+{
+    std::ifstream file(file_name, std::ios::binary);
+
+    if (!caen_decoder::read_capture_header(file, settings))
+    {
+        return false;
+    }
+
+    std::vector<char> buffer;
+
+    while (caen_decoder::read_readout_buffer(file, buffer))
+    {
+        buffers.push_back(buffer);
+    }
+
+    return true;
+}
+
+static bool same_events(const std::vector<struct event_PSD> &a, const std::vector<struct event_PSD> &b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].timestamp != b[i].timestamp || a[i].qshort != b[i].qshort ||
+            a[i].qlong != b[i].qlong || a[i].baseline != b[i].baseline ||
+            a[i].channel != b[i].channel || a[i].pur != b[i].pur)
+        {
+            fprintf(stderr, "Event %zu differs: timestamp: %llu vs %llu; qshort: %u vs %u; qlong: %u vs %u; baseline: %u vs %u; channel: %u vs %u; pur: %u vs %u\n",
+                    i,
+                    (unsigned long long)a[i].timestamp, (unsigned long long)b[i].timestamp,
+                    a[i].qshort, b[i].qshort, a[i].qlong, b[i].qlong,
+                    a[i].baseline, b[i].baseline, a[i].channel, b[i].channel,
+                    a[i].pur, b[i].pur);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void test_PSD(const std::string &directory)
+{
+    caen_decoder::settings settings;
+    std::vector<std::vector<char>> buffers;
+
+    CHECK(read_capture(directory + "/caen_psd_x730.cap", settings, buffers));
+    CHECK(settings.dpp_version == 3);
+    CHECK(buffers.size() == 3);
+
+    // Reading the events returned by the CAEN libraries, buffer by buffer
+    std::vector<std::vector<std::vector<live_PSD_event>>> live_events;
+    std::vector<std::vector<std::vector<live_PSD_waveforms>>> live_waveforms;
+
+    std::ifstream expected_file(directory + "/caen_psd_x730.txt");
+    std::string line;
+
+    while (std::getline(expected_file, line))
+    {
+        if (line.compare(0, 1, "#") == 0)
+        {
+            continue;
+        }
+        else if (line.compare(0, 7, "buffer ") == 0)
+        {
+            live_events.emplace_back(settings.channels_number);
+            live_waveforms.emplace_back(settings.channels_number);
+        }
+        else if (line.compare(0, 6, "event ") == 0)
+        {
+            const std::vector<unsigned long> values = parse_values<unsigned long>(line.substr(6));
+
+            CHECK(values.size() == 8);
+
+            const unsigned int ch = values[0];
+
+            live_PSD_event event;
+
+            event.Format = 0;
+            event.TimeTag = values[1];
+            event.ChargeShort = values[2];
+            event.ChargeLong = values[3];
+            event.Baseline = values[4];
+            event.Pur = values[5];
+            event.Waveforms = nullptr;
+            event.Extras = values[6];
+
+            live_events.back()[ch].push_back(event);
+
+            live_waveforms.back()[ch].emplace_back();
+            live_PSD_waveforms &waveforms = live_waveforms.back()[ch].back();
+
+            std::getline(expected_file, line);
+            waveforms.trace1 = parse_values<uint16_t>(line);
+            std::getline(expected_file, line);
+            waveforms.dtrace1 = parse_values<uint8_t>(line);
+            std::getline(expected_file, line);
+            waveforms.dtrace2 = parse_values<uint8_t>(line);
+
+            CHECK(waveforms.trace1.size() == values[7]);
+            CHECK(waveforms.dtrace1.size() == values[7]);
+            CHECK(waveforms.dtrace2.size() == values[7]);
+        }
+    }
+
+    CHECK(live_events.size() == buffers.size());
+
+    if (live_events.size() != buffers.size())
+    {
+        return;
+    }
+
+    caen_decoder::timestamps live_timestamps;
+    caen_decoder::counters live_counters;
+    caen_decoder::timestamps offline_timestamps;
+    caen_decoder::counters offline_counters;
+
+    live_timestamps.reset(settings.channels_number);
+    live_counters.reset(settings.channels_number);
+    offline_timestamps.reset(settings.channels_number);
+    offline_counters.reset(settings.channels_number);
+
+    std::vector<std::vector<struct caen_decoder::PSD_event>> PSD_events;
+
+    for (size_t index = 0; index < buffers.size(); index++)
+    {
+        // The live path, as in actions::add_to_buffer() of abcd
+        std::vector<struct event_PSD> live_events_buffer;
+        std::vector<uint8_t> live_waveforms_buffer;
+
+        {
+            waveforms_buffer::writer waveforms(live_waveforms_buffer);
+
+            for (unsigned int ch = 0; ch < settings.channels_number; ch++)
+            {
+                const uint32_t events_number = live_events[index][ch].size();
+
+                for (uint32_t i = 0; i < events_number; i++)
+                {
+                    const uint64_t timestamp = caen_decoder::PSD_store_event(live_events[index][ch].data(), i, events_number, ch,
+                                                                             settings.flag_tt64,
+                                                                             live_timestamps.previous_timestamp.data(),
+                                                                             live_timestamps.time_offset.data(),
+                                                                             live_counters,
+                                                                             live_events_buffer);
+
+                    if (settings.enabled_waveforms)
+                    {
+                        live_PSD_waveforms &event_waveforms = live_waveforms[index][ch][i];
+                        event_waveforms.set_pointers();
+
+                        caen_decoder::PSD_store_waveforms(event_waveforms, timestamp, ch,
+                                                          settings.show_gates,
+                                                          waveforms);
+                    }
+                }
+            }
+        }
+
+        // The offline path
+        std::vector<struct event_PSD> offline_events_buffer;
+        std::vector<uint8_t> offline_waveforms_buffer;
+
+        waveforms_buffer::writer waveforms(offline_waveforms_buffer);
+
+        const int64_t events_number = caen_decoder::decode_PSD(buffers[index].data(), buffers[index].size(),
+                                                               settings,
+                                                               offline_timestamps, offline_counters,
+                                                               PSD_events, offline_events_buffer,
+                                                               waveforms);
+
+        CHECK(events_number == static_cast<int64_t>(live_events_buffer.size()));
+        CHECK(same_events(live_events_buffer, offline_events_buffer));
+        CHECK(live_waveforms_buffer == offline_waveforms_buffer);
+    }
+
+    CHECK(live_counters.counts == offline_counters.counts);
+    CHECK(live_counters.ICR_counts == offline_counters.ICR_counts);
+    CHECK(live_timestamps.time_offset == offline_timestamps.time_offset);
+
+    // The ICR flag is set only in the first event of the channel 0
+    CHECK(offline_counters.ICR_counts[0] == 1024);
+}
+
+static void test_STD(const std::string &directory)
+{
+    caen_decoder::settings settings;
+    std::vector<std::vector<char>> buffers;
+
+    CHECK(read_capture(directory + "/caen_std_x730.cap", settings, buffers));
+    CHECK(settings.dpp_version == 0);
+    CHECK(buffers.size() == 2);
+
+    std::vector<std::vector<live_STD_event>> live_events;
+
+    std::ifstream expected_file(directory + "/caen_std_x730.txt");
+    std::string line;
+
+    while (std::getline(expected_file, line))
+    {
+        if (line.compare(0, 1, "#") == 0)
+        {
+            continue;
+        }
+        else if (line.compare(0, 7, "buffer ") == 0)
+        {
+            live_events.emplace_back();
+        }
+        else if (line.compare(0, 6, "event ") == 0)
+        {
+            live_events.back().emplace_back();
+
+            live_STD_event &event = live_events.back().back();
+
+            event.TriggerTimeTag = std::stoul(line.substr(6));
+            event.samples.resize(CAEN_DECODER_MAX_CHANNELS);
+        }
+        else if (line.compare(0, 8, "channel ") == 0)
+        {
+            live_STD_event &event = live_events.back().back();
+
+            std::vector<unsigned long> values = parse_values<unsigned long>(line.substr(8));
+
+            const unsigned int ch = values[0];
+
+            event.samples[ch].assign(values.begin() + 1, values.end());
+        }
+    }
+
+    CHECK(live_events.size() == buffers.size());
+
+    if (live_events.size() != buffers.size())
+    {
+        return;
+    }
+
+    caen_decoder::timestamps live_timestamps;
+    caen_decoder::counters live_counters;
+    caen_decoder::timestamps offline_timestamps;
+    caen_decoder::counters offline_counters;
+
+    live_timestamps.reset(settings.channels_number);
+    live_counters.reset(settings.channels_number);
+    offline_timestamps.reset(settings.channels_number);
+    offline_counters.reset(settings.channels_number);
+
+    for (size_t index = 0; index < buffers.size(); index++)
+    {
+        std::vector<uint8_t> live_waveforms_buffer;
+
+        {
+            waveforms_buffer::writer waveforms(live_waveforms_buffer);
+
+            for (auto &event: live_events[index])
+            {
+                for (unsigned int ch = 0; ch < CAEN_DECODER_MAX_CHANNELS; ch++)
+                {
+                    event.ChSize[ch] = event.samples[ch].size();
+                    event.DataChannel[ch] = event.samples[ch].data();
+                }
+
+                caen_decoder::STD_store_event(event, event.TriggerTimeTag,
+                                              settings.channels_number,
+                                              live_timestamps.previous_timestamp.data(),
+                                              live_timestamps.time_offset.data(),
+                                              settings.offset_step,
+                                              live_counters,
+                                              waveforms);
+            }
+        }
+
+        std::vector<uint8_t> offline_waveforms_buffer;
+
+        waveforms_buffer::writer waveforms(offline_waveforms_buffer);
+
+        const int64_t events_number = caen_decoder::decode_STD(buffers[index].data(), buffers[index].size(),
+                                                               settings,
+                                                               offline_timestamps, offline_counters,
+                                                               waveforms);
+
+        CHECK(events_number == static_cast<int64_t>(live_events[index].size()));
+        CHECK(live_waveforms_buffer == offline_waveforms_buffer);
+    }
+
+    CHECK(live_counters.counts == offline_counters.counts);
+    CHECK(live_timestamps.time_offset == offline_timestamps.time_offset);
+
+    // The trigger time tag rolled over once on the channel 0
+    CHECK(offline_timestamps.time_offset[0] == settings.offset_step);
+}
+
+static void test_malformed(const std::string &directory)
+{
+    caen_decoder::settings settings;
+    std::vector<std::vector<char>> buffers;
+
+    CHECK(read_capture(directory + "/caen_psd_x730.cap", settings, buffers));
+
+    caen_decoder::timestamps timestamps;
+    caen_decoder::counters counters;
+
+    timestamps.reset(settings.channels_number);
+    counters.reset(settings.channels_number);
+
+    std::vector<std::vector<struct caen_decoder::PSD_event>> PSD_events;
+    std::vector<struct event_PSD> events_buffer;
+    std::vector<uint8_t> waveforms_buffer;
+
+    waveforms_buffer::writer waveforms(waveforms_buffer);
+
+    // A truncated aggregate must be rejected
+    std::vector<char> truncated(buffers[0].begin(), buffers[0].end() - 2 * sizeof(uint32_t));
+
+    CHECK(caen_decoder::decode_PSD(truncated.data(), truncated.size(), settings,
+                                   timestamps, counters, PSD_events, events_buffer,
+                                   waveforms) == -1);
+
+    // A wrong header tag must be rejected
+    std::vector<char> wrong_tag = buffers[0];
+    wrong_tag[3] = 0x50;
+
+    CHECK(caen_decoder::decode_PSD(wrong_tag.data(), wrong_tag.size(), settings,
+                                   timestamps, counters, PSD_events, events_buffer,
+                                   waveforms) == -1);
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string directory = (argc > 1) ? argv[1] : "data";
+
+    test_PSD(directory);
+    test_STD(directory);
+    test_malformed(directory);
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+// Checks that the coincidence window of cofi finds the coincidences whose
+// events arrive in different messages exactly once, neither losing them nor
+// duplicating them. The events of a stream are split in messages in many ways
+// and the output shall be the same of the whole stream in a single message.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "cofi_plugin.h"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+struct output
+{
+    struct event_PSD *events;
+    size_t number;
+};
+
+static struct cofi_config *create_config(int64_t left_window, int64_t right_window, size_t multiplicity)
+{
+    struct cofi_config *config = calloc(1, sizeof(struct cofi_config));
+
+    config->window_events.type = FILTER_EVENTS;
+    config->window_waveforms.type = FILTER_WAVEFORMS;
+
+    // The reference channel is 0
+    config->settings.reference_channels[0] = 1;
+    config->settings.left_window = left_window;
+    config->settings.right_window = right_window;
+    config->settings.multiplicity = multiplicity;
+
+    return config;
+}
+
+static void append_output(struct output *output, const struct filter_batch *batch)
+{
+    const size_t number = batch->size / sizeof(struct event_PSD);
+
+    output->events = realloc(output->events, (output->number + number + 1) * sizeof(struct event_PSD));
+
+    if (number > 0)
+    {
+        memcpy(output->events + output->number, batch->buffer, batch->size);
+        output->number += number;
+    }
+}
+
+static void process(struct cofi_config *config, const struct event_PSD *events, size_t number, struct output *output)
+{
+    struct filter_batch batch;
+
+    batch.type = FILTER_EVENTS;
+    batch.size = number * sizeof(struct event_PSD);
+    batch.buffer = malloc(batch.size + 1);
+
+    memcpy(batch.buffer, events, batch.size);
+
+    CHECK(cofi_process(&batch, config));
+
+    append_output(output, &batch);
+
+    free(batch.buffer);
+}
+
+static void flush(struct cofi_config *config, struct output *output)
+{
+    struct filter_batch batch = {FILTER_EVENTS, NULL, 0};
+
+    CHECK(cofi_flush(&batch, config));
+
+    append_output(output, &batch);
+
+    free(batch.buffer);
+}
+
+static struct event_PSD make_event(uint64_t timestamp, uint8_t channel)
+{
+    struct event_PSD event;
+
+    memset(&event, 0, sizeof(event));
+
+    event.timestamp = timestamp;
+    event.channel = channel;
+    // Marks the event, to tell the events apart in the output
+    event.qlong = (uint16_t)(timestamp * 7 + channel);
+
+    return event;
+}
+
+static bool same_output(const struct output *a, const struct output *b)
+{
+    return a->number == b->number &&
+           memcmp(a->events, b->events, a->number * sizeof(struct event_PSD)) == 0;
+}
+
+// The reference event of the second message is in coincidence with an event
+// of the first message, that is older than the events held for the search
+static void test_split_coincidence(void)
+{
+    const struct event_PSD first[2] = {make_event(1000, 1), make_event(1200, 1)};
+    const struct event_PSD second[2] = {make_event(1050, 0), make_event(2000, 1)};
+
+    struct cofi_config *config = create_config(100, 10, 1);
+    struct output output = {NULL, 0};
+
+    process(config, first, 2, &output);
+    process(config, second, 2, &output);
+    flush(config, &output);
+
+    CHECK(output.number == 2);
+
+    if (output.number == 2)
+    {
+        CHECK(output.events[0].timestamp == 1050 && output.events[0].channel == 0);
+        CHECK(output.events[0].group_counter == 1);
+        CHECK(output.events[1].timestamp == 1000 && output.events[1].channel == 1);
+    }
+
+    CHECK(config->window_events.late_events == 0);
+
+    cofi_close(config);
+    free(output.events);
+}
+
+static uint64_t random_state = 0x2545F4914F6CDD1DULL;
+
+static uint64_t random_next(void)
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+
+    return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+// A sorted stream of events split in messages at random positions, every
+// split shall give the output of the whole stream.
+// With delayed references, some reference events arrive with the following
+// message, as from a slower board. The splits where those events are late,
+// or where a message of only delayed events looks like a restart, cannot give
+// the same output and they are skipped.
+static void test_random_splits(int64_t left_window, int64_t right_window, size_t multiplicity, bool keep_reference, bool delayed_references)
+{
+    const size_t number = 2000;
+
+    struct event_PSD *events = malloc(number * sizeof(struct event_PSD));
+    uint64_t timestamp = 1000;
+
+    for (size_t i = 0; i < number; i++)
+    {
+        // Many events closer than the windows, with some gaps
+        timestamp += (random_next() % 10 == 0) ? 500 : random_next() % 30;
+
+        events[i] = make_event(timestamp, random_next() % 4);
+    }
+
+    struct cofi_config *config = create_config(left_window, right_window, multiplicity);
+    config->settings.keep_reference_event = keep_reference;
+
+    struct output expected = {NULL, 0};
+
+    process(config, events, number, &expected);
+    flush(config, &expected);
+    cofi_close(config);
+
+    CHECK(expected.number > 0);
+
+    struct event_PSD *message = malloc(2 * number * sizeof(struct event_PSD));
+    struct event_PSD *delayed = malloc(number * sizeof(struct event_PSD));
+
+    unsigned int compared_splits = 0;
+
+    for (unsigned int split = 0; split < 50; split++)
+    {
+        config = create_config(left_window, right_window, multiplicity);
+        config->settings.keep_reference_event = keep_reference;
+
+        struct output output = {NULL, 0};
+
+        // From messages with a single event to messages with most events
+        const size_t maximum_size = 1 + random_next() % ((split % 2 == 0) ? 5 : 500);
+
+        size_t delayed_number = 0;
+
+        for (size_t start = 0; start < number;)
+        {
+            size_t size = 1 + random_next() % maximum_size;
+
+            if (start + size > number)
+            {
+                size = number - start;
+            }
+
+            // The references delayed from the previous message come first
+            size_t message_number = delayed_number;
+
+            memcpy(message, delayed, delayed_number * sizeof(struct event_PSD));
+            delayed_number = 0;
+
+            for (size_t i = start; i < start + size; i++)
+            {
+                // Only the references that are not yet searched may arrive
+                // later without being late
+                const bool delay = delayed_references && events[i].channel == 0 && start + size < number &&
+                                   (int64_t)(events[start + size - 1].timestamp - events[i].timestamp) < right_window &&
+                                   random_next() % 2 == 0;
+
+                if (delay)
+                {
+                    delayed[delayed_number++] = events[i];
+                }
+                else
+                {
+                    message[message_number++] = events[i];
+                }
+            }
+
+            if (message_number > 0)
+            {
+                process(config, message, message_number, &output);
+            }
+
+            start += size;
+        }
+
+        flush(config, &output);
+
+        if (config->window_events.late_events > 0 || config->window_events.restarts > 0)
+        {
+            CHECK(delayed_references);
+
+            cofi_close(config);
+            free(output.events);
+
+            continue;
+        }
+
+        compared_splits += 1;
+
+        const bool same = same_output(&expected, &output);
+
+        CHECK(same);
+
+        if (!same)
+        {
+            fprintf(stderr, "left: %" PRId64 "; right: %" PRId64 "; multiplicity: %zu; expected events: %zu; output events: %zu\n",
+                    left_window, right_window, multiplicity, expected.number, output.number);
+        }
+
+        cofi_close(config);
+        free(output.events);
+    }
+
+    CHECK(compared_splits > 0);
+
+    free(message);
+    free(delayed);
+    free(expected.events);
+    free(events);
+}
+
+int main(void)
+{
+    test_split_coincidence();
+
+    for (unsigned int delayed = 0; delayed < 2; delayed++)
+    {
+        test_random_splits(100, 10, 1, false, delayed);
+        test_random_splits(10, 100, 1, false, delayed);
+        test_random_splits(50, 50, 2, true, delayed);
+        test_random_splits(0, 40, 1, false, delayed);
+        test_random_splits(40, 0, 1, true, delayed);
+    }
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
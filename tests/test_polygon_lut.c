@@ -0,0 +1,187 @@
+// Checks the classification of the points with the polygon lookup tables of
+// pufi against the plain winding number test. Besides random points, the
+// points lie on the vertexes, on the edges and on the borders of the cells,
+// where the rounding of the coordinates might move a point to a cell that was
+// not marked as crossed by an edge.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "polygon_lut.h"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+#define MAX_POINTS 16
+
+struct test_polygon
+{
+    const char *name;
+    size_t n;
+    // The polygon is closed by the test, with polygon[n] = polygon[0]
+    struct Point_t points[MAX_POINTS + 1];
+};
+
+static uint64_t random_state = 0x853C49E6748FEA9BULL;
+
+static double random_uniform(double minimum, double maximum)
+{
+    random_state = random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    return minimum + (maximum - minimum) * ((random_state >> 11) * (1.0 / 9007199254740992.0));
+}
+
+static size_t mismatches = 0;
+
+static void check_point(struct Point_t P, const struct PolygonLUT_t *lut, struct test_polygon *polygon, size_t lut_size)
+{
+    // As in pufi, only the points in the bounding box are tested
+    if (!point_in_bounding_box(P, lut->bounding_box))
+    {
+        return;
+    }
+
+    const int expected = (point_winding_number(P, polygon->points, polygon->n) != 0);
+    const int result = (point_in_polygon_lut(P, lut, polygon->points, polygon->n) != 0);
+
+    if (expected != result)
+    {
+        if (mismatches < 10)
+        {
+            fprintf(stderr, "Mismatch: polygon: %s; LUT size: %zu; point: (%.17g, %.17g); expected: %d\n",
+                    polygon->name, lut_size, P.x, P.y, expected);
+        }
+
+        mismatches += 1;
+    }
+}
+
+static void test_polygon(struct test_polygon *polygon, size_t lut_size)
+{
+    polygon->points[polygon->n] = polygon->points[0];
+
+    struct PolygonLUT_t lut;
+
+    CHECK(compute_polygon_lut(&lut, polygon->points, polygon->n, lut_size, lut_size) == 0);
+
+    const struct BoundingBox_t box = lut.bounding_box;
+
+    // Random points, also outside the bounding box
+    for (unsigned int i = 0; i < 20000; i++)
+    {
+        struct Point_t P;
+        P.x = random_uniform(box.top_left.x - 1, box.bottom_right.x + 1);
+        P.y = random_uniform(box.bottom_right.y - 1, box.top_left.y + 1);
+
+        check_point(P, &lut, polygon, lut_size);
+    }
+
+    // Points with integer coordinates, as the charges of the events
+    for (double x = floor(box.top_left.x); x <= box.bottom_right.x; x += 1)
+    {
+        for (double y = floor(box.bottom_right.y); y <= box.top_left.y; y += 1)
+        {
+            const struct Point_t P = {x, y};
+
+            check_point(P, &lut, polygon, lut_size);
+        }
+    }
+
+    for (size_t i = 0; i < polygon->n; i++)
+    {
+        const struct Point_t P0 = polygon->points[i];
+        const struct Point_t P1 = polygon->points[i + 1];
+
+        // The vertexes
+        check_point(P0, &lut, polygon, lut_size);
+
+        // Points on the edges and slightly off them
+        for (unsigned int j = 0; j <= 64; j++)
+        {
+            const double t = j / 64.0;
+
+            const struct Point_t P = {P0.x + t * (P1.x - P0.x), P0.y + t * (P1.y - P0.y)};
+
+            check_point(P, &lut, polygon, lut_size);
+
+            const struct Point_t above = {P.x, nextafter(P.y, INFINITY)};
+            const struct Point_t below = {P.x, nextafter(P.y, -INFINITY)};
+            const struct Point_t left = {nextafter(P.x, -INFINITY), P.y};
+            const struct Point_t right = {nextafter(P.x, INFINITY), P.y};
+
+            check_point(above, &lut, polygon, lut_size);
+            check_point(below, &lut, polygon, lut_size);
+            check_point(left, &lut, polygon, lut_size);
+            check_point(right, &lut, polygon, lut_size);
+        }
+    }
+
+    // The borders and the corners of the cells
+    if (lut.cells != NULL)
+    {
+        for (size_t column = 0; column <= lut.width; column++)
+        {
+            for (size_t row = 0; row <= lut.height; row++)
+            {
+                const struct Point_t P = {box.top_left.x + column / lut.x_scale,
+                                          box.bottom_right.y + row / lut.y_scale};
+
+                check_point(P, &lut, polygon, lut_size);
+
+                const struct Point_t inner = {nextafter(P.x, INFINITY), nextafter(P.y, INFINITY)};
+
+                check_point(inner, &lut, polygon, lut_size);
+            }
+        }
+    }
+
+    free_polygon_lut(&lut);
+}
+
+int main(void)
+{
+    struct test_polygon polygons[] = {
+        {"square", 4, {{0, 0}, {10, 0}, {10, 10}, {0, 10}}},
+        {"triangle", 3, {{0, 0}, {1000, 10}, {300, 700}}},
+        // A typical PSD selection, on the qlong and PSD plane
+        {"band", 6, {{100, 0.05}, {4000, 0.1}, {16000, 0.12}, {16000, 0.2}, {4000, 0.3}, {100, 0.25}}},
+        {"concave", 8, {{0, 0}, {8, 0}, {8, 8}, {6, 8}, {6, 2}, {2, 2}, {2, 8}, {0, 8}}},
+        {"star", 10, {{50, 0}, {61, 35}, {98, 35}, {68, 57}, {79, 91}, {50, 70}, {21, 91}, {32, 57}, {2, 35}, {39, 35}}},
+        // The winding number is 2 in the inner pentagon
+        {"pentagram", 5, {{50, 0}, {79, 91}, {2, 35}, {98, 35}, {21, 91}}},
+        {"bow tie", 4, {{0, 0}, {10, 10}, {10, 0}, {0, 10}}},
+        {"sliver", 3, {{0, 0}, {1000, 1}, {1000, 1.001}}},
+        {"clockwise", 4, {{0, 0}, {0, 5}, {7, 5}, {7, 0}}},
+        {"degenerate", 3, {{0, 0}, {5, 5}, {10, 10}}},
+    };
+
+    const size_t lut_sizes[] = {1, 2, 3, 16, 100, 256};
+
+    for (size_t p = 0; p < sizeof(polygons) / sizeof(polygons[0]); p++)
+    {
+        for (size_t s = 0; s < sizeof(lut_sizes) / sizeof(lut_sizes[0]); s++)
+        {
+            test_polygon(&polygons[p], lut_sizes[s]);
+        }
+    }
+
+    CHECK(mismatches == 0);
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u; mismatches: %zu\n", failures, mismatches);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
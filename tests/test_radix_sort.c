@@ -0,0 +1,280 @@
+// Checks the radix sort of the timestamps against qsort(), on random arrays
+// with the patterns that select the different strategies of the sort: sorted,
+// almost sorted, made of sorted runs, narrow and full ranges of the keys.
+// The sizes go across the threshold of the parallel sort, which falls back to
+// the serial one below threads_number * RADIX_SORT_BUCKETS * 16 elements.
+// The elements carry their original position, to check that the sort is
+// stable.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define RADIX_SORT_PARALLEL
+#include "radix_sort.h"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+// Bigger than RADIX_SORT_INSERTION_MAX_SIZE, with the key not at the start
+struct big_element
+{
+    uint32_t position;
+    uint64_t timestamp;
+    uint8_t padding[80];
+};
+
+enum pattern_t
+{
+    PATTERN_RANDOM,
+    PATTERN_NARROW,
+    PATTERN_SORTED,
+    PATTERN_ALMOST_SORTED,
+    PATTERN_RUNS,
+    PATTERN_REVERSED,
+    PATTERN_EQUAL,
+    PATTERNS_NUMBER
+};
+
+static const char *pattern_names[PATTERNS_NUMBER] = {
+    "random", "narrow", "sorted", "almost sorted", "runs", "reversed", "equal"
+};
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t random_next(void)
+{
+    // xorshift64*
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+
+    return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void generate_keys(uint64_t *keys, size_t number, enum pattern_t pattern)
+{
+    const uint64_t start = random_next();
+    const size_t runs_number = 1 + random_next() % 8;
+
+    for (size_t i = 0; i < number; i++)
+    {
+        switch (pattern)
+        {
+            case PATTERN_RANDOM:
+                keys[i] = random_next();
+                break;
+            case PATTERN_NARROW:
+                // Few distinct keys, many duplicates to check the stability
+                keys[i] = start + random_next() % 1000;
+                break;
+            case PATTERN_SORTED:
+                keys[i] = start + i * 10;
+                break;
+            case PATTERN_ALMOST_SORTED:
+                keys[i] = start + i * 10 + random_next() % 25;
+                break;
+            case PATTERN_RUNS:
+                // The blocks of events of a few channels
+                keys[i] = start + (i / runs_number) * 7 + (i % runs_number) * 3;
+                break;
+            case PATTERN_REVERSED:
+                keys[i] = start - i * 3;
+                break;
+            case PATTERN_EQUAL:
+            default:
+                keys[i] = start;
+                break;
+        }
+    }
+
+    if (pattern == PATTERN_RUNS)
+    {
+        // Grouping the keys by run, each run is sorted
+        uint64_t *copy = malloc(number * sizeof(uint64_t));
+        size_t index = 0;
+
+        memcpy(copy, keys, number * sizeof(uint64_t));
+
+        for (size_t r = 0; r < runs_number; r++)
+        {
+            for (size_t i = r; i < number; i += runs_number)
+            {
+                keys[index++] = copy[i];
+            }
+        }
+
+        free(copy);
+    }
+}
+
+static int compare_events(const void *a, const void *b)
+{
+    const struct event_PSD *event_a = (const struct event_PSD *)a;
+    const struct event_PSD *event_b = (const struct event_PSD *)b;
+
+    if (event_a->timestamp != event_b->timestamp)
+    {
+        return (event_a->timestamp < event_b->timestamp) ? -1 : 1;
+    }
+
+    // The position makes qsort() behave as a stable sort
+    const uint32_t position_a = event_a->qshort | ((uint32_t)event_a->qlong << 16);
+    const uint32_t position_b = event_b->qshort | ((uint32_t)event_b->qlong << 16);
+
+    return (position_a < position_b) ? -1 : (position_a > position_b);
+}
+
+static int compare_big(const void *a, const void *b)
+{
+    const struct big_element *element_a = (const struct big_element *)a;
+    const struct big_element *element_b = (const struct big_element *)b;
+
+    if (element_a->timestamp != element_b->timestamp)
+    {
+        return (element_a->timestamp < element_b->timestamp) ? -1 : 1;
+    }
+
+    return (element_a->position < element_b->position) ? -1 : (element_a->position > element_b->position);
+}
+
+static void test_events(size_t number, enum pattern_t pattern, unsigned int threads_number, bool with_buffer)
+{
+    uint64_t *keys = malloc(number * sizeof(uint64_t) + 1);
+    struct event_PSD *events = malloc(number * sizeof(struct event_PSD) + 1);
+    struct event_PSD *expected = malloc(number * sizeof(struct event_PSD) + 1);
+    struct event_PSD *buffer = with_buffer ? malloc(number * sizeof(struct event_PSD) + 1) : NULL;
+
+    generate_keys(keys, number, pattern);
+
+    for (size_t i = 0; i < number; i++)
+    {
+        events[i].timestamp = keys[i];
+        events[i].qshort = i & 0xFFFF;
+        events[i].qlong = (i >> 16) & 0xFFFF;
+        events[i].baseline = 0;
+        events[i].channel = i % 16;
+        events[i].group_counter = 0;
+    }
+
+    memcpy(expected, events, number * sizeof(struct event_PSD));
+    qsort(expected, number, sizeof(struct event_PSD), compare_events);
+
+    const enum radix_sort_error_t result = radix_sort_timestamps_parallel(events, number,
+                                                                          sizeof(struct event_PSD),
+                                                                          offsetof(struct event_PSD, timestamp),
+                                                                          buffer, threads_number);
+
+    CHECK(result == RADIX_SORT_OK);
+
+    const bool same = (memcmp(events, expected, number * sizeof(struct event_PSD)) == 0);
+
+    CHECK(same);
+
+    if (!same)
+    {
+        fprintf(stderr, "events: number: %zu, pattern: %s, threads: %u, buffer: %d\n",
+                number, pattern_names[pattern], threads_number, with_buffer);
+    }
+
+    free(keys);
+    free(events);
+    free(expected);
+    free(buffer);
+}
+
+static void test_big(size_t number, enum pattern_t pattern, unsigned int threads_number)
+{
+    uint64_t *keys = malloc(number * sizeof(uint64_t) + 1);
+    struct big_element *elements = calloc(number + 1, sizeof(struct big_element));
+    struct big_element *expected = calloc(number + 1, sizeof(struct big_element));
+
+    generate_keys(keys, number, pattern);
+
+    for (size_t i = 0; i < number; i++)
+    {
+        elements[i].position = i;
+        elements[i].timestamp = keys[i];
+        memset(elements[i].padding, i & 0xFF, sizeof(elements[i].padding));
+    }
+
+    memcpy(expected, elements, number * sizeof(struct big_element));
+    qsort(expected, number, sizeof(struct big_element), compare_big);
+
+    const enum radix_sort_error_t result = radix_sort_timestamps_parallel(elements, number,
+                                                                          sizeof(struct big_element),
+                                                                          offsetof(struct big_element, timestamp),
+                                                                          NULL, threads_number);
+
+    CHECK(result == RADIX_SORT_OK);
+
+    const bool same = (memcmp(elements, expected, number * sizeof(struct big_element)) == 0);
+
+    CHECK(same);
+
+    if (!same)
+    {
+        fprintf(stderr, "big: number: %zu, pattern: %s, threads: %u\n",
+                number, pattern_names[pattern], threads_number);
+    }
+
+    free(keys);
+    free(elements);
+    free(expected);
+}
+
+int main(void)
+{
+    const unsigned int threads_numbers[] = {1, 2, 3, 4};
+
+    for (size_t t = 0; t < sizeof(threads_numbers) / sizeof(threads_numbers[0]); t++)
+    {
+        const unsigned int threads_number = threads_numbers[t];
+        const size_t threshold = threads_number * RADIX_SORT_BUCKETS * 16;
+
+        const size_t sizes[] = {
+            0, 1, 2, 3,
+            RADIX_SORT_SMALL_SIZE - 1, RADIX_SORT_SMALL_SIZE, RADIX_SORT_SMALL_SIZE + 1,
+            1000,
+            threshold - 1, threshold, threshold + 1,
+            threshold * 3 + 7
+        };
+
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            for (unsigned int p = 0; p < PATTERNS_NUMBER; p++)
+            {
+                test_events(sizes[s], p, threads_number, true);
+                test_events(sizes[s], p, threads_number, false);
+                test_big(sizes[s], p, threads_number);
+            }
+        }
+    }
+
+    // The serial sort on its own, with more random sizes
+    for (unsigned int n = 0; n < 200; n++)
+    {
+        const size_t number = random_next() % 5000;
+        const enum pattern_t pattern = random_next() % PATTERNS_NUMBER;
+
+        test_events(number, pattern, 1, n % 2 == 0);
+    }
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
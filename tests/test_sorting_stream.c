@@ -0,0 +1,385 @@
+// Checks the sorting of the events across the messages of sofi: the stream of
+// pending events, the emission of the events older than the reorder horizon,
+// the late events and the restarts of the digitizer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sofi_plugin.h"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+struct output
+{
+    struct event_PSD *events;
+    size_t number;
+};
+
+static struct sofi_config *create_config(uint64_t horizon_time, size_t horizon_events, uint64_t restart_time)
+{
+    struct sofi_config *config = calloc(1, sizeof(struct sofi_config));
+
+    config->streaming = true;
+    config->horizon_time = horizon_time;
+    config->horizon_events = horizon_events;
+    config->restart_time = (restart_time > horizon_time) ? restart_time : horizon_time;
+
+    return config;
+}
+
+static struct event_PSD make_event(uint64_t timestamp, uint16_t marker)
+{
+    struct event_PSD event;
+
+    memset(&event, 0, sizeof(event));
+
+    event.timestamp = timestamp;
+    // Marks the event, to tell apart the events with the same timestamp
+    event.qlong = marker;
+
+    return event;
+}
+
+//! Processes a message and returns the emitted events
+static struct output process(struct sofi_config *config, const struct event_PSD *events, size_t number)
+{
+    struct filter_batch batch;
+
+    batch.type = FILTER_EVENTS;
+    batch.size = number * sizeof(struct event_PSD);
+    batch.buffer = malloc(batch.size + 1);
+
+    memcpy(batch.buffer, events, batch.size);
+
+    CHECK(sofi_process(&batch, config));
+
+    struct output output = {(struct event_PSD *)batch.buffer, batch.size / sizeof(struct event_PSD)};
+
+    return output;
+}
+
+static struct output flush(struct sofi_config *config)
+{
+    struct filter_batch batch = {FILTER_EVENTS, NULL, 0};
+
+    CHECK(sofi_flush(&batch, config));
+
+    struct output output = {(struct event_PSD *)batch.buffer, batch.size / sizeof(struct event_PSD)};
+
+    return output;
+}
+
+static bool same_timestamps(const struct output *output, const uint64_t *timestamps, size_t number)
+{
+    if (output->number != number)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < number; i++)
+    {
+        if (output->events[i].timestamp != timestamps[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The events are held until they are older than the newest one by more than
+// the horizon time
+static void test_horizon_time(void)
+{
+    struct sofi_config *config = create_config(100, 0, 0);
+
+    const struct event_PSD first[4] = {make_event(30, 0), make_event(10, 1), make_event(50, 2), make_event(20, 3)};
+
+    struct output output = process(config, first, 4);
+
+    CHECK(output.number == 0);
+
+    free(output.events);
+
+    const struct event_PSD second[2] = {make_event(140, 4), make_event(40, 5)};
+
+    output = process(config, second, 2);
+
+    // The watermark is 40
+    const uint64_t expected_second[3] = {10, 20, 30};
+
+    CHECK(same_timestamps(&output, expected_second, 3));
+
+    free(output.events);
+
+    output = flush(config);
+
+    const uint64_t expected_flush[3] = {40, 50, 140};
+
+    CHECK(same_timestamps(&output, expected_flush, 3));
+
+    free(output.events);
+
+    CHECK(config->stream_events.late_events == 0);
+    CHECK(config->stream_events.restarts == 0);
+
+    sofi_close(config);
+}
+
+// At most horizon_events events are pending
+static void test_horizon_events(void)
+{
+    struct sofi_config *config = create_config(0, 2, 0);
+
+    const struct event_PSD first[3] = {make_event(30, 0), make_event(10, 1), make_event(20, 2)};
+
+    struct output output = process(config, first, 3);
+
+    const uint64_t expected_first[1] = {10};
+
+    CHECK(same_timestamps(&output, expected_first, 1));
+
+    free(output.events);
+
+    const struct event_PSD second[2] = {make_event(25, 3), make_event(15, 4)};
+
+    output = process(config, second, 2);
+
+    const uint64_t expected_second[2] = {15, 20};
+
+    CHECK(same_timestamps(&output, expected_second, 2));
+
+    free(output.events);
+
+    sofi_close(config);
+}
+
+// An event older than the last emitted one is counted as late, but it is
+// emitted anyways in the order of the pending events
+static void test_late_events(void)
+{
+    struct sofi_config *config = create_config(100, 0, 1000);
+
+    const struct event_PSD first[3] = {make_event(100, 0), make_event(200, 1), make_event(300, 2)};
+
+    struct output output = process(config, first, 3);
+
+    const uint64_t expected_first[1] = {100};
+
+    CHECK(same_timestamps(&output, expected_first, 1));
+    CHECK(config->stream_events.late_events == 0);
+
+    free(output.events);
+
+    const struct event_PSD second[2] = {make_event(50, 3), make_event(450, 4)};
+
+    output = process(config, second, 2);
+
+    const uint64_t expected_second[3] = {50, 200, 300};
+
+    CHECK(same_timestamps(&output, expected_second, 3));
+    CHECK(config->stream_events.late_events == 1);
+    CHECK(config->stream_events.restarts == 0);
+
+    free(output.events);
+
+    sofi_close(config);
+}
+
+// A jump back larger than the restart time emits the pending events before
+// the new ones, then the horizon starts from the new events
+static void test_restart(void)
+{
+    struct sofi_config *config = create_config(100, 0, 1000);
+
+    const struct event_PSD first[3] = {make_event(5000, 0), make_event(5200, 1), make_event(5150, 2)};
+
+    struct output output = process(config, first, 3);
+
+    const uint64_t expected_first[1] = {5000};
+
+    CHECK(same_timestamps(&output, expected_first, 1));
+
+    free(output.events);
+
+    const struct event_PSD second[3] = {make_event(20, 3), make_event(10, 4), make_event(300, 5)};
+
+    output = process(config, second, 3);
+
+    // The pending events come first, then the new ones older than the
+    // horizon of the new events
+    const uint64_t expected_second[4] = {5150, 5200, 10, 20};
+
+    CHECK(same_timestamps(&output, expected_second, 4));
+    CHECK(config->stream_events.restarts == 1);
+    CHECK(config->stream_events.late_events == 0);
+
+    free(output.events);
+
+    output = flush(config);
+
+    const uint64_t expected_flush[1] = {300};
+
+    CHECK(same_timestamps(&output, expected_flush, 1));
+
+    free(output.events);
+
+    sofi_close(config);
+}
+
+// The restart is detected also when there are no pending events, e.g. after
+// a flush, and the horizon starts from the new events
+static void test_restart_without_pending(void)
+{
+    struct sofi_config *config = create_config(100, 0, 1000);
+
+    const struct event_PSD first[2] = {make_event(5000, 0), make_event(5200, 1)};
+
+    struct output output = process(config, first, 2);
+
+    free(output.events);
+
+    output = flush(config);
+
+    const uint64_t expected_flush[1] = {5200};
+
+    CHECK(same_timestamps(&output, expected_flush, 1));
+    CHECK(config->stream_events.pointers_number == 0);
+
+    free(output.events);
+
+    const struct event_PSD second[3] = {make_event(20, 2), make_event(10, 3), make_event(300, 4)};
+
+    output = process(config, second, 3);
+
+    const uint64_t expected_second[2] = {10, 20};
+
+    CHECK(same_timestamps(&output, expected_second, 2));
+    CHECK(config->stream_events.restarts == 1);
+    CHECK(config->stream_events.late_events == 0);
+
+    free(output.events);
+
+    sofi_close(config);
+}
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t random_next(void)
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+
+    return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+// The stream is fed with random messages, sorted or not, and random numbers
+// of events are removed. The pending events shall always be sorted, with the
+// events with the same timestamp in their order of arrival, and their data
+// shall follow them through the compactions.
+static void test_stream_random(void)
+{
+    struct sorting_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    struct event_PSD message[64];
+    struct event_pointer *pointers = NULL;
+    size_t pointers_capacity = 0;
+
+    uint16_t marker = 0;
+    uint64_t base = 1000;
+
+    for (unsigned int iteration = 0; iteration < 2000; iteration++)
+    {
+        const size_t number = random_next() % 64;
+
+        for (size_t i = 0; i < number; i++)
+        {
+            // Few distinct timestamps, to have many equal ones
+            message[i] = make_event(base + random_next() % 50, marker++);
+        }
+
+        // Most messages are sorted, as in sofi
+        if (random_next() % 4 != 0)
+        {
+            for (size_t i = 1; i < number; i++)
+            {
+                for (size_t j = i; j > 0 && message[j - 1].timestamp > message[j].timestamp; j--)
+                {
+                    const struct event_PSD temp = message[j];
+                    message[j] = message[j - 1];
+                    message[j - 1] = temp;
+                }
+            }
+        }
+
+        const size_t parsed = sorting_stream_parse_message(EVENTS_SEARCH, (const uint8_t *)message,
+                                                           number * sizeof(struct event_PSD),
+                                                           &pointers, &pointers_capacity);
+
+        CHECK(parsed == number);
+        CHECK(sorting_stream_add(&stream, (const uint8_t *)message, pointers, number, 0));
+
+        for (size_t i = 0; i < stream.pointers_number; i++)
+        {
+            struct event_PSD event;
+            memcpy(&event, stream.data + stream.pointers[i].index, sizeof(event));
+
+            CHECK(event.timestamp == stream.pointers[i].timestamp);
+
+            if (i > 0)
+            {
+                const struct event_pointer previous = stream.pointers[i - 1];
+
+                CHECK(previous.timestamp <= stream.pointers[i].timestamp);
+
+                if (previous.timestamp == stream.pointers[i].timestamp)
+                {
+                    struct event_PSD previous_event;
+                    memcpy(&previous_event, stream.data + previous.index, sizeof(previous_event));
+
+                    // The markers wrap around only after many events
+                    CHECK((uint16_t)(event.qlong - previous_event.qlong) < 0x8000);
+                }
+            }
+        }
+
+        sorting_stream_remove(&stream, random_next() % (stream.pointers_number + 1));
+
+        base += random_next() % 20;
+    }
+
+    sorting_stream_free(&stream);
+    free(pointers);
+}
+
+int main(void)
+{
+    test_horizon_time();
+    test_horizon_events();
+    test_late_events();
+    test_restart();
+    test_restart_without_pending();
+    test_stream_random();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+// Checks the reset commands of spec against the partial histograms of the
+// workers: the events filled before a reset shall not come back with the
+// next merge, while the other channels shall keep their counts.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "typedefs.hpp"
+#include "actions.hpp"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+static const unsigned int channels_number = 3;
+
+// The PSD is the normalized tail, that is always 0.5 for the events below
+static void setup_status(status &global_status, unsigned int workers_number)
+{
+    global_status.spectra_type = QLONG_SPECTRA;
+    global_status.PSD_type = QTAIL_VS_ENERGY_PSD;
+    global_status.PSD_normalize = true;
+    global_status.partials.resize(workers_number);
+
+    for (unsigned int channel = 0; channel < channels_number; channel++)
+    {
+        global_status.histos_E[channel] = histogram_create(64, 0, 1024, 0);
+        global_status.histos_PSD[channel] = histogram2D_create_with_storage(64, 0, 1024, 32, -1, 2,
+                                                                            HISTOGRAM2D_STORAGE_TILED, 0);
+        global_status.counts_partial[channel] = 0;
+        global_status.counts_total[channel] = 0;
+    }
+}
+
+static void destroy_status(status &global_status)
+{
+    for (auto &partial: global_status.partials)
+    {
+        for (unsigned int channel = 0; channel < channels_number; channel++)
+        {
+            histogram_destroy(partial.histos_E[channel]);
+            histogram2D_destroy(partial.histos_PSD[channel]);
+        }
+    }
+
+    for (unsigned int channel = 0; channel < channels_number; channel++)
+    {
+        histogram_destroy(global_status.histos_E[channel]);
+        histogram2D_destroy(global_status.histos_PSD[channel]);
+    }
+}
+
+static std::vector<struct event_PSD> make_events(size_t number)
+{
+    std::vector<struct event_PSD> events(number);
+
+    for (size_t i = 0; i < number; i++)
+    {
+        memset(&events[i], 0, sizeof(struct event_PSD));
+
+        events[i].timestamp = i;
+        events[i].channel = i % channels_number;
+        events[i].qlong = 100 + (i * 37) % 900;
+        events[i].qshort = events[i].qlong / 2;
+    }
+
+    return events;
+}
+
+//! Every worker fills its partial histograms with a slice of the events
+static void fill(status &global_status, const std::vector<struct event_PSD> &events)
+{
+    const size_t workers_number = global_status.partials.size();
+    const size_t slice = events.size() / workers_number;
+
+    for (size_t worker = 0; worker < workers_number; worker++)
+    {
+        const size_t first = worker * slice;
+        const size_t last = (worker + 1 == workers_number) ? events.size() : first + slice;
+
+        actions::generic::fill_partial_spectra(global_status, global_status.partials[worker],
+                                               events.data() + first, last - first);
+    }
+}
+
+static double sum_E(const histogram_t *histo)
+{
+    double sum = 0;
+
+    for (unsigned int i = 0; i < histo->bins; i++)
+    {
+        sum += histo->histo[i];
+    }
+
+    return sum;
+}
+
+static double sum_PSD(const histogram2D_t *histo)
+{
+    double sum = 0;
+
+    for (unsigned int x = 0; x < histo->bins_x; x++)
+    {
+        for (unsigned int y = 0; y < histo->bins_y; y++)
+        {
+            sum += histogram2D_get_bin(histo, x, y);
+        }
+    }
+
+    return sum;
+}
+
+static void check_channel(const status &global_status, unsigned int channel, unsigned int expected_counts)
+{
+    CHECK(global_status.counts_total.at(channel) == expected_counts);
+    CHECK(global_status.counts_partial.at(channel) == expected_counts);
+    CHECK(sum_E(global_status.histos_E.at(channel)) == expected_counts);
+    CHECK(sum_PSD(global_status.histos_PSD.at(channel)) == expected_counts);
+}
+
+// A channel is reset between the fill of the partial histograms and their
+// merge, its events are dropped and the other channels are untouched
+static void test_reset_channel(unsigned int workers_number)
+{
+    status global_status;
+    setup_status(global_status, workers_number);
+
+    const std::vector<struct event_PSD> events = make_events(300);
+
+    fill(global_status, events);
+    actions::generic::merge_partial_spectra(global_status);
+
+    fill(global_status, events);
+    actions::generic::reset_channel(global_status, 1);
+    actions::generic::merge_partial_spectra(global_status);
+
+    check_channel(global_status, 0, 200);
+    check_channel(global_status, 1, 0);
+    check_channel(global_status, 2, 200);
+
+    // The reset channel is filled again from scratch
+    fill(global_status, events);
+    actions::generic::merge_partial_spectra(global_status);
+
+    check_channel(global_status, 0, 300);
+    check_channel(global_status, 1, 100);
+    check_channel(global_status, 2, 300);
+
+    destroy_status(global_status);
+}
+
+static void test_reset_all_channels(unsigned int workers_number)
+{
+    status global_status;
+    setup_status(global_status, workers_number);
+
+    const std::vector<struct event_PSD> events = make_events(300);
+
+    fill(global_status, events);
+    actions::generic::merge_partial_spectra(global_status);
+
+    fill(global_status, events);
+    actions::generic::reset_all_channels(global_status);
+    actions::generic::merge_partial_spectra(global_status);
+
+    for (unsigned int channel = 0; channel < channels_number; channel++)
+    {
+        check_channel(global_status, channel, 0);
+    }
+
+    fill(global_status, events);
+    actions::generic::merge_partial_spectra(global_status);
+
+    for (unsigned int channel = 0; channel < channels_number; channel++)
+    {
+        check_channel(global_status, channel, 100);
+    }
+
+    destroy_status(global_status);
+}
+
+int main()
+{
+    for (const unsigned int workers_number: {1, 4})
+    {
+        test_reset_channel(workers_number);
+        test_reset_all_channels(workers_number);
+    }
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
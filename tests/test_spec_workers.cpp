@@ -0,0 +1,322 @@
+// Checks the pieces used by spec to fill the histograms concurrently: the
+// pool of workers, that is reused for every message, the batch fills of the
+// histograms, and the merge of the partial histograms limited to the tiles
+// that were filled, that shall give the same histograms of a merge of all the
+// bins.
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <random>
+#include <limits>
+#include <cstring>
+
+#define counter_type double
+
+extern "C" {
+#include "histogram.h"
+#include "histogram2D.h"
+}
+
+#include "workers_pool.hpp"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+static void test_pool(unsigned int threads_number)
+{
+    workers_pool pool(threads_number);
+
+    CHECK(pool.size() == threads_number + 1);
+
+    std::vector<unsigned long int> sums(pool.size(), 0);
+
+    // Many runs, with a varying number of jobs, so that the threads without a
+    // job at a run shall still take the following ones
+    for (unsigned int run = 0; run < 2000; run++)
+    {
+        const size_t jobs_number = 1 + run % pool.size();
+
+        std::vector<std::function<void()>> jobs;
+
+        for (size_t j = 0; j < jobs_number; j++)
+        {
+            jobs.push_back([&sums, j, run]{ sums[j] += run; });
+        }
+
+        pool.run(jobs);
+    }
+
+    for (size_t j = 0; j < pool.size(); j++)
+    {
+        unsigned long int expected = 0;
+
+        for (unsigned int run = 0; run < 2000; run++)
+        {
+            if (j < 1 + run % pool.size())
+            {
+                expected += run;
+            }
+        }
+
+        CHECK(sums[j] == expected);
+    }
+
+    std::vector<std::function<void()>> empty_jobs;
+    pool.run(empty_jobs);
+}
+
+// Many short runs with fewer jobs than threads: the threads without a job
+// shall not look at the jobs of a run that already returned
+static void test_pool_stress(unsigned int threads_number)
+{
+    workers_pool pool(threads_number);
+
+    unsigned long int counter = 0;
+
+    for (unsigned int run = 0; run < 50000; run++)
+    {
+        std::vector<std::function<void()>> jobs;
+
+        jobs.push_back([&counter]{ counter += 1; });
+
+        if (run % 3 == 0)
+        {
+            jobs.push_back([]{});
+        }
+
+        pool.run(jobs);
+    }
+
+    CHECK(counter == 50000);
+}
+
+static bool same_histograms(const histogram2D_t *a, const histogram2D_t *b)
+{
+    for (unsigned int i_y = 0; i_y < a->bins_y; i_y++)
+    {
+        for (unsigned int i_x = 0; i_x < a->bins_x; i_x++)
+        {
+            if (histogram2D_get_bin(a, i_x, i_y) != histogram2D_get_bin(b, i_x, i_y))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// The batch fills shall give the same histograms of the fast fills, and the
+// values out of range, even those that do not fit in an integer, shall be
+// discarded
+static void test_batch_fills()
+{
+    // Same layout of the energies in the events
+    struct event
+    {
+        uint16_t qshort;
+        uint16_t qlong;
+        uint32_t padding;
+    };
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<unsigned int> energies(0, 0xFFFF);
+    std::uniform_real_distribution<double> values(-100, 1100);
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    const double special_values[] = {std::numeric_limits<double>::quiet_NaN(), infinity, -infinity,
+                                     1e300, -1e300, 1e10, -1e10, -0.5, 0, 1000, 999.99};
+
+    std::vector<struct event> events(1000);
+
+    for (auto &this_event: events)
+    {
+        this_event.qshort = energies(generator);
+        this_event.qlong = energies(generator) % 2000;
+    }
+
+    std::vector<double> values_x(1000);
+    std::vector<double> values_y(1000);
+
+    for (size_t i = 0; i < values_x.size(); i++)
+    {
+        values_x[i] = values(generator);
+        values_y[i] = values(generator);
+    }
+
+    for (size_t i = 0; i < sizeof(special_values) / sizeof(special_values[0]); i++)
+    {
+        values_x[i] = special_values[i];
+        values_y[values_y.size() - 1 - i] = special_values[i];
+    }
+
+    histogram_t *batch = histogram_create(1000, 0, 1000, 0);
+    histogram_t *reference = histogram_create(1000, 0, 1000, 0);
+
+    CHECK(histogram_fill_n_uint16(batch, &events[0].qlong, events.size(), sizeof(struct event)) == HISTOGRAM_OK);
+
+    for (const auto &this_event: events)
+    {
+        histogram_fill_fast(reference, this_event.qlong);
+    }
+
+    CHECK(memcmp(batch->histo, reference->histo, batch->bins * sizeof(counter_type)) == 0);
+
+    CHECK(histogram_fill_n(batch, values_x.data(), values_x.size()) == HISTOGRAM_OK);
+
+    size_t in_range = 0;
+
+    for (const double value: values_x)
+    {
+        histogram_fill_fast(reference, value);
+
+        in_range += (0 <= value && value < 1000) ? 1 : 0;
+    }
+
+    for (const auto &this_event: events)
+    {
+        in_range += (this_event.qlong < 1000) ? 1 : 0;
+    }
+
+    CHECK(memcmp(batch->histo, reference->histo, batch->bins * sizeof(counter_type)) == 0);
+    CHECK(histogram_get_integral(batch) == in_range);
+
+    histogram_destroy(batch);
+    histogram_destroy(reference);
+
+    for (const histogram2D_storage_t storage: {HISTOGRAM2D_STORAGE_DENSE, HISTOGRAM2D_STORAGE_TILED})
+    {
+        histogram2D_t *batch_2D = histogram2D_create_with_storage(300, 0, 1000, 200, 0, 1000, storage, 0);
+        histogram2D_t *reference_2D = histogram2D_create_with_storage(300, 0, 1000, 200, 0, 1000, storage, 0);
+
+        std::vector<int> tile_indexes(values_x.size());
+
+        CHECK(histogram2D_fill_n(batch_2D, values_x.data(), values_y.data(), values_x.size(), tile_indexes.data()) == HISTOGRAM2D_OK);
+
+        for (size_t i = 0; i < values_x.size(); i++)
+        {
+            CHECK(tile_indexes[i] == histogram2D_fill_fast(reference_2D, values_x[i], values_y[i]));
+        }
+
+        CHECK(same_histograms(batch_2D, reference_2D));
+
+        histogram2D_destroy(batch_2D);
+        histogram2D_destroy(reference_2D);
+    }
+}
+
+static void test_tiles_merge(histogram2D_storage_t partial_storage,
+                             histogram2D_storage_t output_storage)
+{
+    // Sizes that are not multiples of the tiles, to check the borders
+    const unsigned int bins_x = 3 * HISTOGRAM2D_TILE_SIZE + 5;
+    const unsigned int bins_y = 2 * HISTOGRAM2D_TILE_SIZE + 7;
+
+    histogram2D_t *partial = histogram2D_create_with_storage(bins_x, 0, bins_x, bins_y, 0, bins_y, partial_storage, 0);
+    histogram2D_t *reference_partial = histogram2D_create_with_storage(bins_x, 0, bins_x, bins_y, 0, bins_y, partial_storage, 0);
+    histogram2D_t *output = histogram2D_create_with_storage(bins_x, 0, bins_x, bins_y, 0, bins_y, output_storage, 0);
+    histogram2D_t *reference = histogram2D_create_with_storage(bins_x, 0, bins_x, bins_y, 0, bins_y, output_storage, 0);
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> values(-10, bins_x + 10);
+
+    const unsigned int tiles_number = partial->tiles_x * partial->tiles_y;
+
+    for (unsigned int publication = 0; publication < 5; publication++)
+    {
+        std::vector<bool> flags(tiles_number, false);
+        std::vector<unsigned int> touched_tiles;
+
+        // A few events, in a region that changes at each publication
+        for (unsigned int i = 0; i < 200 * (publication + 1); i++)
+        {
+            const double x = (publication == 2) ? values(generator) / 4 : values(generator);
+            const double y = values(generator) * bins_y / bins_x;
+
+            const int tile_index = histogram2D_fill_fast(partial, x, y);
+            histogram2D_fill_fast(reference_partial, x, y);
+
+            if (tile_index >= 0)
+            {
+                CHECK(static_cast<unsigned int>(tile_index) < tiles_number);
+                CHECK(tile_index == static_cast<int>(histogram2D_get_tile_index(partial,
+                                                                                 static_cast<unsigned int>(x),
+                                                                                 static_cast<unsigned int>(y))));
+
+                if (!flags[tile_index])
+                {
+                    flags[tile_index] = true;
+                    touched_tiles.push_back(tile_index);
+                }
+            }
+        }
+
+        // The time decay of spec scales the output between the merges
+        histogram2D_scale_lazy(output, 0.5, 0);
+        histogram2D_scale_lazy(reference, 0.5, 0);
+
+        for (const unsigned int tile_index: touched_tiles)
+        {
+            CHECK(histogram2D_add_tile_to(output, partial, tile_index) == HISTOGRAM2D_OK);
+            CHECK(histogram2D_reset_tile(partial, tile_index) == HISTOGRAM2D_OK);
+        }
+
+        histogram2D_add_to(reference, reference_partial);
+        histogram2D_reset(reference_partial);
+
+        CHECK(same_histograms(output, reference));
+
+        // The partial histogram shall be empty again
+        for (unsigned int i_y = 0; i_y < bins_y; i_y++)
+        {
+            for (unsigned int i_x = 0; i_x < bins_x; i_x++)
+            {
+                CHECK(histogram2D_get_bin(partial, i_x, i_y) == 0);
+            }
+        }
+    }
+
+    CHECK(histogram2D_add_tile_to(output, partial, tiles_number) != HISTOGRAM2D_OK);
+    CHECK(histogram2D_reset_tile(partial, tiles_number) != HISTOGRAM2D_OK);
+
+    histogram2D_destroy(partial);
+    histogram2D_destroy(reference_partial);
+    histogram2D_destroy(output);
+    histogram2D_destroy(reference);
+}
+
+int main()
+{
+    test_pool(0);
+    test_pool(1);
+    test_pool(3);
+    test_pool(7);
+
+    test_pool_stress(1);
+    test_pool_stress(7);
+
+    test_batch_fills();
+
+    test_tiles_merge(HISTOGRAM2D_STORAGE_DENSE, HISTOGRAM2D_STORAGE_DENSE);
+    test_tiles_merge(HISTOGRAM2D_STORAGE_TILED, HISTOGRAM2D_STORAGE_TILED);
+    test_tiles_merge(HISTOGRAM2D_STORAGE_DENSE, HISTOGRAM2D_STORAGE_TILED);
+    test_tiles_merge(HISTOGRAM2D_STORAGE_TILED, HISTOGRAM2D_STORAGE_DENSE);
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
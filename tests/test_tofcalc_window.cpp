@@ -0,0 +1,201 @@
+// Checks the carry-over window of tofcalc, that looks for the coincidences
+// whose events arrive in different messages. Each coincidence shall be found
+// exactly once, however the events stream is split in messages.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <random>
+
+#include "typedefs.hpp"
+#include "actions.hpp"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+static const double min_ToF = -50;
+static const double max_ToF = 100;
+static const unsigned int target_channel = 1;
+
+// The reference channel is 0 and the coincidences are histogrammed only for
+// channel 1
+static void setup_status(status &global_status)
+{
+    global_status.ns_per_sample = 1;
+    global_status.reference_channels.insert(0);
+    global_status.reference_mask.set(0);
+
+    struct channel_histograms &histos = global_status.channels_histos[target_channel];
+
+    histos.ToF = histogram_create(150, min_ToF, max_ToF, 0);
+    histos.E = histogram_create(1024, 0, 1024, 0);
+    histos.EvsToF = histogram2D_create(150, min_ToF, max_ToF, 64, 0, 1024, 0);
+    histos.EvsE = histogram2D_create(64, 0, 1024, 64, 0, 1024, 0);
+
+    global_status.channels_counts.fill(0);
+}
+
+static void destroy_status(status &global_status)
+{
+    struct channel_histograms &histos = global_status.channels_histos[target_channel];
+
+    histogram_destroy(histos.ToF);
+    histogram_destroy(histos.E);
+    histogram2D_destroy(histos.EvsToF);
+    histogram2D_destroy(histos.EvsE);
+}
+
+static struct event_PSD make_event(uint64_t timestamp, uint8_t channel, uint16_t qlong)
+{
+    struct event_PSD event;
+
+    memset(&event, 0, sizeof(event));
+
+    event.timestamp = timestamp;
+    event.channel = channel;
+    event.qlong = qlong;
+
+    return event;
+}
+
+static size_t process(status &global_status, const std::vector<struct event_PSD> &events)
+{
+    return actions::generic::process_events(global_status, events.data(), events.size(), min_ToF, max_ToF);
+}
+
+// The events of the forward window of a reference arrive with the next
+// message, the reference is processed only when its window is complete
+static void test_split_forward()
+{
+    status global_status;
+    setup_status(global_status);
+
+    size_t found_coincidences = 0;
+
+    found_coincidences += process(global_status, {make_event(1000, 0, 10)});
+    found_coincidences += process(global_status, {make_event(1050, 1, 20)});
+
+    CHECK(found_coincidences == 0);
+
+    found_coincidences += process(global_status, {make_event(2000, 1, 30)});
+
+    CHECK(found_coincidences == 1);
+
+    // The following messages shall not find it again
+    found_coincidences += process(global_status, {make_event(3000, 2, 40)});
+    found_coincidences += process(global_status, {make_event(4000, 2, 50)});
+
+    CHECK(found_coincidences == 1);
+    CHECK(global_status.channels_counts[target_channel] == 1);
+    CHECK(histogram_get_integral(global_status.channels_histos[target_channel].ToF) == 1);
+
+    destroy_status(global_status);
+}
+
+// The event of the backward window of a reference arrived with the previous
+// message
+static void test_split_backward()
+{
+    status global_status;
+    setup_status(global_status);
+
+    size_t found_coincidences = 0;
+
+    found_coincidences += process(global_status, {make_event(1000, 1, 20)});
+    found_coincidences += process(global_status, {make_event(1030, 0, 10), make_event(3000, 2, 30)});
+    found_coincidences += process(global_status, {make_event(4000, 2, 40)});
+
+    CHECK(found_coincidences == 1);
+    CHECK(global_status.channels_counts[target_channel] == 1);
+
+    destroy_status(global_status);
+}
+
+// A sorted stream of events split in messages at random positions, every
+// split shall give the coincidences of the whole stream
+static void test_random_splits()
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<unsigned int> steps(0, 40);
+    std::uniform_int_distribution<unsigned int> channels(0, 2);
+    std::uniform_int_distribution<unsigned int> energies(0, 1023);
+
+    std::vector<struct event_PSD> events;
+    uint64_t timestamp = 1000;
+
+    for (size_t i = 0; i < 5000; i++)
+    {
+        // Many events closer than the window, with some gaps
+        timestamp += (steps(generator) == 0) ? 1000 : steps(generator);
+
+        events.push_back(make_event(timestamp, channels(generator), energies(generator)));
+    }
+
+    // The last event completes the windows of all the references
+    events.push_back(make_event(timestamp + 1000, 2, 0));
+
+    status expected_status;
+    setup_status(expected_status);
+
+    const size_t expected_coincidences = process(expected_status, events);
+
+    CHECK(expected_coincidences > 0);
+
+    for (unsigned int split = 0; split < 50; split++)
+    {
+        status global_status;
+        setup_status(global_status);
+
+        // From messages with a single event to messages with most events
+        std::uniform_int_distribution<size_t> sizes(1, (split % 2 == 0) ? 5 : 1000);
+
+        size_t found_coincidences = 0;
+
+        for (size_t start = 0; start < events.size();)
+        {
+            const size_t size = std::min(sizes(generator), events.size() - start);
+
+            const std::vector<struct event_PSD> message(events.begin() + start, events.begin() + start + size);
+
+            found_coincidences += process(global_status, message);
+
+            start += size;
+        }
+
+        CHECK(found_coincidences == expected_coincidences);
+        CHECK(global_status.channels_counts[target_channel] == expected_status.channels_counts[target_channel]);
+
+        const histogram_t *expected_ToF = expected_status.channels_histos[target_channel].ToF;
+        const histogram_t *ToF = global_status.channels_histos[target_channel].ToF;
+
+        CHECK(memcmp(ToF->histo, expected_ToF->histo, ToF->bins * sizeof(counter_type)) == 0);
+
+        destroy_status(global_status);
+    }
+
+    destroy_status(expected_status);
+}
+
+int main()
+{
+    test_split_forward();
+    test_split_backward();
+    test_random_splits();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
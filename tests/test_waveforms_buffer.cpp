@@ -0,0 +1,294 @@
+// Checks the waveforms_buffer writers, in particular the concurrent writers
+// used by the parallel readout of absp: several boards write in the same
+// buffer from their own threads, a failed readout is discarded and the final
+// buffer must contain exactly the records of the successful readouts.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <thread>
+#include <memory>
+
+#include "waveforms_buffer.hpp"
+
+static unsigned int failures = 0;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures += 1; \
+    }
+
+struct record_info
+{
+    uint64_t timestamp;
+    uint8_t channel;
+    uint32_t samples_number;
+    uint8_t additional_waveforms;
+    bool samples_correct;
+};
+
+static uint16_t sample_value(uint64_t timestamp, uint32_t index)
+{
+    return static_cast<uint16_t>(timestamp * 7 + index);
+}
+
+static std::vector<record_info> parse(const std::vector<uint8_t> &buffer)
+{
+    std::vector<record_info> records;
+
+    size_t offset = 0;
+
+    while (offset < buffer.size())
+    {
+        const uint8_t *const record = buffer.data() + offset;
+
+        record_info info;
+
+        memcpy(&info.timestamp, record + waveforms_buffer::timestamp_offset, sizeof(info.timestamp));
+        info.channel = waveforms_buffer::get_channel(record);
+        memcpy(&info.samples_number, record + waveforms_buffer::samples_number_offset, sizeof(info.samples_number));
+        memcpy(&info.additional_waveforms, record + waveforms_buffer::additional_waveforms_offset, sizeof(info.additional_waveforms));
+
+        info.samples_correct = true;
+
+        for (uint32_t i = 0; i < info.samples_number; i++)
+        {
+            uint16_t sample;
+            memcpy(&sample, record + waveforms_buffer::header_size + i * sizeof(uint16_t), sizeof(sample));
+
+            if (sample != sample_value(info.timestamp, i))
+            {
+                info.samples_correct = false;
+            }
+        }
+
+        for (uint8_t a = 0; a < info.additional_waveforms; a++)
+        {
+            for (uint32_t i = 0; i < info.samples_number; i++)
+            {
+                const uint8_t value = record[waveforms_buffer::header_size
+                                             + sizeof(uint16_t) * info.samples_number
+                                             + info.samples_number * a + i];
+
+                if (value != static_cast<uint8_t>(a + i))
+                {
+                    info.samples_correct = false;
+                }
+            }
+        }
+
+        records.push_back(info);
+
+        offset += waveforms_buffer::record_size(record);
+    }
+
+    return records;
+}
+
+// Emulates the readout of a board, writing records with a varying size
+static void read_board(waveforms_buffer::writer &waveforms,
+                       unsigned int board,
+                       unsigned int records_number,
+                       bool fail)
+{
+    for (unsigned int n = 0; n < records_number; n++)
+    {
+        const uint64_t timestamp = board * 1000000 + n;
+        const uint8_t channel = n % 4;
+        const uint32_t samples_number = 16 + (n * 37 + board * 11) % 300;
+        const uint8_t additional_waveforms = (n % 5 == 0) ? 2 : 0;
+
+        uint16_t *const samples = waveforms.append(timestamp, channel, samples_number, additional_waveforms);
+
+        for (uint32_t i = 0; i < samples_number; i++)
+        {
+            samples[i] = sample_value(timestamp, i);
+        }
+
+        for (uint8_t a = 0; a < additional_waveforms; a++)
+        {
+            uint8_t *const additional = waveforms.additional(a);
+
+            for (uint32_t i = 0; i < samples_number; i++)
+            {
+                additional[i] = static_cast<uint8_t>(a + i);
+            }
+        }
+
+        // Letting the other threads claim their records in between
+        if (n % 64 == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    if (fail)
+    {
+        waveforms.discard();
+    }
+
+    waveforms.close();
+}
+
+static void test_sequential()
+{
+    std::vector<uint8_t> buffer;
+
+    {
+        waveforms_buffer::writer waveforms(buffer);
+        read_board(waveforms, 0, 10, false);
+
+        CHECK(waveforms.get_records_number() == 10);
+        CHECK(waveforms.size() == buffer.size());
+    }
+
+    const size_t size_before = buffer.size();
+
+    {
+        waveforms_buffer::writer waveforms(buffer, 4);
+        read_board(waveforms, 1, 10, true);
+
+        CHECK(waveforms.get_records_number() == 0);
+        CHECK(buffer.size() == size_before);
+    }
+
+    {
+        waveforms_buffer::writer waveforms(buffer, 8);
+        read_board(waveforms, 2, 5, false);
+    }
+
+    const std::vector<record_info> records = parse(buffer);
+
+    CHECK(records.size() == 15);
+
+    for (const auto &record: records)
+    {
+        CHECK(record.samples_correct);
+
+        const unsigned int board = record.timestamp / 1000000;
+
+        CHECK(board == 0 || board == 2);
+        CHECK(record.channel / 4 == (board == 0 ? 0 : 2));
+    }
+}
+
+static void test_concurrent(unsigned int boards_number, unsigned int records_number)
+{
+    std::vector<uint8_t> buffer;
+
+    // Some data from a previous readout, that must be preserved
+    {
+        waveforms_buffer::writer waveforms(buffer);
+        read_board(waveforms, 99, 3, false);
+    }
+
+    const size_t previous_size = buffer.size();
+
+    waveforms_buffer::concurrent_buffer shared_buffer(buffer);
+
+    std::vector<std::unique_ptr<waveforms_buffer::writer>> writers;
+    std::vector<std::thread> threads;
+
+    for (unsigned int board = 0; board < boards_number; board++)
+    {
+        writers.push_back(std::make_unique<waveforms_buffer::writer>(shared_buffer, board * 4));
+    }
+
+    for (unsigned int board = 0; board < boards_number; board++)
+    {
+        // The board 1 fails its readout
+        threads.emplace_back(read_board, std::ref(*writers[board]), board, records_number, board == 1);
+    }
+
+    for (auto &thread: threads)
+    {
+        thread.join();
+    }
+
+    size_t expected_size = previous_size;
+
+    for (unsigned int board = 0; board < boards_number; board++)
+    {
+        if (board == 1)
+        {
+            CHECK(writers[board]->records.empty());
+            CHECK(writers[board]->get_records_number() == 0);
+        }
+        else
+        {
+            CHECK(writers[board]->records.size() == records_number);
+
+            // The offsets recorded by the writers point to its own records
+            for (const auto &entry: writers[board]->records)
+            {
+                CHECK(waveforms_buffer::get_channel(buffer.data() + entry.first) / 4 == board);
+                CHECK(waveforms_buffer::record_size(buffer.data() + entry.first) == entry.second);
+            }
+        }
+
+        expected_size += writers[board]->size();
+    }
+
+    shared_buffer.finish();
+
+    CHECK(buffer.size() == expected_size);
+
+    const std::vector<record_info> records = parse(buffer);
+
+    std::map<unsigned int, unsigned int> records_per_board;
+
+    for (size_t index = 0; index < records.size(); index++)
+    {
+        const record_info &record = records[index];
+        const unsigned int board = record.timestamp / 1000000;
+
+        CHECK(record.samples_correct);
+
+        if (index < 3)
+        {
+            CHECK(board == 99);
+            CHECK(record.channel == record.timestamp % 4);
+        }
+        else
+        {
+            CHECK(board != 1);
+            CHECK(record.channel / 4 == board);
+        }
+
+        records_per_board[board] += 1;
+    }
+
+    CHECK(records_per_board[99] == 3);
+    CHECK(records_per_board.count(1) == 0);
+
+    for (unsigned int board = 0; board < boards_number; board++)
+    {
+        if (board != 1)
+        {
+            CHECK(records_per_board[board] == records_number);
+        }
+    }
+}
+
+int main()
+{
+    test_sequential();
+
+    test_concurrent(2, 10);
+    test_concurrent(4, 1000);
+    test_concurrent(8, 3000);
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "Failed checks: %u\n", failures);
+
+        return 1;
+    }
+
+    printf("All checks passed\n");
+
+    return 0;
+}
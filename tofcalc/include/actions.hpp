@@ -14,6 +14,8 @@ namespace actions
         void publish_message(status&, std::string, json_t*);
         bool publish_status(status&);
         bool publish_data(status&);
+        bool publish_deltas(status&);
+        size_t process_events(status&, const struct event_PSD*, size_t, double, double);
         bool read_socket(status&);
     }
 
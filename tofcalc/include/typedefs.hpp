@@ -7,8 +7,12 @@
 #include <map>
 #include <cstdint>
 #include <set>
+#include <vector>
+#include <array>
+#include <bitset>
 
 #include "defaults.h"
+#include "histograms_deltas.hpp"
 
 #define counter_type double
 
@@ -17,8 +21,18 @@ extern "C" {
 
 #include "histogram.h"
 #include "histogram2D.h"
+#include "events.h"
 }
 
+// Histograms of a channel, to access them without the maps lookups
+struct channel_histograms
+{
+    histogram_t *ToF = nullptr;
+    histogram_t *E = nullptr;
+    histogram2D_t *EvsToF = nullptr;
+    histogram2D_t *EvsE = nullptr;
+};
+
 struct status
 {
     std::string status_address = defaults_tofcalc_status_address;
@@ -63,6 +77,30 @@ struct status
     double time_decay_minimum = defaults_tofcalc_time_decay_minimum;
 
     bool disable_bidimensional_plots = false;
+    // Tiled storage of the bidimensional histograms, allocated only where they are filled
+    bool sparse_bidimensional_plots = false;
+
+    // The histograms may be published as JSON and/or as binary deltas
+    bool publish_json = true;
+    bool publish_binary = false;
+    histograms_deltas::publisher deltas_publisher = histograms_deltas::publisher(defaults_tofcalc_keyframe_period);
+
+    // Time sorted carry-over window of the events, so that the coincidences
+    // across two messages are not lost. It holds the references whose
+    // forward window is not complete yet, and the events that might be in
+    // their backward window.
+    std::vector<struct event_PSD> events_window;
+    // Scratch buffer of the radix sort of the messages
+    std::vector<struct event_PSD> sorting_buffer;
+    // Timestamp of the last processed reference
+    uint64_t processed_timestamp = 0;
+    bool processed_any = false;
+
+    // Tables indexed by the channel, updated from the maps at each read of
+    // the socket and used in the coincidences loops
+    std::bitset<256> reference_mask;
+    std::array<struct channel_histograms, 256> channels_histos;
+    std::array<unsigned int, 256> channels_counts;
 };
 
 struct state
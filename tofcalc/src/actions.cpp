@@ -28,6 +28,7 @@ extern "C" {
 #include "histogram.h"
 #include "histogram2D.h"
 #include "events.h"
+#include "radix_sort.h"
 }
 
 #define BUFFER_SIZE 32
@@ -37,6 +38,162 @@ bool before_than(const struct event_PSD event_a, const struct event_PSD event_b)
     return event_a.timestamp < event_b.timestamp;
 }
 
+//! Builds the tables indexed by the channel, that are used in the
+//! coincidences loops instead of the maps
+void update_channels_tables(status &global_status)
+{
+    global_status.reference_mask.reset();
+
+    for (const unsigned int &channel: global_status.reference_channels)
+    {
+        if (channel < global_status.reference_mask.size())
+        {
+            global_status.reference_mask.set(channel);
+        }
+    }
+
+    for (unsigned int channel = 0; channel < global_status.channels_histos.size(); channel++)
+    {
+        struct channel_histograms &histos = global_status.channels_histos[channel];
+
+        const auto histo_ToF_it = global_status.histos_ToF.find(channel);
+        const auto histo_E_it = global_status.histos_E.find(channel);
+        const auto histo_EvsToF_it = global_status.histos_EvsToF.find(channel);
+        const auto histo_EvsE_it = global_status.histos_EvsE.find(channel);
+
+        histos.ToF = (histo_ToF_it != global_status.histos_ToF.end()) ? histo_ToF_it->second : nullptr;
+        histos.E = (histo_E_it != global_status.histos_E.end()) ? histo_E_it->second : nullptr;
+        histos.EvsToF = (histo_EvsToF_it != global_status.histos_EvsToF.end()) ? histo_EvsToF_it->second : nullptr;
+        histos.EvsE = (histo_EvsE_it != global_status.histos_EvsE.end()) ? histo_EvsE_it->second : nullptr;
+    }
+
+    global_status.channels_counts.fill(0);
+}
+
+//! Fills the histograms of the target channel with a coincidence.
+//! Returns true if the coincidence was within the histograms ranges.
+inline bool fill_coincidence(status &global_status,
+                             const struct event_PSD &reference_event,
+                             const struct event_PSD &target_event,
+                             double time_of_flight)
+{
+    const struct channel_histograms &histos = global_status.channels_histos[target_event.channel];
+
+    // This is not really an error as a user might not be interested on
+    // the ToF of this channel
+    if (!histos.ToF || !histos.E || !histos.EvsToF || !histos.EvsE) {
+        if (global_status.verbosity > 1) {
+            char time_buffer[BUFFER_SIZE];
+            time_string(time_buffer, BUFFER_SIZE, NULL);
+            std::cout << '[' << time_buffer << "] ";
+            std::cout << "WARNING: Unable to get histo for channel: " << target_event.channel << "; ";
+            std::cout << std::endl;
+        }
+
+        return false;
+    }
+
+    if (global_status.verbosity > 1)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "Coincidence!; ";
+        std::cout << "reference channel: " << (unsigned int)reference_event.channel << "; ";
+        std::cout << "channel: " << (unsigned int)target_event.channel << "; ";
+        std::cout << "ToF: " << time_of_flight << "; ";
+        std::cout << std::endl;
+    }
+
+    if (histos.EvsToF->min_x <= time_of_flight && time_of_flight < histos.EvsToF->max_x &&
+        histos.EvsToF->min_y <= target_event.qlong && target_event.qlong < histos.EvsToF->max_y) {
+        histogram_fill_fast(histos.ToF, time_of_flight);
+        histogram_fill_fast(histos.E, target_event.qlong);
+        histogram2D_fill_fast(histos.EvsToF, time_of_flight, target_event.qlong);
+        histogram2D_fill_fast(histos.EvsE, target_event.qlong, reference_event.qlong);
+        global_status.channels_counts[target_event.channel] += 1;
+
+        return true;
+    }
+
+    return false;
+}
+
+//! Looks for the coincidences of the reference events in the interval
+//! [first, last) of the events window, with all the events of the window.
+//! The window is swept with two indexes that delimit the events within
+//! [min_ToF, max_ToF) of the current reference. As the references are time
+//! sorted the indexes only move forward, thus the cost is linear in the
+//! number of events plus the number of events in the windows.
+//! Returns the number of coincidences found.
+size_t search_coincidences(status &global_status,
+                           size_t first,
+                           size_t last,
+                           double min_ToF,
+                           double max_ToF)
+{
+    const std::vector<struct event_PSD> &window = global_status.events_window;
+    const std::bitset<256> &reference_mask = global_status.reference_mask;
+    const double ns_per_sample = global_status.ns_per_sample;
+    const size_t window_size = window.size();
+
+    size_t found_coincidences = 0;
+
+    // The first event with time_of_flight >= min_ToF
+    size_t begin = 0;
+    // The first event with time_of_flight >= max_ToF
+    size_t end = 0;
+
+    for (size_t i = first; i < last; i++)
+    {
+        const struct event_PSD this_event = window[i];
+
+        // If it is a reference channel we can look for the coincidences
+        if (!reference_mask[this_event.channel])
+        {
+            continue;
+        }
+
+        const int64_t this_timestamp = static_cast<int64_t>(this_event.timestamp);
+
+        while (begin < window_size &&
+               (static_cast<int64_t>(window[begin].timestamp) - this_timestamp) * ns_per_sample < min_ToF)
+        {
+            begin += 1;
+        }
+
+        if (end < begin)
+        {
+            end = begin;
+        }
+
+        while (end < window_size &&
+               (static_cast<int64_t>(window[end].timestamp) - this_timestamp) * ns_per_sample < max_ToF)
+        {
+            end += 1;
+        }
+
+        for (size_t j = begin; j < end; j++)
+        {
+            const struct event_PSD that_event = window[j];
+
+            // If it is not a reference channel we can tag this as a coincidence
+            if (j != i && !reference_mask[that_event.channel])
+            {
+                const double time_of_flight = (static_cast<int64_t>(that_event.timestamp) - this_timestamp)
+                                              * ns_per_sample;
+
+                if (fill_coincidence(global_status, this_event, that_event, time_of_flight))
+                {
+                    found_coincidences += 1;
+                }
+            }
+        }
+    }
+
+    return found_coincidences;
+}
+
 /******************************************************************************/
 /* Generic actions                                                            */
 /******************************************************************************/
@@ -92,6 +249,12 @@ void actions::generic::clear_memory(status &global_status)
 
     global_status.counts_partial.clear();
     global_status.counts_total.clear();
+
+    global_status.events_window.clear();
+    global_status.processed_any = false;
+
+    // The clients need a keyframe after a reconfiguration
+    global_status.deltas_publisher.reset();
 }
 
 void actions::generic::publish_message(status &global_status,
@@ -278,15 +441,13 @@ bool actions::generic::publish_status(status &global_status)
                     std::cout << std::endl;
                 }
 
-                histogram_scale(histo_ToF, time_decay_constant);
-                histogram_scale(histo_E, time_decay_constant);
-                histogram2D_scale(histo_EvsToF, time_decay_constant);
-                histogram2D_scale(histo_EvsE, time_decay_constant);
-
-                histogram_counts_clear_minimum(histo_ToF, global_status.time_decay_minimum);
-                histogram_counts_clear_minimum(histo_E, global_status.time_decay_minimum);
-                histogram2D_counts_clear_minimum(histo_EvsToF, global_status.time_decay_minimum);
-                histogram2D_counts_clear_minimum(histo_EvsE, global_status.time_decay_minimum);
+                // The decay is accumulated in the weights of the histograms,
+                // the bins are updated and cleared from the counts below the
+                // minimum only when the weights drift too much.
+                histogram_scale_lazy(histo_ToF, time_decay_constant, global_status.time_decay_minimum);
+                histogram_scale_lazy(histo_E, time_decay_constant, global_status.time_decay_minimum);
+                histogram2D_scale_lazy(histo_EvsToF, time_decay_constant, global_status.time_decay_minimum);
+                histogram2D_scale_lazy(histo_EvsE, time_decay_constant, global_status.time_decay_minimum);
             }
         }
     }
@@ -296,6 +457,16 @@ bool actions::generic::publish_status(status &global_status)
 
 bool actions::generic::publish_data(status &global_status)
 {
+    if (global_status.publish_binary)
+    {
+        actions::generic::publish_deltas(global_status);
+    }
+
+    if (!global_status.publish_json)
+    {
+        return true;
+    }
+
     json_t *status_message = json_object();
     if (status_message == NULL)
     {
@@ -450,8 +621,264 @@ bool actions::generic::publish_data(status &global_status)
     return true;
 }
 
+bool actions::generic::publish_deltas(status &global_status)
+{
+    histograms_deltas::publisher &deltas_publisher = global_status.deltas_publisher;
+
+    json_t *header = json_object();
+    json_t *reference_channels = json_array();
+    json_t *active_channels = json_array();
+    json_t *channels_data = json_array();
+
+    if (header == NULL || reference_channels == NULL || active_channels == NULL || channels_data == NULL)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "ERROR: Unable to create deltas header json; ";
+        std::cout << std::endl;
+
+        json_decref(header);
+        json_decref(reference_channels);
+        json_decref(active_channels);
+        json_decref(channels_data);
+
+        return false;
+    }
+
+    const auto now = std::chrono::system_clock::now();
+    const auto pub_delta_time = std::chrono::duration_cast<std::chrono::duration<long int>>(now - global_status.last_publication);
+    const double pubtime = static_cast<double>(pub_delta_time.count());
+
+    deltas_publisher.begin();
+
+    for (const unsigned int &channel: global_status.reference_channels)
+    {
+        json_array_append_new(reference_channels, json_integer(channel));
+
+        json_t *channel_data = json_object();
+
+        json_object_set_new_nocheck(channel_data, "id", json_integer(channel));
+        json_object_set_new_nocheck(channel_data, "enabled", json_true());
+        json_object_set_new_nocheck(channel_data, "reference", json_true());
+
+        json_array_append_new(channels_data, channel_data);
+    }
+
+    for (const unsigned int &channel: global_status.active_channels)
+    {
+        histogram_t *const histo_ToF = global_status.histos_ToF[channel];
+        histogram_t *const histo_E = global_status.histos_E[channel];
+        histogram2D_t *const histo_EvsToF = global_status.histos_EvsToF[channel];
+        histogram2D_t *const histo_EvsE = global_status.histos_EvsE[channel];
+        const unsigned int channel_total_counts = global_status.counts_total[channel];
+        const unsigned int channel_partial_counts = global_status.counts_partial[channel];
+        const double channel_rate = channel_partial_counts / pubtime;
+
+        if (histo_ToF && histo_E && histo_EvsToF && histo_EvsE) {
+            const std::string channel_key = std::to_string(channel);
+
+            json_t *histo_ToF_data = deltas_publisher.add(channel_key + "/ToF", histo_ToF->histo, histo_ToF->bins, histo_ToF->scale);
+            json_object_set_new_nocheck(histo_ToF_data, "config", histogram_config_to_json(histo_ToF));
+
+            json_t *histo_E_data = deltas_publisher.add(channel_key + "/energy", histo_E->histo, histo_E->bins, histo_E->scale);
+            json_object_set_new_nocheck(histo_E_data, "config", histogram_config_to_json(histo_E));
+
+            json_t *channel_data = json_object();
+
+            json_object_set_new_nocheck(channel_data, "id", json_integer(channel));
+            json_object_set_new_nocheck(channel_data, "enabled", json_true());
+            json_object_set_new_nocheck(channel_data, "reference", json_false());
+            json_object_set_new_nocheck(channel_data, "rate", json_real(channel_rate));
+            json_object_set_new_nocheck(channel_data, "counts", json_integer(channel_total_counts));
+            json_object_set_new_nocheck(channel_data, "ToF", histo_ToF_data);
+            json_object_set_new_nocheck(channel_data, "energy", histo_E_data);
+
+            if (!global_status.disable_bidimensional_plots) {
+                json_t *histo_EvsToF_data = deltas_publisher.add_histogram2D(channel_key + "/EvsToF", histo_EvsToF);
+                json_object_set_new_nocheck(histo_EvsToF_data, "config", histogram2D_config_to_json(histo_EvsToF));
+
+                json_t *histo_EvsE_data = deltas_publisher.add_histogram2D(channel_key + "/EvsE", histo_EvsE);
+                json_object_set_new_nocheck(histo_EvsE_data, "config", histogram2D_config_to_json(histo_EvsE));
+
+                json_object_set_new_nocheck(channel_data, "EvsToF", histo_EvsToF_data);
+                json_object_set_new_nocheck(channel_data, "EvsE", histo_EvsE_data);
+            }
+
+            json_array_append_new(channels_data, channel_data);
+
+            json_array_append_new(active_channels, json_integer(channel));
+        }
+    }
+
+    json_object_set_new_nocheck(header, "data", channels_data);
+    json_object_set_new_nocheck(header, "reference_channels", reference_channels);
+    json_object_set_new_nocheck(header, "active_channels", active_channels);
+
+    char time_buffer[BUFFER_SIZE];
+    time_string(time_buffer, BUFFER_SIZE, NULL);
+
+    json_object_set_new_nocheck(header, "module", json_string("tofcalc"));
+    json_object_set_new_nocheck(header, "timestamp", json_string(time_buffer));
+    json_object_set_new_nocheck(header, "msg_ID", json_integer(global_status.data_msg_ID));
+
+    std::vector<uint8_t> message;
+
+    const bool result = deltas_publisher.finish(header, message);
+
+    json_decref(header);
+
+    if (!result)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "ERROR: Unable to encode the deltas header; ";
+        std::cout << std::endl;
+
+        return false;
+    }
+
+    if (global_status.verbosity > 0)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "Publishing deltas; ";
+        std::cout << "Keyframe: " << (deltas_publisher.keyframe ? "true" : "false") << "; ";
+        std::cout << "Payload size: " << deltas_publisher.payload.size() << "; ";
+        std::cout << "Message size: " << message.size() << "; ";
+        std::cout << std::endl;
+    }
+
+    send_byte_message(global_status.data_socket, defaults_tofcalc_data_deltas_topic, message.data(), message.size(), 0);
+
+    // When both are published, the JSON message is sent with the same msg_ID
+    if (!global_status.publish_json)
+    {
+        global_status.data_msg_ID += 1;
+    }
+
+    return true;
+}
+
+//! Merges the sorted events of a message to the carry-over window and looks
+//! for the coincidences of the references whose forward window is complete.
+//! The references already processed with the previous messages are skipped,
+//! thus each coincidence is found only once even if its events are split
+//! across two messages.
+//! Returns the number of coincidences found.
+size_t actions::generic::process_events(status &global_status,
+                                        const struct event_PSD *events,
+                                        size_t events_number,
+                                        double min_ToF,
+                                        double max_ToF)
+{
+    const double ns_per_sample = global_status.ns_per_sample;
+
+    size_t found_coincidences = 0;
+
+    std::vector<struct event_PSD> &window = global_status.events_window;
+
+    // If the timestamps went back by more than the window, the
+    // acquisition was restarted and the old window is not related to
+    // the new events. The pending references are processed with the
+    // events that are available and the window starts anew.
+    if (events_number > 0 && global_status.processed_any &&
+        (static_cast<int64_t>(global_status.processed_timestamp)
+         -
+         static_cast<int64_t>(events[events_number - 1].timestamp))
+         * ns_per_sample > (max_ToF - min_ToF))
+    {
+        if (global_status.verbosity > 0)
+        {
+            char time_buffer[BUFFER_SIZE];
+            time_string(time_buffer, BUFFER_SIZE, NULL);
+            std::cout << '[' << time_buffer << "] ";
+            std::cout << "Timestamps went back, restarting the coincidences window; ";
+            std::cout << std::endl;
+        }
+
+        const auto first_pending = std::upper_bound(window.begin(), window.end(),
+                                                    global_status.processed_timestamp,
+                                                    [](uint64_t timestamp, const struct event_PSD &event) {
+                                                        return timestamp < event.timestamp;
+                                                    });
+
+        found_coincidences += search_coincidences(global_status,
+                                                  first_pending - window.begin(),
+                                                  window.size(),
+                                                  min_ToF, max_ToF);
+
+        window.clear();
+        global_status.processed_any = false;
+    }
+
+    // The sorted events are merged to the carry-over window, that is
+    // already sorted
+    const size_t previous_size = window.size();
+
+    window.insert(window.end(), events, events + events_number);
+    std::inplace_merge(window.begin(), window.begin() + previous_size, window.end(), before_than);
+
+    if (window.size() > 0)
+    {
+        const uint64_t last_timestamp = window.back().timestamp;
+
+        // The references already processed in the previous messages
+        // are skipped, thus each coincidence is found only once
+        size_t first = 0;
+
+        if (global_status.processed_any)
+        {
+            first = std::upper_bound(window.begin(), window.end(),
+                                     global_status.processed_timestamp,
+                                     [](uint64_t timestamp, const struct event_PSD &event) {
+                                         return timestamp < event.timestamp;
+                                     }) - window.begin();
+        }
+
+        // A reference is processed only when all the events of its
+        // forward window are available, the others are pending
+        const size_t last = std::partition_point(window.begin() + first, window.end(),
+                                                 [=](const struct event_PSD &event) {
+                                                     return (static_cast<int64_t>(last_timestamp)
+                                                             -
+                                                             static_cast<int64_t>(event.timestamp))
+                                                             * ns_per_sample >= max_ToF;
+                                                 }) - window.begin();
+
+        found_coincidences += search_coincidences(global_status, first, last, min_ToF, max_ToF);
+
+        if (last > first)
+        {
+            global_status.processed_timestamp = window[last - 1].timestamp;
+            global_status.processed_any = true;
+        }
+
+        // Only the events that might be in the backward window of the
+        // pending references are kept
+        const uint64_t pending_timestamp = (last < window.size()) ? window[last].timestamp : last_timestamp;
+        const double backward_ToF = std::min(min_ToF, 0.0);
+
+        const auto first_kept = std::partition_point(window.begin(), window.begin() + last,
+                                                     [=](const struct event_PSD &event) {
+                                                         return (static_cast<int64_t>(event.timestamp)
+                                                                 -
+                                                                 static_cast<int64_t>(pending_timestamp))
+                                                                 * ns_per_sample < backward_ToF;
+                                                     });
+
+        window.erase(window.begin(), first_kept);
+    }
+
+    return found_coincidences;
+}
+
 bool actions::generic::read_socket(status &global_status)
 {
+    update_channels_tables(global_status);
+
     double max_ToF = std::numeric_limits<double>::min();
     double min_ToF = std::numeric_limits<double>::max();
 
@@ -524,8 +951,6 @@ bool actions::generic::read_socket(status &global_status)
 
         if (topic_string.find(defaults_abcd_data_events_topic) == 0)
         {
-            const double ns_per_sample = global_status.ns_per_sample;
-
             const clock_t event_start = clock();
 
             const size_t data_size = size;
@@ -557,7 +982,9 @@ bool actions::generic::read_socket(status &global_status)
             }
 
             const auto sorting_start = std::chrono::high_resolution_clock::now();
-            std::sort(events, events + events_number, before_than);
+            global_status.sorting_buffer.resize(events_number);
+
+            radix_sort_events_PSD(events, events_number, global_status.sorting_buffer.data());
             const auto sorting_end = std::chrono::high_resolution_clock::now();
             const auto sorting_duration = std::chrono::duration_cast<std::chrono::microseconds>(sorting_end - sorting_start);
 
@@ -570,188 +997,15 @@ bool actions::generic::read_socket(status &global_status)
                 std::cout << std::endl;
             }
 
-            for (size_t i = 0; i < events_number; i++)
-            {
-                //std::cout << "i: " << i << "; Events number: " << events_number << "; " << std::endl;
-                const struct event_PSD this_event = events[i];
+            found_coincidences += process_events(global_status, events, events_number, min_ToF, max_ToF);
 
-                // If it is a reference channel we can look for the coincidences
-                if (std::find(global_status.reference_channels.begin(),
-                              global_status.reference_channels.end(),
-                              this_event.channel) != global_status.reference_channels.end())
-                {
-                    //std::cout << "Reference channel " << std::endl;
-
-                    for (intmax_t j = (i + 1); j < static_cast<int64_t>(events_number); j++)
-                    {
-                        //std::cout << "Forward:  i: " << i << "; j: " << j << std::endl;
-                        const struct event_PSD that_event = events[j];
-
-                        const double time_of_flight = (static_cast<int64_t>(that_event.timestamp)
-                                                       -
-                                                       static_cast<int64_t>(this_event.timestamp))
-                                                       * ns_per_sample;
-
-                        if (global_status.verbosity > 1)
-                        {
-                            char time_buffer[BUFFER_SIZE];
-                            time_string(time_buffer, BUFFER_SIZE, NULL);
-                            std::cout << '[' << time_buffer << "] ";
-                            std::cout << "Forward: ";
-                            std::cout << "i: " << i << "; ";
-                            std::cout << "ch: " << (int)this_event.channel << "; ";
-                            std::cout << "j: " << j << "; ";
-                            std::cout << "ch: " << (int)that_event.channel << "; ";
-                            std::cout << "time_of_flight: " << time_of_flight << "; ";
-                            std::cout << "ToF interval: [" << min_ToF << ", " << max_ToF << "]; ";
-                            std::cout << std::endl;
-                        }
-
-                        // We first look for the time window as it is the strongest requirement
-                        if (min_ToF <= time_of_flight && time_of_flight < max_ToF)
-                        {
-                            // If it is not a reference channel we can tag this as a coincidence
-                            if (std::find(global_status.reference_channels.begin(),
-                                          global_status.reference_channels.end(),
-                                          that_event.channel) == global_status.reference_channels.end())
-                            {
-                                if (global_status.verbosity > 1)
-                                {
-                                    char time_buffer[BUFFER_SIZE];
-                                    time_string(time_buffer, BUFFER_SIZE, NULL);
-                                    std::cout << '[' << time_buffer << "] ";
-                                    std::cout << "Forward coincidence!; ";
-                                    std::cout << "i: " << i << "; ";
-                                    std::cout << "channel: " << (unsigned int)this_event.channel << "; ";
-                                    std::cout << "j: " << j << "; ";
-                                    std::cout << "channel: " << (unsigned int)that_event.channel << "; ";
-                                    std::cout << "ToF: " << time_of_flight << "; ";
-                                    std::cout << std::endl;
-                                }
-
-                                histogram_t *const histo_ToF = global_status.histos_ToF[that_event.channel];
-                                histogram_t *const histo_E = global_status.histos_E[that_event.channel];
-                                histogram2D_t *const histo_EvsToF = global_status.histos_EvsToF[that_event.channel];
-                                histogram2D_t *const histo_EvsE = global_status.histos_EvsE[that_event.channel];
-
-                                // This is not really an error as a user might not be interested on
-                                // the ToF of this channel
-                                if (!histo_ToF || !histo_E || !histo_EvsToF || !histo_EvsE) {
-                                    if (global_status.verbosity > 1) {
-                                        char time_buffer[BUFFER_SIZE];
-                                        time_string(time_buffer, BUFFER_SIZE, NULL);
-                                        std::cout << '[' << time_buffer << "] ";
-                                        std::cout << "WARNING: Unable to get histo for channel: " << that_event.channel << "; ";
-                                        std::cout << std::endl;
-                                    }
-                                }
-                                else
-                                {
-                                    if (histo_EvsToF->min_x <= time_of_flight && time_of_flight < histo_EvsToF->max_x &&
-                                        histo_EvsToF->min_y <= that_event.qlong && that_event.qlong < histo_EvsToF->max_y) {
-                                        histogram_fill(histo_ToF, time_of_flight);
-                                        histogram_fill(histo_E, that_event.qlong);
-                                        histogram2D_fill(histo_EvsToF, time_of_flight, that_event.qlong);
-                                        histogram2D_fill(histo_EvsE, that_event.qlong, this_event.qlong);
-                                        global_status.counts_partial[that_event.channel] += 1;
-                                        global_status.counts_total[that_event.channel] += 1;
-
-                                        found_coincidences += 1;
-                                    }
-                                }
-                            }
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
-
-                    for (intmax_t j = (i - 1); j > 0; j--)
-                    {
-                        //std::cout << "Backward:  i: " << i << "; j: " << j << std::endl;
-                        const struct event_PSD that_event = events[j];
-                        const double time_of_flight = (static_cast<int64_t>(that_event.timestamp)
-                                                       -
-                                                       static_cast<int64_t>(this_event.timestamp))
-                                                       * ns_per_sample;
-
-                        if (global_status.verbosity > 1)
-                        {
-                            char time_buffer[BUFFER_SIZE];
-                            time_string(time_buffer, BUFFER_SIZE, NULL);
-                            std::cout << '[' << time_buffer << "] ";
-                            std::cout << "Backward: ";
-                            std::cout << "i: " << i << "; ";
-                            std::cout << "ch: " << (int)this_event.channel << "; ";
-                            std::cout << "j: " << j << "; ";
-                            std::cout << "ch: " << (int)that_event.channel << "; ";
-                            std::cout << "time_of_flight: " << time_of_flight << "; ";
-                            std::cout << "ToF interval: [" << min_ToF << ", " << max_ToF << "]; ";
-                            std::cout << std::endl;
-                        }
-
-                        // We first look for the time window as it is the strongest requirement
-                        if (min_ToF <= time_of_flight && time_of_flight < max_ToF)
-                        {
-
-                            // If it is not a reference channel we can tag this as a coincidence
-                            if (std::find(global_status.reference_channels.begin(),
-                                          global_status.reference_channels.end(),
-                                          that_event.channel) == global_status.reference_channels.end())
-                            {
-                                if (global_status.verbosity > 1)
-                                {
-                                    char time_buffer[BUFFER_SIZE];
-                                    time_string(time_buffer, BUFFER_SIZE, NULL);
-                                    std::cout << '[' << time_buffer << "] ";
-                                    std::cout << "Backward coincidence!; ";
-                                    std::cout << "i: " << i << "; ";
-                                    std::cout << "channel: " << (unsigned int)this_event.channel << "; ";
-                                    std::cout << "j: " << j << "; ";
-                                    std::cout << "channel: " << (unsigned int)that_event.channel << "; ";
-                                    std::cout << "ToF: " << time_of_flight << "; ";
-                                    std::cout << std::endl;
-                                }
-
-                                histogram_t *const histo_ToF = global_status.histos_ToF[that_event.channel];
-                                histogram_t *const histo_E = global_status.histos_E[that_event.channel];
-                                histogram2D_t *const histo_EvsToF = global_status.histos_EvsToF[that_event.channel];
-                                histogram2D_t *const histo_EvsE = global_status.histos_EvsE[that_event.channel];
-
-                                // This is not really an error as a user might not be interested on
-                                // the ToF of this channel
-                                if (!histo_ToF || !histo_E || !histo_EvsToF) {
-                                    if (global_status.verbosity > 1) {
-                                        char time_buffer[BUFFER_SIZE];
-                                        time_string(time_buffer, BUFFER_SIZE, NULL);
-                                        std::cout << '[' << time_buffer << "] ";
-                                        std::cout << "WARNING: Unable to get histo for channel: " << this_event.channel << "; ";
-                                        std::cout << std::endl;
-                                    }
-                                }
-                                else
-                                {
-                                    if (histo_EvsToF->min_x <= time_of_flight && time_of_flight < histo_EvsToF->max_x &&
-                                        histo_EvsToF->min_y <= that_event.qlong && that_event.qlong < histo_EvsToF->max_y) {
-                                        histogram_fill(histo_ToF, time_of_flight);
-                                        histogram_fill(histo_E, that_event.qlong);
-                                        histogram2D_fill(histo_EvsToF, time_of_flight, that_event.qlong);
-                                        histogram2D_fill(histo_EvsE, that_event.qlong, this_event.qlong);
-                                        global_status.counts_partial[that_event.channel] += 1;
-                                        global_status.counts_total[that_event.channel] += 1;
-
-                                        found_coincidences += 1;
-                                    }
-                                }
-                            }
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
-                }
+            if (global_status.verbosity > 0)
+            {
+                char time_buffer[BUFFER_SIZE];
+                time_string(time_buffer, BUFFER_SIZE, NULL);
+                std::cout << '[' << time_buffer << "] ";
+                std::cout << "Events in the coincidences window: " << global_status.events_window.size() << "; ";
+                std::cout << std::endl;
             }
 
             const clock_t event_stop = clock();
@@ -782,6 +1036,16 @@ bool actions::generic::read_socket(status &global_status)
         result = receive_byte_message(abcd_data_socket, &topic, (void **)(&input_buffer), &size, true, global_status.verbosity);
     }
 
+    // The counts are accumulated in the table during the search
+    for (unsigned int channel = 0; channel < global_status.channels_counts.size(); channel++)
+    {
+        if (global_status.channels_counts[channel] > 0)
+        {
+            global_status.counts_partial[channel] += global_status.channels_counts[channel];
+            global_status.counts_total[channel] += global_status.channels_counts[channel];
+        }
+    }
+
     return true;
 }
 
@@ -1016,6 +1280,17 @@ state actions::read_config(status &global_status)
         json_object_set_new_nocheck(new_config, "time_decay", json_time_decay);
 
         json_object_set_new_nocheck(new_config, "disable_bidimensional_plots", json_false());
+        json_object_set_new_nocheck(new_config, "sparse_bidimensional_plots", json_false());
+        json_object_set_new_nocheck(new_config, "sparse_bidimensional_plots_note", json_string("Allocates the bidimensional histograms in tiles only where they are filled, reducing the memory usage of large histograms"));
+
+        json_object_set_new_nocheck(new_config, "publication_format", json_string("json"));
+        json_object_set_new_nocheck(new_config, "publication_format_note", json_string("Defines how the histograms are published, the binary format publishes only the bins that changed since the last publication"));
+        json_object_set_new_nocheck(new_config, "publication_format_possible_value0", json_string("json"));
+        json_object_set_new_nocheck(new_config, "publication_format_possible_value1", json_string("binary"));
+        json_object_set_new_nocheck(new_config, "publication_format_possible_value2", json_string("both"));
+
+        json_object_set_new_nocheck(new_config, "keyframe_period", json_integer(defaults_tofcalc_keyframe_period));
+        json_object_set_new_nocheck(new_config, "keyframe_period_note", json_string("Number of binary publications between two publications of the full histograms"));
 
         global_status.config = new_config;
     }
@@ -1062,6 +1337,64 @@ state actions::apply_config(status &global_status)
 
     global_status.disable_bidimensional_plots = disable_bidimensional_plots;
 
+    const bool sparse_bidimensional_plots = json_is_true(json_object_get(config, "sparse_bidimensional_plots"));
+
+    if (global_status.verbosity > 0) {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "Sparse bidimensional plots: " << (sparse_bidimensional_plots ? "true" : "false") << "; ";
+        std::cout << std::endl;
+    }
+
+    json_object_set_nocheck(config, "sparse_bidimensional_plots", (sparse_bidimensional_plots ? json_true() : json_false()));
+
+    global_status.sparse_bidimensional_plots = sparse_bidimensional_plots;
+
+    const char *cstr_publication_format = json_string_value(json_object_get(config, "publication_format"));
+    const std::string publication_format = cstr_publication_format ? std::string(cstr_publication_format) : std::string("json");
+
+    if (global_status.verbosity > 0)
+    {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "Found publication format: '" << publication_format << "'; ";
+        std::cout << std::endl;
+    }
+
+    if (publication_format == std::string("json")) {
+        global_status.publish_json = true;
+        global_status.publish_binary = false;
+    } else if (publication_format == std::string("binary")) {
+        global_status.publish_json = false;
+        global_status.publish_binary = true;
+    } else if (publication_format == std::string("both")) {
+        global_status.publish_json = true;
+        global_status.publish_binary = true;
+    } else {
+        char time_buffer[BUFFER_SIZE];
+        time_string(time_buffer, BUFFER_SIZE, NULL);
+        std::cout << '[' << time_buffer << "] ";
+        std::cout << "ERROR: Invalid publication format, found: '" << publication_format << "'; ";
+        std::cout << std::endl;
+
+        global_status.publish_json = true;
+        global_status.publish_binary = false;
+
+        json_object_set_new_nocheck(config, "publication_format", json_string("json"));
+    }
+
+    json_t *json_keyframe_period = json_object_get(config, "keyframe_period");
+
+    if (json_keyframe_period != NULL && json_is_integer(json_keyframe_period) && json_integer_value(json_keyframe_period) >= 0) {
+        global_status.deltas_publisher.keyframe_period = json_integer_value(json_keyframe_period);
+    } else {
+        global_status.deltas_publisher.keyframe_period = defaults_tofcalc_keyframe_period;
+    }
+
+    json_object_set_new_nocheck(config, "keyframe_period", json_integer(global_status.deltas_publisher.keyframe_period));
+
 
     json_t *json_time_decay = json_object_get(config, "time_decay");
 
@@ -1268,21 +1601,27 @@ state actions::apply_config(status &global_status)
                                                                       max_E,
                                                                       global_status.verbosity);
 
-                        global_status.histos_EvsToF[id] = histogram2D_create(bins_ToF,
-                                                                             min_ToF,
-                                                                             max_ToF,
-                                                                             bins_E,
-                                                                             min_E,
-                                                                             max_E,
-                                                                             global_status.verbosity);
-
-                        global_status.histos_EvsE[id] = histogram2D_create(bins_E,
-                                                                           min_E,
-                                                                           max_E,
-                                                                           bins_E,
-                                                                           min_E,
-                                                                           max_E,
-                                                                           global_status.verbosity);
+                        const histogram2D_storage_t storage = global_status.sparse_bidimensional_plots ?
+                                                              HISTOGRAM2D_STORAGE_TILED :
+                                                              HISTOGRAM2D_STORAGE_DENSE;
+
+                        global_status.histos_EvsToF[id] = histogram2D_create_with_storage(bins_ToF,
+                                                                                          min_ToF,
+                                                                                          max_ToF,
+                                                                                          bins_E,
+                                                                                          min_E,
+                                                                                          max_E,
+                                                                                          storage,
+                                                                                          global_status.verbosity);
+
+                        global_status.histos_EvsE[id] = histogram2D_create_with_storage(bins_E,
+                                                                                        min_E,
+                                                                                        max_E,
+                                                                                        bins_E,
+                                                                                        min_E,
+                                                                                        max_E,
+                                                                                        storage,
+                                                                                        global_status.verbosity);
 
                         global_status.counts_partial[id] = 0;
                         global_status.counts_total[id] = 0;